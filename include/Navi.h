@@ -25,9 +25,22 @@
 
 #include "NaviManager.h"
 #include "NaviDelegate.h"
+#include "NaviStats.h"
+#include "NaviAllocator.h"
+#include "NaviRecorder.h"
 
 namespace NaviLibrary
 {
+	/**
+	* Enumerates the ways a NaviMaterial can generate mipmaps for its texture. Used by Navi::setMipmapping.
+	*/
+	enum MipmapMode
+	{
+		NoMipmaps = 0,
+		SoftwareMipmaps,
+		HardwareMipmaps
+	};
+
 	/**
 	* The core component of NaviLibrary, an offscreen browser window rendered to a dynamic texture (encapsulated 
 	* as an Ogre Material) that can optionally be attached to an overlay and manipulated within a scene.
@@ -194,6 +207,91 @@ namespace NaviLibrary
 		*/
 		void setMaxUPS(unsigned int maxUPS = 0);
 
+		/**
+		* Paces this Navi's updates to every Nth display refresh (see NaviManager::setDisplayRefreshRate), this
+		* assumes that NaviManager::Update is called once per presented frame. Unlike Navi::setMaxUPS the
+		* cadence never drifts or aliases against the display. Navis are assigned to frames so that those
+		* sharing a rate don't all update on the same frame. Jitter is reported by Navi::getStats.
+		*
+		* @param	divisor		Update on one of every 'divisor' frames (e.g. 2 gives 30 updates per second at 60 Hz).
+		*						Set this to '0' to disable pacing (default).
+		*/
+		void setUpdateDivisor(unsigned int divisor = 0);
+
+		/**
+		* Returns the divisor set with Navi::setUpdateDivisor, or 0 if this Navi isn't paced.
+		*/
+		unsigned int getUpdateDivisor();
+
+		/**
+		* Toggles on-demand updating. An on-demand Navi is skipped entirely by NaviManager::Update (it isn't
+		* polled, rendered or uploaded) until it is woken up for a number of frames, which happens when:
+		* <ul>
+		* <li>the page calls Client.requestFrame(frameCount) (frameCount is optional and defaults to 1),
+		* <li>the application calls Navi::requestUpdates, Navi::evaluateJS or Navi::evaluateJSWithResult,
+		* <li>a page is loaded or input is injected into the Navi.
+		* </ul>
+		*
+		* @param	enabled		Whether or not this Navi should only update on demand (disabled by default).
+		*
+		* @param	wakeFrames	The number of frames to update for after JavaScript, loading or input wakes the Navi.
+		*/
+		void setOnDemandUpdates(bool enabled, unsigned int wakeFrames = 10);
+
+		/**
+		* Returns whether or not this Navi only updates on demand. (see Navi::setOnDemandUpdates)
+		*/
+		bool isUpdatingOnDemand();
+
+		/**
+		* Asks an on-demand Navi to update for a number of frames, this is what Client.requestFrame calls.
+		*
+		* @param	frameCount	The number of frames to update for.
+		*/
+		void requestUpdates(unsigned int frameCount = 1);
+
+		/**
+		* Generates a mipmap chain for this Navi's texture so that pages mapped onto distant surfaces don't
+		* alias or sample the full-resolution texture. (not applicable to Navis with an overlay)
+		*
+		* @param	mode	The mipmapping mode to use:
+		*					NoMipmaps - Only the base level is kept (default).
+		*					SoftwareMipmaps - Levels are box-filtered on the CPU, only the tiles covered by the
+		*						dirty region of the page are recomputed and uploaded.
+		*					HardwareMipmaps - The videocard regenerates the chain after every upload. If the
+		*						render system doesn't support this, SoftwareMipmaps is used instead.
+		*
+		* @param	maxRefreshPS	The maximum number of times per second the mip levels (below the base level) may
+		*							be refreshed with SoftwareMipmaps. Changes are accumulated in-between refreshes.
+		*							Set this to '0' to refresh them on every update (default).
+		*/
+		void setMipmapping(MipmapMode mode, unsigned int maxRefreshPS = 0);
+
+		/**
+		* Enables distance-based resolution scaling for this Navi. Every update, the projected screen size of the
+		* target (as seen by the camera given to NaviManager::setLODCamera) decides how many times the page's
+		* resolution is halved; the page is zoomed out accordingly so that its layout is unaffected. The derived
+		* UV's (see Navi::getDerivedUV) never change, so meshes built with them stay valid.
+		* (not applicable to Navis with an overlay)
+		*
+		* @param	target		The scene object that this NaviMaterial is applied to. Pass 0 to disable scaling
+		*						and return to full resolution.
+		*
+		* @param	maxLevel	The maximum number of times the resolution may be halved.
+		*/
+		void setLODTarget(Ogre::MovableObject* target, unsigned short maxLevel = 2);
+
+		/**
+		* Returns the number of times the resolution of this Navi is currently halved. (see Navi::setLODTarget)
+		*/
+		unsigned short getLODLevel();
+
+		/**
+		* Returns the performance counters of this Navi. Counters are only collected while statistics
+		* are enabled. (see NaviManager::setStatsEnabled)
+		*/
+		NaviStats getStats();
+
 		/**
 		* Toggles whether or not this Navi is movable. (not applicable to NaviMaterials)
 		*
@@ -396,6 +494,45 @@ namespace NaviLibrary
 		*/
 		void captureImage(const std::string& filename);
 
+		/**
+		* Starts recording every updated frame of this Navi. Frames are copied into a fixed pool of buffers
+		* and encoded on a background thread, so recording costs one memcpy per dirty frame on the main thread.
+		* Any previous recording of this Navi is stopped first. Must be called from the main thread.
+		*
+		* @param	filename	The file to write to. For PNGSequence this is the prefix of each image,
+		*						"name" produces "name_000000.png", "name_000001.png", ...
+		*
+		* @param	format	The format to write, either Y4MRecording or PNGSequence.
+		*
+		* @param	policy	What to do when every buffer is waiting to be encoded: DropFrames skips the new
+		*					frame, BlockOnFull stalls the update until a buffer is free.
+		*
+		* @param	bufferCount	The number of frames that may be waiting to be encoded.
+		*
+		* @param	frameRate	The frame rate of a Y4MRecording. Frames are repeated (or superseded) to match
+		*						this rate, since Navis only update when their page changes.
+		*
+		* @throws	Ogre::Exception::ERR_CANNOT_WRITE_TO_FILE	When the output file can't be created.
+		*/
+		void startRecording(const std::string& filename, RecordingFormat format = Y4MRecording, 
+			RecordingPolicy policy = DropFrames, unsigned int bufferCount = 8, unsigned int frameRate = 30);
+
+		/**
+		* Stops recording this Navi, waits for the queued frames to be encoded and closes the output. When called
+		* from a thread other than the main thread, the recording is stopped at the next NaviManager::Update.
+		*/
+		void stopRecording();
+
+		/**
+		* Returns whether or not this Navi is being recorded.
+		*/
+		bool isRecording();
+
+		/**
+		* Returns the progress of the current recording. (all zeros when not recording)
+		*/
+		NaviRecordingStats getRecordingStats();
+
 		/**
 		* Resizes this Navi to new dimensions.
 		*
@@ -451,12 +588,37 @@ namespace NaviLibrary
 		unsigned short texHeight;
 		size_t texDepth;
 		size_t texPitch;
-		std::map<std::string, NaviDelegate> delegateMap;
+		typedef std::map<std::string, NaviDelegate, std::less<std::string>, Impl::TaggedAllocator<std::pair<const std::string, NaviDelegate>, DelegateAllocations> > DelegateMap;
+		DelegateMap delegateMap;
 		Ogre::FilterOptions texFiltering;
 		std::pair<std::string, std::string> maskImageParameters;
 		bool tooltipsEnabled, needsForceRender, alwaysReceivesKeyboard;
 		bool hasInternalKeyboardFocus;
 		std::pair<int, int> resizeParameters;
+		MipmapMode mipmapMode;
+		unsigned int maxMipRefreshPS;
+		unsigned long lastMipRefreshTime;
+		unsigned char* mipChain;
+		unsigned short mipCount;
+		awe_rect pendingMipBounds;
+		Ogre::MovableObject* lodTarget;
+		unsigned short lodLevel, maxLODLevel, pendingLODLevel, pendingLODFrames;
+		int zoomPercent;
+		const unsigned char* stagingSource;
+		int stagingSourceWidth, stagingSourceHeight, stagingSourceRowSpan;
+		Impl::FrameTripleBuffer* browserFrames;
+		unsigned char* stagingBuffer;
+		size_t stagingPitch;
+		awe_rect stagingDirtyBounds;
+		NaviStats stats;
+		bool statsEnabled;
+		Navi* zOrderAbove, *zOrderBelow;
+		unsigned int updateDivisor, updatePhase;
+		unsigned long long lastPacedTime;
+		bool updatesOnDemand;
+		unsigned int wakeFrameCount;
+		volatile LONG pendingUpdateFrames;
+		Impl::FrameRecorder* recorder;
 
 		friend class NaviManager;
 
@@ -472,14 +634,64 @@ namespace NaviLibrary
 
 		void createMaterial();
 
+		void destroyWebView();
+
+		void renderFrame();
+
+		void publishFrame(const awe_renderbuffer* renderBuffer);
+
+		void focusWebView(bool isFocused);
+
+		void injectKeyboardEvent(UINT msg, WPARAM wParam, LPARAM lParam);
+
+		void injectWebViewMouseMove(int xPos, int yPos);
+
+		void attachRecorder(Impl::FrameRecorder* newRecorder);
+
+		void injectWebViewMouseDown();
+
+		void changeKeyboardFocus(bool isFocused);
+
+		void resizeWebView(int width, int height, int zoom);
+
+		void setWebViewTransparent(bool isTransparent);
+
+		void applyZoom(int zoom);
+
+		void evaluateJSInto(const std::string& javascript, const OSM::JSArguments& args, OSM::JSValue* result);
+
+		void createTexture();
+
+		void recreateTexture();
+
 		void loadResource(Ogre::Resource* resource);
 
 		void update();
 
+		bool prepareUpdate();
+
+		void copyRows(int startRow, int endRow);
+
+		void extractAlphaRows(int startRow, int endRow);
+
+		void finishUpdate();
+
+		void updateMipmaps(bool forceRefresh);
+
+		void updateLOD(Ogre::Camera* camera, Ogre::Viewport* viewport);
+
+		void setLODLevel(unsigned short level);
+
 		void updateFade();
 
 		void resizeIfNeeded();
 
+		void wakeUpdates();
+
+		bool hasUpdateRequest();
+
+		void consumeUpdateRequest();
+
 		bool isPointOverMe(int x, int y);
 
 
@@ -566,6 +778,8 @@ namespace NaviLibrary
 								 awe_rect caretRect);
 
 		virtual void onRequestDrag(Navi *caller, const OSM::JSArguments &args);
+
+		virtual void onRequestFrame(Navi *caller, const OSM::JSArguments &args);
 	};
 }
 
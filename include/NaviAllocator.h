@@ -0,0 +1,147 @@
+#ifndef __NaviAllocator_H__
+#define __NaviAllocator_H__
+
+/*
+	This file is part of NaviLibrary, a library that allows developers to create and 
+	interact with web-content as an overlay or material in Ogre3D applications.
+
+	Copyright (C) 2011 Khrona LLC
+	https://github.com/khrona/navi
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "NaviPlatform.h"
+#include <cstddef>
+#include <limits>
+#include <new>
+
+namespace NaviLibrary
+{
+	/**
+	* Identifies the subsystem that an internal allocation belongs to. (see NaviAllocator)
+	*/
+	enum AllocationTag
+	{
+		/// Temporary buffers used to convert strings (OSM::String::str/wstr, NaviUtilities::toWide/toMultibyte).
+		StringAllocations = 0,
+		/// Nodes of each Navi's map of bound callbacks.
+		DelegateAllocations,
+		/// Nodes of NaviManager's map of active Navis.
+		NaviMapAllocations,
+		/// Nodes of NaviManager's queue of pending JS callbacks.
+		CallbackAllocations,
+		/// Commands passed between the main thread and the browser thread.
+		CommandAllocations,
+		/// Temporary arrays of values used to build JS arrays (CreateJSValueFromArray).
+		JSArrayAllocations,
+
+		AllocationTagCount
+	};
+
+	/**
+	* Inherit from this class to route NaviLibrary's internal allocations through your own allocator.
+	* Allocations may be made from any NaviLibrary thread, so implementations must be thread-safe.
+	* (see setNaviAllocator)
+	*/
+	class _NaviExport NaviAllocator
+	{
+	public:
+		virtual ~NaviAllocator() {}
+
+		virtual void* allocate(size_t size, AllocationTag tag) = 0;
+
+		virtual void deallocate(void* pointer, size_t size, AllocationTag tag) = 0;
+	};
+
+	/**
+	* The number of allocations (and bytes) made for each AllocationTag. (see NaviManager::getFrameAllocations)
+	*/
+	struct _NaviExport NaviAllocationCounts
+	{
+		unsigned long count[AllocationTagCount];
+		unsigned long bytes[AllocationTagCount];
+
+		NaviAllocationCounts();
+
+		unsigned long getTotalCount() const;
+	};
+
+	/**
+	* Installs the allocator used for NaviLibrary's internal allocations. This must be called before the
+	* NaviManager is created and the allocator must outlive it.
+	*
+	* @param	allocator	The allocator to use. Pass 0 to restore the default (malloc/free).
+	*/
+	_NaviExport void setNaviAllocator(NaviAllocator* allocator);
+
+	/**
+	* Returns the allocator installed with setNaviAllocator, or 0 if the default is being used.
+	*/
+	_NaviExport NaviAllocator* getNaviAllocator();
+
+	/**
+	* Returns a short, printable name for an AllocationTag.
+	*/
+	_NaviExport const char* getAllocationTagName(AllocationTag tag);
+
+	namespace Impl
+	{
+		_NaviExport void* allocate(size_t size, AllocationTag tag);
+
+		_NaviExport void deallocate(void* pointer, size_t size, AllocationTag tag);
+
+		void setAllocationTracking(bool enabled);
+
+		// Returns the counts gathered since the last call and starts counting from zero
+		NaviAllocationCounts takeAllocationCounts();
+
+		// An STL allocator that routes through the NaviAllocator with a fixed tag
+		template<class T, AllocationTag Tag>
+		class TaggedAllocator
+		{
+		public:
+			typedef T value_type;
+			typedef T* pointer;
+			typedef const T* const_pointer;
+			typedef T& reference;
+			typedef const T& const_reference;
+			typedef size_t size_type;
+			typedef ptrdiff_t difference_type;
+
+			template<class U> struct rebind { typedef TaggedAllocator<U, Tag> other; };
+
+			TaggedAllocator() {}
+			TaggedAllocator(const TaggedAllocator&) {}
+			template<class U> TaggedAllocator(const TaggedAllocator<U, Tag>&) {}
+
+			pointer address(reference value) const { return &value; }
+			const_pointer address(const_reference value) const { return &value; }
+
+			pointer allocate(size_type count, const void* = 0) { return static_cast<pointer>(Impl::allocate(count * sizeof(T), Tag)); }
+			void deallocate(pointer memory, size_type count) { Impl::deallocate(memory, count * sizeof(T), Tag); }
+
+			size_type max_size() const { return (std::numeric_limits<size_type>::max)() / sizeof(T); }
+
+			void construct(pointer memory, const T& value) { new(memory) T(value); }
+			void destroy(pointer memory) { memory->~T(); }
+
+			bool operator==(const TaggedAllocator&) const { return true; }
+			bool operator!=(const TaggedAllocator&) const { return false; }
+		};
+	}
+}
+
+#endif
\ No newline at end of file
@@ -35,6 +35,12 @@
 #include <OGRE/Ogre.h>
 #include <OGRE/OgrePanelOverlayElement.h>
 #include "KeyboardHook.h"
+#include "WorkerPool.h"
+#include "NaviThreading.h"
+#include "NaviStats.h"
+#include "NaviTrace.h"
+#include "NaviAllocator.h"
+#include "NaviTooltip.h"
 #include "NaviOverlay.h"
 #include "NaviDelegate.h"
 
@@ -74,8 +80,15 @@ namespace NaviLibrary
 		*
 		* @param	baseDirectory		The relative path to your base directory. This directory is used
 		*								by Navi::loadFile and Navi::loadHTML (to resolve relative URLs).
+		*
+		* @param	useBrowserThread	Whether or not the web core should be owned by a dedicated thread (disabled by
+		*								default). In this mode the web core is updated and pages are rendered on that
+		*								thread, NaviManager::Update only uploads the newest finished frames and dispatches
+		*								callbacks. Navi methods that talk to the page (loading, evaluateJS, bind, inject*)
+		*								may then be called from any thread and are queued for the browser thread, the rest
+		*								are queued for the thread that calls NaviManager::Update when called from elsewhere.
 		*/
-		NaviManager(Ogre::Viewport* defaultViewport, const std::string &baseDirectory = "");
+		NaviManager(Ogre::Viewport* defaultViewport, const std::string &baseDirectory = "", bool useBrowserThread = false);
 
 		/**
 		* Destroys the NaviManager singleton (also destroys any lingering Navis).
@@ -130,7 +143,8 @@ namespace NaviLibrary
 		* @param	viewport	The viewport that this Navi should be contained in. Specify 0 here to use the default
 		*						viewport that was given to NaviManager at initialization.
 		*
-		* @throws	Ogre::Exception::ERR_RT_ASSERTION_FAILED	Throws this if a Navi by the same name already exists.
+		* @throws	Ogre::Exception::ERR_RT_ASSERTION_FAILED	Throws this if a Navi by the same name already exists, or if
+		*															the tier already has a Navi at each of its 199 z-orders.
 		*/
 		Navi* createNavi(const std::string &naviName, unsigned short width, unsigned short height, const NaviPosition &naviPosition, 
 			bool asyncRender = false, int maxAsyncRenderRate = 70, Tier tier = Middle, Ogre::Viewport* viewport = 0);
@@ -297,34 +311,262 @@ namespace NaviLibrary
 		*/
 		void setDefaultViewport(Ogre::Viewport* viewport);
 
+		/**
+		* Sets the camera used to measure the projected size of NaviMaterials that have a LOD target
+		* (see Navi::setLODTarget). The camera's last viewport (or the default viewport) supplies the screen size.
+		*
+		* @param	camera	The camera that the scene is rendered with. Pass 0 to keep all NaviMaterials at
+		*					their current resolution.
+		*/
+		void setLODCamera(Ogre::Camera* camera);
+
+		/**
+		* Sets the number of worker threads used to copy rendered pages into their textures (and to extract
+		* their alpha caches). Rendering and texture locking always happen on the calling thread, only the
+		* pixel copies of all dirty Navis are spread over the workers (the calling thread also takes part).
+		*
+		* @param	numWorkers	The number of worker threads to spawn. Pass 0 to do all copies on the calling
+		*						thread (default).
+		*/
+		void setWorkerCount(unsigned int numWorkers);
+
+		/**
+		* Returns the number of worker threads used to copy rendered pages. (see NaviManager::setWorkerCount)
+		*/
+		unsigned int getWorkerCount();
+
+		/**
+		* Returns whether or not the web core is owned by a dedicated browser thread. (see NaviManager::NaviManager)
+		*/
+		bool isThreaded();
+
+		/**
+		* Toggles the collection of performance counters for all Navis (see Navi::getStats). Collection is
+		* off by default and can be compiled out entirely by defining NAVI_ENABLE_STATS as 0.
+		*
+		* @param	enabled		Whether or not to collect statistics.
+		*/
+		void setStatsEnabled(bool enabled);
+
+		/**
+		* Returns whether or not performance counters are being collected. (see NaviManager::setStatsEnabled)
+		*/
+		bool isStatsEnabled();
+
+		/**
+		* Returns the combined performance counters of all Navis (including the internal tooltip Navi).
+		*/
+		NaviStats getStats();
+
+		/**
+		* Clears the performance counters of all Navis.
+		*/
+		void resetStats();
+
+		/**
+		* Starts recording a timeline of NaviManager activity (web core updates, callback dispatch, texture
+		* uploads, tooltip handling and every delegate invocation) from all threads. Events are kept in a
+		* ring buffer, so only the most recent events remain once it fills up. Define NAVI_ENABLE_TRACE as 0
+		* to compile out all trace events.
+		*
+		* @param	capacity	The maximum number of events to keep (rounded up to a power of two).
+		*/
+		void startTrace(unsigned int capacity = 65536);
+
+		/**
+		* Stops recording trace events. The recorded events are kept until the next call to startTrace.
+		*/
+		void stopTrace();
+
+		/**
+		* Returns whether or not trace events are currently being recorded. (see NaviManager::startTrace)
+		*/
+		bool isTracing();
+
+		/**
+		* Saves the recorded trace events in the Chrome trace format (viewable in chrome://tracing or
+		* ui.perfetto.dev). May be called while recording. Each thread is shown in its own lane.
+		*
+		* @param	filename	The path of the JSON file to write.
+		*
+		* @throws	Ogre::Exception::ERR_CANNOT_WRITE_TO_FILE	Throws this if the file could not be written.
+		*/
+		void saveTrace(const std::string& filename);
+
+		/**
+		* Sets the refresh rate of the display that NaviManager::Update is paced to. Paced Navis (see
+		* Navi::setUpdateDivisor) use it to measure their jitter. By default the rate of the primary display
+		* is used.
+		*
+		* @param	refreshRate		The refresh rate in Hz. Set this to '0' to query the primary display.
+		*/
+		void setDisplayRefreshRate(unsigned int refreshRate = 0);
+
+		/**
+		* Returns the refresh rate paced Navis are measured against. (see NaviManager::setDisplayRefreshRate)
+		*/
+		unsigned int getDisplayRefreshRate();
+
+		/**
+		* Switches between native tooltips and the default web-view tooltip (tooltip.html). Native tooltips
+		* are drawn with an Ogre::Font on a plain overlay and are measured and wrapped in C++, so showing one
+		* never involves a web view. The web-view tooltip remains available for fully styled tooltips.
+		*
+		* @param	enabled		Whether or not to use native tooltips.
+		*
+		* @param	style		The font and colors to draw native tooltips with.
+		*
+		* @throws	Ogre::Exception::ERR_ITEM_NOT_FOUND		Throws this if the style's font could not be found.
+		*/
+		void setNativeTooltips(bool enabled, const NaviTooltipStyle& style = NaviTooltipStyle());
+
+		/**
+		* Returns whether or not tooltips are drawn natively. (see NaviManager::setNativeTooltips)
+		*/
+		bool isUsingNativeTooltips();
+
+		/**
+		* Toggles the counting of NaviLibrary's internal allocations (see NaviAllocator). Counts are gathered
+		* per AllocationTag and collected at the start of each NaviManager::Update.
+		*
+		* @param	enabled			Whether or not to count allocations.
+		*
+		* @param	logEachFrame	Whether or not to write a per-tag report to the Ogre log for every frame
+		*							that allocated.
+		*/
+		void setAllocationTracking(bool enabled, bool logEachFrame = false);
+
+		/**
+		* Returns the allocations counted during the previous frame. (see NaviManager::setAllocationTracking)
+		*/
+		NaviAllocationCounts getFrameAllocations();
+
 	protected:
 		friend class Navi; // Our very close friend <3
 
-		std::map<std::string,Navi*> activeNavis;
+		typedef std::map<std::string, Navi*, std::less<std::string>, Impl::TaggedAllocator<std::pair<const std::string, Navi*>, NaviMapAllocations> > NaviMap;
+		NaviMap activeNavis;
 		Navi* focusedNavi, *tooltipNavi, *tooltipParent, *keyboardFocusedNavi;
-		std::map<std::string,Navi*>::iterator iter;
+		NaviMap::iterator iter;
 		Ogre::Viewport* defaultViewport;
+		Ogre::Camera* lodCamera;
 		int mouseXPos, mouseYPos;
 		bool mouseButtonRDown, mouseButtonLDown;
 		unsigned short zOrderCounter;
+		struct ZOrderList { Navi* bottom; Navi* top; unsigned int count; };
+		ZOrderList zOrderLists[3];
 		Impl::KeyboardHook* keyboardHook;
 		Ogre::Timer tooltipTimer;
 		double lastTooltip, tooltipShowTime;
 		bool isDraggingFocusedNavi;
 		bool isFocusedNaviModal;
-		struct CallbackInvocation { Navi* caller; OSM::JSArguments args; NaviDelegate callback; };
-		std::deque<CallbackInvocation> queuedCallbacks;
+		struct CallbackInvocation { Navi* caller; OSM::JSArguments args; NaviDelegate callback; std::string name; unsigned long long queuedTime; };
+		typedef std::deque<CallbackInvocation, Impl::TaggedAllocator<CallbackInvocation, CallbackAllocations> > CallbackQueue;
+		CallbackQueue queuedCallbacks;
+		Impl::WorkerPool* workerPool;
+		struct CopyBand { Navi* navi; int startRow, endRow; unsigned long long copyTime, alphaTime; };
+		std::vector<CopyBand> copyBands;
+		std::vector<Navi*> dirtyNavis;
+		std::string baseDirectory;
+		HANDLE browserThread, browserWakeEvent, browserReadyEvent;
+		DWORD browserThreadId, mainThreadId;
+		volatile bool isBrowserThreadRunning;
+		Impl::CommandQueue browserCommands, mainCommands;
+		std::vector<Navi*> browserNavis;
+		std::vector<Navi*> browserTargets;
+		bool statsEnabled;
+		Impl::NativeTooltip* nativeTooltip;
+		unsigned int displayRefreshRate;
+		std::vector<unsigned int> pacingLoads;
+		bool logFrameAllocations;
+		NaviAllocationCounts lastFrameAllocations;
+		unsigned long frameNumber;
 
 		bool focusNavi(int x, int y, Navi* selection = 0);
 		void handleKeyMessage(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
 		void onResizeTooltip(Navi* Navi, const OSM::JSArguments& args);
 		void handleTooltip(Navi* tooltipParent, const std::wstring& tipText);
 		void handleRequestDrag(Navi* caller);
+		void logAllocations();
+		void assignPacing(Navi* navi, unsigned int divisor);
+		void releasePacing(Navi* navi);
+		bool isPacedFrame(Navi* navi, unsigned long long timestamp);
+		void createTooltipNavi();
+		void destroyTooltipNavi();
+		void presentTooltip();
+		void showTooltip();
+		bool isTooltipVisible();
+		void raiseToTop(Navi* navi);
+		void unlinkZOrder(Navi* navi);
+		void compactZOrder(Tier tier);
 		void handleKeyboardFocusChange(Navi* caller, bool isFocused);
 		void setNaviModality(Navi* caller, bool isModal);
 		void handleNaviHide(Navi* caller);
-		void queueCallback(Navi* caller, const OSM::JSArguments& args, const NaviDelegate& callback);
+		void queueCallback(const CallbackInvocation& invocation);
 		void moveTooltip(int x, int y);
+		static void copyBand(void* manager, unsigned int bandIndex);
+		void initializeWebCore();
+		bool isBrowserThread();
+		bool isMainThread();
+		bool postCommand(Impl::CommandQueue& queue, Impl::Command* command, bool waitForCompletion);
+		void executeMainCommands();
+		void executeBrowserCommands();
+		bool isCommandTargetAlive(const void* target);
+		void addBrowserTarget(Navi* navi);
+		static DWORD WINAPI browserThreadProc(LPVOID param);
+
+		// The defer* methods queue a call for the browser/main thread and return true, unless the browser thread is
+		// disabled or we are already on that thread, in which case they return false and the caller proceeds inline.
+		// The send* methods additionally block until the call has been executed.
+
+		template<class ObjectType>
+		bool deferToBrowser(ObjectType* object, void (ObjectType::*method)())
+		{ return !isBrowserThread() && postCommand(browserCommands, Impl::bindCommand(object, method), false); }
+
+		template<class ObjectType, class P1, class A1>
+		bool deferToBrowser(ObjectType* object, void (ObjectType::*method)(P1), const A1& arg1)
+		{ return !isBrowserThread() && postCommand(browserCommands, Impl::bindCommand(object, method, arg1), false); }
+
+		template<class ObjectType, class P1, class P2, class A1, class A2>
+		bool deferToBrowser(ObjectType* object, void (ObjectType::*method)(P1, P2), const A1& arg1, const A2& arg2)
+		{ return !isBrowserThread() && postCommand(browserCommands, Impl::bindCommand(object, method, arg1, arg2), false); }
+
+		template<class ObjectType, class P1, class P2, class P3, class A1, class A2, class A3>
+		bool deferToBrowser(ObjectType* object, void (ObjectType::*method)(P1, P2, P3), const A1& arg1, const A2& arg2, const A3& arg3)
+		{ return !isBrowserThread() && postCommand(browserCommands, Impl::bindCommand(object, method, arg1, arg2, arg3), false); }
+
+		template<class ObjectType>
+		bool sendToBrowser(ObjectType* object, void (ObjectType::*method)())
+		{ return !isBrowserThread() && postCommand(browserCommands, Impl::bindCommand(object, method), true); }
+
+		template<class ObjectType, class P1, class P2, class A1, class A2>
+		bool sendToBrowser(ObjectType* object, void (ObjectType::*method)(P1, P2), const A1& arg1, const A2& arg2)
+		{ return !isBrowserThread() && postCommand(browserCommands, Impl::bindCommand(object, method, arg1, arg2), true); }
+
+		template<class ObjectType, class P1, class P2, class P3, class A1, class A2, class A3>
+		bool sendToBrowser(ObjectType* object, void (ObjectType::*method)(P1, P2, P3), const A1& arg1, const A2& arg2, const A3& arg3)
+		{ return !isBrowserThread() && postCommand(browserCommands, Impl::bindCommand(object, method, arg1, arg2, arg3), true); }
+
+		template<class ObjectType>
+		bool deferToMain(ObjectType* object, void (ObjectType::*method)())
+		{ return !isMainThread() && postCommand(mainCommands, Impl::bindCommand(object, method), false); }
+
+		template<class ObjectType, class P1, class A1>
+		bool deferToMain(ObjectType* object, void (ObjectType::*method)(P1), const A1& arg1)
+		{ return !isMainThread() && postCommand(mainCommands, Impl::bindCommand(object, method, arg1), false); }
+
+		template<class ObjectType, class P1, class P2, class A1, class A2>
+		bool deferToMain(ObjectType* object, void (ObjectType::*method)(P1, P2), const A1& arg1, const A2& arg2)
+		{ return !isMainThread() && postCommand(mainCommands, Impl::bindCommand(object, method, arg1, arg2), false); }
+
+		template<class ObjectType, class P1, class P2, class P3, class A1, class A2, class A3>
+		bool deferToMain(ObjectType* object, void (ObjectType::*method)(P1, P2, P3), const A1& arg1, const A2& arg2, const A3& arg3)
+		{ return !isMainThread() && postCommand(mainCommands, Impl::bindCommand(object, method, arg1, arg2, arg3), false); }
+
+		// Like deferToMain, but the queued call owns 'owned' and deletes it if the call is dropped
+		template<class ObjectType, class OwnedType>
+		bool transferToMain(ObjectType* object, void (ObjectType::*method)(OwnedType*), OwnedType* owned)
+		{ return !isMainThread() && postCommand(mainCommands, new Impl::TransferCommand<ObjectType, OwnedType>(object, method, owned), false); }
 	};
 
 }
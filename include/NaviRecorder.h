@@ -0,0 +1,126 @@
+#ifndef __NaviRecorder_H__
+#define __NaviRecorder_H__
+
+/*
+	This file is part of NaviLibrary, a library that allows developers to create and 
+	interact with web-content as an overlay or material in Ogre3D applications.
+
+	Copyright (C) 2011 Khrona LLC
+	https://github.com/khrona/navi
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "NaviPlatform.h"
+#include <windows.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+namespace NaviLibrary
+{
+	/**
+	* The formats that Navi::startRecording can write.
+	*/
+	enum RecordingFormat
+	{
+		/// A single uncompressed YUV4MPEG2 (4:2:0) stream, playable by most video tools (ffplay, mpv, VLC).
+		Y4MRecording,
+		/// A numbered sequence of PNG images ("name_000000.png", "name_000001.png", ...).
+		PNGSequence
+	};
+
+	/**
+	* What Navi::startRecording should do when the encoder falls behind and every buffer is in use.
+	*/
+	enum RecordingPolicy
+	{
+		/// Drop the new frame, the frame rate of the application is never affected.
+		DropFrames,
+		/// Wait for the encoder to free a buffer, no frames are lost.
+		BlockOnFull
+	};
+
+	/**
+	* The progress of a recording. (see Navi::getRecordingStats)
+	*/
+	struct NaviRecordingStats
+	{
+		/// The number of dirty frames that were handed to the recorder.
+		unsigned long framesCaptured;
+		/// The number of frames that were dropped because every buffer was in use or the size changed.
+		unsigned long framesDropped;
+		/// The number of frames that were written out (Y4M recordings repeat frames to keep a constant rate).
+		unsigned long framesEncoded;
+		/// The number of bytes written out.
+		unsigned long long bytesWritten;
+
+		NaviRecordingStats() : framesCaptured(0), framesDropped(0), framesEncoded(0), bytesWritten(0) {}
+	};
+
+	namespace Impl
+	{
+		// Copies dirty frames into a fixed pool of buffers and encodes them on its own thread
+		class FrameRecorder
+		{
+		public:
+			FrameRecorder(const std::string& filename, RecordingFormat format, RecordingPolicy policy, 
+				unsigned int bufferCount, unsigned int frameRate);
+			~FrameRecorder();
+
+			// Copies a BGRA frame into a free buffer and queues it for encoding
+			void submit(const unsigned char* pixels, int width, int height, int rowSpan);
+
+			NaviRecordingStats getStats();
+
+			// Returns false if the output file or the encoder thread could not be created
+			bool isOpen() const;
+
+		protected:
+			struct Buffer
+			{
+				unsigned char* pixels;
+				int width, height;
+				unsigned long long timestamp;
+			};
+
+			std::string filename;
+			RecordingFormat format;
+			RecordingPolicy policy;
+			unsigned int bufferCount, frameRate;
+			std::vector<Buffer*> freeBuffers, readyBuffers;
+			CRITICAL_SECTION lock;
+			HANDLE thread, frameReadyEvent, bufferFreeEvent;
+			volatile bool isStopping;
+			NaviRecordingStats stats;
+			int frameWidth, frameHeight;
+			unsigned long long startTime;
+			FILE* file;
+			std::vector<unsigned char> encodeBuffer;
+			bool isWritable, hasHeader, hasPendingFrame;
+			unsigned long long slotsWritten;
+
+			void allocateBuffers(int width, int height);
+			void encode(Buffer* buffer);
+			void writeY4M(Buffer* buffer);
+			void writePendingY4MFrame();
+			void writePNG(Buffer* buffer);
+
+			static DWORD WINAPI encoderProc(LPVOID param);
+		};
+	}
+}
+
+#endif
\ No newline at end of file
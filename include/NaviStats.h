@@ -0,0 +1,146 @@
+#ifndef __NaviStats_H__
+#define __NaviStats_H__
+
+/*
+	This file is part of NaviLibrary, a library that allows developers to create and 
+	interact with web-content as an overlay or material in Ogre3D applications.
+
+	Copyright (C) 2011 Khrona LLC
+	https://github.com/khrona/navi
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <windows.h>
+
+/**
+* Set NAVI_ENABLE_STATS to 0 to compile out all statistics collection (see NaviManager::setStatsEnabled).
+*/
+#ifndef NAVI_ENABLE_STATS
+#	define NAVI_ENABLE_STATS 1
+#endif
+
+#if NAVI_ENABLE_STATS
+#	define NAVI_STATS(enabled, statement) if(enabled) { statement; }
+#else
+#	define NAVI_STATS(enabled, statement)
+#endif
+
+namespace NaviLibrary
+{
+	/**
+	* Performance counters of a Navi (see Navi::getStats), or of all Navis combined (see NaviManager::getStats).
+	* All times are in microseconds. Counters are only collected while NaviManager::setStatsEnabled is on.
+	*/
+	struct NaviStats
+	{
+		/// The number of times the Navi was given a chance to update.
+		unsigned long long updatesAttempted;
+		/// The number of times the texture was actually updated.
+		unsigned long long updatesPerformed;
+		/// The number of updates in which the page had new content.
+		unsigned long long dirtyFrames;
+		/// The number of bytes written to the texture (including mipmaps).
+		unsigned long long bytesUploaded;
+		/// The time spent in awe_webview_render.
+		unsigned long long renderTime;
+		/// The time spent copying rendered pixels into the texture or staging memory.
+		unsigned long long copyTime;
+		/// The time spent rebuilding the alpha cache used for transparency picking.
+		unsigned long long alphaCacheTime;
+		/// The number of bound JS callbacks that were dispatched.
+		unsigned long long callbacksDispatched;
+		/// The number of JavaScript evaluations (Navi::evaluateJS and Navi::evaluateJSWithResult).
+		unsigned long long jsEvaluations;
+		/// The combined time between each callback being raised by the page and it being dispatched.
+		unsigned long long callbackLatency;
+		/// The number of intervals measured between the frames a paced Navi was scheduled on (see Navi::setUpdateDivisor).
+		unsigned long long pacedIntervals;
+		/// The combined deviation of those intervals from the Navi's target interval.
+		unsigned long long pacingJitter;
+		/// The largest deviation of a single interval from the target interval.
+		unsigned long long maxPacingJitter;
+
+		NaviStats() { reset(); }
+
+		/**
+		* Clears all counters.
+		*/
+		void reset()
+		{
+			updatesAttempted = updatesPerformed = dirtyFrames = bytesUploaded = 0;
+			renderTime = copyTime = alphaCacheTime = 0;
+			callbacksDispatched = jsEvaluations = callbackLatency = 0;
+			pacedIntervals = pacingJitter = maxPacingJitter = 0;
+		}
+
+		/**
+		* Returns the average time between a callback being raised by the page and it being dispatched.
+		*/
+		double getAverageCallbackLatency() const
+		{
+			return callbacksDispatched ? (double)callbackLatency / callbacksDispatched : 0;
+		}
+
+		/**
+		* Returns the average deviation of a paced Navi's update interval from its target interval.
+		*/
+		double getAveragePacingJitter() const
+		{
+			return pacedIntervals ? (double)pacingJitter / pacedIntervals : 0;
+		}
+
+		NaviStats& operator+=(const NaviStats& rhs)
+		{
+			updatesAttempted += rhs.updatesAttempted;
+			updatesPerformed += rhs.updatesPerformed;
+			dirtyFrames += rhs.dirtyFrames;
+			bytesUploaded += rhs.bytesUploaded;
+			renderTime += rhs.renderTime;
+			copyTime += rhs.copyTime;
+			alphaCacheTime += rhs.alphaCacheTime;
+			callbacksDispatched += rhs.callbacksDispatched;
+			jsEvaluations += rhs.jsEvaluations;
+			callbackLatency += rhs.callbackLatency;
+			pacedIntervals += rhs.pacedIntervals;
+			pacingJitter += rhs.pacingJitter;
+
+			if(rhs.maxPacingJitter > maxPacingJitter)
+				maxPacingJitter = rhs.maxPacingJitter;
+
+			return *this;
+		}
+	};
+
+	namespace Impl
+	{
+		// A thread-safe microsecond timestamp (Ogre::Timer may not be used from worker threads)
+		inline unsigned long long getTimestampUS()
+		{
+			static LARGE_INTEGER frequency = { 0 };
+			LARGE_INTEGER counter;
+
+			if(!frequency.QuadPart)
+				QueryPerformanceFrequency(&frequency);
+
+			QueryPerformanceCounter(&counter);
+
+			return (unsigned long long)(counter.QuadPart / frequency.QuadPart * 1000000 + 
+				counter.QuadPart % frequency.QuadPart * 1000000 / frequency.QuadPart);
+		}
+	}
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,243 @@
+#ifndef __NaviThreading_H__
+#define __NaviThreading_H__
+
+/*
+	This file is part of NaviLibrary, a library that allows developers to create and 
+	interact with web-content as an overlay or material in Ogre3D applications.
+
+	Copyright (C) 2011 Khrona LLC
+	https://github.com/khrona/navi
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "NaviAllocator.h"
+#include <windows.h>
+
+namespace NaviLibrary {
+namespace Impl {
+
+class Command
+{
+public:
+	Command* volatile next;
+
+	Command() : next(0) {}
+	virtual ~Command() {}
+
+	virtual void execute() = 0;
+
+	// The object that the command will be executed on, if any
+	virtual const void* getTarget() const { return 0; }
+
+	// Called instead of execute when the command is dropped because its target no longer exists
+	virtual void cancel() {}
+
+	static void* operator new(size_t size) { return Impl::allocate(size, CommandAllocations); }
+	static void operator delete(void* pointer, size_t size) { Impl::deallocate(pointer, size, CommandAllocations); }
+};
+
+// Lock-free intrusive multi-producer/single-consumer queue. Any thread may push, only one thread may pop.
+// Popped commands are owned by the caller.
+class CommandQueue
+{
+public:
+	CommandQueue();
+	~CommandQueue();
+
+	void push(Command* command);
+	Command* pop();
+
+protected:
+	class StubCommand : public Command
+	{
+	public:
+		void execute() {}
+	};
+
+	StubCommand stub;
+	Command* volatile head;
+	Command* tail;
+};
+
+// Wraps a command so that the thread which queued it can wait for its completion
+class BlockingCommand : public Command
+{
+public:
+	BlockingCommand(Command* command, HANDLE completedEvent) : command(command), completedEvent(completedEvent) {}
+	~BlockingCommand() { delete command; }
+
+	void execute() { command->execute(); SetEvent(completedEvent); }
+	const void* getTarget() const { return command->getTarget(); }
+	void cancel() { command->cancel(); SetEvent(completedEvent); }
+
+protected:
+	Command* command;
+	HANDLE completedEvent;
+};
+
+template<class ParamType> struct StorageOf { typedef ParamType Type; };
+template<class ParamType> struct StorageOf<const ParamType&> { typedef ParamType Type; };
+template<class ParamType> struct StorageOf<ParamType&> { typedef ParamType Type; };
+
+template<class ObjectType>
+class MethodCommand0 : public Command
+{
+public:
+	typedef void (ObjectType::*Method)();
+
+	MethodCommand0(ObjectType* object, Method method) : object(object), method(method) {}
+	void execute() { (object->*method)(); }
+	const void* getTarget() const { return object; }
+
+protected:
+	ObjectType* object;
+	Method method;
+};
+
+template<class ObjectType, class P1>
+class MethodCommand1 : public Command
+{
+public:
+	typedef void (ObjectType::*Method)(P1);
+
+	MethodCommand1(ObjectType* object, Method method, const typename StorageOf<P1>::Type& arg1) 
+		: object(object), method(method), arg1(arg1) {}
+	void execute() { (object->*method)(arg1); }
+	const void* getTarget() const { return object; }
+
+protected:
+	ObjectType* object;
+	Method method;
+	typename StorageOf<P1>::Type arg1;
+};
+
+template<class ObjectType, class P1, class P2>
+class MethodCommand2 : public Command
+{
+public:
+	typedef void (ObjectType::*Method)(P1, P2);
+
+	MethodCommand2(ObjectType* object, Method method, const typename StorageOf<P1>::Type& arg1, 
+		const typename StorageOf<P2>::Type& arg2) : object(object), method(method), arg1(arg1), arg2(arg2) {}
+	void execute() { (object->*method)(arg1, arg2); }
+	const void* getTarget() const { return object; }
+
+protected:
+	ObjectType* object;
+	Method method;
+	typename StorageOf<P1>::Type arg1;
+	typename StorageOf<P2>::Type arg2;
+};
+
+template<class ObjectType, class P1, class P2, class P3>
+class MethodCommand3 : public Command
+{
+public:
+	typedef void (ObjectType::*Method)(P1, P2, P3);
+
+	MethodCommand3(ObjectType* object, Method method, const typename StorageOf<P1>::Type& arg1, 
+		const typename StorageOf<P2>::Type& arg2, const typename StorageOf<P3>::Type& arg3) 
+		: object(object), method(method), arg1(arg1), arg2(arg2), arg3(arg3) {}
+	void execute() { (object->*method)(arg1, arg2, arg3); }
+	const void* getTarget() const { return object; }
+
+protected:
+	ObjectType* object;
+	Method method;
+	typename StorageOf<P1>::Type arg1;
+	typename StorageOf<P2>::Type arg2;
+	typename StorageOf<P3>::Type arg3;
+};
+
+// Passes ownership of a heap object to a method, the object is deleted along with the command if it is never executed
+template<class ObjectType, class OwnedType>
+class TransferCommand : public Command
+{
+public:
+	typedef void (ObjectType::*Method)(OwnedType*);
+
+	TransferCommand(ObjectType* object, Method method, OwnedType* owned) : object(object), method(method), owned(owned) {}
+	~TransferCommand() { delete owned; }
+	void execute() { OwnedType* transferred = owned; owned = 0; (object->*method)(transferred); }
+	const void* getTarget() const { return object; }
+
+protected:
+	ObjectType* object;
+	Method method;
+	OwnedType* owned;
+};
+
+template<class ObjectType>
+Command* bindCommand(ObjectType* object, void (ObjectType::*method)())
+{
+	return new MethodCommand0<ObjectType>(object, method);
+}
+
+template<class ObjectType, class P1, class A1>
+Command* bindCommand(ObjectType* object, void (ObjectType::*method)(P1), const A1& arg1)
+{
+	return new MethodCommand1<ObjectType, P1>(object, method, arg1);
+}
+
+template<class ObjectType, class P1, class P2, class A1, class A2>
+Command* bindCommand(ObjectType* object, void (ObjectType::*method)(P1, P2), const A1& arg1, const A2& arg2)
+{
+	return new MethodCommand2<ObjectType, P1, P2>(object, method, arg1, arg2);
+}
+
+template<class ObjectType, class P1, class P2, class P3, class A1, class A2, class A3>
+Command* bindCommand(ObjectType* object, void (ObjectType::*method)(P1, P2, P3), const A1& arg1, const A2& arg2, const A3& arg3)
+{
+	return new MethodCommand3<ObjectType, P1, P2, P3>(object, method, arg1, arg2, arg3);
+}
+
+struct Frame
+{
+	unsigned char* buffer;
+	int width, height, rowSpan;
+	int capacity;
+};
+
+// Single-producer/single-consumer triple buffer of BGRA frames. The producer always has a back frame to
+// write into and the consumer always reads the most recently published frame, neither ever waits.
+class FrameTripleBuffer
+{
+public:
+	FrameTripleBuffer();
+	~FrameTripleBuffer();
+
+	// Producer: returns the back frame, resized to the given dimensions
+	Frame& getBackFrame(int width, int height);
+
+	// Producer: makes the back frame the newest published frame
+	void publish();
+
+	// Consumer: swaps in the newest published frame, returns false if nothing new was published
+	bool acquire();
+
+	// Consumer: the frame acquired last (its buffer is 0 until the first frame is acquired)
+	const Frame& getFrontFrame();
+
+protected:
+	Frame frames[3];
+	int backIndex, frontIndex;
+	volatile LONG middleState;
+};
+
+}
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,93 @@
+#ifndef __NaviTooltip_H__
+#define __NaviTooltip_H__
+
+/*
+	This file is part of NaviLibrary, a library that allows developers to create and 
+	interact with web-content as an overlay or material in Ogre3D applications.
+
+	Copyright (C) 2011 Khrona LLC
+	https://github.com/khrona/navi
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "NaviOverlay.h"
+#include <string>
+
+namespace Ogre { class TextAreaOverlayElement; class Font; }
+
+namespace NaviLibrary
+{
+	/**
+	* Describes the appearance of native tooltips. (see NaviManager::setNativeTooltips)
+	*/
+	struct _NaviExport NaviTooltipStyle
+	{
+		/// The name of a loaded (or loadable) Ogre::Font to draw the text with.
+		Ogre::String fontName;
+		/// The height of a line of text, in pixels.
+		Ogre::Real charHeight;
+		/// The widest the text may get before it is wrapped, in pixels.
+		int maxWidth;
+		/// The space between the text and the border, in pixels.
+		int padding;
+		Ogre::ColourValue textColor;
+		Ogre::ColourValue backgroundColor;
+		Ogre::ColourValue borderColor;
+
+		/**
+		* Creates a style that resembles the default web-view tooltip (tooltip.html).
+		*
+		* @param	fontName	The name of the Ogre::Font to use.
+		*
+		* @param	charHeight	The height of a line of text, in pixels.
+		*/
+		NaviTooltipStyle(const Ogre::String& fontName = "", Ogre::Real charHeight = 12);
+	};
+
+	namespace Impl
+	{
+		// Draws tooltips with an Ogre::Font (whose glyphs live in a single texture atlas) on a NaviOverlay, text
+		// is measured and wrapped here so that changing the tooltip never involves a web view.
+		class NativeTooltip
+		{
+		public:
+			NativeTooltip(const NaviTooltipStyle& style, Ogre::Viewport* viewport);
+			~NativeTooltip();
+
+			void setText(const std::wstring& text);
+
+			void setViewport(Ogre::Viewport* viewport);
+			void setPosition(int x, int y);
+
+			void show();
+			void hide();
+			bool getVisibility() const;
+
+		protected:
+			NaviTooltipStyle style;
+			NaviOverlay* overlay;
+			Ogre::PanelOverlayElement* background;
+			Ogre::TextAreaOverlayElement* textArea;
+			Ogre::Font* font;
+			Ogre::Real spaceWidth;
+
+			Ogre::Real getCharWidth(wchar_t character) const;
+			std::wstring wrapText(const std::wstring& text, Ogre::Real& width, int& lineCount) const;
+		};
+	}
+}
+
+#endif
\ No newline at end of file
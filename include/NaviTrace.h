@@ -0,0 +1,142 @@
+#ifndef __NaviTrace_H__
+#define __NaviTrace_H__
+
+/*
+	This file is part of NaviLibrary, a library that allows developers to create and 
+	interact with web-content as an overlay or material in Ogre3D applications.
+
+	Copyright (C) 2011 Khrona LLC
+	https://github.com/khrona/navi
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "NaviStats.h"
+#include <string>
+#include <string.h>
+
+/**
+* Set NAVI_ENABLE_TRACE to 0 to compile out all trace events (see NaviManager::startTrace).
+*/
+#ifndef NAVI_ENABLE_TRACE
+#	define NAVI_ENABLE_TRACE 1
+#endif
+
+#define NAVI_TRACE_CONCAT_IMPL(a, b) a##b
+#define NAVI_TRACE_CONCAT(a, b) NAVI_TRACE_CONCAT_IMPL(a, b)
+
+#if NAVI_ENABLE_TRACE
+#	define NAVI_TRACE_SCOPE(name) NaviLibrary::Impl::TraceScope NAVI_TRACE_CONCAT(naviTraceScope, __LINE__)(name)
+#	define NAVI_TRACE_SCOPE_DETAIL(name, detail) NaviLibrary::Impl::TraceScope NAVI_TRACE_CONCAT(naviTraceScope, __LINE__)(name, detail)
+#	define NAVI_TRACE_THREAD(name) NaviLibrary::Impl::TraceRecorder::nameThread(name)
+#else
+#	define NAVI_TRACE_SCOPE(name)
+#	define NAVI_TRACE_SCOPE_DETAIL(name, detail)
+#	define NAVI_TRACE_THREAD(name)
+#endif
+
+namespace NaviLibrary {
+namespace Impl {
+
+// Records complete ("X") events into a fixed-size ring buffer that any thread may write to without locking.
+// Once the buffer wraps, the oldest events are overwritten.
+class TraceRecorder
+{
+public:
+	static void start(unsigned int capacity);
+	static void stop();
+	static void shutdown();
+
+	static bool isRecording() { return isEnabled; }
+
+	static void record(const char* name, const char* detail, unsigned long long startTime, unsigned long long duration);
+
+	// Names the calling thread's lane in the exported trace
+	static void nameThread(const char* name);
+
+	// Writes every recorded event as Chrome trace JSON (chrome://tracing, ui.perfetto.dev)
+	static bool save(const std::string& filename);
+
+protected:
+	enum { MAX_NAME_LENGTH = 48, MAX_THREADS = 64 };
+
+	struct Event
+	{
+		volatile LONG sequence;
+		DWORD threadId;
+		unsigned long long startTime;
+		unsigned long long duration;
+		char name[MAX_NAME_LENGTH];
+		char detail[MAX_NAME_LENGTH];
+	};
+
+	struct ThreadName
+	{
+		DWORD threadId;
+		char name[MAX_NAME_LENGTH];
+	};
+
+	// A ring of events. A writer may still be inside record() after recording stops, so a buffer that is replaced
+	// by a larger or smaller one is kept (see retired) and only freed by shutdown().
+	struct Buffer
+	{
+		Event* events;
+		LONG capacityMask;
+		Buffer* retired;
+	};
+
+	static volatile bool isEnabled;
+	static Buffer* volatile buffer;
+	static volatile LONG writeIndex;
+	static ThreadName threadNames[MAX_THREADS];
+	static volatile LONG threadNameCount;
+};
+
+class TraceScope
+{
+public:
+	// The detail is copied because it often names an object that is destroyed within the scope
+	TraceScope(const char* name, const char* detail = 0) : name(name), startTime(0)
+	{
+		this->detail[0] = 0;
+
+		if(TraceRecorder::isRecording())
+		{
+			startTime = getTimestampUS();
+
+			if(detail)
+			{
+				strncpy(this->detail, detail, sizeof(this->detail) - 1);
+				this->detail[sizeof(this->detail) - 1] = 0;
+			}
+		}
+	}
+
+	~TraceScope()
+	{
+		if(startTime && TraceRecorder::isRecording())
+			TraceRecorder::record(name, detail, startTime, getTimestampUS() - startTime);
+	}
+
+protected:
+	const char* name;
+	char detail[48];
+	unsigned long long startTime;
+};
+
+}
+}
+
+#endif
\ No newline at end of file
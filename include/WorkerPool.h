@@ -0,0 +1,71 @@
+#ifndef __WorkerPool_H__
+#define __WorkerPool_H__
+
+/*
+	This file is part of NaviLibrary, a library that allows developers to create and 
+	interact with web-content as an overlay or material in Ogre3D applications.
+
+	Copyright (C) 2011 Khrona LLC
+	https://github.com/khrona/navi
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <windows.h>
+#include <vector>
+
+namespace NaviLibrary {
+namespace Impl {
+
+class WorkerPool
+{
+public:
+	typedef void (*TaskFunction)(void* userData, unsigned int taskIndex);
+
+	WorkerPool(unsigned int numWorkers);
+	~WorkerPool();
+
+	unsigned int getWorkerCount();
+
+	// Executes 'function' once for every index in [0, taskCount). The calling thread takes part and
+	// this only returns once every task has completed.
+	void run(TaskFunction function, void* userData, unsigned int taskCount);
+
+protected:
+	struct Worker
+	{
+		WorkerPool* pool;
+		HANDLE thread;
+		HANDLE wakeEvent;
+		HANDLE idleEvent;
+	};
+
+	std::vector<Worker*> workers;
+	std::vector<HANDLE> idleEvents;
+	TaskFunction taskFunction;
+	void* taskUserData;
+	volatile LONG nextTask;
+	LONG taskCount;
+	volatile bool isShuttingDown;
+
+	void processTasks();
+
+	static DWORD WINAPI workerProc(LPVOID param);
+};
+
+}
+}
+
+#endif
\ No newline at end of file
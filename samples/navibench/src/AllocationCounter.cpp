@@ -0,0 +1,58 @@
+/*
+	This file is part of NaviLibrary, a library that allows developers to create and 
+	interact with web-content as an overlay or material in Ogre3D applications.
+
+	Copyright (C) 2011 Khrona LLC
+	https://github.com/khrona/navi
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "AllocationCounter.h"
+#include <windows.h>
+#include <new>
+#include <stdlib.h>
+
+namespace
+{
+	volatile LONG allocationCount = 0;
+
+	void* countedAlloc(size_t size)
+	{
+		InterlockedIncrement(&allocationCount);
+
+		void* result = malloc(size ? size : 1);
+
+		if(!result)
+			throw std::bad_alloc();
+
+		return result;
+	}
+}
+
+void* operator new(size_t size) { return countedAlloc(size); }
+void* operator new[](size_t size) { return countedAlloc(size); }
+void operator delete(void* pointer) { free(pointer); }
+void operator delete[](void* pointer) { free(pointer); }
+
+long AllocationCounter::getCount()
+{
+	return allocationCount;
+}
+
+void AllocationCounter::reset()
+{
+	InterlockedExchange(&allocationCount, 0);
+}
\ No newline at end of file
@@ -0,0 +1,637 @@
+/*
+	This file is part of NaviLibrary, a library that allows developers to create and 
+	interact with web-content as an overlay or material in Ogre3D applications.
+
+	Copyright (C) 2011 Khrona LLC
+	https://github.com/khrona/navi
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+	AtlasBench compares the skyline packer used by the demo's Atlas (samples/navidemo/src/AtlasPacker.cpp) with
+	the recursive fill-and-retry packer it replaced, on glyph-heavy, texture-heavy and mixed inputs. Ogre isn't
+	needed; the glyph input mimics the 11 sizes of LucidaSans that TitleCanvas used to load.
+	Each packer is repeated until it has run for at least 200 ms and reports the time per pack, the atlas
+	dimensions (power-of-two, like Atlas) and the occupancy.
+
+	It also times the glyph rendering that FontFace does at startup (GlyphRasterizer) for media/LucidaSans.ttf
+	at those 11 sizes, and as a distance field at the one size that replaces them, for the BasicLatin, Latin1 and
+	All ranges, on one thread and on one thread per processor. The total glyph area is reported as well.
+
+	Finally it times how Canvas writes vertices (QuadList::writeVertices) for 10k, 100k and 1M glyph quads: the
+	structure-of-arrays list with colors packed in advance, with and without SSE, against the array of quads that
+	Canvas used to convert color by color. The destination is system memory rather than a locked vertex buffer.
+
+	Usage: AtlasBench [filter]		(only runs the inputs whose name contains 'filter')
+*/
+
+#include "AtlasPacker.h"
+#include "GlyphRasterizer.h"
+#include "QuadList.h"
+#include "NaviStats.h"
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <math.h>
+#include <stdio.h>
+
+namespace
+{
+	const unsigned long long MIN_RUN_TIME_US = 200000;
+
+	struct PackResult
+	{
+		int width, height;
+		int placedCount;
+		int attemptCount;
+	};
+
+	int firstPO2From(int n)
+	{
+		int result = 1;
+
+		while(result < n)
+			result <<= 1;
+
+		return result;
+	}
+
+	// A small deterministic generator so that every run packs the same input
+	unsigned int nextRandom(unsigned int& state)
+	{
+		state = state * 1664525 + 1013904223;
+		return state >> 8;
+	}
+
+	/************************
+	* Inputs
+	************************/
+
+	void addGlyphs(std::vector<PackRect>& rects)
+	{
+		unsigned int state = 1;
+
+		// TitleCanvas loaded sizes 15 to 25 of the BasicLatin range, glyph bitmaps are roughly 0.2-0.7 em wide
+		// and 0.1-0.95 em tall (descenders, punctuation and capitals)
+		for(int size = 15; size <= 25; size++)
+		{
+			for(int charCode = 33; charCode <= 126; charCode++)
+			{
+				int width = std::max(1, (int)(size * (0.2f + (nextRandom(state) % 50) / 100.0f)));
+				int height = std::max(1, (int)(size * (0.1f + (nextRandom(state) % 85) / 100.0f)));
+
+				rects.push_back(PackRect(width, height));
+			}
+		}
+	}
+
+	void addTextures(std::vector<PackRect>& rects)
+	{
+		static const int sizes[] = { 16, 24, 32, 48, 64, 96, 128, 200, 256 };
+		unsigned int state = 7;
+
+		for(int i = 0; i < 40; i++)
+		{
+			int width = sizes[nextRandom(state) % 9];
+			int height = sizes[nextRandom(state) % 9];
+
+			rects.push_back(PackRect(width, height));
+		}
+	}
+
+	void addVertexColor(std::vector<PackRect>& rects)
+	{
+		rects.push_back(PackRect(2, 2));
+	}
+
+	/************************
+	* Skyline packer (Atlas::pack)
+	************************/
+
+	int guessWidth(const std::vector<PackRect>& rects, int& area)
+	{
+		int maxWidth = 0;
+		int maxHeight = 0;
+		area = 0;
+
+		for(std::vector<PackRect>::const_iterator i = rects.begin(); i != rects.end(); i++)
+		{
+			area += i->width * i->height;
+			maxWidth = std::max(maxWidth, i->width);
+			maxHeight = std::max(maxHeight, i->height);
+		}
+
+		int squareRoot = (int)ceil(sqrt(area * 1.02));
+
+		if(maxWidth > squareRoot)
+			return firstPO2From(maxWidth);
+		else if(maxHeight > squareRoot)
+			return firstPO2From(std::max(area / firstPO2From(maxHeight), maxWidth));
+		else if(maxWidth > maxHeight)
+			return firstPO2From(squareRoot);
+		else
+			return firstPO2From(std::max(area / firstPO2From(squareRoot), maxWidth));
+	}
+
+	PackResult packSkyline(std::vector<PackRect>& rects)
+	{
+		int area;
+		std::pair<int, int> dimensions = AtlasPacker::packAtlas(rects, guessWidth(rects, area), true);
+
+		PackResult result;
+		result.width = dimensions.first;
+		result.height = dimensions.second;
+		result.placedCount = 0;
+		result.attemptCount = 2;
+
+		for(std::vector<PackRect>::const_iterator i = rects.begin(); i != rects.end(); i++)
+			if(i->isPlaced)
+				result.placedCount++;
+
+		return result;
+	}
+
+	/************************
+	* Recursive packer (the original Atlas::pack/fill)
+	************************/
+
+	struct LegacyRect
+	{
+		int width, height;
+		int x, y;
+		int area;
+		float weight;
+		bool isPlaced;
+	};
+
+	bool WeightCompare(LegacyRect* a, LegacyRect* b)
+	{
+		return a->weight > b->weight;
+	}
+
+	void fill(std::vector<LegacyRect*>& rectangles, int x1, int y1, int x2, int y2, int& count)
+	{
+		std::vector<LegacyRect*>::iterator iter;
+
+		for(iter = rectangles.begin(); iter != rectangles.end(); iter++)
+		{
+			if((!(*iter)->isPlaced) && (x2 - x1 + 1 >= (*iter)->width) && (y2 - y1 + 1 >= (*iter)->height))
+				break;
+		}
+
+		if(iter == rectangles.end())
+			return;
+
+		LegacyRect* rect = *iter;
+
+		rect->x = x1;
+		rect->y = y1;
+		rect->isPlaced = true;
+		count++;
+
+		if((x2 - x1 + 1 - rect->width) * rect->height < (y2 - y1 + 1 - rect->height) * rect->width)
+		{
+			if(y1 + rect->height < y2)
+				fill(rectangles, x1, y1 + rect->height, x2, y2, count);
+
+			if((x1 + rect->width < x2) && (y1 < y1 + rect->height - 1))
+				fill(rectangles, x1 + rect->width, y1, x2, y1 + rect->height - 1, count);
+		}
+		else
+		{
+			if(x1 + rect->width < x2)
+				fill(rectangles, x1 + rect->width, y1, x2, y2, count);
+
+			if((y1 + rect->height < y2) && (x1 < x1 + rect->width - 1))
+				fill(rectangles, x1, y1 + rect->height, x1 + rect->width - 1, y2, count);
+		}
+	}
+
+	PackResult packLegacy(std::vector<PackRect>& input)
+	{
+		std::vector<LegacyRect> storage(input.size());
+		std::vector<LegacyRect*> rectangles;
+
+		int actualArea = 0;
+		int maxWidth = 0;
+		int maxHeight = 0;
+		float totalOblong = 0;
+
+		for(size_t i = 0; i < input.size(); i++)
+		{
+			LegacyRect& rect = storage[i];
+			rect.width = input[i].width;
+			rect.height = input[i].height;
+			rect.x = rect.y = 0;
+			rect.area = rect.width * rect.height;
+			rect.isPlaced = false;
+			rectangles.push_back(&rect);
+
+			actualArea += rect.area;
+			maxWidth = std::max(maxWidth, rect.width);
+			maxHeight = std::max(maxHeight, rect.height);
+			totalOblong += rect.area * (std::max(rect.width, rect.height) + 1) / ((float)std::min(rect.width, rect.height) + 1);
+		}
+
+		float oblongFactor = totalOblong / actualArea / 2;
+
+		for(std::vector<LegacyRect*>::iterator i = rectangles.begin(); i != rectangles.end(); i++)
+		{
+			float oblongitude = (std::max((*i)->width, (*i)->height) + 1) / ((float)std::min((*i)->width, (*i)->height) + 1);
+			float percentArea = (*i)->area / (float)actualArea;
+
+			(*i)->weight = percentArea * pow(oblongitude, percentArea + oblongFactor);
+		}
+
+		PackResult result;
+		int squareRoot = (int)ceil(sqrt((double)actualArea * 1.02));
+
+		if(maxWidth > squareRoot)
+		{
+			result.width = firstPO2From(maxWidth);
+			result.height = firstPO2From(std::max(actualArea / result.width, maxHeight));
+		}
+		else if(maxHeight > squareRoot)
+		{
+			result.height = firstPO2From(maxHeight);
+			result.width = firstPO2From(std::max(actualArea / result.height, maxWidth));
+		}
+		else if(maxWidth > maxHeight)
+		{
+			result.width = firstPO2From(squareRoot);
+			result.height = firstPO2From(std::max(actualArea / result.width, maxHeight));
+		}
+		else
+		{
+			result.height = firstPO2From(squareRoot);
+			result.width = firstPO2From(std::max(actualArea / result.height, maxWidth));
+		}
+
+		std::sort(rectangles.begin(), rectangles.end(), WeightCompare);
+		result.attemptCount = 0;
+
+		for(;;)
+		{
+			result.attemptCount++;
+			result.placedCount = 0;
+			fill(rectangles, 0, 0, result.width - 1, result.height - 1, result.placedCount);
+
+			if(result.placedCount == (int)rectangles.size())
+				break;
+
+			if(result.width < result.height)
+				result.width = firstPO2From(result.width + 1);
+			else
+				result.height = firstPO2From(result.height + 1);
+
+			for(std::vector<LegacyRect*>::iterator i = rectangles.begin(); i != rectangles.end(); i++)
+				(*i)->isPlaced = false;
+		}
+
+		return result;
+	}
+
+	/************************
+	* Runner
+	************************/
+
+	struct Input
+	{
+		std::string name;
+		std::vector<PackRect> rects;
+	};
+
+	void runBenchmark(const Input& input, const char* packerName, PackResult (*packer)(std::vector<PackRect>&))
+	{
+		std::vector<PackRect> rects = input.rects;
+		PackResult result = packer(rects);
+
+		int area = 0;
+
+		for(std::vector<PackRect>::const_iterator i = input.rects.begin(); i != input.rects.end(); i++)
+			area += i->width * i->height;
+
+		unsigned int iterations = 0;
+		unsigned long long startTime = NaviLibrary::Impl::getTimestampUS();
+		unsigned long long elapsed = 0;
+
+		while(elapsed < MIN_RUN_TIME_US)
+		{
+			rects = input.rects;
+			packer(rects);
+			iterations++;
+			elapsed = NaviLibrary::Impl::getTimestampUS() - startTime;
+		}
+
+		printf("%-10s %-9s %5u rects %12.1f us/pack %5dx%-5d %6.1f%% occupancy %3d attempt(s)%s\n", input.name.c_str(), packerName, 
+			(unsigned int)input.rects.size(), (double)elapsed / iterations, result.width, result.height, 
+			area * 100.0 / ((double)result.width * result.height), result.attemptCount, 
+			result.placedCount == (int)input.rects.size() ? "" : " (incomplete)");
+	}
+
+	/************************
+	* Glyph rendering (FontFace)
+	************************/
+
+	void runFontBenchmark(GlyphRasterizer& rasterizer, const char* modeName, const char* rangeName, unsigned long lastCharCode, 
+		const std::vector<unsigned int>& sizes, unsigned int threadCount)
+	{
+		std::vector<GlyphRasterizer::CharMapEntry> glyphs;
+
+		for(std::vector<GlyphRasterizer::CharMapEntry>::const_iterator i = rasterizer.getCharMap().begin(); i != rasterizer.getCharMap().end(); i++)
+			if(i->first >= 32 && i->first <= lastCharCode)
+				glyphs.push_back(*i);
+
+		unsigned int iterations = 0;
+		unsigned long long startTime = NaviLibrary::Impl::getTimestampUS();
+		unsigned long long elapsed = 0;
+
+		while(elapsed < MIN_RUN_TIME_US)
+		{
+			rasterizer.rasterize(sizes, glyphs, threadCount);
+			iterations++;
+			elapsed = NaviLibrary::Impl::getTimestampUS() - startTime;
+		}
+
+		// The area the glyphs take up in the atlas, before packing
+		size_t area = 0;
+
+		for(std::vector<RasterizedSize>::const_iterator i = rasterizer.getSizes().begin(); i != rasterizer.getSizes().end(); i++)
+			for(std::vector<RasterizedGlyph>::const_iterator j = i->glyphs.begin(); j != i->glyphs.end(); j++)
+				area += j->bitmap ? j->pitch * j->rows : 0;
+
+		printf("%-10s %-9s %-10s %4u chars x %2u size(s) %12.1f us/face %2u thread(s) %8u px\n", "Fonts", modeName, rangeName, 
+			(unsigned int)glyphs.size(), (unsigned int)sizes.size(), (double)elapsed / iterations, rasterizer.getThreadCount(), (unsigned int)area);
+	}
+
+	void runFontBenchmarks(const std::string& filter)
+	{
+		if(!filter.empty() && std::string("Fonts").find(filter) == std::string::npos)
+			return;
+
+		FILE* file = fopen("media/LucidaSans.ttf", "rb");
+
+		if(!file)
+		{
+			printf("Fonts: media/LucidaSans.ttf not found, run AtlasBench from the build/bin directory\n");
+			return;
+		}
+
+		std::vector<unsigned char> fontData;
+		unsigned char buffer[4096];
+		size_t length;
+
+		while((length = fread(buffer, 1, sizeof(buffer), file)) > 0)
+			fontData.insert(fontData.end(), buffer, buffer + length);
+
+		fclose(file);
+
+		GlyphRasterizer rasterizer(&fontData[0], fontData.size(), GlyphRasterizer::DefaultHinting);
+		GlyphRasterizer distanceFieldRasterizer(&fontData[0], fontData.size(), GlyphRasterizer::DistanceField);
+
+		if(!rasterizer.getError().empty())
+		{
+			printf("Fonts: %s\n", rasterizer.getError().c_str());
+			return;
+		}
+
+		const char* rangeNames[] = { "BasicLatin", "Latin1", "All" };
+		const unsigned long lastCharCodes[] = { 166, 255, 0xFFFFFFFF };
+
+		// TitleCanvas used to load the 11 sizes it draws, with distance fields it loads one and scales it
+		std::vector<unsigned int> sizes;
+		std::vector<unsigned int> distanceFieldSizes(1, 20);
+
+		for(unsigned int size = 15; size <= 25; size++)
+			sizes.push_back(size);
+
+		for(int i = 0; i < 3; i++)
+		{
+			runFontBenchmark(rasterizer, "Bitmap", rangeNames[i], lastCharCodes[i], sizes, 1);
+			runFontBenchmark(rasterizer, "Bitmap", rangeNames[i], lastCharCodes[i], sizes, 0);
+			runFontBenchmark(distanceFieldRasterizer, "SDF", rangeNames[i], lastCharCodes[i], distanceFieldSizes, 1);
+			runFontBenchmark(distanceFieldRasterizer, "SDF", rangeNames[i], lastCharCodes[i], distanceFieldSizes, 0);
+		}
+	}
+
+	/************************
+	* Vertex emission (Canvas::writeQuads)
+	************************/
+
+	// Canvas used to keep each quad as corners of Ogre::Vector2 and Ogre::ColourValue, and packed the colors as it wrote
+	// every vertex (Root::convertColourValue, which goes through the render system)
+	struct LegacyQuad
+	{
+		float vertices[4][2];
+		float texCoords[4][2];
+		float colors[4][4];
+		size_t element;
+	};
+
+	void packColourABGR(const float* color, unsigned int* packed)
+	{
+		*packed = ((unsigned int)(color[3] * 255) << 24) | ((unsigned int)(color[2] * 255) << 16) | 
+			((unsigned int)(color[1] * 255) << 8) | (unsigned int)(color[0] * 255);
+	}
+
+	// Called through a pointer, like the render system's conversion
+	void (* volatile packColour)(const float*, unsigned int*) = &packColourABGR;
+
+	struct VertexInput
+	{
+		std::vector<LegacyQuad> legacyQuads;
+		QuadList quads;
+		std::vector<size_t> quadElements;
+		std::vector<QuadList::Transform> transforms;
+	};
+
+	// Glyphs in words of 1 to 10 quads, each word being an element with its own transform
+	void addVertexQuads(VertexInput& input, size_t quadCount)
+	{
+		unsigned int state = 1;
+
+		while(input.quads.size() < quadCount)
+		{
+			size_t element = input.transforms.size();
+			QuadList::Transform transform = { 2 / 1024.0f, (nextRandom(state) % 200) / 1024.0f - 1, -2 / 768.0f, 1 - (nextRandom(state) % 200) / 768.0f };
+			input.transforms.push_back(transform);
+
+			float x = (float)(nextRandom(state) % 900);
+			float y = (float)(nextRandom(state) % 700);
+			float color[4] = { (nextRandom(state) % 256) / 255.0f, (nextRandom(state) % 256) / 255.0f, 1, 1 };
+			unsigned int packedColor;
+			packColourABGR(color, &packedColor);
+
+			for(size_t i = 1 + nextRandom(state) % 10; i > 0 && input.quads.size() < quadCount; i--)
+			{
+				float width = (float)(6 + nextRandom(state) % 8);
+				float height = (float)(12 + nextRandom(state) % 6);
+				float u = (nextRandom(state) % 1000) / 1024.0f;
+				float v = (nextRandom(state) % 1000) / 1024.0f;
+
+				QuadList::Positions positions = { { x, x + width, x, x + width }, { y, y, y + height, y + height } };
+				QuadList::TexCoords texCoords = { u, v, u + width / 1024.0f, v + height / 1024.0f };
+				QuadList::Colors colors = { { packedColor, packedColor, packedColor, packedColor } };
+				input.quads.push_back(positions, texCoords, colors);
+				input.quadElements.push_back(element);
+
+				LegacyQuad legacy;
+				const float legacyUV[4][2] = { { texCoords.left, texCoords.top }, { texCoords.right, texCoords.top }, 
+					{ texCoords.left, texCoords.bottom }, { texCoords.right, texCoords.bottom } };
+
+				for(int c = 0; c < 4; c++)
+				{
+					legacy.vertices[c][0] = positions.x[c];
+					legacy.vertices[c][1] = positions.y[c];
+					legacy.texCoords[c][0] = legacyUV[c][0];
+					legacy.texCoords[c][1] = legacyUV[c][1];
+					std::copy(color, color + 4, legacy.colors[c]);
+				}
+
+				legacy.element = element;
+				input.legacyQuads.push_back(legacy);
+				x += width;
+			}
+		}
+	}
+
+	void writeLegacy(const VertexInput& input, unsigned char* dest)
+	{
+		float* vBuffer = (float*)dest;
+
+		for(std::vector<LegacyQuad>::const_iterator quad = input.legacyQuads.begin(); quad != input.legacyQuads.end(); quad++)
+		{
+			const QuadList::Transform& transform = input.transforms[quad->element];
+
+			for(int v = 0; v < 4; v++)
+			{
+				*vBuffer++ = quad->vertices[v][0] * transform.xMul + transform.xAdd;
+				*vBuffer++ = quad->vertices[v][1] * transform.yMul + transform.yAdd;
+				*vBuffer++ = 0;
+				packColour(quad->colors[v], (unsigned int*)vBuffer++);
+				*vBuffer++ = quad->texCoords[v][0];
+				*vBuffer++ = quad->texCoords[v][1];
+			}
+		}
+	}
+
+	// Like Canvas::writeQuads: a run of quads per element
+	void writeQuadList(const VertexInput& input, unsigned char* dest, bool useSSE)
+	{
+		size_t quadCount = input.quads.size();
+
+		for(size_t q = 0; q < quadCount;)
+		{
+			size_t runEnd = q + 1;
+
+			while(runEnd < quadCount && input.quadElements[runEnd] == input.quadElements[q])
+				runEnd++;
+
+			input.quads.writeVertices(q, runEnd - q, input.transforms[input.quadElements[q]], 
+				dest + q * 4 * QuadList::VERTEX_SIZE, useSSE);
+			q = runEnd;
+		}
+	}
+
+	void runVertexBenchmark(const VertexInput& input, const char* methodName, int method, std::vector<unsigned char>& dest)
+	{
+		unsigned int iterations = 0;
+		unsigned long long startTime = NaviLibrary::Impl::getTimestampUS();
+		unsigned long long elapsed = 0;
+
+		while(elapsed < MIN_RUN_TIME_US)
+		{
+			if(method == 0)
+				writeLegacy(input, &dest[0]);
+			else
+				writeQuadList(input, &dest[0], method == 2);
+
+			iterations++;
+			elapsed = NaviLibrary::Impl::getTimestampUS() - startTime;
+		}
+
+		double usPerWrite = (double)elapsed / iterations;
+
+		printf("%-10s %-9s %8u quads %12.1f us/write %8.2f ns/quad %8.2f GB/s\n", "Vertices", methodName, 
+			(unsigned int)input.quads.size(), usPerWrite, usPerWrite * 1000 / input.quads.size(), 
+			dest.size() / (usPerWrite * 1000));
+	}
+
+	void runVertexBenchmarks(const std::string& filter)
+	{
+		if(!filter.empty() && std::string("Vertices").find(filter) == std::string::npos)
+			return;
+
+		const size_t quadCounts[] = { 10000, 100000, 1000000 };
+
+		for(int i = 0; i < 3; i++)
+		{
+			VertexInput input;
+			addVertexQuads(input, quadCounts[i]);
+
+			// Every method must write the same vertices
+			std::vector<unsigned char> expected(quadCounts[i] * 4 * QuadList::VERTEX_SIZE);
+			std::vector<unsigned char> dest(expected.size());
+			writeLegacy(input, &expected[0]);
+
+			runVertexBenchmark(input, "AoS", 0, dest);
+			runVertexBenchmark(input, "SoA", 1, dest);
+
+			if(dest != expected)
+				printf("Vertices: the SoA vertices differ\n");
+
+#if QUADLIST_HAVE_SSE
+			runVertexBenchmark(input, "SoA+SSE", 2, dest);
+
+			if(dest != expected)
+				printf("Vertices: the SoA+SSE vertices differ\n");
+#endif
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::string filter = argc > 1 ? argv[1] : "";
+	std::vector<Input> inputs(3);
+
+	inputs[0].name = "Glyphs";
+	addGlyphs(inputs[0].rects);
+	addVertexColor(inputs[0].rects);
+
+	inputs[1].name = "Textures";
+	addTextures(inputs[1].rects);
+	addVertexColor(inputs[1].rects);
+
+	inputs[2].name = "Mixed";
+	addGlyphs(inputs[2].rects);
+	addTextures(inputs[2].rects);
+	addVertexColor(inputs[2].rects);
+
+	for(std::vector<Input>::iterator i = inputs.begin(); i != inputs.end(); i++)
+	{
+		if(!filter.empty() && i->name.find(filter) == std::string::npos)
+			continue;
+
+		runBenchmark(*i, "Recursive", &packLegacy);
+		runBenchmark(*i, "Skyline", &packSkyline);
+	}
+
+	runFontBenchmarks(filter);
+	runVertexBenchmarks(filter);
+
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,1066 @@
+/*
+	This file is part of NaviLibrary, a library that allows developers to create and 
+	interact with web-content as an overlay or material in Ogre3D applications.
+
+	Copyright (C) 2011 Khrona LLC
+	https://github.com/khrona/navi
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "AwesomiumStandIn.h"
+#include <vector>
+#include <map>
+#include <string>
+#include <algorithm>
+#include <string.h>
+#include <wchar.h>
+
+/************************
+* Data types
+************************/
+
+struct _awe_string
+{
+	std::vector<wchar16> text;
+};
+
+struct _awe_jsvalue
+{
+	awe_jsvalue_type type;
+	bool boolValue;
+	int integerValue;
+	double doubleValue;
+	awe_string* stringValue;
+	awe_jsarray* arrayValue;
+	awe_jsobject* objectValue;
+};
+
+struct _awe_jsarray
+{
+	std::vector<awe_jsvalue*> elements;
+};
+
+struct _awe_jsobject
+{
+	std::map<std::vector<wchar16>, awe_jsvalue*> properties;
+};
+
+struct _awe_renderbuffer
+{
+	std::vector<unsigned char> pixels;
+	int width, height, rowSpan;
+};
+
+struct _awe_webview
+{
+	int width, height;
+	bool isDirty;
+	awe_rect dirtyBounds;
+	unsigned int paintCount;
+	awe_renderbuffer renderBuffer;
+	std::vector<std::vector<wchar16> > callbackNames;
+	std::wstring pendingLoad;
+
+	struct Callbacks
+	{
+		void (*beginNavigation)(awe_webview*, const awe_string*, const awe_string*);
+		void (*beginLoading)(awe_webview*, const awe_string*, const awe_string*, int, const awe_string*);
+		void (*finishLoading)(awe_webview*);
+		void (*jsCallback)(awe_webview*, const awe_string*, const awe_string*, const awe_jsarray*);
+		void (*receiveTitle)(awe_webview*, const awe_string*, const awe_string*);
+		void (*changeTooltip)(awe_webview*, const awe_string*);
+		void (*changeCursor)(awe_webview*, awe_cursor_type);
+		void (*changeKeyboardFocus)(awe_webview*, bool);
+		void (*changeTargetURL)(awe_webview*, const awe_string*);
+		void (*openExternalLink)(awe_webview*, const awe_string*, const awe_string*);
+		void (*requestDownload)(awe_webview*, const awe_string*);
+		void (*webViewCrashed)(awe_webview*);
+		void (*pluginCrashed)(awe_webview*, const awe_string*);
+		void (*requestMove)(awe_webview*, int, int);
+		void (*getPageContents)(awe_webview*, const awe_string*, const awe_string*);
+		void (*domReady)(awe_webview*);
+		void (*requestFileChooser)(awe_webview*, bool, const awe_string*, const awe_string*);
+		void (*getScrollData)(awe_webview*, int, int, int, int, int);
+		void (*jsConsoleMessage)(awe_webview*, const awe_string*, int, const awe_string*);
+		void (*getFindResults)(awe_webview*, int, int, awe_rect, int, bool);
+		void (*updateIME)(awe_webview*, awe_ime_state, awe_rect);
+	} callbacks;
+};
+
+namespace
+{
+	StandIn::Config config;
+	StandIn::Counters counters;
+	std::vector<awe_webview*> webViews;
+	awe_string emptyString;
+
+	awe_string* createString(const std::vector<wchar16>& text)
+	{
+		awe_string* result = new awe_string();
+		result->text = text;
+
+		return result;
+	}
+
+	awe_string* createString(const wchar_t* text)
+	{
+		return awe_string_create_from_wide(text, wcslen(text));
+	}
+
+	void markDirty(awe_webview* webView, int top, int bottom)
+	{
+		top = top < 0 ? 0 : top;
+		bottom = bottom > webView->height ? webView->height : bottom;
+
+		if(bottom <= top)
+			return;
+
+		if(webView->isDirty)
+		{
+			int dirtyBottom = webView->dirtyBounds.y + webView->dirtyBounds.height;
+			top = top < webView->dirtyBounds.y ? top : webView->dirtyBounds.y;
+			bottom = bottom > dirtyBottom ? bottom : dirtyBottom;
+		}
+
+		webView->dirtyBounds.x = 0;
+		webView->dirtyBounds.y = top;
+		webView->dirtyBounds.width = webView->width;
+		webView->dirtyBounds.height = bottom - top;
+		webView->isDirty = true;
+	}
+
+	void markAllDirty(awe_webview* webView)
+	{
+		markDirty(webView, 0, webView->height);
+	}
+
+	// Repaints a horizontal band that scrolls down the view a little more every time
+	void markBandDirty(awe_webview* webView)
+	{
+		int bandHeight = (int)(webView->height * config.dirtyCoverage);
+		bandHeight = bandHeight < 1 ? 1 : bandHeight;
+
+		int top = (webView->paintCount * bandHeight) % webView->height;
+
+		markDirty(webView, top, top + bandHeight);
+		webView->paintCount++;
+	}
+
+	void raiseCallbacks(awe_webview* webView)
+	{
+		if(!webView->callbacks.jsCallback || webView->callbackNames.empty())
+			return;
+
+		awe_string* objectName = createString(L"Client");
+		awe_jsarray* args = awe_jsarray_create(0, 0);
+
+		for(unsigned int i = 0; i < config.callbackArgCount; i++)
+			args->elements.push_back(i % 2 ? awe_jsvalue_create_string_value(objectName) : 
+				awe_jsvalue_create_integer_value((int)counters.callbacksRaised));
+
+		// Copy the names as the listener may bind or unbind callbacks in response
+		std::vector<std::vector<wchar16> > callbackNames = webView->callbackNames;
+
+		for(std::vector<std::vector<wchar16> >::iterator i = callbackNames.begin(); i != callbackNames.end(); i++)
+		{
+			awe_string* callbackName = createString(*i);
+			webView->callbacks.jsCallback(webView, objectName, callbackName, args);
+			awe_string_destroy(callbackName);
+			counters.callbacksRaised++;
+		}
+
+		awe_jsarray_destroy(args);
+		awe_string_destroy(objectName);
+	}
+
+	void finishLoad(awe_webview* webView)
+	{
+		awe_string* url = createString(webView->pendingLoad.c_str());
+		awe_string* mimeType = createString(L"text/html");
+
+		if(webView->callbacks.beginLoading)
+			webView->callbacks.beginLoading(webView, url, &emptyString, 200, mimeType);
+
+		if(webView->callbacks.domReady)
+			webView->callbacks.domReady(webView);
+
+		if(webView->callbacks.finishLoading)
+			webView->callbacks.finishLoading(webView);
+
+		awe_string_destroy(mimeType);
+		awe_string_destroy(url);
+
+		webView->pendingLoad.clear();
+		markAllDirty(webView);
+	}
+
+	void requestLoad(awe_webview* webView, const awe_string* source)
+	{
+		std::vector<wchar_t> text(source->text.begin(), source->text.end());
+		webView->pendingLoad = text.empty() ? L"about:blank" : std::wstring(&text[0], text.size());
+	}
+}
+
+void StandIn::configure(const Config& newConfig)
+{
+	config = newConfig;
+}
+
+const StandIn::Config& StandIn::getConfig()
+{
+	return config;
+}
+
+const StandIn::Counters& StandIn::getCounters()
+{
+	return counters;
+}
+
+void StandIn::resetCounters()
+{
+	counters = Counters();
+}
+
+const char* StandIn::getCallbackName(CallbackType type)
+{
+	static const char* names[CallbackTypeCount] = { "begin_navigation", "begin_loading", "finish_loading", 
+		"js_callback", "receive_title", "change_tooltip", "change_cursor", "change_keyboard_focus", 
+		"change_target_url", "open_external_link", "request_download", "web_view_crashed", "plugin_crashed", 
+		"request_move", "get_page_contents", "dom_ready", "request_file_chooser", "get_scroll_data", 
+		"js_console_message", "get_find_results", "update_ime" };
+
+	return type < CallbackTypeCount ? names[type] : "";
+}
+
+bool StandIn::raiseCallback(awe_webview* webView, CallbackType type)
+{
+	static awe_string* url = createString(L"http://bench.local/index.html");
+	static awe_string* text = createString(L"The quick brown fox jumps over the lazy dog");
+	static awe_string* objectName = createString(L"Client");
+	static awe_string* callbackName = createString(L"onScore");
+	static awe_jsarray* args = 0;
+
+	if(!args)
+	{
+		const awe_jsvalue* values[2] = { awe_jsvalue_create_integer_value(1337), awe_jsvalue_create_string_value(text) };
+		args = awe_jsarray_create(values, 2);
+		awe_jsvalue_destroy(const_cast<awe_jsvalue*>(values[0]));
+		awe_jsvalue_destroy(const_cast<awe_jsvalue*>(values[1]));
+	}
+
+	awe_webview::Callbacks& callbacks = webView->callbacks;
+	awe_rect rect = { 10, 20, 30, 40 };
+
+	switch(type)
+	{
+#define RAISE(callback, args) if(!callbacks.callback) return false; callbacks.callback args; break
+	case BeginNavigation:		RAISE(beginNavigation, (webView, url, &emptyString));
+	case BeginLoading:			RAISE(beginLoading, (webView, url, &emptyString, 200, text));
+	case FinishLoading:			RAISE(finishLoading, (webView));
+	case JSCallback:			RAISE(jsCallback, (webView, objectName, callbackName, args));
+	case ReceiveTitle:			RAISE(receiveTitle, (webView, text, &emptyString));
+	case ChangeTooltip:			RAISE(changeTooltip, (webView, text));
+	case ChangeCursor:			RAISE(changeCursor, (webView, (awe_cursor_type)0));
+	case ChangeKeyboardFocus:	RAISE(changeKeyboardFocus, (webView, true));
+	case ChangeTargetURL:		RAISE(changeTargetURL, (webView, url));
+	case OpenExternalLink:		RAISE(openExternalLink, (webView, url, url));
+	case RequestDownload:		RAISE(requestDownload, (webView, url));
+	case WebViewCrashed:		RAISE(webViewCrashed, (webView));
+	case PluginCrashed:			RAISE(pluginCrashed, (webView, text));
+	case RequestMove:			RAISE(requestMove, (webView, 100, 200));
+	case GetPageContents:		RAISE(getPageContents, (webView, url, text));
+	case DOMReady:				RAISE(domReady, (webView));
+	case RequestFileChooser:	RAISE(requestFileChooser, (webView, false, text, url));
+	case GetScrollData:			RAISE(getScrollData, (webView, 1024, 4096, 1024, 0, 512));
+	case JSConsoleMessage:		RAISE(jsConsoleMessage, (webView, text, 42, url));
+	case GetFindResults:		RAISE(getFindResults, (webView, 1, 3, rect, 1, true));
+	case UpdateIME:				RAISE(updateIME, (webView, (awe_ime_state)0, rect));
+#undef RAISE
+	default:
+		return false;
+	}
+
+	counters.callbacksRaised++;
+
+	return true;
+}
+
+/************************
+* awe_string
+************************/
+
+const awe_string* awe_string_empty()
+{
+	return &emptyString;
+}
+
+awe_string* awe_string_create_from_ascii(const char* str, size_t len)
+{
+	awe_string* result = new awe_string();
+	result->text.assign(str, str + len);
+
+	return result;
+}
+
+awe_string* awe_string_create_from_wide(const wchar_t* str, size_t len)
+{
+	awe_string* result = new awe_string();
+	result->text.assign(str, str + len);
+
+	return result;
+}
+
+awe_string* awe_string_create_from_utf16(const wchar16* str, size_t len)
+{
+	awe_string* result = new awe_string();
+	result->text.assign(str, str + len);
+
+	return result;
+}
+
+void awe_string_destroy(awe_string* str)
+{
+	delete str;
+}
+
+size_t awe_string_get_length(const awe_string* str)
+{
+	return str->text.size();
+}
+
+const wchar16* awe_string_get_utf16(const awe_string* str)
+{
+	static const wchar16 emptyText = 0;
+
+	return str->text.empty() ? &emptyText : &str->text[0];
+}
+
+int awe_string_to_wide(const awe_string* str, wchar_t* dest, size_t len)
+{
+	if(dest)
+		for(size_t i = 0; i < len && i < str->text.size(); i++)
+			dest[i] = (wchar_t)str->text[i];
+
+	return (int)str->text.size();
+}
+
+int awe_string_to_utf8(const awe_string* str, char* dest, size_t len)
+{
+	std::string result;
+
+	for(size_t i = 0; i < str->text.size(); i++)
+	{
+		unsigned int codePoint = str->text[i];
+
+		if(codePoint >= 0xD800 && codePoint < 0xDC00 && i + 1 < str->text.size())
+			codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (str->text[++i] - 0xDC00);
+
+		if(codePoint < 0x80)
+		{
+			result += (char)codePoint;
+		}
+		else if(codePoint < 0x800)
+		{
+			result += (char)(0xC0 | (codePoint >> 6));
+			result += (char)(0x80 | (codePoint & 0x3F));
+		}
+		else if(codePoint < 0x10000)
+		{
+			result += (char)(0xE0 | (codePoint >> 12));
+			result += (char)(0x80 | ((codePoint >> 6) & 0x3F));
+			result += (char)(0x80 | (codePoint & 0x3F));
+		}
+		else
+		{
+			result += (char)(0xF0 | (codePoint >> 18));
+			result += (char)(0x80 | ((codePoint >> 12) & 0x3F));
+			result += (char)(0x80 | ((codePoint >> 6) & 0x3F));
+			result += (char)(0x80 | (codePoint & 0x3F));
+		}
+	}
+
+	if(dest)
+		memcpy(dest, result.data(), len < result.size() ? len : result.size());
+
+	return (int)result.size();
+}
+
+/************************
+* awe_jsvalue
+************************/
+
+namespace
+{
+	awe_jsvalue* createValue(awe_jsvalue_type type)
+	{
+		awe_jsvalue* result = new awe_jsvalue();
+		result->type = type;
+		result->boolValue = false;
+		result->integerValue = 0;
+		result->doubleValue = 0;
+		result->stringValue = 0;
+		result->arrayValue = 0;
+		result->objectValue = 0;
+
+		return result;
+	}
+
+	awe_jsvalue* copyValue(const awe_jsvalue* value)
+	{
+		switch(value->type)
+		{
+		case JSVALUE_TYPE_BOOLEAN:
+			return awe_jsvalue_create_bool_value(value->boolValue);
+		case JSVALUE_TYPE_INTEGER:
+			return awe_jsvalue_create_integer_value(value->integerValue);
+		case JSVALUE_TYPE_DOUBLE:
+			return awe_jsvalue_create_double_value(value->doubleValue);
+		case JSVALUE_TYPE_STRING:
+			return awe_jsvalue_create_string_value(value->stringValue);
+		case JSVALUE_TYPE_OBJECT:
+			return awe_jsvalue_create_object_value(value->objectValue);
+		case JSVALUE_TYPE_ARRAY:
+			return awe_jsvalue_create_array_value(value->arrayValue);
+		default:
+			return awe_jsvalue_create_null_value();
+		}
+	}
+}
+
+awe_jsvalue* awe_jsvalue_create_null_value()
+{
+	return createValue(JSVALUE_TYPE_NULL);
+}
+
+awe_jsvalue* awe_jsvalue_create_bool_value(bool value)
+{
+	awe_jsvalue* result = createValue(JSVALUE_TYPE_BOOLEAN);
+	result->boolValue = value;
+
+	return result;
+}
+
+awe_jsvalue* awe_jsvalue_create_integer_value(int value)
+{
+	awe_jsvalue* result = createValue(JSVALUE_TYPE_INTEGER);
+	result->integerValue = value;
+
+	return result;
+}
+
+awe_jsvalue* awe_jsvalue_create_double_value(double value)
+{
+	awe_jsvalue* result = createValue(JSVALUE_TYPE_DOUBLE);
+	result->doubleValue = value;
+
+	return result;
+}
+
+awe_jsvalue* awe_jsvalue_create_string_value(const awe_string* value)
+{
+	awe_jsvalue* result = createValue(JSVALUE_TYPE_STRING);
+	result->stringValue = createString(value->text);
+
+	return result;
+}
+
+awe_jsvalue* awe_jsvalue_create_object_value(const awe_jsobject* value)
+{
+	awe_jsvalue* result = createValue(JSVALUE_TYPE_OBJECT);
+	result->objectValue = awe_jsobject_create();
+
+	for(std::map<std::vector<wchar16>, awe_jsvalue*>::const_iterator i = value->properties.begin(); 
+		i != value->properties.end(); i++)
+		result->objectValue->properties[i->first] = copyValue(i->second);
+
+	return result;
+}
+
+awe_jsvalue* awe_jsvalue_create_array_value(const awe_jsarray* value)
+{
+	awe_jsvalue* result = createValue(JSVALUE_TYPE_ARRAY);
+	result->arrayValue = awe_jsarray_create((const awe_jsvalue**)(value->elements.empty() ? 0 : &value->elements[0]), 
+		value->elements.size());
+
+	return result;
+}
+
+void awe_jsvalue_destroy(awe_jsvalue* jsvalue)
+{
+	if(jsvalue->stringValue)
+		awe_string_destroy(jsvalue->stringValue);
+
+	if(jsvalue->arrayValue)
+		awe_jsarray_destroy(jsvalue->arrayValue);
+
+	if(jsvalue->objectValue)
+		awe_jsobject_destroy(jsvalue->objectValue);
+
+	delete jsvalue;
+}
+
+awe_jsvalue_type awe_jsvalue_get_type(const awe_jsvalue* jsvalue)
+{
+	return jsvalue->type;
+}
+
+awe_string* awe_jsvalue_to_string(const awe_jsvalue* jsvalue)
+{
+	if(jsvalue->type == JSVALUE_TYPE_STRING)
+		return createString(jsvalue->stringValue->text);
+
+	wchar_t buffer[64] = { 0 };
+
+	switch(jsvalue->type)
+	{
+	case JSVALUE_TYPE_BOOLEAN:
+		wcscpy(buffer, jsvalue->boolValue ? L"true" : L"false");
+		break;
+	case JSVALUE_TYPE_INTEGER:
+		swprintf(buffer, 64, L"%d", jsvalue->integerValue);
+		break;
+	case JSVALUE_TYPE_DOUBLE:
+		swprintf(buffer, 64, L"%g", jsvalue->doubleValue);
+		break;
+	case JSVALUE_TYPE_OBJECT:
+		wcscpy(buffer, L"[object Object]");
+		break;
+	case JSVALUE_TYPE_NULL:
+		wcscpy(buffer, L"null");
+		break;
+	default:
+		break;
+	}
+
+	return createString(buffer);
+}
+
+int awe_jsvalue_to_integer(const awe_jsvalue* jsvalue)
+{
+	switch(jsvalue->type)
+	{
+	case JSVALUE_TYPE_BOOLEAN:
+		return jsvalue->boolValue ? 1 : 0;
+	case JSVALUE_TYPE_INTEGER:
+		return jsvalue->integerValue;
+	case JSVALUE_TYPE_DOUBLE:
+		return (int)jsvalue->doubleValue;
+	default:
+		return 0;
+	}
+}
+
+double awe_jsvalue_to_double(const awe_jsvalue* jsvalue)
+{
+	return jsvalue->type == JSVALUE_TYPE_DOUBLE ? jsvalue->doubleValue : awe_jsvalue_to_integer(jsvalue);
+}
+
+bool awe_jsvalue_to_boolean(const awe_jsvalue* jsvalue)
+{
+	return jsvalue->type == JSVALUE_TYPE_DOUBLE ? jsvalue->doubleValue != 0 : awe_jsvalue_to_integer(jsvalue) != 0;
+}
+
+const awe_jsarray* awe_jsvalue_get_array(const awe_jsvalue* jsvalue)
+{
+	static awe_jsarray emptyArray;
+
+	return jsvalue->arrayValue ? jsvalue->arrayValue : &emptyArray;
+}
+
+const awe_jsobject* awe_jsvalue_get_object(const awe_jsvalue* jsvalue)
+{
+	static awe_jsobject emptyObject;
+
+	return jsvalue->objectValue ? jsvalue->objectValue : &emptyObject;
+}
+
+/************************
+* awe_jsarray / awe_jsobject
+************************/
+
+awe_jsarray* awe_jsarray_create(const awe_jsvalue** jsvalue_array, size_t length)
+{
+	awe_jsarray* result = new awe_jsarray();
+	result->elements.reserve(length);
+
+	for(size_t i = 0; i < length; i++)
+		result->elements.push_back(copyValue(jsvalue_array[i]));
+
+	return result;
+}
+
+void awe_jsarray_destroy(awe_jsarray* jsarray)
+{
+	for(std::vector<awe_jsvalue*>::iterator i = jsarray->elements.begin(); i != jsarray->elements.end(); i++)
+		awe_jsvalue_destroy(*i);
+
+	delete jsarray;
+}
+
+size_t awe_jsarray_get_size(const awe_jsarray* jsarray)
+{
+	return jsarray->elements.size();
+}
+
+const awe_jsvalue* awe_jsarray_get_element(const awe_jsarray* jsarray, size_t index)
+{
+	return jsarray->elements[index];
+}
+
+awe_jsobject* awe_jsobject_create()
+{
+	return new awe_jsobject();
+}
+
+void awe_jsobject_destroy(awe_jsobject* object)
+{
+	for(std::map<std::vector<wchar16>, awe_jsvalue*>::iterator i = object->properties.begin(); i != object->properties.end(); i++)
+		awe_jsvalue_destroy(i->second);
+
+	delete object;
+}
+
+const awe_jsvalue* awe_jsobject_get_property(const awe_jsobject* object, const awe_string* property_name)
+{
+	static awe_jsvalue* nullValue = awe_jsvalue_create_null_value();
+
+	std::map<std::vector<wchar16>, awe_jsvalue*>::const_iterator i = object->properties.find(property_name->text);
+
+	return i != object->properties.end() ? i->second : nullValue;
+}
+
+void awe_jsobject_set_property(awe_jsobject* object, const awe_string* property_name, const awe_jsvalue* value)
+{
+	awe_jsvalue*& property = object->properties[property_name->text];
+
+	if(property)
+		awe_jsvalue_destroy(property);
+
+	property = copyValue(value);
+}
+
+awe_jsarray* awe_jsobject_get_keys(awe_jsobject* object)
+{
+	awe_jsarray* result = new awe_jsarray();
+
+	for(std::map<std::vector<wchar16>, awe_jsvalue*>::iterator i = object->properties.begin(); i != object->properties.end(); i++)
+	{
+		awe_jsvalue* key = createValue(JSVALUE_TYPE_STRING);
+		key->stringValue = createString(i->first);
+		result->elements.push_back(key);
+	}
+
+	return result;
+}
+
+/************************
+* awe_webcore
+************************/
+
+void awe_webcore_initialize(bool enable_plugins, bool enable_javascript, bool enable_databases, 
+	const awe_string* package_path, const awe_string* locale_path, const awe_string* user_data_path, 
+	const awe_string* plugin_path, const awe_string* log_path, awe_loglevel log_level, bool force_single_process, 
+	const awe_string* child_process_path, bool enable_auto_detect_encoding, const awe_string* accept_language_override, 
+	const awe_string* default_charset_override, const awe_string* user_agent_override, const awe_string* proxy_server, 
+	const awe_string* proxy_config_script, const awe_string* auth_server_whitelist, bool save_cache_and_cookies, 
+	int max_cache_size, bool disable_same_origin_policy, bool disable_win_message_pump, const awe_string* custom_css)
+{
+}
+
+void awe_webcore_shutdown()
+{
+	while(!webViews.empty())
+		awe_webview_destroy(webViews.back());
+}
+
+void awe_webcore_set_base_directory(const awe_string* base_dir_path)
+{
+}
+
+void awe_webcore_update()
+{
+	counters.webCoreUpdates++;
+
+	// Iterate over a copy as listeners may create or destroy web views
+	std::vector<awe_webview*> views = webViews;
+
+	for(std::vector<awe_webview*>::iterator i = views.begin(); i != views.end(); i++)
+	{
+		if(std::find(webViews.begin(), webViews.end(), *i) == webViews.end())
+			continue;
+
+		awe_webview* webView = *i;
+
+		if(!webView->pendingLoad.empty())
+			finishLoad(webView);
+
+		if(config.dirtyInterval && counters.webCoreUpdates % config.dirtyInterval == 0)
+			markBandDirty(webView);
+
+		if(config.callbackInterval && counters.webCoreUpdates % config.callbackInterval == 0)
+			raiseCallbacks(webView);
+	}
+}
+
+awe_webview* awe_webcore_create_webview(int width, int height, bool view_source)
+{
+	awe_webview* webView = new awe_webview();
+	webView->width = width;
+	webView->height = height;
+	webView->isDirty = false;
+	webView->paintCount = 0;
+	webView->renderBuffer.width = 0;
+	webView->renderBuffer.height = 0;
+	webView->renderBuffer.rowSpan = 0;
+	webView->callbacks = awe_webview::Callbacks();
+
+	markAllDirty(webView);
+
+	webViews.push_back(webView);
+	counters.webViewsCreated++;
+
+	return webView;
+}
+
+/************************
+* awe_webview
+************************/
+
+void awe_webview_destroy(awe_webview* webview)
+{
+	webViews.erase(std::remove(webViews.begin(), webViews.end(), webview), webViews.end());
+	counters.webViewsDestroyed++;
+
+	delete webview;
+}
+
+void awe_webview_load_url(awe_webview* webview, const awe_string* url, const awe_string* frame_name, 
+	const awe_string* username, const awe_string* password)
+{
+	requestLoad(webview, url);
+}
+
+void awe_webview_load_html(awe_webview* webview, const awe_string* html, const awe_string* frame_name)
+{
+	requestLoad(webview, awe_string_empty());
+}
+
+void awe_webview_load_file(awe_webview* webview, const awe_string* file, const awe_string* frame_name)
+{
+	requestLoad(webview, file);
+}
+
+void awe_webview_execute_javascript(awe_webview* webview, const awe_string* javascript, const awe_string* frame_name)
+{
+	counters.javascriptExecutions++;
+
+	if(config.javascriptDirties)
+		markBandDirty(webview);
+}
+
+awe_jsvalue* awe_webview_execute_javascript_with_result(awe_webview* webview, const awe_string* javascript, 
+	const awe_string* frame_name, int timeout_ms)
+{
+	counters.javascriptExecutions++;
+
+	return awe_jsvalue_create_integer_value((int)counters.javascriptExecutions);
+}
+
+void awe_webview_create_object(awe_webview* webview, const awe_string* object_name)
+{
+}
+
+void awe_webview_set_object_property(awe_webview* webview, const awe_string* object_name, 
+	const awe_string* property_name, const awe_jsvalue* value)
+{
+}
+
+void awe_webview_set_object_callback(awe_webview* webview, const awe_string* object_name, const awe_string* callback_name)
+{
+	if(std::find(webview->callbackNames.begin(), webview->callbackNames.end(), callback_name->text) == webview->callbackNames.end())
+		webview->callbackNames.push_back(callback_name->text);
+}
+
+bool awe_webview_is_dirty(awe_webview* webview)
+{
+	return webview->isDirty;
+}
+
+awe_rect awe_webview_get_dirty_bounds(awe_webview* webview)
+{
+	return webview->dirtyBounds;
+}
+
+const awe_renderbuffer* awe_webview_render(awe_webview* webview)
+{
+	awe_renderbuffer& buffer = webview->renderBuffer;
+
+	if(buffer.width != webview->width || buffer.height != webview->height)
+	{
+		buffer.width = webview->width;
+		buffer.height = webview->height;
+		buffer.rowSpan = webview->width * 4;
+		buffer.pixels.assign(buffer.rowSpan * buffer.height, 0);
+		markAllDirty(webview);
+	}
+
+	if(webview->isDirty)
+	{
+		// Paint the dirty rows with a colour that changes every frame so that every upload is distinct
+		unsigned char shade = (unsigned char)(counters.framesRendered * 7);
+
+		for(int row = webview->dirtyBounds.y; row < webview->dirtyBounds.y + webview->dirtyBounds.height; row++)
+			memset(&buffer.pixels[row * buffer.rowSpan], shade, buffer.rowSpan);
+
+		webview->isDirty = false;
+		counters.framesRendered++;
+	}
+
+	return &buffer;
+}
+
+void awe_webview_inject_mouse_move(awe_webview* webview, int x, int y)
+{
+	counters.mouseEvents++;
+}
+
+void awe_webview_inject_mouse_down(awe_webview* webview, awe_mousebutton button)
+{
+	counters.mouseEvents++;
+	markBandDirty(webview);
+}
+
+void awe_webview_inject_mouse_up(awe_webview* webview, awe_mousebutton button)
+{
+	counters.mouseEvents++;
+}
+
+void awe_webview_inject_mouse_wheel(awe_webview* webview, int scroll_amount_vert, int scroll_amount_horz)
+{
+	counters.mouseEvents++;
+	markBandDirty(webview);
+}
+
+void awe_webview_inject_keyboard_event_win(awe_webview* webview, UINT msg, WPARAM wparam, LPARAM lparam)
+{
+	counters.keyboardEvents++;
+}
+
+void awe_webview_focus(awe_webview* webview)
+{
+}
+
+void awe_webview_unfocus(awe_webview* webview)
+{
+}
+
+void awe_webview_set_transparent(awe_webview* webview, bool is_transparent)
+{
+	markAllDirty(webview);
+}
+
+void awe_webview_set_zoom(awe_webview* webview, int zoom_percent)
+{
+	markAllDirty(webview);
+}
+
+void awe_webview_reset_zoom(awe_webview* webview)
+{
+	markAllDirty(webview);
+}
+
+bool awe_webview_resize(awe_webview* webview, int width, int height, bool wait_for_repaint, int repaint_timeout_ms)
+{
+	webview->width = width;
+	webview->height = height;
+	webview->isDirty = false;
+	markAllDirty(webview);
+
+	return true;
+}
+
+/************************
+* awe_renderbuffer
+************************/
+
+int awe_renderbuffer_get_width(const awe_renderbuffer* renderbuffer)
+{
+	return renderbuffer->width;
+}
+
+int awe_renderbuffer_get_height(const awe_renderbuffer* renderbuffer)
+{
+	return renderbuffer->height;
+}
+
+int awe_renderbuffer_get_rowspan(const awe_renderbuffer* renderbuffer)
+{
+	return renderbuffer->rowSpan;
+}
+
+const unsigned char* awe_renderbuffer_get_buffer(const awe_renderbuffer* renderbuffer)
+{
+	return renderbuffer->pixels.empty() ? 0 : &renderbuffer->pixels[0];
+}
+
+void awe_renderbuffer_copy_to(const awe_renderbuffer* renderbuffer, unsigned char* dest_buffer, int dest_rowspan, 
+	int dest_depth, bool convert_to_rgba, bool flip_y)
+{
+	int rowBytes = renderbuffer->width * 4 < dest_rowspan ? renderbuffer->width * 4 : dest_rowspan;
+
+	for(int row = 0; row < renderbuffer->height; row++)
+	{
+		int sourceRow = flip_y ? renderbuffer->height - 1 - row : row;
+		memcpy(dest_buffer + row * dest_rowspan, &renderbuffer->pixels[sourceRow * renderbuffer->rowSpan], rowBytes);
+	}
+}
+
+bool awe_renderbuffer_save_to_jpeg(const awe_renderbuffer* renderbuffer, const awe_string* file_path, int quality)
+{
+	return false;
+}
+
+/************************
+* Callbacks
+************************/
+
+void awe_webview_set_callback_begin_navigation(awe_webview* webview, 
+	void (*callback)(awe_webview* caller, const awe_string* url, const awe_string* frame_name))
+{
+	webview->callbacks.beginNavigation = callback;
+}
+
+void awe_webview_set_callback_begin_loading(awe_webview* webview, 
+	void (*callback)(awe_webview* caller, const awe_string* url, const awe_string* frame_name, int status_code, 
+	const awe_string* mime_type))
+{
+	webview->callbacks.beginLoading = callback;
+}
+
+void awe_webview_set_callback_finish_loading(awe_webview* webview, void (*callback)(awe_webview* caller))
+{
+	webview->callbacks.finishLoading = callback;
+}
+
+void awe_webview_set_callback_js_callback(awe_webview* webview, 
+	void (*callback)(awe_webview* caller, const awe_string* object_name, const awe_string* callback_name, 
+	const awe_jsarray* arguments))
+{
+	webview->callbacks.jsCallback = callback;
+}
+
+void awe_webview_set_callback_receive_title(awe_webview* webview, 
+	void (*callback)(awe_webview* caller, const awe_string* title, const awe_string* frame_name))
+{
+	webview->callbacks.receiveTitle = callback;
+}
+
+void awe_webview_set_callback_change_tooltip(awe_webview* webview, 
+	void (*callback)(awe_webview* caller, const awe_string* tooltip))
+{
+	webview->callbacks.changeTooltip = callback;
+}
+
+void awe_webview_set_callback_change_cursor(awe_webview* webview, 
+	void (*callback)(awe_webview* caller, awe_cursor_type cursor))
+{
+	webview->callbacks.changeCursor = callback;
+}
+
+void awe_webview_set_callback_change_keyboard_focus(awe_webview* webview, 
+	void (*callback)(awe_webview* caller, bool is_focused))
+{
+	webview->callbacks.changeKeyboardFocus = callback;
+}
+
+void awe_webview_set_callback_change_target_url(awe_webview* webview, 
+	void (*callback)(awe_webview* caller, const awe_string* url))
+{
+	webview->callbacks.changeTargetURL = callback;
+}
+
+void awe_webview_set_callback_open_external_link(awe_webview* webview, 
+	void (*callback)(awe_webview* caller, const awe_string* url, const awe_string* source))
+{
+	webview->callbacks.openExternalLink = callback;
+}
+
+void awe_webview_set_callback_request_download(awe_webview* webview, 
+	void (*callback)(awe_webview* caller, const awe_string* download))
+{
+	webview->callbacks.requestDownload = callback;
+}
+
+void awe_webview_set_callback_web_view_crashed(awe_webview* webview, void (*callback)(awe_webview* caller))
+{
+	webview->callbacks.webViewCrashed = callback;
+}
+
+void awe_webview_set_callback_plugin_crashed(awe_webview* webview, 
+	void (*callback)(awe_webview* caller, const awe_string* plugin_name))
+{
+	webview->callbacks.pluginCrashed = callback;
+}
+
+void awe_webview_set_callback_request_move(awe_webview* webview, 
+	void (*callback)(awe_webview* caller, int x, int y))
+{
+	webview->callbacks.requestMove = callback;
+}
+
+void awe_webview_set_callback_get_page_contents(awe_webview* webview, 
+	void (*callback)(awe_webview* caller, const awe_string* url, const awe_string* contents))
+{
+	webview->callbacks.getPageContents = callback;
+}
+
+void awe_webview_set_callback_dom_ready(awe_webview* webview, void (*callback)(awe_webview* caller))
+{
+	webview->callbacks.domReady = callback;
+}
+
+void awe_webview_set_callback_request_file_chooser(awe_webview* webview, 
+	void (*callback)(awe_webview* caller, bool select_multiple_files, const awe_string* title, 
+	const awe_string* default_path))
+{
+	webview->callbacks.requestFileChooser = callback;
+}
+
+void awe_webview_set_callback_get_scroll_data(awe_webview* webview, 
+	void (*callback)(awe_webview* caller, int contentWidth, int contentHeight, int preferredWidth, int scrollX, 
+	int scrollY))
+{
+	webview->callbacks.getScrollData = callback;
+}
+
+void awe_webview_set_callback_js_console_message(awe_webview* webview, 
+	void (*callback)(awe_webview* caller, const awe_string* message, int line_number, const awe_string* source))
+{
+	webview->callbacks.jsConsoleMessage = callback;
+}
+
+void awe_webview_set_callback_get_find_results(awe_webview* webview, 
+	void (*callback)(awe_webview* caller, int request_id, int num_matches, awe_rect selection, int cur_match, 
+	bool finalUpdate))
+{
+	webview->callbacks.getFindResults = callback;
+}
+
+void awe_webview_set_callback_update_ime(awe_webview* webview, 
+	void (*callback)(awe_webview* caller, awe_ime_state state, awe_rect caret_rect))
+{
+	webview->callbacks.updateIME = callback;
+}
\ No newline at end of file
@@ -0,0 +1,110 @@
+/*
+	This file is part of NaviLibrary, a library that allows developers to create and 
+	interact with web-content as an overlay or material in Ogre3D applications.
+
+	Copyright (C) 2011 Khrona LLC
+	https://github.com/khrona/navi
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef __AwesomiumStandIn_H__
+#define __AwesomiumStandIn_H__
+
+#include <Awesomium/awesomium_capi.h>
+
+/**
+* A scripted stand-in for the subset of the Awesomium C API used by NaviLibrary. Link this instead of
+* Awesomium.lib to drive NaviManager/Navi without a browser: web views produce synthetic dirty frames,
+* JS callbacks and JavaScript results at the rates given by StandIn::configure.
+*/
+namespace StandIn
+{
+	struct Config
+	{
+		/// A web view repaints every this many calls to awe_webcore_update (0 = only when loaded/resized).
+		unsigned int dirtyInterval;
+		/// The fraction of a web view's height that is repainted each time (0..1).
+		float dirtyCoverage;
+		/// Each bound 'Client' callback is raised every this many calls to awe_webcore_update (0 = never).
+		unsigned int callbackInterval;
+		/// The number of arguments passed with each raised callback.
+		unsigned int callbackArgCount;
+		/// Whether or not awe_webview_execute_javascript repaints the web view, as a typical DOM update would.
+		bool javascriptDirties;
+
+		Config() : dirtyInterval(1), dirtyCoverage(0.25f), callbackInterval(0), callbackArgCount(2), 
+			javascriptDirties(false) {}
+	};
+
+	struct Counters
+	{
+		unsigned long long webCoreUpdates;
+		unsigned long long framesRendered;
+		unsigned long long callbacksRaised;
+		unsigned long long javascriptExecutions;
+		unsigned long long mouseEvents;
+		unsigned long long keyboardEvents;
+		unsigned long long webViewsCreated;
+		unsigned long long webViewsDestroyed;
+
+		Counters() : webCoreUpdates(0), framesRendered(0), callbacksRaised(0), javascriptExecutions(0), 
+			mouseEvents(0), keyboardEvents(0), webViewsCreated(0), webViewsDestroyed(0) {}
+	};
+
+	enum CallbackType
+	{
+		BeginNavigation = 0,
+		BeginLoading,
+		FinishLoading,
+		JSCallback,
+		ReceiveTitle,
+		ChangeTooltip,
+		ChangeCursor,
+		ChangeKeyboardFocus,
+		ChangeTargetURL,
+		OpenExternalLink,
+		RequestDownload,
+		WebViewCrashed,
+		PluginCrashed,
+		RequestMove,
+		GetPageContents,
+		DOMReady,
+		RequestFileChooser,
+		GetScrollData,
+		JSConsoleMessage,
+		GetFindResults,
+		UpdateIME,
+		CallbackTypeCount
+	};
+
+	void configure(const Config& config);
+
+	const Config& getConfig();
+
+	const Counters& getCounters();
+
+	void resetCounters();
+
+	const char* getCallbackName(CallbackType type);
+
+	/**
+	* Raises a callback on a web view with fixed, representative arguments (created once, so only the
+	* dispatch itself is measured). Returns false if no handler is bound for that callback.
+	*/
+	bool raiseCallback(awe_webview* webView, CallbackType type);
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,429 @@
+/*
+	This file is part of NaviLibrary, a library that allows developers to create and 
+	interact with web-content as an overlay or material in Ogre3D applications.
+
+	Copyright (C) 2011 Khrona LLC
+	https://github.com/khrona/navi
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+	CapiBench measures the OSM wrapper layer (awesomium_capi_helpers) against the Awesomium stand-in: string
+	construction, copying and conversion, JSValue trees of various shapes, and the dispatch of every web view
+	callback through WebViewEventHelper. Each benchmark is repeated until it has run for at least 200 ms and
+	reports ns/op and allocations/op.
+
+	Usage: CapiBench [filter]		(only runs the benchmarks whose name contains 'filter')
+*/
+
+#include "AwesomiumStandIn.h"
+#include "AllocationCounter.h"
+#include "awesomium_capi_helpers.h"
+#include "NaviStats.h"
+#include <string>
+#include <vector>
+#include <stdio.h>
+
+using namespace OSM;
+
+namespace
+{
+	const unsigned long long MIN_RUN_TIME_US = 200000;
+
+	// Results are accumulated here so that the measured work cannot be optimized away
+	volatile size_t sink = 0;
+
+	/************************
+	* Fixtures
+	************************/
+
+	const std::string& getAsciiText(size_t length)
+	{
+		static std::string texts[3];
+		std::string& text = texts[length <= 8 ? 0 : length <= 64 ? 1 : 2];
+
+		if(text.length() != length)
+		{
+			text.resize(length);
+
+			for(size_t i = 0; i < length; i++)
+				text[i] = (char)('a' + i % 26);
+		}
+
+		return text;
+	}
+
+	std::wstring getWideText(size_t length)
+	{
+		const std::string& text = getAsciiText(length);
+
+		return std::wstring(text.begin(), text.end());
+	}
+
+	enum Shape
+	{
+		FlatArray,		// 16 integers
+		NestedObject,	// objects 3 levels deep with 4 properties each, string leaves
+		RecordArray		// 64 objects with an integer, string, double and boolean property
+	};
+
+	JSValue createNestedObject(int depth)
+	{
+		JSValue::Object object;
+
+		for(int i = 0; i < 4; i++)
+		{
+			std::wstring key = L"key";
+			key += (wchar_t)(L'0' + i);
+
+			object[key] = depth > 1 ? createNestedObject(depth - 1) : JSValue(L"leaf value");
+		}
+
+		return JSValue(object);
+	}
+
+	JSValue createShape(Shape shape)
+	{
+		JSValue::Array array;
+
+		switch(shape)
+		{
+		case FlatArray:
+			for(int i = 0; i < 16; i++)
+				array.push_back(JSValue(i));
+			break;
+		case NestedObject:
+			return createNestedObject(3);
+		case RecordArray:
+			for(int i = 0; i < 64; i++)
+			{
+				JSValue::Object record;
+				record[L"id"] = JSValue(i);
+				record[L"name"] = JSValue(L"player name");
+				record[L"score"] = JSValue(i * 1.5);
+				record[L"active"] = JSValue(i % 2 == 0);
+				array.push_back(JSValue(record));
+			}
+			break;
+		}
+
+		return JSValue(array);
+	}
+
+	const JSValue& getShape(Shape shape)
+	{
+		static JSValue* shapes[3] = { 0, 0, 0 };
+
+		if(!shapes[shape])
+			shapes[shape] = new JSValue(createShape(shape));
+
+		return *shapes[shape];
+	}
+
+	class CountingListener : public WebViewListener
+	{
+	public:
+		size_t eventCount;
+
+		CountingListener() : eventCount(0) {}
+
+		void onBeginNavigation(awe_webview* caller, const String& url, const String& frameName) { eventCount++; }
+		void onBeginLoading(awe_webview* caller, const String& url, const String& frameName, int statusCode, 
+			const String& mimeType) { eventCount++; }
+		void onFinishLoading(awe_webview* caller) { eventCount++; }
+		void onJSCallback(awe_webview* caller, const String& objectName, const String& callbackName, 
+			const JSArguments& args) { eventCount += args.size(); }
+		void onReceiveTitle(awe_webview* caller, const String& title, const String& frameName) { eventCount++; }
+		void onChangeTooltip(awe_webview* caller, const String& tooltip) { eventCount++; }
+		void onChangeCursor(awe_webview* caller, awe_cursor_type cursor) { eventCount++; }
+		void onChangeKeyboardFocus(awe_webview* caller, bool isFocused) { eventCount++; }
+		void onChangeTargetURL(awe_webview* caller, const String& url) { eventCount++; }
+		void onOpenExternalLink(awe_webview* caller, const String& url, const String& source) { eventCount++; }
+		void onRequestDownload(awe_webview* caller, const String& url) { eventCount++; }
+		void onWebViewCrashed(awe_webview* caller) { eventCount++; }
+		void onPluginCrashed(awe_webview* caller, const String& pluginName) { eventCount++; }
+		void onRequestMove(awe_webview* caller, int x, int y) { eventCount++; }
+		void onGetPageContents(awe_webview* caller, const String& url, const String& contents) { eventCount++; }
+		void onDOMReady(awe_webview* caller) { eventCount++; }
+		void onRequestFileChooser(awe_webview* caller, bool selectMultipleFiles, const String& title, 
+			const String& defaultPath) { eventCount++; }
+		void onGetScrollData(awe_webview* caller, int contentWidth, int contentHeight, int preferredWidth, 
+			int scrollX, int scrollY) { eventCount++; }
+		void onJSConsoleMessage(awe_webview* caller, const String& message, int lineNumber, 
+			const String& source) { eventCount++; }
+		void onGetFindResults(awe_webview* caller, int requestID, int numMatches, awe_rect selection, 
+			int curMatch, bool finalUpdate) { eventCount++; }
+		void onUpdateIME(awe_webview* caller, awe_ime_state imeState, awe_rect caretRect) { eventCount++; }
+	};
+
+	awe_webview* getListeningWebView()
+	{
+		static awe_webview* webView = 0;
+		static CountingListener listener;
+
+		if(!webView)
+		{
+			webView = awe_webcore_create_webview(64, 64, false);
+			WebViewEventHelper::instance().addListener(webView, &listener);
+		}
+
+		return webView;
+	}
+
+	/************************
+	* Benchmarks
+	************************/
+
+	template<size_t Length>
+	void stringFromAscii(unsigned int iterations)
+	{
+		const std::string& text = getAsciiText(Length);
+
+		for(unsigned int i = 0; i < iterations; i++)
+			sink += String(text).length();
+	}
+
+	template<size_t Length>
+	void stringFromWide(unsigned int iterations)
+	{
+		std::wstring text = getWideText(Length);
+
+		for(unsigned int i = 0; i < iterations; i++)
+			sink += String(text).length();
+	}
+
+	template<size_t Length>
+	void stringCopy(unsigned int iterations)
+	{
+		String original(getAsciiText(Length));
+
+		for(unsigned int i = 0; i < iterations; i++)
+			sink += String(original).length();
+	}
+
+	template<size_t Length>
+	void stringToUTF8(unsigned int iterations)
+	{
+		String original(getWideText(Length));
+
+		for(unsigned int i = 0; i < iterations; i++)
+			sink += original.str().length();
+	}
+
+	template<size_t Length>
+	void stringToWide(unsigned int iterations)
+	{
+		String original(getAsciiText(Length));
+
+		for(unsigned int i = 0; i < iterations; i++)
+			sink += original.wstr().length();
+	}
+
+	void jsValueInteger(unsigned int iterations)
+	{
+		for(unsigned int i = 0; i < iterations; i++)
+			sink += JSValue((int)i).toInteger();
+	}
+
+	void jsValueDouble(unsigned int iterations)
+	{
+		for(unsigned int i = 0; i < iterations; i++)
+			sink += (size_t)JSValue(i * 0.5).toDouble();
+	}
+
+	void jsValueString(unsigned int iterations)
+	{
+		const std::string& text = getAsciiText(64);
+
+		for(unsigned int i = 0; i < iterations; i++)
+			sink += JSValue(text).isString();
+	}
+
+	template<Shape ShapeType>
+	void jsValueBuild(unsigned int iterations)
+	{
+		for(unsigned int i = 0; i < iterations; i++)
+			sink += createShape(ShapeType).isNull();
+	}
+
+	template<Shape ShapeType>
+	void jsValueCopy(unsigned int iterations)
+	{
+		const JSValue& original = getShape(ShapeType);
+
+		for(unsigned int i = 0; i < iterations; i++)
+			sink += JSValue(original).isNull();
+	}
+
+	template<Shape ShapeType>
+	void jsValueGetArray(unsigned int iterations)
+	{
+		const JSValue& value = getShape(ShapeType);
+
+		for(unsigned int i = 0; i < iterations; i++)
+			sink += value.getArray().size();
+	}
+
+	void jsValueGetObject(unsigned int iterations)
+	{
+		const JSValue& value = getShape(NestedObject);
+
+		for(unsigned int i = 0; i < iterations; i++)
+			sink += value.getObject().size();
+	}
+
+	template<size_t ArgCount>
+	void convertJSArray(unsigned int iterations)
+	{
+		JSValue::Array args;
+
+		for(size_t i = 0; i < ArgCount; i++)
+			args.push_back(i % 2 ? JSValue(getAsciiText(8)) : JSValue((int)i));
+
+		JSValue value(args);
+
+		for(unsigned int i = 0; i < iterations; i++)
+			sink += ConvertJSArray(awe_jsvalue_get_array(value.getInstance())).size();
+	}
+
+	template<StandIn::CallbackType Type>
+	void dispatchCallback(unsigned int iterations)
+	{
+		awe_webview* webView = getListeningWebView();
+
+		for(unsigned int i = 0; i < iterations; i++)
+			sink += StandIn::raiseCallback(webView, Type);
+	}
+
+	struct Benchmark
+	{
+		std::string name;
+		void (*function)(unsigned int iterations);
+	};
+
+	std::vector<Benchmark> benchmarks;
+
+	void add(const std::string& name, void (*function)(unsigned int))
+	{
+		Benchmark benchmark = { name, function };
+		benchmarks.push_back(benchmark);
+	}
+
+	template<StandIn::CallbackType Type>
+	void addDispatch()
+	{
+		add(std::string("Dispatch/") + StandIn::getCallbackName(Type), &dispatchCallback<Type>);
+	}
+
+	void registerBenchmarks()
+	{
+		add("String/FromAscii/8", &stringFromAscii<8>);
+		add("String/FromAscii/64", &stringFromAscii<64>);
+		add("String/FromAscii/1024", &stringFromAscii<1024>);
+		add("String/FromWide/8", &stringFromWide<8>);
+		add("String/FromWide/64", &stringFromWide<64>);
+		add("String/FromWide/1024", &stringFromWide<1024>);
+		add("String/Copy/8", &stringCopy<8>);
+		add("String/Copy/64", &stringCopy<64>);
+		add("String/Copy/1024", &stringCopy<1024>);
+		add("String/ToUTF8/8", &stringToUTF8<8>);
+		add("String/ToUTF8/64", &stringToUTF8<64>);
+		add("String/ToUTF8/1024", &stringToUTF8<1024>);
+		add("String/ToWide/8", &stringToWide<8>);
+		add("String/ToWide/64", &stringToWide<64>);
+		add("String/ToWide/1024", &stringToWide<1024>);
+
+		add("JSValue/Integer", &jsValueInteger);
+		add("JSValue/Double", &jsValueDouble);
+		add("JSValue/String/64", &jsValueString);
+		add("JSValue/Build/FlatArray", &jsValueBuild<FlatArray>);
+		add("JSValue/Build/NestedObject", &jsValueBuild<NestedObject>);
+		add("JSValue/Build/RecordArray", &jsValueBuild<RecordArray>);
+		add("JSValue/Copy/FlatArray", &jsValueCopy<FlatArray>);
+		add("JSValue/Copy/NestedObject", &jsValueCopy<NestedObject>);
+		add("JSValue/Copy/RecordArray", &jsValueCopy<RecordArray>);
+		add("JSValue/GetArray/FlatArray", &jsValueGetArray<FlatArray>);
+		add("JSValue/GetArray/RecordArray", &jsValueGetArray<RecordArray>);
+		add("JSValue/GetObject/NestedObject", &jsValueGetObject);
+		add("ConvertJSArray/4", &convertJSArray<4>);
+		add("ConvertJSArray/16", &convertJSArray<16>);
+
+		addDispatch<StandIn::BeginNavigation>();
+		addDispatch<StandIn::BeginLoading>();
+		addDispatch<StandIn::FinishLoading>();
+		addDispatch<StandIn::JSCallback>();
+		addDispatch<StandIn::ReceiveTitle>();
+		addDispatch<StandIn::ChangeTooltip>();
+		addDispatch<StandIn::ChangeCursor>();
+		addDispatch<StandIn::ChangeKeyboardFocus>();
+		addDispatch<StandIn::ChangeTargetURL>();
+		addDispatch<StandIn::OpenExternalLink>();
+		addDispatch<StandIn::RequestDownload>();
+		addDispatch<StandIn::WebViewCrashed>();
+		addDispatch<StandIn::PluginCrashed>();
+		addDispatch<StandIn::RequestMove>();
+		addDispatch<StandIn::GetPageContents>();
+		addDispatch<StandIn::DOMReady>();
+		addDispatch<StandIn::RequestFileChooser>();
+		addDispatch<StandIn::GetScrollData>();
+		addDispatch<StandIn::JSConsoleMessage>();
+		addDispatch<StandIn::GetFindResults>();
+		addDispatch<StandIn::UpdateIME>();
+	}
+
+	void runBenchmark(const Benchmark& benchmark)
+	{
+		// Prime any lazily created fixtures outside of the measurement
+		benchmark.function(1);
+
+		unsigned int iterations = 1;
+
+		for(;;)
+		{
+			AllocationCounter::reset();
+
+			unsigned long long startTime = NaviLibrary::Impl::getTimestampUS();
+			benchmark.function(iterations);
+			unsigned long long elapsed = NaviLibrary::Impl::getTimestampUS() - startTime;
+
+			long allocations = AllocationCounter::getCount();
+
+			if(elapsed >= MIN_RUN_TIME_US || iterations >= 0x40000000)
+			{
+				printf("%-34s %12.1f ns/op %10.2f allocs/op %12u iterations\n", benchmark.name.c_str(), 
+					elapsed * 1000.0 / iterations, (double)allocations / iterations, iterations);
+				return;
+			}
+
+			// Aim slightly past the target time, growing by at most 10x per attempt
+			double scale = elapsed ? MIN_RUN_TIME_US * 1.4 / elapsed : 10.0;
+			iterations = (unsigned int)(iterations * (scale > 10.0 ? 10.0 : scale < 2.0 ? 2.0 : scale));
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::string filter = argc > 1 ? argv[1] : "";
+
+	registerBenchmarks();
+
+	for(std::vector<Benchmark>::iterator i = benchmarks.begin(); i != benchmarks.end(); i++)
+		if(filter.empty() || i->name.find(filter) != std::string::npos)
+			runBenchmark(*i);
+
+	return (int)(sink & 0);
+}
\ No newline at end of file
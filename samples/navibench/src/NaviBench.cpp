@@ -0,0 +1,367 @@
+/*
+	This file is part of NaviLibrary, a library that allows developers to create and 
+	interact with web-content as an overlay or material in Ogre3D applications.
+
+	Copyright (C) 2011 Khrona LLC
+	https://github.com/khrona/navi
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+	NaviBench drives NaviManager/Navi against the scripted Awesomium stand-in (see AwesomiumStandIn.h) so that
+	frame costs can be measured without a browser. Each scenario runs for a fixed number of frames and reports
+	frame time percentiles, allocations per frame and the NaviManager statistics.
+
+	Usage: NaviBench [frames] [-threaded] [-workers N] [-trace file.json]
+*/
+
+#include "AwesomiumStandIn.h"
+#include "AllocationCounter.h"
+#include "NaviManager.h"
+#include "Navi.h"
+#include <OGRE/Ogre.h>
+#include <windows.h>
+#include <algorithm>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace Ogre;
+using namespace NaviLibrary;
+using namespace NaviLibrary::NaviUtilities;
+
+/************************
+* Scenarios
+************************/
+
+class Scenario
+{
+public:
+	virtual ~Scenario() {}
+
+	virtual const char* getName() = 0;
+
+	virtual StandIn::Config getConfig() { return StandIn::Config(); }
+
+	virtual void setup(Viewport* viewport) = 0;
+
+	virtual void runFrame(unsigned int frameIndex) {}
+
+	virtual void teardown()
+	{
+		for(std::vector<Navi*>::iterator i = navis.begin(); i != navis.end(); i++)
+			NaviManager::Get().destroyNavi(*i);
+
+		navis.clear();
+	}
+
+protected:
+	std::vector<Navi*> navis;
+
+	Navi* createOverlay(unsigned int index, unsigned short width, unsigned short height, short left, short top)
+	{
+		Navi* navi = NaviManager::Get().createNavi("bench" + StringConverter::toString(index), width, height, 
+			NaviPosition(left, top));
+		navi->loadHTML("<html><body>NaviBench</body></html>");
+		navis.push_back(navi);
+
+		return navi;
+	}
+};
+
+// Dozens of small overlays that all repaint a quarter of their area every frame
+class ManyOverlays : public Scenario
+{
+public:
+	const char* getName() { return "many-overlays"; }
+
+	void setup(Viewport* viewport)
+	{
+		for(unsigned int i = 0; i < 64; i++)
+			createOverlay(i, 128, 96, (short)(i % 8 * 130), (short)(i / 8 * 98));
+	}
+};
+
+// A few overlays that receive many JavaScript pushes per frame and raise callbacks back to the application
+class JavascriptPush : public Scenario
+{
+public:
+	JavascriptPush() : callbackCount(0) {}
+
+	const char* getName() { return "js-push"; }
+
+	StandIn::Config getConfig()
+	{
+		StandIn::Config config;
+		config.dirtyInterval = 0;
+		config.callbackInterval = 1;
+		config.callbackArgCount = 4;
+		config.javascriptDirties = true;
+
+		return config;
+	}
+
+	void setup(Viewport* viewport)
+	{
+		for(unsigned int i = 0; i < 4; i++)
+		{
+			Navi* navi = createOverlay(i, 512, 256, (short)(i % 2 * 520), (short)(i / 2 * 260));
+			navi->bind("onScore", NaviDelegate(this, &JavascriptPush::onCallback));
+			navi->bind("onChat", NaviDelegate(this, &JavascriptPush::onCallback));
+		}
+	}
+
+	void runFrame(unsigned int frameIndex)
+	{
+		for(std::vector<Navi*>::iterator i = navis.begin(); i != navis.end(); i++)
+			for(int push = 0; push < 50; push++)
+				(*i)->evaluateJS("updateScore(?, ?)", JSArgs(push, "player"));
+
+		navis.front()->evaluateJSWithResult("getScore()");
+	}
+
+protected:
+	unsigned int callbackCount;
+
+	void onCallback(Navi* caller, const OSM::JSArguments& args)
+	{
+		callbackCount += (unsigned int)args.size();
+	}
+};
+
+// Overlapping overlays under a constantly moving, clicking and scrolling cursor
+class MouseInput : public Scenario
+{
+public:
+	const char* getName() { return "mouse-input"; }
+
+	StandIn::Config getConfig()
+	{
+		StandIn::Config config;
+		config.dirtyInterval = 0;
+
+		return config;
+	}
+
+	void setup(Viewport* viewport)
+	{
+		for(unsigned int i = 0; i < 8; i++)
+			createOverlay(i, 400, 300, (short)(i * 60), (short)(i * 40));
+	}
+
+	void runFrame(unsigned int frameIndex)
+	{
+		for(int move = 0; move < 20; move++)
+		{
+			int x = (int)((frameIndex * 20 + move) * 7 % 800);
+			int y = (int)((frameIndex * 20 + move) * 3 % 600);
+			NaviManager::Get().injectMouseMove(x, y);
+		}
+
+		if(frameIndex % 4 == 0)
+		{
+			NaviManager::Get().injectMouseDown(LeftMouseButton);
+			NaviManager::Get().injectMouseUp(LeftMouseButton);
+		}
+
+		NaviManager::Get().injectMouseWheel(frameIndex % 2 ? 120 : -120);
+	}
+};
+
+// The many-overlays load with every overlay paced to a half or a quarter of the display rate
+class PacedOverlays : public Scenario
+{
+public:
+	const char* getName() { return "paced"; }
+
+	void setup(Viewport* viewport)
+	{
+		for(unsigned int i = 0; i < 64; i++)
+			createOverlay(i, 128, 96, (short)(i % 8 * 130), (short)(i / 8 * 98))->setUpdateDivisor(i % 2 ? 2 : 4);
+	}
+};
+
+// Overlays being created and destroyed every frame, as with transient popups
+class CreateDestroyChurn : public Scenario
+{
+public:
+	CreateDestroyChurn() : nextIndex(0) {}
+
+	const char* getName() { return "churn"; }
+
+	void setup(Viewport* viewport)
+	{
+		for(nextIndex = 0; nextIndex < 16; nextIndex++)
+			createOverlay(nextIndex, 256, 128, (short)(nextIndex % 4 * 260), (short)(nextIndex / 4 * 130));
+	}
+
+	void runFrame(unsigned int frameIndex)
+	{
+		NaviManager::Get().destroyNavi(navis.front());
+		navis.erase(navis.begin());
+
+		createOverlay(nextIndex, 256, 128, (short)(nextIndex % 4 * 260), (short)(nextIndex / 4 % 4 * 130));
+		nextIndex++;
+	}
+
+protected:
+	unsigned int nextIndex;
+};
+
+/************************
+* Harness
+************************/
+
+namespace
+{
+	double getPercentile(std::vector<double>& sortedTimes, double percentile)
+	{
+		if(sortedTimes.empty())
+			return 0;
+
+		size_t index = (size_t)(percentile / 100.0 * (sortedTimes.size() - 1) + 0.5);
+
+		return sortedTimes[std::min(index, sortedTimes.size() - 1)];
+	}
+
+	void runScenario(Scenario& scenario, Viewport* viewport, unsigned int frameCount)
+	{
+		const unsigned int warmupFrames = 30;
+
+		StandIn::configure(scenario.getConfig());
+		scenario.setup(viewport);
+
+		std::vector<double> frameTimes;
+		frameTimes.reserve(frameCount);
+
+		for(unsigned int frame = 0; frame < warmupFrames + frameCount; frame++)
+		{
+			if(frame == warmupFrames)
+			{
+				StandIn::resetCounters();
+				NaviManager::Get().resetStats();
+				AllocationCounter::reset();
+			}
+
+			unsigned long long startTime = Impl::getTimestampUS();
+
+			scenario.runFrame(frame);
+			NaviManager::Get().Update();
+			Root::getSingleton().renderOneFrame();
+
+			if(frame >= warmupFrames)
+				frameTimes.push_back((Impl::getTimestampUS() - startTime) / 1000.0);
+
+			WindowEventUtilities::messagePump();
+		}
+
+		long allocations = AllocationCounter::getCount();
+		NaviStats stats = NaviManager::Get().getStats();
+		const StandIn::Counters& counters = StandIn::getCounters();
+
+		scenario.teardown();
+
+		std::sort(frameTimes.begin(), frameTimes.end());
+
+		printf("%-14s p50 %7.3f ms  p90 %7.3f ms  p99 %7.3f ms  max %7.3f ms  allocs/frame %8.1f\n", scenario.getName(), 
+			getPercentile(frameTimes, 50), getPercentile(frameTimes, 90), getPercentile(frameTimes, 99), 
+			frameTimes.empty() ? 0 : frameTimes.back(), (double)allocations / frameCount);
+
+		printf("%-14s uploaded %.1f MB  updates %llu/%llu  render %.3f ms  copy %.3f ms  callbacks %llu (avg latency %.1f us)  js %llu\n\n", 
+			"", stats.bytesUploaded / (1024.0 * 1024.0), stats.updatesPerformed, stats.updatesAttempted, 
+			stats.renderTime / 1000.0, stats.copyTime / 1000.0, stats.callbacksDispatched, 
+			stats.getAverageCallbackLatency(), counters.javascriptExecutions);
+
+		if(stats.pacedIntervals)
+			printf("%-14s pacing jitter avg %.1f us  max %llu us (%u Hz)\n\n", "", stats.getAveragePacingJitter(), 
+				stats.maxPacingJitter, NaviManager::Get().getDisplayRefreshRate());
+	}
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int frameCount = 600;
+	unsigned int workerCount = 0;
+	bool useBrowserThread = false;
+	std::string traceFile;
+
+	for(int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+
+		if(arg == "-threaded")
+			useBrowserThread = true;
+		else if(arg == "-workers" && i + 1 < argc)
+			workerCount = (unsigned int)atoi(argv[++i]);
+		else if(arg == "-trace" && i + 1 < argc)
+			traceFile = argv[++i];
+		else if(atoi(argv[i]) > 0)
+			frameCount = (unsigned int)atoi(argv[i]);
+	}
+
+	try
+	{
+		Root* root = new Root("Plugins.cfg", "", "NaviBench.log");
+
+		if(root->getAvailableRenderers().empty())
+			OGRE_EXCEPT(Exception::ERR_RENDERINGAPI_ERROR, "No render system is available.", "main");
+
+		root->setRenderSystem(root->getAvailableRenderers().front());
+		root->initialise(false);
+
+		RenderWindow* renderWin = root->createRenderWindow("NaviBench", 1024, 768, false);
+		SceneManager* sceneMgr = root->createSceneManager(ST_GENERIC);
+		Camera* camera = sceneMgr->createCamera("BenchCam");
+		Viewport* viewport = renderWin->addViewport(camera);
+
+		ResourceGroupManager::getSingleton().initialiseAllResourceGroups();
+
+		NaviManager* naviMgr = new NaviManager(viewport, "", useBrowserThread);
+		naviMgr->setWorkerCount(workerCount);
+		naviMgr->setStatsEnabled(true);
+
+		if(!traceFile.empty())
+			naviMgr->startTrace();
+
+		printf("NaviBench: %u frames per scenario, %s, %u workers\n\n", frameCount, 
+			useBrowserThread ? "browser thread" : "single thread", workerCount);
+
+		ManyOverlays manyOverlays;
+		JavascriptPush javascriptPush;
+		MouseInput mouseInput;
+		PacedOverlays pacedOverlays;
+		CreateDestroyChurn churn;
+
+		Scenario* scenarios[] = { &manyOverlays, &javascriptPush, &mouseInput, &pacedOverlays, &churn };
+
+		for(size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++)
+			runScenario(*scenarios[i], viewport, frameCount);
+
+		if(!traceFile.empty())
+			naviMgr->saveTrace(traceFile);
+
+		delete naviMgr;
+		root->shutdown();
+		delete root;
+	}
+	catch(Ogre::Exception& e)
+	{
+		fprintf(stderr, "%s\n", e.getFullDescription().c_str());
+		return 1;
+	}
+
+	return 0;
+}
\ No newline at end of file
@@ -20,16 +20,26 @@
 */
 
 #include "Atlas.h"
+#include "GlyphCache.h"
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <stdio.h>
+
+// Pages of glyphs that are rasterized on demand
+#define GLYPH_PAGE_SIZE 512
+#define MAX_GLYPH_PAGES 4
 
 /************************
 * TextureInfo
 ************************/
 
-TextureInfo::TextureInfo() : isEmpty(true), width(0), height(0)
+TextureInfo::TextureInfo() : isEmpty(true), width(0), height(0), page(0)
 {
 }
 
-TextureInfo::TextureInfo(int atlasWidth, int atlasHeight, int x, int y, int width, int height) : isEmpty(false), width(width), height(height)
+TextureInfo::TextureInfo(int atlasWidth, int atlasHeight, int x, int y, int width, int height) : isEmpty(false), width(width), height(height), page(0)
 {
 	texCoords.left = x / (float)atlasWidth;
 	texCoords.top = y / (float)atlasHeight;
@@ -105,7 +115,7 @@ bool CharCodeRange::isWithinRange(CharCode code) const
 ************************/
 
 ComputationRect::ComputationRect(const Ogre::String& texFilename, const Ogre::String& resourceGroup) 
-	: x(0), y(0), weight(1), isPlaced(false), isFontGlyph(false), filename(texFilename)
+	: x(0), y(0), isPlaced(false), isFontGlyph(false), filename(texFilename), isDistanceField(false), padding(0)
 {
 	image.load(texFilename, resourceGroup);
 	width = (int)image.getWidth();
@@ -114,7 +124,7 @@ ComputationRect::ComputationRect(const Ogre::String& texFilename, const Ogre::St
 }
 
 ComputationRect::ComputationRect(const Ogre::String& texName, unsigned char* buffer, int width, int height)
-	: x(0), y(0), weight(1), isPlaced(false), isFontGlyph(false), filename(texName)
+	: x(0), y(0), isPlaced(false), isFontGlyph(false), filename(texName), isDistanceField(false), padding(0)
 {
 	image.loadDynamicImage(buffer, width, height, 1, Ogre::PF_BYTE_BGRA, true);
 	this->width = (int)image.getWidth();
@@ -122,8 +132,10 @@ ComputationRect::ComputationRect(const Ogre::String& texName, unsigned char* buf
 	area = this->width * this->height;
 }
 
-ComputationRect::ComputationRect(const Ogre::String& fontFilename, Ogre::uint fontSize, CharCode charCode, unsigned char* buffer, int width, int height)
-	: x(0), y(0), weight(1), isPlaced(false), isFontGlyph(true), filename(fontFilename), fontSize(fontSize), charCode(charCode)
+ComputationRect::ComputationRect(const Ogre::String& fontFilename, Ogre::uint fontSize, CharCode charCode, unsigned char* buffer, int width, int height,
+								 bool isDistanceField, int padding)
+	: x(0), y(0), isPlaced(false), isFontGlyph(true), filename(fontFilename), fontSize(fontSize), charCode(charCode),
+	isDistanceField(isDistanceField), padding(padding)
 {
 	image.loadDynamicImage(buffer, width, height, 1, Ogre::PF_BYTE_LA, true);
 	this->width = (int)image.getWidth();
@@ -144,6 +156,16 @@ void FontFaceDefinition::addSize(Ogre::uint fontSize)
 	sizes.push_back(fontSize);
 }
 
+GlyphRasterizer::RenderMode FontFaceDefinition::getRenderMode(short renderType)
+{
+	if(renderType == BetterShape)
+		return GlyphRasterizer::LightHinting;
+	else if(renderType == DistanceField)
+		return GlyphRasterizer::DistanceField;
+
+	return GlyphRasterizer::DefaultHinting;
+}
+
 /************************
 * FontFace
 ************************/
@@ -154,86 +176,73 @@ FontFace::FontFace()
 
 FontFace::FontFace(const FontFaceDefinition& definition, const Ogre::String& resourceGroup, ComputationVector& renderContext)
 {
-	FT_Library library;
-	FT_Face face;
-	FT_Error error;
-
-	error = FT_Init_FreeType(&library);
-	if(error)
-		OGRE_EXCEPT(Ogre::Exception::ERR_INTERNAL_ERROR, "Could not load FreeType library.", "FontFace::FontFace");
+	Ogre::Timer timer;
 
 	Ogre::DataStreamPtr dataStream = Ogre::ResourceGroupManager::getSingleton().openResource(definition.filename, resourceGroup);
 	Ogre::MemoryDataStream stream(dataStream);
-	
-	error = FT_New_Memory_Face(library, stream.getPtr(), (FT_Long)stream.size(), 0, &face);
-	if(error)
-		OGRE_EXCEPT(Ogre::Exception::ERR_INTERNAL_ERROR, "FreeType could not load a font-face.", "FontFace::FontFace");
-
-
-	for(std::vector<Ogre::uint>::const_iterator i = definition.sizes.begin(); i != definition.sizes.end(); i++)
-	{
-		FT_ULong charCode = 0;
-		FT_UInt glyphIndex = 1;
 
-		error = FT_Set_Pixel_Sizes(face, 0, (FT_UInt)*i);
-		if(error)
-			OGRE_EXCEPT(Ogre::Exception::ERR_INTERNAL_ERROR, "FreeType could not set a font-size.", "FontFace::FontFace");
+	GlyphRasterizer rasterizer(stream.getPtr(), stream.size(), FontFaceDefinition::getRenderMode(definition.renderType));
+	if(!rasterizer.getError().empty())
+		OGRE_EXCEPT(Ogre::Exception::ERR_INTERNAL_ERROR, rasterizer.getError(), "FontFace::FontFace");
 
-		fontMetrics[*i] = FontMetrics(face->size->metrics.ascender / 64.0f, face->size->metrics.descender / 64.0f, 
-			face->size->metrics.height / 64.0f, face->size->metrics.max_advance / 64.0f);
+	std::vector<GlyphRasterizer::CharMapEntry> glyphs;
 
-		for(charCode = FT_Get_First_Char(face, &glyphIndex); glyphIndex != 0; charCode = FT_Get_Next_Char(face, charCode, &glyphIndex))
-		{
-			if(!definition.codeRange.isWithinRange(charCode))
-				continue;
+	for(std::vector<GlyphRasterizer::CharMapEntry>::const_iterator i = rasterizer.getCharMap().begin(); i != rasterizer.getCharMap().end(); i++)
+		if(definition.codeRange.isWithinRange(i->first))
+			glyphs.push_back(*i);
 
-			if(definition.renderType == FontFaceDefinition::BetterContrast)
-			{
-				error = FT_Load_Glyph(face, glyphIndex, FT_LOAD_DEFAULT);
-				if(error)
-					continue;
+	// Glyphs are rendered on several threads, the results come back in the order of definition.sizes and the charmap
+	if(!rasterizer.rasterize(definition.sizes, glyphs))
+		OGRE_EXCEPT(Ogre::Exception::ERR_INTERNAL_ERROR, rasterizer.getError(), "FontFace::FontFace");
 
-				error = FT_Render_Glyph(face->glyph, FT_RENDER_MODE_NORMAL);
-				if(error)
-					continue;
-			}
-			else
-			{
-				error = FT_Load_Glyph(face, glyphIndex, FT_LOAD_TARGET_LIGHT);
-				if(error)
-					continue;
+	int glyphCount = 0;
 
-				error = FT_Render_Glyph(face->glyph, FT_RENDER_MODE_LIGHT);
-				if(error)
-					continue;
-			}
+	// Distance fields are sampled bilinearly, a transparent border keeps the neighbours in the atlas from bleeding in
+	bool isDistanceField = definition.renderType == FontFaceDefinition::DistanceField;
+	int padding = isDistanceField ? 1 : 0;
 
-			FT_Bitmap& bitmap = face->glyph->bitmap;
-			FT_Glyph_Metrics& metrics = face->glyph->metrics;
+	for(std::vector<RasterizedSize>::const_iterator i = rasterizer.getSizes().begin(); i != rasterizer.getSizes().end(); i++)
+	{
+		fontMetrics[i->fontSize] = FontMetrics(i->ascender, i->descender, i->height, i->maxAdvance);
 
-			if(!bitmap.buffer || (!bitmap.rows && !bitmap.width))
+		for(std::vector<RasterizedGlyph>::const_iterator glyph = i->glyphs.begin(); glyph != i->glyphs.end(); glyph++)
+		{
+			if(!glyph->bitmap)
 				continue;
 
-			unsigned char* buffer = OGRE_ALLOC_T(unsigned char, bitmap.rows * bitmap.pitch * 2, Ogre::MEMCATEGORY_GENERAL);
+			int width = glyph->pitch + padding * 2;
+			int height = glyph->rows + padding * 2;
+			unsigned char* buffer = OGRE_ALLOC_T(unsigned char, width * height * 2, Ogre::MEMCATEGORY_GENERAL);
 
-			for(int idx = 0; idx < bitmap.rows * bitmap.pitch; idx++)
+			for(int idx = 0; idx < width * height; idx++)
 			{
 				buffer[idx * 2] = 255;
-				buffer[idx * 2 + 1] = bitmap.buffer[idx];
+				buffer[idx * 2 + 1] = 0;
 			}
 
-			fontSizes[*i][charCode] = GlyphInfo(metrics.horiBearingX / 64.0f, metrics.horiBearingY / 64.0f, metrics.horiAdvance / 64.0f);
+			for(int row = 0; row < glyph->rows; row++)
+				for(int col = 0; col < glyph->pitch; col++)
+					buffer[((row + padding) * width + col + padding) * 2 + 1] = glyph->bitmap[row * glyph->pitch + col];
 
-			renderContext.push_back(new ComputationRect(definition.filename, (Ogre::uint)*i, charCode, buffer, bitmap.pitch, bitmap.rows));
+			fontSizes[i->fontSize][glyph->charCode] = GlyphInfo(glyph->bearingX, glyph->bearingY, glyph->advance);
+
+			renderContext.push_back(new ComputationRect(definition.filename, i->fontSize, glyph->charCode, buffer, width, height, isDistanceField, padding));
+			glyphCount++;
 		}
 	}
+
+	Ogre::LogManager::getSingleton().logMessage("FontFace: Rendered " + Ogre::StringConverter::toString(glyphCount) + " glyphs of " + 
+		definition.filename + " at " + Ogre::StringConverter::toString(definition.sizes.size()) + " sizes in " + 
+		Ogre::StringConverter::toString(timer.getMilliseconds() / 1000.0f) + " secs using " + 
+		Ogre::StringConverter::toString(rasterizer.getThreadCount()) + " threads.");
 }
 
 /************************
 * Atlas
 ************************/
 
-Atlas::Atlas(const std::vector<Ogre::String>& textureFilenames, const std::vector<FontFaceDefinition>& fonts, const Ogre::String& resourceGroup)
+Atlas::Atlas(const std::vector<Ogre::String>& textureFilenames, const std::vector<FontFaceDefinition>& fonts, const Ogre::String& resourceGroup,
+			 const Ogre::String& cacheFilename) : glyphCache(0)
 {
 #if OGRE_DEBUG_MODE
 		Ogre::LogManager::getSingleton().logMessage("Loading an Atlas.");
@@ -241,6 +250,25 @@ Atlas::Atlas(const std::vector<Ogre::String>& textureFilenames, const std::vecto
 
 	Ogre::Timer timer;
 
+	const Ogre::RenderSystemCapabilities* capabilities = Ogre::Root::getSingleton().getRenderSystem()->getCapabilities();
+	//supportsNPOT = capabilities->hasCapability(Ogre::RSC_NON_POWER_OF_2_TEXTURES) && !capabilities->getNonPOW2TexturesLimited();
+	supportsNPOT = false;
+
+	Ogre::uint64 cacheKey = 0;
+
+	if(!cacheFilename.empty())
+	{
+		cacheKey = computeCacheKey(textureFilenames, fonts, resourceGroup);
+
+		if(loadCache(cacheFilename, cacheKey))
+		{
+			Ogre::LogManager::getSingleton().logMessage("Atlas loaded from '" + cacheFilename + "' in " + 
+				Ogre::StringConverter::toString(timer.getMilliseconds() / 1000.0f) + " secs, " + 
+				Ogre::StringConverter::toString(dimensions.first) + "x" + Ogre::StringConverter::toString(dimensions.second) + ".");
+			return;
+		}
+	}
+
 	ComputationVector rectangles;
 
 	for(std::vector<FontFaceDefinition>::const_iterator i = fonts.begin(); i != fonts.end(); i++)
@@ -255,13 +283,11 @@ Atlas::Atlas(const std::vector<Ogre::String>& textureFilenames, const std::vecto
 	
 	rectangles.push_back(new ComputationRect("VertexColor", vcolBuffer, 2, 2));
 
-	const Ogre::RenderSystemCapabilities* capabilities = Ogre::Root::getSingleton().getRenderSystem()->getCapabilities();
-	//supportsNPOT = capabilities->hasCapability(Ogre::RSC_NON_POWER_OF_2_TEXTURES) && !capabilities->getNonPOW2TexturesLimited();
-	supportsNPOT = false;
+	std::vector<Ogre::uint8> pixels;
 
 	guessDimensions(rectangles);
 	pack(rectangles);
-	paint(rectangles);
+	paint(rectangles, pixels);
 
 	int glyphCount = 0;
 	int texCount = -1; // Subtract the default VertexColor texture
@@ -273,7 +299,10 @@ Atlas::Atlas(const std::vector<Ogre::String>& textureFilenames, const std::vecto
 
 		if(rect->isFontGlyph)
 		{
-			fontFaces[rect->filename].fontSizes[rect->fontSize][rect->charCode].texInfo = TextureInfo(dimensions.first, dimensions.second, rect->x, rect->y, rect->width, rect->height);
+			TextureInfo& texInfo = fontFaces[rect->filename].fontSizes[rect->fontSize][rect->charCode].texInfo;
+			texInfo = TextureInfo(dimensions.first, dimensions.second, rect->x + rect->padding, rect->y + rect->padding, 
+				rect->width - rect->padding * 2, rect->height - rect->padding * 2);
+			texInfo.page = rect->isDistanceField ? 1 : 0;
 			glyphCount++;
 		}
 		else
@@ -288,7 +317,24 @@ Atlas::Atlas(const std::vector<Ogre::String>& textureFilenames, const std::vecto
 	Ogre::LogManager::getSingleton().logMessage("Atlas loaded in " + Ogre::StringConverter::toString(timer.getMilliseconds() / 1000.0f) + 
 		" secs. Packed " + Ogre::StringConverter::toString(glyphCount) + " font glyphs and " + Ogre::StringConverter::toString(texCount) +
 		" textures into " + Ogre::StringConverter::toString(dimensions.first) + "x" + Ogre::StringConverter::toString(dimensions.second) +
-		", with an efficiency of " + Ogre::StringConverter::toString(actualArea / (float)(dimensions.first * dimensions.second) * 100) + "%.");
+		", with an efficiency of " + Ogre::StringConverter::toString(getOccupancy() * 100) + "%.");
+
+	if(!cacheFilename.empty())
+		saveCache(cacheFilename, cacheKey, pixels);
+}
+
+Atlas::~Atlas()
+{
+	delete glyphCache;
+}
+
+void Atlas::addDynamicFont(const Ogre::String& fontFilename, const Ogre::String& resourceGroup, short renderType)
+{
+	// The dynamic pages come after the atlas itself, which is pages 0 and 1
+	if(!glyphCache)
+		glyphCache = new GlyphCache(GLYPH_PAGE_SIZE, MAX_GLYPH_PAGES, 2);
+
+	glyphCache->addFont(fontFilename, resourceGroup, renderType);
 }
 
 const std::pair<int, int>& Atlas::getDimensions() const
@@ -296,9 +342,27 @@ const std::pair<int, int>& Atlas::getDimensions() const
 	return dimensions;
 }
 
-const Ogre::String& Atlas::getMaterialName() const
+Ogre::Real Atlas::getOccupancy() const
+{
+	return actualArea / (Ogre::Real)(dimensions.first * dimensions.second);
+}
+
+size_t Atlas::getPageCount() const
+{
+	return (1 + (glyphCache ? glyphCache->getPageCount() : 0)) * 2;
+}
+
+const Ogre::String& Atlas::getMaterialName(size_t page) const
+{
+	if(page > 1 && glyphCache)
+		return glyphCache->getMaterialName((page - 2) / 2, (page & 1) != 0);
+
+	return (page & 1) ? distanceFieldMaterialName : materialName;
+}
+
+const Ogre::String& Atlas::getTiledMaterialName() const
 {
-	return materialName;
+	return tiledMaterialName;
 }
 
 const TextureInfo& Atlas::getTextureInfo(const Ogre::String& filename) const
@@ -312,20 +376,22 @@ const TextureInfo& Atlas::getTextureInfo(const Ogre::String& filename) const
 	return empty;
 }
 
-const FontMetrics& Atlas::getFontMetrics(const Ogre::String& fontFilename, Ogre::uint fontSize) const
+const FontMetrics& Atlas::getFontMetrics(const Ogre::String& fontFilename, Ogre::uint fontSize)
 {
 	std::map<Ogre::String, FontFace>::const_iterator font = fontFaces.find(fontFilename);
 	static FontMetrics empty;
 
-	if(font == fontFaces.end())
-		return empty;
+	if(font != fontFaces.end())
+	{
+		FontMetricsMap::const_iterator iter = font->second.fontMetrics.find(fontSize);
 
-	FontMetricsMap::const_iterator iter = font->second.fontMetrics.find(fontSize);
+		if(iter != font->second.fontMetrics.end())
+			return iter->second;
+	}
 
-	if(iter == font->second.fontMetrics.end())
-		return empty;
+	const FontMetrics* metrics = glyphCache ? glyphCache->getFontMetrics(fontFilename, fontSize) : 0;
 
-	return iter->second;
+	return metrics ? *metrics : empty;
 }
 
 const GlyphMap& Atlas::getGlyphMap(const Ogre::String& fontFilename, Ogre::uint fontSize) const
@@ -344,25 +410,28 @@ const GlyphMap& Atlas::getGlyphMap(const Ogre::String& fontFilename, Ogre::uint
 	return size->second;
 }
 
-const GlyphInfo& Atlas::getGlyphInfo(const Ogre::String& fontFilename, Ogre::uint fontSize, CharCode charCode) const
+const GlyphInfo& Atlas::getGlyphInfo(const Ogre::String& fontFilename, Ogre::uint fontSize, CharCode charCode)
 {
 	std::map<Ogre::String, FontFace>::const_iterator font = fontFaces.find(fontFilename);
 	static GlyphInfo empty;
 
-	if(font == fontFaces.end())
-		return empty;
-
-	FontSizeMap::const_iterator size = font->second.fontSizes.find(fontSize);
+	if(font != fontFaces.end())
+	{
+		FontSizeMap::const_iterator size = font->second.fontSizes.find(fontSize);
 
-	if(size == font->second.fontSizes.end())
-		return empty;
+		if(size != font->second.fontSizes.end())
+		{
+			GlyphMap::const_iterator glyph = size->second.find(charCode);
 
-	GlyphMap::const_iterator glyph = size->second.find(charCode);
+			if(glyph != size->second.end())
+				return glyph->second;
+		}
+	}
 
-	if(glyph == size->second.end())
-		return empty;
+	// Fall back to rasterizing the glyph, if the font is dynamic
+	const GlyphInfo* glyph = glyphCache ? glyphCache->getGlyphInfo(fontFilename, fontSize, charCode) : 0;
 
-	return glyph->second;
+	return glyph ? *glyph : empty;
 }
 
 void Atlas::guessDimensions(ComputationVector& rectangles)
@@ -370,26 +439,12 @@ void Atlas::guessDimensions(ComputationVector& rectangles)
 	actualArea = 0;
 	int maxWidth = 0;
 	int maxHeight = 0;
-	Ogre::Real totalOblong = 0;
 
 	for(ComputationVector::const_iterator i = rectangles.begin(); i != rectangles.end(); i++)
 	{
 		actualArea += (*i)->area;
 		maxWidth = std::max(maxWidth, (*i)->width);
 		maxHeight = std::max(maxHeight, (*i)->height);
-		totalOblong += (*i)->area * (std::max((*i)->width, (*i)->height) + 1) / ((float)std::min((*i)->width, (*i)->height) + 1);
-	}
-
-	Ogre::Real oblongFactor = totalOblong / actualArea / 2;
-	Ogre::Real oblongitude, percentArea;
-
-	for(ComputationVector::iterator i = rectangles.begin(); i != rectangles.end(); i++)
-	{
-		oblongitude = (std::max((*i)->width, (*i)->height) + 1) / ((float)std::min((*i)->width, (*i)->height) + 1);
-
-		percentArea = (*i)->area / (Ogre::Real)actualArea;
-
-		(*i)->weight = percentArea * pow(oblongitude, percentArea + oblongFactor);
 	}
 
 	int squareRoot = (int)Ogre::Math::Ceil(sqrt((double)actualArea * 1.02));
@@ -434,123 +489,190 @@ void Atlas::guessDimensions(ComputationVector& rectangles)
 #endif
 }
 
-bool WeightCompare(ComputationRect* a, ComputationRect* b)
-{
-	return a->weight > b->weight;
-}
-
 void Atlas::pack(ComputationVector& rectangles)
 {
-	std::sort(rectangles.begin(), rectangles.end(), WeightCompare);
-	int attemptCount = 0;
+	std::vector<PackRect> packRects;
+	packRects.reserve(rectangles.size());
 
-	while(true)
-	{
-		int successCount = 0;
-		fill(rectangles, 0, 0, dimensions.first - 1, dimensions.second - 1, successCount);
+	for(ComputationVector::iterator i = rectangles.begin(); i != rectangles.end(); i++)
+		packRects.push_back(PackRect((*i)->width, (*i)->height, *i));
 
-		if(successCount == (int)rectangles.size())
-			break;
+	// The width from guessDimensions always fits the widest rectangle, the height is whatever the packer needs
+	dimensions = AtlasPacker::packAtlas(packRects, dimensions.first, !supportsNPOT);
+
+	for(std::vector<PackRect>::iterator i = packRects.begin(); i != packRects.end(); i++)
+	{
+		ComputationRect* rect = static_cast<ComputationRect*>(i->userData);
+		rect->x = i->x;
+		rect->y = i->y;
+		rect->isPlaced = i->isPlaced;
+	}
 
 #if OGRE_DEBUG_MODE
-		Ogre::LogManager::getSingleton().logMessage("Atlas: Failed to pack " + Ogre::StringConverter::toString(rectangles.size() - successCount) + " rectangle(s), trying again");
+	Ogre::LogManager::getSingleton().logMessage("Atlas: Packed into " + Ogre::StringConverter::toString(dimensions.first) + "x" +
+		Ogre::StringConverter::toString(dimensions.second));
 #endif
+}
 
-		attemptCount++;
+void Atlas::paint(const ComputationVector& rectangles, std::vector<Ogre::uint8>& pixels)
+{
+	// The atlas is composed in system memory first so that it can be written to the cache as well
+	const size_t dstBpp = 4;
+	size_t dstPitch = dimensions.first * dstBpp;
 
-		if(!supportsNPOT)
+	pixels.assign(dstPitch * dimensions.second, 0);
+
+	for(ComputationVector::const_iterator i = rectangles.begin(); i != rectangles.end(); i++)
+	{
+		unsigned char* conversionBuf = 0;
+		Ogre::PixelBox srcPixels = (*i)->image.getPixelBox();
+		
+		if((*i)->image.getFormat() != Ogre::PF_BYTE_BGRA)
 		{
-			if(dimensions.first < dimensions.second)
-				dimensions.first = Ogre::Bitwise::firstPO2From(dimensions.first + 1);
-			else
-				dimensions.second = Ogre::Bitwise::firstPO2From(dimensions.second + 1);
+			conversionBuf = new unsigned char[(*i)->image.getWidth() * (*i)->image.getHeight() * dstBpp];
+			Ogre::PixelBox convPixels(Ogre::Box(0, 0, (*i)->width, (*i)->height), Ogre::PF_BYTE_BGRA, conversionBuf);
+			Ogre::PixelUtil::bulkPixelConversion((*i)->image.getPixelBox(), convPixels);
+			srcPixels = convPixels;
+		}
 
-			for(ComputationVector::iterator i = rectangles.begin(); i != rectangles.end(); i++)
-				(*i)->isPlaced = false;
+		size_t srcPitch = srcPixels.rowPitch * dstBpp;
+		Ogre::uint8* srcData = static_cast<Ogre::uint8*>(srcPixels.data);
 
-#if OGRE_DEBUG_MODE
-			Ogre::LogManager::getSingleton().logMessage("Atlas: Dimensions resized to " + Ogre::StringConverter::toString(dimensions.first) + "x" +
-				Ogre::StringConverter::toString(dimensions.second));
-#endif
+		for(size_t row = 0; row < (*i)->image.getHeight(); row++)
+			memcpy(&pixels[((row + (*i)->y) * dstPitch) + ((*i)->x * dstBpp)], srcData + row * srcPitch, srcPitch);
 
-			continue;
-		}
+		if(conversionBuf)
+			delete[] conversionBuf;
+	}
 
-		int maxFailedWidth = 0;
-		int maxFailedHeight = 0;
-		int totalFailedArea = 0;
+	createTexture(&pixels[0]);
+}
 
-		for(ComputationVector::iterator i = rectangles.begin(); i != rectangles.end(); i++)
+namespace
+{
+	// Thresholds the distance field at its edge (0.5), anti-aliased over about a pixel on screen whatever the scale
+	const char* distanceFieldHLSL =
+		"float4 main(float2 uv : TEXCOORD0, float4 colour : COLOR0, uniform sampler2D atlas : register(s0)) : COLOR\n"
+		"{\n"
+		"	float distance = tex2D(atlas, uv).a;\n"
+		"	float width = fwidth(distance) * 0.7;\n"
+		"	return float4(colour.rgb, colour.a * smoothstep(0.5 - width, 0.5 + width, distance));\n"
+		"}\n";
+
+	const char* distanceFieldGLSL =
+		"uniform sampler2D atlas;\n"
+		"void main()\n"
+		"{\n"
+		"	float distance = texture2D(atlas, gl_TexCoord[0].xy).a;\n"
+		"	float width = fwidth(distance) * 0.7;\n"
+		"	gl_FragColor = vec4(gl_Color.rgb, gl_Color.a * smoothstep(0.5 - width, 0.5 + width, distance));\n"
+		"}\n";
+
+	// Repeats a texture of the atlas: the texture coordinates count tiles, rect is the texture's (left, top, width, height)
+	const char* tiledHLSL =
+		"float4 main(float2 uv : TEXCOORD0, float4 colour : COLOR0, uniform float4 rect, uniform sampler2D atlas : register(s0)) : COLOR\n"
+		"{\n"
+		"	return tex2D(atlas, rect.xy + frac(uv) * rect.zw) * colour;\n"
+		"}\n";
+
+	const char* tiledGLSL =
+		"uniform vec4 rect;\n"
+		"uniform sampler2D atlas;\n"
+		"void main()\n"
+		"{\n"
+		"	gl_FragColor = texture2D(atlas, rect.xy + fract(gl_TexCoord[0].xy) * rect.zw) * gl_Color;\n"
+		"}\n";
+
+	// Creates a fragment program from whichever source the render system supports, returns a null pointer if it supports neither
+	Ogre::HighLevelGpuProgramPtr createFragmentProgram(const Ogre::String& programName, const char* hlslSource, const Ogre::String& hlslTarget, const char* glslSource)
+	{
+		Ogre::HighLevelGpuProgramManager& programManager = Ogre::HighLevelGpuProgramManager::getSingleton();
+		Ogre::HighLevelGpuProgramPtr program;
+
+		if(programManager.isLanguageSupported("hlsl") && Ogre::GpuProgramManager::getSingleton().isSyntaxSupported(hlslTarget))
 		{
-			if(!(*i)->isPlaced)
-			{
-				maxFailedWidth = std::max(maxFailedWidth, (*i)->width);
-				maxFailedHeight = std::max(maxFailedHeight, (*i)->height);
-				totalFailedArea += (*i)->area;
-			}
-			else
-			{
-				(*i)->isPlaced = false;
-			}
+			program = programManager.createProgram(programName, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME, 
+				"hlsl", Ogre::GPT_FRAGMENT_PROGRAM);
+			program->setSource(hlslSource);
+			program->setParameter("entry_point", "main");
+			program->setParameter("target", hlslTarget);
+		}
+		else if(programManager.isLanguageSupported("glsl"))
+		{
+			program = programManager.createProgram(programName, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME, 
+				"glsl", Ogre::GPT_FRAGMENT_PROGRAM);
+			program->setSource(glslSource);
 		}
-
-		Ogre::Real growthFactor = pow(1.02f, attemptCount) + totalFailedArea / (Ogre::Real)actualArea;
-
-		if(maxFailedWidth > maxFailedHeight)
-			dimensions.first = (dimensions.first + 1) * growthFactor;
 		else
-			dimensions.second = (dimensions.second + 1) * growthFactor;
+		{
+			return program;
+		}
 
-#if OGRE_DEBUG_MODE
-			Ogre::LogManager::getSingleton().logMessage("Atlas: Dimensions resized to " + Ogre::StringConverter::toString(dimensions.first) + "x" +
-				Ogre::StringConverter::toString(dimensions.second));
-#endif
-	}
-}
+		program->load();
 
-void Atlas::fill(ComputationVector& rectangles, int x1, int y1, int x2, int y2, int& count)
-{                  
-	static ComputationVector::iterator iter;
+		if(program->hasCompileError() || !program->isSupported())
+		{
+			programManager.remove(programName);
+			program.setNull();
+		}
 
-	for(iter = rectangles.begin(); iter != rectangles.end(); iter++)
-	{
-		if((!(*iter)->isPlaced) && (x2 - x1 + 1 >= (*iter)->width) && (y2 - y1 + 1 >= (*iter)->height))
-			break;
+		return program;
 	}
 
-	if(iter == rectangles.end())
-		return;
+	// Returns the name of the distance-field fragment program, or an empty string if the render system can't run it
+	const Ogre::String& getDistanceFieldProgram()
+	{
+		static Ogre::String programName;
+		static bool isInitialized = false;
 
-	ComputationRect* rect = *iter;
+		if(isInitialized)
+			return programName;
 
-	rect->x = x1;
-	rect->y = y1;
-	rect->isPlaced = true;
-	count++;
+		isInitialized = true;
 
-	if((x2 - x1 + 1 - rect->width) * rect->height < (y2 - y1 + 1 - rect->height) * rect->width)
-	{
-		if(y1 + rect->height < y2)
-			fill(rectangles, x1, y1 + rect->height, x2, y2, count);
+		// fwidth needs ps_2_a at least
+		if(!createFragmentProgram("AtlasDistanceFieldFP", distanceFieldHLSL, "ps_2_a", distanceFieldGLSL).isNull())
+			programName = "AtlasDistanceFieldFP";
+		else
+			Ogre::LogManager::getSingleton().logMessage("Atlas: The distance-field program is not supported, falling back to alpha testing.");
 
-		if((x1 + rect->width < x2) && (y1 < y1 + rect->height - 1))
-			fill(rectangles, x1 + rect->width, y1, x2, y1 + rect->height - 1, count);
+		return programName;
 	}
-	else
+
+	// Returns the name of the tiling fragment program, or an empty string if the render system can't run it
+	const Ogre::String& getTiledProgram()
 	{
-		if(x1 + rect->width < x2)
-			fill(rectangles, x1 + rect->width, y1, x2, y2, count);
+		static Ogre::String programName;
+		static bool isInitialized = false;
+
+		if(isInitialized)
+			return programName;
+
+		isInitialized = true;
+
+		Ogre::HighLevelGpuProgramPtr program = createFragmentProgram("AtlasTiledFP", tiledHLSL, "ps_2_0", tiledGLSL);
+
+		if(!program.isNull())
+		{
+			// Every tiled batch passes the rectangle of its texture as custom parameter 0
+			program->getDefaultParameters()->setNamedAutoConstant("rect", Ogre::GpuProgramParameters::ACT_CUSTOM, 0);
+			programName = "AtlasTiledFP";
+		}
+		else
+		{
+			Ogre::LogManager::getSingleton().logMessage("Atlas: The tiling program is not supported, tiled fills are drawn a quad per tile.");
+		}
 
-		if((y1 + rect->height < y2) && (x1 < x1 + rect->width - 1))
-			fill(rectangles, x1, y1 + rect->height, x1 + rect->width - 1, y2, count);
+		return programName;
 	}
 }
 
-void Atlas::paint(const ComputationVector& rectangles)
+void Atlas::createTexture(const Ogre::uint8* pixels)
 {
 	static unsigned int count = 0;
 	Ogre::String texName = "AtlasTexture_" + Ogre::StringConverter::toString(count);
 	materialName = "AtlasMaterial_" + Ogre::StringConverter::toString(count);
+	distanceFieldMaterialName = "AtlasDistanceFieldMaterial_" + Ogre::StringConverter::toString(count);
 
 	Ogre::TexturePtr texture = Ogre::TextureManager::getSingleton().createManual(
 		texName, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME,
@@ -562,39 +684,35 @@ void Atlas::paint(const ComputationVector& rectangles)
 	const Ogre::PixelBox& pixelBox = pixelBuffer->getCurrentLock();
 	size_t dstBpp = Ogre::PixelUtil::getNumElemBytes(pixelBox.format);
 	size_t dstPitch = pixelBox.rowPitch * dstBpp;
+	size_t srcPitch = dimensions.first * 4;
 
 	Ogre::uint8* dstData = static_cast<Ogre::uint8*>(pixelBox.data);
 
-	for(ComputationVector::const_iterator i = rectangles.begin(); i != rectangles.end(); i++)
-	{
-		unsigned char* conversionBuf = 0;
-		Ogre::PixelBox srcPixels = (*i)->image.getPixelBox();
-		
-		if((*i)->image.getFormat() != Ogre::PF_BYTE_BGRA)
-		{
-			conversionBuf = new unsigned char[(*i)->image.getWidth() * (*i)->image.getHeight() * dstBpp];
-			Ogre::PixelBox convPixels(Ogre::Box(0, 0, (*i)->width, (*i)->height), Ogre::PF_BYTE_BGRA, conversionBuf);
-			Ogre::PixelUtil::bulkPixelConversion((*i)->image.getPixelBox(), convPixels);
-			srcPixels = convPixels;
-		}
+	for(int row = 0; row < dimensions.second; row++)
+		memcpy(dstData + row * dstPitch, pixels + row * srcPitch, srcPitch);
 
-		size_t srcPitch = srcPixels.rowPitch * dstBpp;
-		Ogre::uint8* srcData = static_cast<Ogre::uint8*>(srcPixels.data);
+	pixelBuffer->unlock();
 
-		for(size_t row = 0; row < (*i)->image.getHeight(); row++)
-		{
-			for(size_t col = 0; col < srcPitch; col++)
-			{
-				dstData[((row + (*i)->y) * dstPitch) + ((*i)->x * dstBpp) + col] = srcData[(row * srcPitch) + col];
-			}
-		}
+	createMaterial(materialName, texName, false);
+	createMaterial(distanceFieldMaterialName, texName, true);
 
-		if(conversionBuf)
-			delete[] conversionBuf;
+	// Without the tiling program, Canvas draws tiled fills a quad per tile
+	tiledMaterialName.clear();
+
+	if(!getTiledProgram().empty())
+	{
+		tiledMaterialName = "AtlasTiledMaterial_" + Ogre::StringConverter::toString(count);
+		createMaterial(tiledMaterialName, texName, false);
+
+		Ogre::MaterialPtr material = Ogre::MaterialManager::getSingleton().getByName(tiledMaterialName);
+		material->getTechnique(0)->getPass(0)->setFragmentProgram(getTiledProgram());
 	}
 
-	pixelBuffer->unlock();
+	count++;
+}
 
+void Atlas::createMaterial(const Ogre::String& materialName, const Ogre::String& texName, bool isDistanceField)
+{
 	Ogre::MaterialPtr material = Ogre::MaterialManager::getSingleton().create(materialName, 
 		Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
 	Ogre::Pass* pass = material->getTechnique(0)->getPass(0);
@@ -604,10 +722,395 @@ void Atlas::paint(const ComputationVector& rectangles)
 	pass->setSceneBlending(Ogre::SBT_TRANSPARENT_ALPHA);
 
 	Ogre::TextureUnitState* texUnit = pass->createTextureUnitState(texName);
-	texUnit->setTextureFiltering(Ogre::FO_NONE, Ogre::FO_NONE, Ogre::FO_NONE);
 	texUnit->setTextureAddressingMode(Ogre::TextureUnitState::TAM_CLAMP);
 
-	count++;
+	if(!isDistanceField)
+	{
+		texUnit->setTextureFiltering(Ogre::FO_NONE, Ogre::FO_NONE, Ogre::FO_NONE);
+		return;
+	}
+
+	// Distance fields have to be interpolated to be thresholded smoothly
+	texUnit->setTextureFiltering(Ogre::FO_LINEAR, Ogre::FO_LINEAR, Ogre::FO_NONE);
+
+	const Ogre::String& programName = getDistanceFieldProgram();
+
+	if(!programName.empty())
+		pass->setFragmentProgram(programName);
+	else
+		pass->setAlphaRejectSettings(Ogre::CMPF_GREATER_EQUAL, 128);
+}
+
+/************************
+* Atlas cache
+************************/
+
+// Bump whenever the layout of the cache (or of the packed atlas) changes
+#define ATLAS_CACHE_VERSION 2
+
+namespace
+{
+	struct CacheHeader
+	{
+		char magic[4];
+		Ogre::uint32 version;
+		Ogre::uint64 key;
+		Ogre::int32 width, height, actualArea;
+		Ogre::uint32 pixelOffset;
+	};
+
+	struct CachedTexture
+	{
+		float left, top, right, bottom;
+		Ogre::int32 width, height;
+		Ogre::uint32 page;
+	};
+
+	struct CachedMetrics
+	{
+		Ogre::uint32 fontSize;
+		float ascender, descender, height, maxAdvance;
+	};
+
+	struct CachedGlyph
+	{
+		Ogre::uint32 fontSize, charCode;
+		float bearingX, bearingY, advance;
+		CachedTexture texInfo;
+	};
+
+	// 64-bit FNV-1a
+	Ogre::uint64 hashBytes(Ogre::uint64 hash, const void* data, size_t length)
+	{
+		const Ogre::uint8* bytes = static_cast<const Ogre::uint8*>(data);
+
+		for(size_t i = 0; i < length; i++)
+			hash = (hash ^ bytes[i]) * 1099511628211ULL;
+
+		return hash;
+	}
+
+	Ogre::uint64 hashString(Ogre::uint64 hash, const Ogre::String& text)
+	{
+		Ogre::uint32 length = (Ogre::uint32)text.length();
+		hash = hashBytes(hash, &length, sizeof(length));
+
+		return hashBytes(hash, text.data(), text.length());
+	}
+
+	Ogre::uint64 hashResource(Ogre::uint64 hash, const Ogre::String& filename, const Ogre::String& resourceGroup)
+	{
+		Ogre::DataStreamPtr stream = Ogre::ResourceGroupManager::getSingleton().openResource(filename, resourceGroup);
+		Ogre::uint8 buffer[16384];
+		size_t length;
+
+		while((length = stream->read(buffer, sizeof(buffer))) > 0)
+			hash = hashBytes(hash, buffer, length);
+
+		return hash;
+	}
+
+	CachedTexture toCachedTexture(const TextureInfo& info)
+	{
+		CachedTexture result = { info.texCoords.left, info.texCoords.top, info.texCoords.right, info.texCoords.bottom, info.width, info.height, 
+			(Ogre::uint32)info.page };
+		return result;
+	}
+
+	TextureInfo fromCachedTexture(const CachedTexture& cached)
+	{
+		TextureInfo result;
+		result.isEmpty = false;
+		result.texCoords = Ogre::FloatRect(cached.left, cached.top, cached.right, cached.bottom);
+		result.width = cached.width;
+		result.height = cached.height;
+		result.page = cached.page;
+		return result;
+	}
+
+	template<class T>
+	void writeValue(FILE* file, const T& value)
+	{
+		fwrite(&value, sizeof(T), 1, file);
+	}
+
+	void writeString(FILE* file, const Ogre::String& text)
+	{
+		writeValue(file, (Ogre::uint32)text.length());
+		fwrite(text.data(), 1, text.length(), file);
+	}
+
+	// Reads the records of a mapped cache, every read is bounds-checked so that a truncated file is simply rejected
+	class CacheReader
+	{
+		const Ogre::uint8* data;
+		size_t size, offset;
+
+	public:
+		CacheReader(const Ogre::uint8* data, size_t size) : data(data), size(size), offset(0) {}
+
+		bool read(void* value, size_t length)
+		{
+			if(length > size - offset)
+				return false;
+
+			memcpy(value, data + offset, length);
+			offset += length;
+			return true;
+		}
+
+		template<class T>
+		bool readValue(T& value)
+		{
+			return read(&value, sizeof(T));
+		}
+
+		bool readString(Ogre::String& text)
+		{
+			Ogre::uint32 length;
+
+			if(!readValue(length) || length > size - offset)
+				return false;
+
+			text.assign(reinterpret_cast<const char*>(data + offset), length);
+			offset += length;
+			return true;
+		}
+	};
+
+	// A read-only view of a whole file
+	class MappedFile
+	{
+		HANDLE file, mapping;
+		const Ogre::uint8* view;
+		size_t size;
+
+	public:
+		MappedFile(const Ogre::String& filename) : file(INVALID_HANDLE_VALUE), mapping(0), view(0), size(0)
+		{
+			file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, 0);
+
+			if(file == INVALID_HANDLE_VALUE)
+				return;
+
+			size = GetFileSize(file, 0);
+			mapping = size ? CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0) : 0;
+			view = mapping ? static_cast<const Ogre::uint8*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)) : 0;
+		}
+
+		~MappedFile()
+		{
+			if(view)
+				UnmapViewOfFile(view);
+
+			if(mapping)
+				CloseHandle(mapping);
+
+			if(file != INVALID_HANDLE_VALUE)
+				CloseHandle(file);
+		}
+
+		const Ogre::uint8* getData() const { return view; }
+		size_t getSize() const { return view ? size : 0; }
+	};
+}
+
+Ogre::uint64 Atlas::computeCacheKey(const std::vector<Ogre::String>& textureFilenames, const std::vector<FontFaceDefinition>& fonts, 
+									const Ogre::String& resourceGroup) const
+{
+	Ogre::uint64 key = 14695981039346656037ULL;
+	Ogre::uint32 version = ATLAS_CACHE_VERSION;
+
+	key = hashBytes(key, &version, sizeof(version));
+	key = hashBytes(key, &supportsNPOT, sizeof(supportsNPOT));
+
+	for(std::vector<FontFaceDefinition>::const_iterator i = fonts.begin(); i != fonts.end(); i++)
+	{
+		key = hashString(key, i->filename);
+		key = hashBytes(key, &i->renderType, sizeof(i->renderType));
+
+		for(std::vector<Ogre::uint>::const_iterator size = i->sizes.begin(); size != i->sizes.end(); size++)
+			key = hashBytes(key, &*size, sizeof(*size));
+
+		for(std::vector<std::pair<CharCode, CharCode> >::const_iterator range = i->codeRange.ranges.begin(); range != i->codeRange.ranges.end(); range++)
+		{
+			key = hashBytes(key, &range->first, sizeof(range->first));
+			key = hashBytes(key, &range->second, sizeof(range->second));
+		}
+
+		key = hashResource(key, i->filename, resourceGroup);
+	}
+
+	for(std::vector<Ogre::String>::const_iterator i = textureFilenames.begin(); i != textureFilenames.end(); i++)
+	{
+		key = hashString(key, *i);
+		key = hashResource(key, *i, resourceGroup);
+	}
+
+	return key;
+}
+
+bool Atlas::loadCache(const Ogre::String& cacheFilename, Ogre::uint64 cacheKey)
+{
+	MappedFile file(cacheFilename);
+	CacheReader reader(file.getData(), file.getSize());
+	CacheHeader header;
+
+	if(!reader.readValue(header) || memcmp(header.magic, "ATLC", 4) || header.version != ATLAS_CACHE_VERSION || header.key != cacheKey)
+		return false;
+
+	if(header.width <= 0 || header.height <= 0 || header.pixelOffset > file.getSize() ||
+		file.getSize() - header.pixelOffset < (size_t)header.width * header.height * 4)
+		return false;
+
+	std::map<Ogre::String, FontFace> cachedFaces;
+	std::map<Ogre::String, TextureInfo> cachedTextures;
+	Ogre::uint32 textureCount, fontCount;
+
+	if(!reader.readValue(textureCount))
+		return false;
+
+	for(Ogre::uint32 i = 0; i < textureCount; i++)
+	{
+		Ogre::String name;
+		CachedTexture texture;
+
+		if(!reader.readString(name) || !reader.readValue(texture))
+			return false;
+
+		cachedTextures[name] = fromCachedTexture(texture);
+	}
+
+	if(!reader.readValue(fontCount))
+		return false;
+
+	for(Ogre::uint32 i = 0; i < fontCount; i++)
+	{
+		Ogre::String name;
+		Ogre::uint32 metricsCount, glyphCount;
+
+		if(!reader.readString(name) || !reader.readValue(metricsCount))
+			return false;
+
+		FontFace& face = cachedFaces[name];
+
+		for(Ogre::uint32 j = 0; j < metricsCount; j++)
+		{
+			CachedMetrics metrics;
+
+			if(!reader.readValue(metrics))
+				return false;
+
+			face.fontMetrics[metrics.fontSize] = FontMetrics(metrics.ascender, metrics.descender, metrics.height, metrics.maxAdvance);
+		}
+
+		if(!reader.readValue(glyphCount))
+			return false;
+
+		for(Ogre::uint32 j = 0; j < glyphCount; j++)
+		{
+			CachedGlyph glyph;
+
+			if(!reader.readValue(glyph))
+				return false;
+
+			GlyphInfo& info = face.fontSizes[glyph.fontSize][glyph.charCode];
+			info = GlyphInfo(glyph.bearingX, glyph.bearingY, glyph.advance);
+			info.texInfo = fromCachedTexture(glyph.texInfo);
+		}
+	}
+
+	dimensions.first = header.width;
+	dimensions.second = header.height;
+	actualArea = header.actualArea;
+	fontFaces.swap(cachedFaces);
+	textures.swap(cachedTextures);
+
+	// The page goes straight from the mapped file to the texture
+	createTexture(file.getData() + header.pixelOffset);
+
+	return true;
+}
+
+void Atlas::saveCache(const Ogre::String& cacheFilename, Ogre::uint64 cacheKey, const std::vector<Ogre::uint8>& pixels) const
+{
+	FILE* file = fopen(cacheFilename.c_str(), "wb");
+
+	if(!file)
+	{
+		Ogre::LogManager::getSingleton().logMessage("Atlas: Could not write the cache '" + cacheFilename + "'.");
+		return;
+	}
+
+	// The header is written last so that an interrupted write leaves an invalid file
+	CacheHeader header;
+	memset(&header, 0, sizeof(header));
+	writeValue(file, header);
+
+	writeValue(file, (Ogre::uint32)textures.size());
+
+	for(std::map<Ogre::String, TextureInfo>::const_iterator i = textures.begin(); i != textures.end(); i++)
+	{
+		writeString(file, i->first);
+		writeValue(file, toCachedTexture(i->second));
+	}
+
+	writeValue(file, (Ogre::uint32)fontFaces.size());
+
+	for(std::map<Ogre::String, FontFace>::const_iterator i = fontFaces.begin(); i != fontFaces.end(); i++)
+	{
+		writeString(file, i->first);
+		writeValue(file, (Ogre::uint32)i->second.fontMetrics.size());
+
+		for(FontMetricsMap::const_iterator j = i->second.fontMetrics.begin(); j != i->second.fontMetrics.end(); j++)
+		{
+			CachedMetrics metrics = { j->first, j->second.ascender, j->second.descender, j->second.height, j->second.maxAdvance };
+			writeValue(file, metrics);
+		}
+
+		Ogre::uint32 glyphCount = 0;
+
+		for(FontSizeMap::const_iterator j = i->second.fontSizes.begin(); j != i->second.fontSizes.end(); j++)
+			glyphCount += (Ogre::uint32)j->second.size();
+
+		writeValue(file, glyphCount);
+
+		for(FontSizeMap::const_iterator j = i->second.fontSizes.begin(); j != i->second.fontSizes.end(); j++)
+		{
+			for(GlyphMap::const_iterator k = j->second.begin(); k != j->second.end(); k++)
+			{
+				CachedGlyph glyph = { j->first, k->first, k->second.bearingX, k->second.bearingY, k->second.advance, toCachedTexture(k->second.texInfo) };
+				writeValue(file, glyph);
+			}
+		}
+	}
+
+	// Keep the page aligned for the copy to the texture
+	long offset = ftell(file);
+	long alignedOffset = (offset + 15) & ~15L;
+	static const char padding[16] = { 0 };
+	fwrite(padding, 1, alignedOffset - offset, file);
+	fwrite(&pixels[0], 1, pixels.size(), file);
+
+	memcpy(header.magic, "ATLC", 4);
+	header.version = ATLAS_CACHE_VERSION;
+	header.key = cacheKey;
+	header.width = dimensions.first;
+	header.height = dimensions.second;
+	header.actualArea = actualArea;
+	header.pixelOffset = (Ogre::uint32)alignedOffset;
+
+	fseek(file, 0, SEEK_SET);
+	writeValue(file, header);
+
+	bool failed = ferror(file) != 0;
+	fclose(file);
+
+	if(failed)
+	{
+		remove(cacheFilename.c_str());
+		Ogre::LogManager::getSingleton().logMessage("Atlas: Could not write the cache '" + cacheFilename + "'.");
+	}
 }
 
 void Atlas::loadResource(Ogre::Resource* resource)
@@ -24,23 +24,29 @@
 
 #include <OGRE/Ogre.h>
 #include <OGRE/OgreBitwise.h>
+#include "AtlasPacker.h"
 #include <map>
 #include <vector>
 #include <algorithm>
 
-#include <ft2build.h>
-#include FT_FREETYPE_H
-#include FT_GLYPH_H
+#include "GlyphRasterizer.h"
+
+class GlyphCache;
 
 /**
 * TextureInfo represents a texture within an Atlas instance. 
 * Contains the actual dimensions of a texture and its location within the atlas.
+*
+* The page selects the material to draw it with (see Atlas::getMaterialName). Every texture of the atlas has two pages,
+* the second one for distance-field glyphs: textures and preloaded glyphs are on pages 0 and 1, glyphs rasterized on
+* demand are on the pages after those.
 */
 struct TextureInfo
 {
 	bool isEmpty;
 	Ogre::FloatRect texCoords;
 	int width, height;
+	size_t page;
 
 	TextureInfo();
 	TextureInfo(int atlasWidth, int atlasHeight, int x, int y, int width, int height);
@@ -133,12 +139,15 @@ struct FontFaceDefinition
 	* <ul>
 	* <li>BetterContrast - Sharper text, more like Windows' font rendering.
 	* <li>BetterShape - Smoother text, more like MacOSX's font rendering.
+	* <li>DistanceField - Glyphs are stored as signed distance fields and drawn with a shader that keeps their outline
+	*	crisp at any scale, so one font size can be drawn at many sizes (scale the GlyphInfo metrics and dimensions).
 	* </ul>
 	*/
 	enum RenderType
 	{
 		BetterContrast,
-		BetterShape
+		BetterShape,
+		DistanceField
 	};
 
 	/**
@@ -154,6 +163,11 @@ struct FontFaceDefinition
 	* Adds a font-size (in px) to this font-face definition.
 	*/
 	void addSize(Ogre::uint fontSize);
+
+	/**
+	* Retrieve the GlyphRasterizer mode that renders a FontFaceDefinition::RenderType.
+	*/
+	static GlyphRasterizer::RenderMode getRenderMode(short renderType);
 };
 
 struct ComputationRect
@@ -161,19 +175,21 @@ struct ComputationRect
 	int width, height;
 	int x, y;
 	int area;
-	Ogre::Real weight;
 	bool isPlaced;
 	
 	Ogre::String filename;
 	bool isFontGlyph;
 	Ogre::uint fontSize;
 	CharCode charCode;
+	bool isDistanceField;
+	int padding;
 
 	Ogre::Image image;
 
 	ComputationRect(const Ogre::String& texFilename, const Ogre::String& resourceGroup);
 	ComputationRect(const Ogre::String& texName, unsigned char* buffer, int width, int height);
-	ComputationRect(const Ogre::String& fontFilename, Ogre::uint fontSize, CharCode charCode, unsigned char* buffer, int width, int height);
+	ComputationRect(const Ogre::String& fontFilename, Ogre::uint fontSize, CharCode charCode, unsigned char* buffer, int width, int height,
+		bool isDistanceField = false, int padding = 0);
 };
 
 typedef std::vector<ComputationRect*> ComputationVector;
@@ -202,12 +218,20 @@ class Atlas : public Ogre::ManualResourceLoader
 	std::pair<int, int> dimensions;
 	int actualArea;
 	Ogre::String materialName;
+	Ogre::String distanceFieldMaterialName;
+	Ogre::String tiledMaterialName;
 	bool supportsNPOT;
+	GlyphCache* glyphCache;
 
 	void guessDimensions(ComputationVector& rectangles);
 	void pack(ComputationVector& rectangles);
-	void fill(ComputationVector& rectangles, int x1, int y1, int x2, int y2, int& count);
-	void paint(const ComputationVector& rectangles);
+	void paint(const ComputationVector& rectangles, std::vector<Ogre::uint8>& pixels);
+	void createTexture(const Ogre::uint8* pixels);
+
+	Ogre::uint64 computeCacheKey(const std::vector<Ogre::String>& textureFilenames, const std::vector<FontFaceDefinition>& fonts, 
+		const Ogre::String& resourceGroup) const;
+	bool loadCache(const Ogre::String& cacheFilename, Ogre::uint64 cacheKey);
+	void saveCache(const Ogre::String& cacheFilename, Ogre::uint64 cacheKey, const std::vector<Ogre::uint8>& pixels) const;
 
 public:
 	/**
@@ -216,8 +240,25 @@ public:
 	* @param	textureFilenames	The filenames of the textures to load into this atlas.
 	* @param	fonts	The fonts to load into this atlas.
 	* @param	resourceGroup	The name of the resource group where the textures and fonts can be found.
+	* @param	cacheFilename	Optional; a file to keep the packed atlas in. When it was written for the same textures and
+	*						fonts (the contents of the files are hashed), the atlas is memory-mapped from it instead of being
+	*						rendered and packed again. Otherwise the atlas is built and the file is (re)written.
+	*/
+	Atlas(const std::vector<Ogre::String>& textureFilenames, const std::vector<FontFaceDefinition>& fonts, const Ogre::String& resourceGroup,
+		const Ogre::String& cacheFilename = "");
+
+	~Atlas();
+
+	/**
+	* Lets a font-face rasterize glyphs on demand: glyphs (and sizes) that were not loaded up front are rendered the first
+	* time Atlas::getGlyphInfo asks for them and are kept on extra pages, where the least recently used are evicted when
+	* the pages are full.
+	*
+	* @param	fontFilename	The filename of the font-face, it may also be one of the fonts loaded up front.
+	* @param	resourceGroup	The name of the resource group where the font can be found.
+	* @param	renderType	Optional; the type of rendering to use for this font-face.
 	*/
-	Atlas(const std::vector<Ogre::String>& textureFilenames, const std::vector<FontFaceDefinition>& fonts, const Ogre::String& resourceGroup);
+	void addDynamicFont(const Ogre::String& fontFilename, const Ogre::String& resourceGroup, short renderType = FontFaceDefinition::BetterContrast);
 
 	/**
 	* Retrieve the dimensions of this atlas, in pixels.
@@ -225,9 +266,29 @@ public:
 	const std::pair<int, int>& getDimensions() const;
 
 	/**
-	* Retrieve the name of the internal material
+	* Retrieve the fraction of this atlas (0 to 1) that is covered by textures and glyphs.
 	*/
-	const Ogre::String& getMaterialName() const;
+	Ogre::Real getOccupancy() const;
+
+	/**
+	* Retrieve the number of pages, those of the atlas itself and those of dynamic glyphs.
+	*/
+	size_t getPageCount() const;
+
+	/**
+	* Retrieve the name of the internal material of a page.
+	*
+	* @param	page	Optional; the page, see TextureInfo::page.
+	*/
+	const Ogre::String& getMaterialName(size_t page = 0) const;
+
+	/**
+	* Retrieve the name of the material that repeats a texture of page 0 within a quad: its texture coordinates count
+	* tiles, and the renderable passes the texture's (left, top, width, height) as custom parameter 0.
+	*
+	* @return	An empty string if the render system can't run the fragment program that this needs.
+	*/
+	const Ogre::String& getTiledMaterialName() const;
 
 	/**
 	* Retrieve info about a certain texture within this atlas.
@@ -244,10 +305,10 @@ public:
 	* @param	fontFilename	The filename of the font to look up.
 	* @param	fontSize	The font size to look up.
 	*/
-	const FontMetrics& getFontMetrics(const Ogre::String& fontFilename, Ogre::uint fontSize) const;
+	const FontMetrics& getFontMetrics(const Ogre::String& fontFilename, Ogre::uint fontSize);
 
 	/**
-	* Retrieve the GlyphMap for a certain font size.
+	* Retrieve the GlyphMap for a certain font size. Only contains the glyphs that were loaded up front.
 	*
 	* @param	fontFilename	The filename of the font to look up.
 	* @param	fontSize	The font size to look up.
@@ -262,9 +323,20 @@ public:
 	* @param	charCode	The CharCode to look up.
 	*
 	* @note	If the filename, size, or CharCode is not found, the returned GlyphInfo will contain a TextureInfo with
-	*		the member "isEmpty" set to true.
+	*		the member "isEmpty" set to true. Glyphs of dynamic fonts (see Atlas::addDynamicFont) are rasterized instead;
+	*		they stay valid for the rest of the frame, and may be evicted once a frame passes without them being requested.
+	*/
+	const GlyphInfo& getGlyphInfo(const Ogre::String& fontFilename, Ogre::uint fontSize, CharCode charCode);
+
+	/**
+	* Creates the material of an atlas page.
+	*
+	* @param	materialName	The name of the material to create.
+	* @param	texName	The name of the page's texture.
+	* @param	isDistanceField	Whether the material draws the distance-field glyphs of the texture (with linear filtering
+	*					and a fragment program when available, otherwise with alpha testing) instead of its pixels.
 	*/
-	const GlyphInfo& getGlyphInfo(const Ogre::String& fontFilename, Ogre::uint fontSize, CharCode charCode) const;
+	static void createMaterial(const Ogre::String& materialName, const Ogre::String& texName, bool isDistanceField);
 
 	// Inherited from Ogre::ManualResourceLoader
 	void loadResource(Ogre::Resource* resource);
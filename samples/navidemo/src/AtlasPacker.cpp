@@ -0,0 +1,226 @@
+/*
+	This file is part of Canvas, a fast, lightweight 2D graphics engine for Ogre3D.
+
+	Copyright (C) 2008 Adam J. Simmons
+	ajs15822@gmail.com
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "AtlasPacker.h"
+#include <algorithm>
+
+namespace
+{
+	int firstPO2From(int n)
+	{
+		int result = 1;
+
+		while(result < n)
+			result <<= 1;
+
+		return result;
+	}
+
+	bool HeightCompare(PackRect* a, PackRect* b)
+	{
+		if(a->height != b->height)
+			return a->height > b->height;
+
+		return a->width > b->width;
+	}
+}
+
+/************************
+* PackRect
+************************/
+
+PackRect::PackRect(int width, int height, void* userData) : width(width), height(height), x(0), y(0), isPlaced(false), userData(userData)
+{
+}
+
+/************************
+* AtlasPacker
+************************/
+
+AtlasPacker::AtlasPacker(int binWidth)
+{
+	reset(binWidth);
+}
+
+void AtlasPacker::reset(int binWidth)
+{
+	this->binWidth = binWidth;
+	usedHeight = 0;
+	usedArea = 0;
+
+	skyline.clear();
+	skyline.push_back(Segment(0, 0, binWidth));
+}
+
+bool AtlasPacker::insert(PackRect& rect)
+{
+	int bestTop = -1;
+	int bestWidth = 0;
+	size_t bestIndex = 0;
+	int bestY = 0;
+
+	for(size_t i = 0; i < skyline.size(); i++)
+	{
+		int y = fitAt(i, rect.width);
+
+		if(y < 0)
+			continue;
+
+		// Lowest top edge wins, ties go to the narrowest segment to keep wide gaps for wide rectangles
+		if(bestTop < 0 || y + rect.height < bestTop || (y + rect.height == bestTop && skyline[i].width < bestWidth))
+		{
+			bestTop = y + rect.height;
+			bestWidth = skyline[i].width;
+			bestIndex = i;
+			bestY = y;
+		}
+	}
+
+	if(bestTop < 0)
+		return false;
+
+	rect.x = skyline[bestIndex].x;
+	rect.y = bestY;
+	rect.isPlaced = true;
+
+	addSegment(bestIndex, rect.x, bestY, rect.width, rect.height);
+
+	usedHeight = std::max(usedHeight, bestTop);
+	usedArea += rect.width * rect.height;
+
+	return true;
+}
+
+int AtlasPacker::pack(std::vector<PackRect*>& rects)
+{
+	std::stable_sort(rects.begin(), rects.end(), HeightCompare);
+
+	int count = 0;
+
+	for(std::vector<PackRect*>::iterator i = rects.begin(); i != rects.end(); i++)
+		if(insert(**i))
+			count++;
+
+	return count;
+}
+
+int AtlasPacker::getUsedHeight() const
+{
+	return usedHeight;
+}
+
+float AtlasPacker::getOccupancy(int height) const
+{
+	if(!height)
+		height = usedHeight;
+
+	if(!height || !binWidth)
+		return 0;
+
+	return usedArea / ((float)binWidth * height);
+}
+
+std::pair<int, int> AtlasPacker::packAtlas(std::vector<PackRect>& rects, int width, bool powerOfTwo)
+{
+	const std::vector<PackRect> original(rects);
+	std::vector<PackRect> candidate;
+	std::vector<PackRect*> order;
+	std::pair<int, int> best(0, 0);
+	AtlasPacker packer(width);
+
+	for(int attempt = 0; attempt < (powerOfTwo ? 2 : 1); attempt++, width *= 2)
+	{
+		candidate = original;
+		order.clear();
+
+		for(std::vector<PackRect>::iterator i = candidate.begin(); i != candidate.end(); i++)
+			order.push_back(&*i);
+
+		packer.reset(width);
+		packer.pack(order);
+
+		int height = powerOfTwo ? firstPO2From(packer.getUsedHeight()) : packer.getUsedHeight();
+		long long area = (long long)width * height;
+		long long bestArea = (long long)best.first * best.second;
+
+		if(!bestArea || area < bestArea || (area == bestArea && std::max(width, height) < std::max(best.first, best.second)))
+		{
+			best = std::make_pair(width, height);
+			rects.swap(candidate);
+		}
+	}
+
+	return best;
+}
+
+int AtlasPacker::fitAt(size_t index, int width) const
+{
+	if(skyline[index].x + width > binWidth)
+		return -1;
+
+	int y = skyline[index].y;
+	int widthLeft = width;
+
+	// The segments always span the whole width, so this can't run past the end
+	for(size_t i = index; widthLeft > 0; i++)
+	{
+		y = std::max(y, skyline[i].y);
+		widthLeft -= skyline[i].width;
+	}
+
+	return y;
+}
+
+void AtlasPacker::addSegment(size_t index, int x, int y, int width, int height)
+{
+	skyline.insert(skyline.begin() + index, Segment(x, y + height, width));
+
+	// Trim the segments that are now covered by the new one
+	for(size_t i = index + 1; i < skyline.size(); )
+	{
+		int coveredWidth = skyline[i - 1].x + skyline[i - 1].width - skyline[i].x;
+
+		if(coveredWidth <= 0)
+			break;
+
+		skyline[i].x += coveredWidth;
+		skyline[i].width -= coveredWidth;
+
+		if(skyline[i].width > 0)
+			break;
+
+		skyline.erase(skyline.begin() + i);
+	}
+
+	// Merge neighbours at the same height
+	for(size_t i = 0; i + 1 < skyline.size(); )
+	{
+		if(skyline[i].y == skyline[i + 1].y)
+		{
+			skyline[i].width += skyline[i + 1].width;
+			skyline.erase(skyline.begin() + i + 1);
+		}
+		else
+		{
+			i++;
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,121 @@
+/*
+	This file is part of Canvas, a fast, lightweight 2D graphics engine for Ogre3D.
+
+	Copyright (C) 2008 Adam J. Simmons
+	ajs15822@gmail.com
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef __AtlasPacker__
+#define __AtlasPacker__
+
+#include <stddef.h>
+#include <utility>
+#include <vector>
+
+/**
+* A rectangle to be placed by AtlasPacker::pack.
+*/
+struct PackRect
+{
+	int width, height;
+	int x, y;
+	bool isPlaced;
+
+	/// Identifies the rectangle to the caller, the packer ignores it
+	void* userData;
+
+	PackRect(int width = 0, int height = 0, void* userData = 0);
+};
+
+/**
+* Packs rectangles into an atlas of a fixed width using the skyline bottom-left heuristic.
+*
+* The skyline is the list of horizontal segments formed by the top edges of the rectangles placed so far,
+* each rectangle is put where it rests lowest on it. Rectangles are placed in a single, deterministic pass
+* (tallest first), the height of the atlas is whatever that pass needs.
+*/
+class AtlasPacker
+{
+	struct Segment
+	{
+		int x, y, width;
+
+		Segment(int x, int y, int width) : x(x), y(y), width(width) {}
+	};
+
+	std::vector<Segment> skyline;
+	int binWidth;
+	int usedHeight;
+	long long usedArea;
+
+	int fitAt(size_t index, int width) const;
+	void addSegment(size_t index, int x, int y, int width, int height);
+
+public:
+	/**
+	* Constructs an AtlasPacker.
+	*
+	* @param	binWidth	The width of the atlas, in pixels.
+	*/
+	AtlasPacker(int binWidth);
+
+	/**
+	* Clears all placed rectangles.
+	*/
+	void reset(int binWidth);
+
+	/**
+	* Places a single rectangle.
+	*
+	* @return	True if the rectangle was placed, false if it is wider than the atlas.
+	*/
+	bool insert(PackRect& rect);
+
+	/**
+	* Sorts and places a list of rectangles.
+	*
+	* @return	The number of rectangles that were placed (only those wider than the atlas are left out).
+	*/
+	int pack(std::vector<PackRect*>& rects);
+
+	/**
+	* Retrieve the height needed to hold every placed rectangle, in pixels.
+	*/
+	int getUsedHeight() const;
+
+	/**
+	* Retrieve the fraction of the atlas (binWidth x height) that is covered by rectangles.
+	*
+	* @param	height	The height of the atlas, pass 0 to use AtlasPacker::getUsedHeight.
+	*/
+	float getOccupancy(int height = 0) const;
+
+	/**
+	* Packs a list of rectangles into a complete atlas.
+	*
+	* @param	rects	The rectangles to place, their positions are filled in.
+	* @param	width	The width of the atlas, it must fit the widest rectangle.
+	* @param	powerOfTwo	Whether the height must be rounded up to a power of two. When it is, twice the width
+	*						is tried as well since a packed height just past a power of two would double the
+	*						atlas, the smaller (then squarer) of the two is kept.
+	*
+	* @return	The dimensions of the atlas.
+	*/
+	static std::pair<int, int> packAtlas(std::vector<PackRect>& rects, int width, bool powerOfTwo);
+};
+
+#endif
\ No newline at end of file
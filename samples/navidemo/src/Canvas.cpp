@@ -20,9 +20,22 @@
 */
 
 #include "Canvas.h"
+#include <OGRE/OgrePlatformInformation.h>
 
 using namespace Ogre;
 
+// Compaction doesn't bother with a handful of free quads
+#define MIN_COMPACTION_QUADS 256
+
+// Dirty ranges closer than this are written with a single lock, rewriting the quads in between
+#define DIRTY_RANGE_GAP 16
+
+// The most quads that 16-bit indexes can address, at 4 vertices each
+#define MAX_16BIT_INDEX_QUADS 16384
+
+// Element::batch of an element whose quads are in more than one batch
+#define NO_BATCH ((size_t)-1)
+
 /************************
 * Fill
 ************************/
@@ -76,16 +89,71 @@ Border::Border(const WidthRect& widths, const ColorRect& colors) : widths(widths
 }
 
 /************************
-* Canvas
+* CanvasBatch
 ************************/
 
-Canvas::Canvas(Atlas* atlas, Ogre::Viewport* viewport) : atlas(atlas), viewport(viewport), vertexData(0), indexData(0), 
-	bufferSize(100), renderQueueID(Ogre::RENDER_QUEUE_OVERLAY), isDirty(false), visibility(true)
+CanvasBatch::CanvasBatch(Canvas* canvas) : canvas(canvas), page(0), isTiled(false), firstIndex(0), indexCount(0), left(0), top(0), right(0), bottom(0)
 {
-	viewport->getTarget()->addListener(this);
-	material = Ogre::MaterialManager::getSingleton().getByName(atlas->getMaterialName());
+	indexData = new Ogre::IndexData();
 	setUseIdentityProjection(true);
 	setUseIdentityView(true);
+}
+
+CanvasBatch::~CanvasBatch()
+{
+	delete indexData;
+}
+
+const Ogre::MaterialPtr& CanvasBatch::getMaterial() const
+{
+	return material;
+}
+
+void CanvasBatch::getRenderOperation(Ogre::RenderOperation& op)
+{
+	op.operationType = Ogre::RenderOperation::OT_TRIANGLE_LIST;
+
+	op.vertexData = canvas->vertexData;
+
+	// Every batch is a range of the canvas' index buffer, which lists the quads of each batch in draw order
+	op.useIndexes = true;
+	op.indexData = indexData;
+	op.indexData->indexBuffer = canvas->indexData->indexBuffer;
+	op.indexData->indexStart = firstIndex;
+	op.indexData->indexCount = indexCount;
+}
+
+void CanvasBatch::getWorldTransforms(Ogre::Matrix4* xform) const
+{
+	xform[0] = canvas->_getParentNodeFullTransform();
+}
+
+Ogre::Real CanvasBatch::getSquaredViewDepth(const Ogre::Camera* cam) const
+{
+	Ogre::Node* node = canvas->getParentNode();
+	assert(node);
+	return node->getSquaredViewDepth(cam);
+}
+
+const Ogre::LightList& CanvasBatch::getLights() const
+{
+	return canvas->queryLights();
+}
+
+/************************
+* Canvas
+************************/
+
+Canvas::Canvas(Atlas* atlas, Ogre::Viewport* viewport) : atlas(atlas), viewport(viewport), freeQuadCount(0), batchCount(0), vertexData(0), 
+	indexData(0), bufferSize(100), renderQueueID(Ogre::RENDER_QUEUE_OVERLAY), isLayoutDirty(false), needsFullUpdate(false), visibility(true)
+{
+#if QUADLIST_HAVE_SSE
+	useSSE = (Ogre::PlatformInformation::getCpuFeatures() & Ogre::PlatformInformation::CPU_FEATURE_SSE) != 0;
+#else
+	useSSE = false;
+#endif
+
+	viewport->getTarget()->addListener(this);
 
 	resizeBuffers();
 	clearClip();
@@ -94,35 +162,50 @@ Canvas::Canvas(Atlas* atlas, Ogre::Viewport* viewport) : atlas(atlas), viewport(
 
 Canvas::~Canvas()
 {
+	for(std::vector<CanvasBatch*>::iterator i = batches.begin(); i != batches.end(); i++)
+		delete *i;
+
 	destroyBuffers();
 	viewport->getTarget()->removeListener(this);
 }
 
-void Canvas::drawRectangle(int x, int y, int width, int height, const Fill& fill, const Border& border)
+ElementHandle Canvas::drawRectangle(int x, int y, int width, int height, const Fill& fill, const Border& border)
 {
 	PixelRect rect(x, y, x + width, y + height);
 
 	if(border.isEmpty)
 	{
 		if(isOutsideClip(rect))
-			return;
+			return addElement();
 	}
 	else
 	{
 		if(isOutsideClip(PixelRect(rect.left - border.widths.left, rect.top - border.widths.top, rect.right + border.widths.right, rect.bottom + border.widths.bottom)))
-			return;
+			return addElement();
 	}
 
 	if(!fill.isEmpty)
 	{
 		TextureInfo texInfo = atlas->getTextureInfo(fill.atlasKey);
 		if(texInfo.isEmpty)
-			return;
+			return addElement();
 
 		// Draw a simple rectangle with the normal texture-coordinates at each corner
 		if(fill.atlasKey == "VertexColor" || (width == texInfo.width && height == texInfo.height))
 		{
-			drawQuad(rect, texInfo.texCoords, fill.coloring);
+			drawQuad(rect, texInfo.texCoords, fill.coloring, texInfo.page);
+		}
+		else if(!atlas->getTiledMaterialName().empty()) // Draw a single quad, the fragment program repeats the texture
+		{
+			Ogre::FloatRect tileCoords(0, 0, width / (Ogre::Real)texInfo.width, height / (Ogre::Real)texInfo.height);
+
+			// Inset a quarter texel so that the edges of a tile never round to the texture's neighbours in the atlas
+			Ogre::Real xInset = 0.25f / atlas->getDimensions().first;
+			Ogre::Real yInset = 0.25f / atlas->getDimensions().second;
+			Ogre::Vector4 tileRect(texInfo.texCoords.left + xInset, texInfo.texCoords.top + yInset, 
+				texInfo.texCoords.width() - xInset * 2, texInfo.texCoords.height() - yInset * 2);
+
+			drawQuad(rect, tileCoords, fill.coloring, texInfo.page, &tileRect);
 		}
 		else // Draw a tiled rectangle, may contain multiple quads to give the illusion that the texture is "tiling"
 		{
@@ -175,7 +258,7 @@ void Canvas::drawRectangle(int x, int y, int width, int height, const Fill& fill
 						coloring.colors.second = (fill.coloring.colors.first * (1 - amount2)) + (fill.coloring.colors.second * amount2);
 					}
 
-					drawQuad(tile, texCoords, coloring);
+					drawQuad(tile, texCoords, coloring, texInfo.page);
 				}
 			}
 		}
@@ -184,7 +267,8 @@ void Canvas::drawRectangle(int x, int y, int width, int height, const Fill& fill
 	// Draw the four sides of the border, if present
 	if(!border.isEmpty)
 	{
-		Ogre::FloatRect vColCoords = atlas->getTextureInfo("VertexColor").texCoords;
+		const TextureInfo& vColInfo = atlas->getTextureInfo("VertexColor");
+		Ogre::FloatRect vColCoords = vColInfo.texCoords;
 		Corners<Ogre::Vector2> corners;
 
 		PixelRect bRect(rect.left - border.widths.left, rect.top - border.widths.top, rect.right + border.widths.right, rect.bottom + border.widths.bottom);
@@ -197,7 +281,7 @@ void Canvas::drawRectangle(int x, int y, int width, int height, const Fill& fill
 			corners.bottomRight = Ogre::Vector2(rect.left, rect.bottom);
 			corners.topRight = Ogre::Vector2(rect.left, rect.top);
 			
-			drawQuad(corners, vColCoords, border.colors.left);
+			drawQuad(corners, vColCoords, border.colors.left, vColInfo.page);
 		}
 
 		// Bottom Border
@@ -208,7 +292,7 @@ void Canvas::drawRectangle(int x, int y, int width, int height, const Fill& fill
 			corners.bottomRight = Ogre::Vector2(bRect.right, bRect.bottom);
 			corners.topRight = Ogre::Vector2(rect.right, rect.bottom);
 
-			drawQuad(corners, vColCoords, border.colors.bottom);
+			drawQuad(corners, vColCoords, border.colors.bottom, vColInfo.page);
 		}
 
 		// Right Border
@@ -219,7 +303,7 @@ void Canvas::drawRectangle(int x, int y, int width, int height, const Fill& fill
 			corners.bottomRight = Ogre::Vector2(bRect.right, bRect.bottom);
 			corners.topRight = Ogre::Vector2(bRect.right, bRect.top);
 
-			drawQuad(corners, vColCoords, border.colors.right);
+			drawQuad(corners, vColCoords, border.colors.right, vColInfo.page);
 		}
 
 		// Top Border
@@ -230,94 +314,133 @@ void Canvas::drawRectangle(int x, int y, int width, int height, const Fill& fill
 			corners.bottomRight = Ogre::Vector2(rect.right, rect.top);
 			corners.topRight = Ogre::Vector2(bRect.right, bRect.top);
 
-			drawQuad(corners, vColCoords, border.colors.top);
+			drawQuad(corners, vColCoords, border.colors.top, vColInfo.page);
 		}
 	}
+
+	return addElement();
 }
 
-void Canvas::drawGlyph(const GlyphInfo& glyph, int x, int y, int width, int height, const Ogre::ColourValue& color)
+ElementHandle Canvas::drawGlyph(const GlyphInfo& glyph, int x, int y, int width, int height, const Ogre::ColourValue& color)
 {
 	if(glyph.texInfo.isEmpty)
-		return;
+		return addElement();
 
 	PixelRect rect(x, y, x + width, y + height);
 
 	if(isOutsideClip(rect))
-		return;
+		return addElement();
 
 	Coloring coloring;
 	coloring.colors.first = color;
 	coloring.hasGradient = false;
 
-	drawQuad(rect, glyph.texInfo.texCoords, coloring);
-}
+	drawQuad(rect, glyph.texInfo.texCoords, coloring, glyph.texInfo.page);
 
-void Canvas::clear()
-{
-	quadList.clear();
-	isDirty = true;
+	return addElement();
 }
 
-void Canvas::setClip(int left, int top, int right, int bottom)
+void Canvas::setElementTransform(ElementHandle element, Ogre::Real x, Ogre::Real y, Ogre::Real scale)
 {
-	clip.left = left;
-	clip.top = top;
-	clip.right = right;
-	clip.bottom = bottom;
-}
+	assert(element < elements.size() && elements[element].isUsed);
+	Element& elem = elements[element];
 
-void Canvas::clearClip()
-{
-	clip.left = 0;
-	clip.top = 0;
-	clip.right = viewport->getActualWidth();
-	clip.bottom = viewport->getActualHeight();
-}
+	if(elem.x == x && elem.y == y && elem.scale == scale)
+		return;
 
-const Ogre::MaterialPtr& Canvas::getMaterial() const
-{
-	return material;
+	elem.x = x;
+	elem.y = y;
+	elem.scale = scale;
+
+	if(elem.quadCount)
+	{
+		dirtyRanges.push_back(std::pair<size_t, size_t>(elem.firstQuad, elem.quadCount));
+
+		// The batches depend on where quads overlap, hidden elements aren't in any
+		if(elem.isVisible && !isLayoutDirty && !moveWithinBatch(elem))
+			isLayoutDirty = true;
+	}
 }
 
-void Canvas::getRenderOperation(Ogre::RenderOperation& op)
+void Canvas::setElementColor(ElementHandle element, const Ogre::ColourValue& color)
 {
-	op.operationType = Ogre::RenderOperation::OT_TRIANGLE_LIST;
+	assert(element < elements.size() && elements[element].isUsed);
+	Element& elem = elements[element];
+	bool isChanged = false;
 
-	op.vertexData = vertexData;
-	op.vertexData->vertexStart = 0;
-	op.vertexData->vertexCount = quadList.size() * 4;
+	Ogre::RGBA packedColor;
+	Ogre::Root::getSingleton().convertColourValue(color, &packedColor);
 
-	op.useIndexes = true;
-	op.indexData = indexData;
-	op.indexData->indexStart = 0;
-	op.indexData->indexCount = quadList.size() * 6;
+	for(size_t i = elem.firstQuad; i < elem.firstQuad + elem.quadCount; i++)
+	{
+		unsigned int* corners = quadList.colors[i].corners;
+
+		if(corners[0] != packedColor || corners[1] != packedColor || corners[2] != packedColor || corners[3] != packedColor)
+		{
+			corners[0] = corners[1] = corners[2] = corners[3] = packedColor;
+			isChanged = true;
+		}
+	}
+
+	if(isChanged)
+		dirtyRanges.push_back(std::pair<size_t, size_t>(elem.firstQuad, elem.quadCount));
 }
 
-void Canvas::getWorldTransforms(Ogre::Matrix4* xform) const
+void Canvas::setElementVisible(ElementHandle element, bool visible)
 {
-	xform[0] = this->_getParentNodeFullTransform();
+	assert(element < elements.size() && elements[element].isUsed);
+	Element& elem = elements[element];
+
+	if(elem.isVisible == visible)
+		return;
+
+	elem.isVisible = visible;
+
+	if(elem.quadCount)
+		isLayoutDirty = true;
 }
 
-const Ogre::Quaternion& Canvas::getWorldOrientation() const
+void Canvas::removeElement(ElementHandle element)
 {
-	return this->getParentNode()->_getDerivedOrientation();
+	assert(element < elements.size() && elements[element].isUsed);
+	Element& elem = elements[element];
+
+	release(elem.firstQuad, elem.quadCount);
+	elem.isUsed = false;
+
+	// The handle is recycled once it is out of the draw order, when the batches are next updated
+	removedElements.push_back(element);
+	isLayoutDirty = true;
 }
 
-const Ogre::Vector3& Canvas::getWorldPosition() const
+void Canvas::clear()
 {
-	return this->getParentNode()->_getDerivedPosition();
+	quadList.clear();
+	quadInfos.clear();
+	elements.clear();
+	drawOrder.clear();
+	freeElements.clear();
+	removedElements.clear();
+	freeRanges.clear();
+	dirtyRanges.clear();
+	freeQuadCount = 0;
+	isLayoutDirty = true;
 }
 
-Ogre::Real Canvas::getSquaredViewDepth(const Ogre::Camera* cam) const
+void Canvas::setClip(int left, int top, int right, int bottom)
 {
-	Ogre::Node* node = this->getParentNode();
-	assert(node);
-	return node->getSquaredViewDepth(cam);
+	clip.left = left;
+	clip.top = top;
+	clip.right = right;
+	clip.bottom = bottom;
 }
 
-const Ogre::LightList& Canvas::getLights() const
+void Canvas::clearClip()
 {
-	return this->queryLights();
+	clip.left = 0;
+	clip.top = 0;
+	clip.right = viewport->getActualWidth();
+	clip.bottom = viewport->getActualHeight();
 }
 
 const Ogre::String& Canvas::getMovableType() const
@@ -342,10 +465,16 @@ Ogre::Real Canvas::getBoundingRadius() const
 
 void Canvas::_updateRenderQueue(Ogre::RenderQueue* queue)
 {
+	// Compact rather than grow the buffer, if that makes enough room
+	if(quadList.size() > bufferSize || (freeQuadCount >= MIN_COMPACTION_QUADS && freeQuadCount * 2 >= quadList.size()))
+		compact();
+
 	resizeBuffers();
 	updateGeometry();
 
-	queue->addRenderable(this, renderQueueID);
+	// The priorities keep the batches in the order they were drawn in
+	for(size_t i = 0; i < batchCount; i++)
+		queue->addRenderable(batches[i], renderQueueID, (Ogre::ushort)(OGRE_RENDERABLE_DEFAULT_PRIORITY + i));
 }
 
 void Canvas::setVisible(bool visible)
@@ -367,6 +496,8 @@ bool Canvas::isVisible() const
 
 void Canvas::visitRenderables(Ogre::Renderable::Visitor* visitor, bool debugRenderables)
 {
+	for(size_t i = 0; i < batchCount; i++)
+		visitor->visit(batches[i], 0, false);
 }
 
 void Canvas::preRenderTargetUpdate(const Ogre::RenderTargetEvent& evt)
@@ -416,6 +547,7 @@ void Canvas::destroyBuffers()
 
 void Canvas::resizeBuffers()
 {
+	// Grow to twice what is needed, so that a canvas whose text keeps changing soon stops reallocating
 	if(bufferSize < quadList.size())
 	{
 		bufferSize = quadList.size() * 2;
@@ -438,38 +570,30 @@ void Canvas::resizeBuffers()
 		offset += Ogre::VertexElement::getTypeSize(Ogre::VET_COLOUR);
 		decl->addElement(0, offset, Ogre::VET_FLOAT2, Ogre::VES_TEXTURE_COORDINATES, 0);
 
+		// Not discardable, quads are updated in place
 		buffer = Ogre::HardwareBufferManager::getSingleton().createVertexBuffer(
-			decl->getVertexSize(0), vertexData->vertexCount, Ogre::HardwareBuffer::HBU_DYNAMIC_WRITE_ONLY_DISCARDABLE);
+			decl->getVertexSize(0), vertexData->vertexCount, Ogre::HardwareBuffer::HBU_DYNAMIC_WRITE_ONLY);
 		binding->setBinding(0, buffer);
+
+		needsFullUpdate = true;
+		isLayoutDirty = true;
 	}
 
 	if(!indexData)
 	{
+		// The indexes list the visible quads batch by batch, they are written in Canvas::updateBatches
 		indexData = new Ogre::IndexData();
 		indexData->indexStart = 0;
 		indexData->indexCount = bufferSize * 6;
 
-		indexData->indexBuffer = Ogre::HardwareBufferManager::getSingleton().createIndexBuffer(
-			Ogre::HardwareIndexBuffer::IT_16BIT, indexData->indexCount, Ogre::HardwareBuffer::HBU_STATIC_WRITE_ONLY);
-
-		unsigned short* indexBuffer = (unsigned short*)indexData->indexBuffer->lock(0, indexData->indexBuffer->getSizeInBytes(), Ogre::HardwareBuffer::HBL_DISCARD);
+		Ogre::HardwareIndexBuffer::IndexType indexType = bufferSize > MAX_16BIT_INDEX_QUADS ? 
+			Ogre::HardwareIndexBuffer::IT_32BIT : Ogre::HardwareIndexBuffer::IT_16BIT;
 
-		// Indexes are generated here because we know that we will only be rendering quads
-		// This means that we only have to handle updating the vertex buffer in Canvas::updateGeometry
-		for(size_t indexIdx, vertexIdx, quadIdx = 0; quadIdx < bufferSize; quadIdx++)
-		{
-			indexIdx = quadIdx * 6;
-			vertexIdx = quadIdx * 4;
-
-			indexBuffer[indexIdx++] = (unsigned short)(vertexIdx + 0);
-			indexBuffer[indexIdx++] = (unsigned short)(vertexIdx + 2);
-			indexBuffer[indexIdx++] = (unsigned short)(vertexIdx + 1);
-			indexBuffer[indexIdx++] = (unsigned short)(vertexIdx + 1);
-			indexBuffer[indexIdx++] = (unsigned short)(vertexIdx + 2);
-			indexBuffer[indexIdx++] = (unsigned short)(vertexIdx + 3);
-		}
+		indexData->indexBuffer = Ogre::HardwareBufferManager::getSingleton().createIndexBuffer(
+			indexType, indexData->indexCount, Ogre::HardwareBuffer::HBU_DYNAMIC_WRITE_ONLY_DISCARDABLE);
 
-		indexData->indexBuffer->unlock();
+		needsFullUpdate = true;
+		isLayoutDirty = true;
 	}
 }
 
@@ -487,16 +611,142 @@ bool Canvas::isOutsideClip(const PixelRect& rect)
 	return false;
 }
 
-void Canvas::localize(Ogre::Vector2& vertex)
+ElementHandle Canvas::addElement()
+{
+	ElementHandle handle;
+
+	if(!freeElements.empty())
+	{
+		handle = freeElements.back();
+		freeElements.pop_back();
+	}
+	else
+	{
+		handle = elements.size();
+		elements.push_back(Element());
+	}
+
+	Element& elem = elements[handle];
+	elem.firstQuad = allocate(pendingQuads.size());
+	elem.quadCount = pendingQuads.size();
+	elem.x = elem.y = 0;
+	elem.scale = 1;
+	elem.isUsed = true;
+	elem.isVisible = true;
+
+	quadList.copy(elem.firstQuad, pendingQuads, 0, pendingQuads.size());
+
+	for(size_t i = 0; i < pendingInfos.size(); i++)
+	{
+		quadInfos[elem.firstQuad + i] = pendingInfos[i];
+		quadInfos[elem.firstQuad + i].element = handle;
+	}
+
+	if(elem.quadCount)
+		dirtyRanges.push_back(std::pair<size_t, size_t>(elem.firstQuad, elem.quadCount));
+
+	pendingQuads.clear();
+	pendingInfos.clear();
+	drawOrder.push_back(handle);
+	isLayoutDirty = true;
+
+	return handle;
+}
+
+size_t Canvas::allocate(size_t quadCount)
+{
+	if(!quadCount)
+		return 0;
+
+	// First fit among the ranges of removed elements, otherwise at the end of the buffer
+	for(std::vector<std::pair<size_t, size_t> >::iterator i = freeRanges.begin(); i != freeRanges.end(); i++)
+	{
+		if(i->second >= quadCount)
+		{
+			size_t firstQuad = i->first;
+			i->first += quadCount;
+			i->second -= quadCount;
+			freeQuadCount -= quadCount;
+
+			if(!i->second)
+				freeRanges.erase(i);
+
+			return firstQuad;
+		}
+	}
+
+	size_t firstQuad = quadList.size();
+	resizeQuads(firstQuad + quadCount);
+
+	return firstQuad;
+}
+
+void Canvas::release(size_t firstQuad, size_t quadCount)
 {
-	Ogre::Real xTexel = Ogre::Root::getSingleton().getRenderSystem()->getHorizontalTexelOffset();
-	Ogre::Real yTexel = Ogre::Root::getSingleton().getRenderSystem()->getVerticalTexelOffset();
+	if(!quadCount)
+		return;
+
+	// Keep the free ranges sorted and merged with their neighbours
+	std::vector<std::pair<size_t, size_t> >::iterator next = freeRanges.begin();
+
+	while(next != freeRanges.end() && next->first < firstQuad)
+		next++;
+
+	next = freeRanges.insert(next, std::pair<size_t, size_t>(firstQuad, quadCount));
+	freeQuadCount += quadCount;
 
-	vertex.x = ((vertex.x + xTexel) / (Ogre::Real)viewport->getActualWidth()) * 2 - 1;
-	vertex.y = ((vertex.y + yTexel) / (Ogre::Real)viewport->getActualHeight()) * -2 + 1;
+	if(next + 1 != freeRanges.end() && next->first + next->second == (next + 1)->first)
+	{
+		next->second += (next + 1)->second;
+		freeRanges.erase(next + 1);
+	}
+
+	if(next != freeRanges.begin() && (next - 1)->first + (next - 1)->second == next->first)
+	{
+		(next - 1)->second += next->second;
+		next = freeRanges.erase(next) - 1;
+	}
+
+	// A range that reaches the end of the buffer gives its quads back
+	if(next->first + next->second == quadList.size())
+	{
+		resizeQuads(next->first);
+		freeQuadCount -= next->second;
+		freeRanges.erase(next);
+	}
+}
+
+void Canvas::compact()
+{
+	// Lay the elements out again in draw order, without the ranges of removed ones
+	QuadList compacted;
+	std::vector<QuadInfo> compactedInfos;
+	compacted.reserve(quadList.size() - freeQuadCount);
+	compactedInfos.reserve(quadList.size() - freeQuadCount);
+
+	for(std::vector<ElementHandle>::iterator i = drawOrder.begin(); i != drawOrder.end(); i++)
+	{
+		Element& elem = elements[*i];
+
+		// Empty elements have no range to move
+		if(!elem.isUsed || !elem.quadCount)
+			continue;
+
+		compacted.append(quadList, elem.firstQuad, elem.quadCount);
+		compactedInfos.insert(compactedInfos.end(), quadInfos.begin() + elem.firstQuad, quadInfos.begin() + elem.firstQuad + elem.quadCount);
+		elem.firstQuad = compacted.size() - elem.quadCount;
+	}
+
+	quadList.swap(compacted);
+	quadInfos.swap(compactedInfos);
+	freeRanges.clear();
+	dirtyRanges.clear();
+	freeQuadCount = 0;
+	needsFullUpdate = true;
+	isLayoutDirty = true;
 }
 
-void Canvas::drawQuad(const PixelRect& rect, const Ogre::FloatRect& texCoords, const Coloring& coloring)
+void Canvas::drawQuad(const PixelRect& rect, const Ogre::FloatRect& texCoords, const Coloring& coloring, size_t page, const Ogre::Vector4* tileRect)
 {
 	PixelRect clipped;
 	Ogre::FloatRect clippedTexCoords(texCoords);
@@ -558,37 +808,28 @@ void Canvas::drawQuad(const PixelRect& rect, const Ogre::FloatRect& texCoords, c
 			clippedColoring.colors.second = (coloring.colors.first * (-delta)) + (coloring.colors.second * (1 + delta));
 	}
 	
-	Canvas::Quad quad;
-	quad.vertices = Corners<Ogre::Vector2>(Ogre::Vector2(clipped.left, clipped.top), Ogre::Vector2(clipped.left, clipped.bottom), 
-		Ogre::Vector2(clipped.right, clipped.bottom), Ogre::Vector2(clipped.right, clipped.top));
-
-	localize(quad.vertices.topLeft);
-	localize(quad.vertices.bottomLeft);
-	localize(quad.vertices.bottomRight);
-	localize(quad.vertices.topRight);
-
-	quad.texCoords.topLeft = Ogre::Vector2(clippedTexCoords.left, clippedTexCoords.top);
-	quad.texCoords.bottomLeft = Ogre::Vector2(clippedTexCoords.left, clippedTexCoords.bottom);
-	quad.texCoords.bottomRight = Ogre::Vector2(clippedTexCoords.right, clippedTexCoords.bottom);
-	quad.texCoords.topRight = Ogre::Vector2(clippedTexCoords.right, clippedTexCoords.top);
+	QuadList::Positions positions = { 
+		{ (float)clipped.left, (float)clipped.right, (float)clipped.left, (float)clipped.right }, 
+		{ (float)clipped.top, (float)clipped.top, (float)clipped.bottom, (float)clipped.bottom } };
+
+	Corners<Ogre::ColourValue> colors;
 	
 	if(clippedColoring.hasGradient)
 	{
 		if(clippedColoring.orientation == Coloring::Vertical)
-			quad.colors = Corners<Ogre::ColourValue>(clippedColoring.colors.first, clippedColoring.colors.second, clippedColoring.colors.second, clippedColoring.colors.first);
+			colors = Corners<Ogre::ColourValue>(clippedColoring.colors.first, clippedColoring.colors.second, clippedColoring.colors.second, clippedColoring.colors.first);
 		else
-			quad.colors = Corners<Ogre::ColourValue>(clippedColoring.colors.first, clippedColoring.colors.first, clippedColoring.colors.second, clippedColoring.colors.second);
+			colors = Corners<Ogre::ColourValue>(clippedColoring.colors.first, clippedColoring.colors.first, clippedColoring.colors.second, clippedColoring.colors.second);
 	}
 	else
 	{
-		quad.colors = Corners<Ogre::ColourValue>(clippedColoring.colors.first);
+		colors = Corners<Ogre::ColourValue>(clippedColoring.colors.first);
 	}
 
-	quadList.push_back(quad);
-	isDirty = true;
+	addQuad(positions, clippedTexCoords, colors, page, tileRect);
 }
 
-void Canvas::drawQuad(const Corners<Ogre::Vector2>& corners, const Ogre::FloatRect& texCoords, const Ogre::ColourValue& color)
+void Canvas::drawQuad(const Corners<Ogre::Vector2>& corners, const Ogre::FloatRect& texCoords, const Ogre::ColourValue& color, size_t page)
 {
 	Corners<Ogre::Vector2> clippedCorners;
 	clippedCorners.topLeft.x = corners.topLeft.x > clip.left ? corners.topLeft.x : clip.left;
@@ -600,94 +841,348 @@ void Canvas::drawQuad(const Corners<Ogre::Vector2>& corners, const Ogre::FloatRe
 	clippedCorners.topRight.x = corners.topRight.x < clip.right ? corners.topRight.x : clip.right;
 	clippedCorners.topRight.y = corners.topRight.y > clip.top ? corners.topRight.y : clip.top;
 
-	Canvas::Quad quad;
-	quad.vertices = clippedCorners;
+	QuadList::Positions positions = { 
+		{ clippedCorners.topLeft.x, clippedCorners.topRight.x, clippedCorners.bottomLeft.x, clippedCorners.bottomRight.x }, 
+		{ clippedCorners.topLeft.y, clippedCorners.topRight.y, clippedCorners.bottomLeft.y, clippedCorners.bottomRight.y } };
 
-	localize(quad.vertices.topLeft);
-	localize(quad.vertices.bottomLeft);
-	localize(quad.vertices.bottomRight);
-	localize(quad.vertices.topRight);
+	addQuad(positions, texCoords, Corners<Ogre::ColourValue>(color), page, 0);
+}
 
-	quad.texCoords.topLeft = Ogre::Vector2(texCoords.left, texCoords.top);
-	quad.texCoords.bottomLeft = Ogre::Vector2(texCoords.left, texCoords.bottom);
-	quad.texCoords.bottomRight = Ogre::Vector2(texCoords.right, texCoords.bottom);
-	quad.texCoords.topRight = Ogre::Vector2(texCoords.right, texCoords.top);
-	
-	quad.colors = Corners<Ogre::ColourValue>(color);
+void Canvas::addQuad(const QuadList::Positions& positions, const Ogre::FloatRect& texCoords, const Corners<Ogre::ColourValue>& colors, 
+	size_t page, const Ogre::Vector4* tileRect)
+{
+	QuadList::TexCoords quadTexCoords = { texCoords.left, texCoords.top, texCoords.right, texCoords.bottom };
+
+	// Colors are packed once, here, rather than every time the quad is written
+	Ogre::Root& root = Ogre::Root::getSingleton();
+	QuadList::Colors quadColors;
+	root.convertColourValue(colors.topLeft, &quadColors.corners[0]);
+	root.convertColourValue(colors.topRight, &quadColors.corners[1]);
+	root.convertColourValue(colors.bottomLeft, &quadColors.corners[2]);
+	root.convertColourValue(colors.bottomRight, &quadColors.corners[3]);
+
+	pendingQuads.push_back(positions, quadTexCoords, quadColors);
+
+	QuadInfo info;
+	info.page = page;
+	info.isTiled = tileRect != 0;
+	info.element = 0;
 
-	quadList.push_back(quad);
-	isDirty = true;
+	if(tileRect)
+		info.tileRect = *tileRect;
+
+	pendingInfos.push_back(info);
 }
 
-void Canvas::updateGeometry()
+void Canvas::resizeQuads(size_t quadCount)
+{
+	quadList.resize(quadCount);
+	quadInfos.resize(quadCount);
+}
+
+void Canvas::updateBatches()
 {
-	if(!isDirty)
+	// Drop removed elements from the draw order, their handles can be recycled from now on
+	if(!removedElements.empty())
+	{
+		size_t kept = 0;
+
+		for(size_t i = 0; i < drawOrder.size(); i++)
+			if(elements[drawOrder[i]].isUsed)
+				drawOrder[kept++] = drawOrder[i];
+
+		drawOrder.resize(kept);
+		freeElements.insert(freeElements.end(), removedElements.begin(), removedElements.end());
+		removedElements.clear();
+	}
+
+	batchCount = 0;
+	quadBatches.clear();
+
+	for(std::vector<ElementHandle>::const_iterator e = drawOrder.begin(); e != drawOrder.end(); e++)
+	{
+		Element& elem = elements[*e];
+
+		if(!elem.isVisible)
+			continue;
+
+		for(size_t i = elem.firstQuad; i < elem.firstQuad + elem.quadCount; i++)
+		{
+			const QuadInfo& quad = quadInfos[i];
+			const QuadList::Positions& v = quadList.positions[i];
+
+			// Corners are top-left, top-right, bottom-left, bottom-right
+			Ogre::Real quadLeft = std::min(v.x[0], v.x[2]);
+			Ogre::Real quadRight = std::max(v.x[1], v.x[3]);
+			Ogre::Real quadTop = std::min(v.y[0], v.y[1]);
+			Ogre::Real quadBottom = std::max(v.y[2], v.y[3]);
+
+			if(i == elem.firstQuad)
+			{
+				elem.left = quadLeft;
+				elem.right = quadRight;
+				elem.top = quadTop;
+				elem.bottom = quadBottom;
+			}
+			else
+			{
+				elem.left = std::min(elem.left, quadLeft);
+				elem.right = std::max(elem.right, quadRight);
+				elem.top = std::min(elem.top, quadTop);
+				elem.bottom = std::max(elem.bottom, quadBottom);
+			}
+
+			Ogre::Real left = quadLeft * elem.scale + elem.x;
+			Ogre::Real right = quadRight * elem.scale + elem.x;
+			Ogre::Real top = quadTop * elem.scale + elem.y;
+			Ogre::Real bottom = quadBottom * elem.scale + elem.y;
+
+			// Find the last batch of the same page (and tiled texture) that the quad may join: none of the batches after it
+			// may overlap the quad
+			size_t target = batchCount;
+
+			for(size_t b = batchCount; b-- > 0;)
+			{
+				CanvasBatch* batch = batches[b];
+
+				if(batch->page == quad.page && batch->isTiled == quad.isTiled && (!quad.isTiled || batch->tileRect == quad.tileRect))
+				{
+					target = b;
+					break;
+				}
+
+				if(left < batch->right && right > batch->left && top < batch->bottom && bottom > batch->top)
+					break;
+			}
+
+			if(target == batchCount)
+			{
+				if(batchCount == batches.size())
+					batches.push_back(new CanvasBatch(this));
+
+				CanvasBatch* batch = batches[batchCount++];
+
+				if(batch->material.isNull() || batch->page != quad.page || batch->isTiled != quad.isTiled)
+					batch->material = Ogre::MaterialManager::getSingleton().getByName(quad.isTiled ? 
+						atlas->getTiledMaterialName() : atlas->getMaterialName(quad.page));
+
+				// The tiled material reads the rectangle of the texture from custom parameter 0
+				if(quad.isTiled)
+					batch->setCustomParameter(0, quad.tileRect);
+
+				batch->page = quad.page;
+				batch->isTiled = quad.isTiled;
+				batch->tileRect = quad.tileRect;
+				batch->indexCount = 0;
+				batch->left = left;
+				batch->right = right;
+				batch->top = top;
+				batch->bottom = bottom;
+			}
+			else
+			{
+				CanvasBatch* batch = batches[target];
+				batch->left = std::min(batch->left, left);
+				batch->right = std::max(batch->right, right);
+				batch->top = std::min(batch->top, top);
+				batch->bottom = std::max(batch->bottom, bottom);
+			}
+
+			batches[target]->indexCount += 6;
+			quadBatches.push_back(target);
+
+			if(i == elem.firstQuad)
+				elem.batch = target;
+			else if(elem.batch != target)
+				elem.batch = NO_BATCH;
+		}
+	}
+
+	size_t indexCount = 0;
+
+	for(size_t b = 0; b < batchCount; b++)
+	{
+		batches[b]->firstIndex = indexCount;
+		indexCount += batches[b]->indexCount;
+	}
+
+	// List the quads of every batch in draw order, wherever they are in the vertex buffer
+	batchFill.assign(batchCount, 0);
+	size_t visited = 0;
+	batchIndexes.resize(indexCount);
+
+	for(std::vector<ElementHandle>::const_iterator e = drawOrder.begin(); e != drawOrder.end(); e++)
+	{
+		const Element& elem = elements[*e];
+
+		if(!elem.isVisible)
+			continue;
+
+		for(size_t i = elem.firstQuad; i < elem.firstQuad + elem.quadCount; i++)
+		{
+			size_t b = quadBatches[visited++];
+			Ogre::uint32* index = &batchIndexes[batches[b]->firstIndex + batchFill[b]];
+			Ogre::uint32 vertexIdx = (Ogre::uint32)(i * 4);
+			batchFill[b] += 6;
+
+			index[0] = vertexIdx + 0;
+			index[1] = vertexIdx + 2;
+			index[2] = vertexIdx + 1;
+			index[3] = vertexIdx + 1;
+			index[4] = vertexIdx + 2;
+			index[5] = vertexIdx + 3;
+		}
+	}
+
+	// Moving elements rarely changes the batches, the index buffer is only written when it does
+	if(batchIndexes == indexes && !needsFullUpdate)
 		return;
 
-	float* vBuffer = (float*)buffer->lock(0, quadList.size() * buffer->getVertexSize() * 4, Ogre::HardwareBuffer::HBL_DISCARD);
-	
-	Ogre::RGBA color;
-	Ogre::RGBA* vBufferCol = 0;
+	indexes.swap(batchIndexes);
 
-	for(std::vector<Canvas::Quad>::iterator i = quadList.begin(); i != quadList.end(); i++)
+	if(indexes.empty())
+		return;
+
+	if(indexData->indexBuffer->getType() == Ogre::HardwareIndexBuffer::IT_32BIT)
+	{
+		indexData->indexBuffer->writeData(0, indexes.size() * sizeof(Ogre::uint32), &indexes[0], true);
+	}
+	else
 	{
-		// Top-Left Vertex
-		*vBuffer++ = i->vertices.topLeft.x;
-		*vBuffer++ = i->vertices.topLeft.y;
-		*vBuffer++ = 0;
+		Ogre::uint16* index = (Ogre::uint16*)indexData->indexBuffer->lock(0, indexes.size() * sizeof(Ogre::uint16), 
+			Ogre::HardwareBuffer::HBL_DISCARD);
 
-		vBufferCol = (Ogre::RGBA*)vBuffer;
-		Ogre::Root::getSingleton().convertColourValue(i->colors.topLeft, &color);
-		*vBufferCol++ = color;
+		for(size_t i = 0; i < indexes.size(); i++)
+			index[i] = (Ogre::uint16)indexes[i];
 
-		vBuffer = (float*)vBufferCol;
+		indexData->indexBuffer->unlock();
+	}
+}
 
-		*vBuffer++ = i->texCoords.topLeft.x;
-		*vBuffer++ = i->texCoords.topLeft.y;
+bool Canvas::moveWithinBatch(Element& elem)
+{
+	if(elem.batch >= batchCount)
+		return false;
+
+	CanvasBatch* batch = batches[elem.batch];
+	Ogre::Real left = std::min(batch->left, elem.left * elem.scale + elem.x);
+	Ogre::Real right = std::max(batch->right, elem.right * elem.scale + elem.x);
+	Ogre::Real top = std::min(batch->top, elem.top * elem.scale + elem.y);
+	Ogre::Real bottom = std::max(batch->bottom, elem.bottom * elem.scale + elem.y);
+
+	// While the batch, grown to cover the element where it was and where it is, touches no other batch, none of the
+	// overlap tests of Canvas::updateBatches that involve the element can pass, so the batches stay as they are
+	for(size_t b = 0; b < batchCount; b++)
+	{
+		const CanvasBatch* other = batches[b];
+
+		if(b != elem.batch && left < other->right && right > other->left && top < other->bottom && bottom > other->top)
+			return false;
+	}
 
-		// Top-Right Vertex
-		*vBuffer++ = i->vertices.topRight.x;
-		*vBuffer++ = i->vertices.topRight.y;
-		*vBuffer++ = 0;
+	batch->left = left;
+	batch->right = right;
+	batch->top = top;
+	batch->bottom = bottom;
+
+	return true;
+}
+
+void Canvas::updateGeometry()
+{
+	if(isLayoutDirty)
+	{
+		updateBatches();
+		isLayoutDirty = false;
+	}
 
-		vBufferCol = (Ogre::RGBA*)vBuffer;
-		Ogre::Root::getSingleton().convertColourValue(i->colors.topRight, &color);
-		*vBufferCol++ = color;
+	vertexData->vertexStart = 0;
+	vertexData->vertexCount = quadList.size() * 4;
 
-		vBuffer = (float*)vBufferCol;
+	size_t quadSize = buffer->getVertexSize() * 4;
 
-		*vBuffer++ = i->texCoords.topRight.x;
-		*vBuffer++ = i->texCoords.topRight.y;
+	if(needsFullUpdate)
+	{
+		if(!quadList.empty())
+		{
+			Ogre::uint8* vBufferStart = (Ogre::uint8*)buffer->lock(0, quadList.size() * quadSize, Ogre::HardwareBuffer::HBL_DISCARD);
+			writeQuads(0, quadList.size(), vBufferStart);
+			buffer->unlock();
+		}
 
-		// Bottom-Left Vertex
-		*vBuffer++ = i->vertices.bottomLeft.x;
-		*vBuffer++ = i->vertices.bottomLeft.y;
-		*vBuffer++ = 0;
+		dirtyRanges.clear();
+		needsFullUpdate = false;
+		return;
+	}
 
-		vBufferCol = (Ogre::RGBA*)vBuffer;
-		Ogre::Root::getSingleton().convertColourValue(i->colors.bottomLeft, &color);
-		*vBufferCol++ = color;
+	if(dirtyRanges.empty())
+		return;
 
-		vBuffer = (float*)vBufferCol;
+	// Merge the dirty ranges and write each one with its own lock, the rest of the buffer is left as it is
+	std::sort(dirtyRanges.begin(), dirtyRanges.end());
 
-		*vBuffer++ = i->texCoords.bottomLeft.x;
-		*vBuffer++ = i->texCoords.bottomLeft.y;
+	size_t firstQuad = dirtyRanges[0].first;
+	size_t endQuad = firstQuad + dirtyRanges[0].second;
 
-		// Bottom-Right Vertex
-		*vBuffer++ = i->vertices.bottomRight.x;
-		*vBuffer++ = i->vertices.bottomRight.y;
-		*vBuffer++ = 0;
+	for(size_t i = 1; i <= dirtyRanges.size(); i++)
+	{
+		if(i < dirtyRanges.size() && dirtyRanges[i].first <= endQuad + DIRTY_RANGE_GAP)
+		{
+			endQuad = std::max(endQuad, dirtyRanges[i].first + dirtyRanges[i].second);
+			continue;
+		}
 
-		vBufferCol = (Ogre::RGBA*)vBuffer;
-		Ogre::Root::getSingleton().convertColourValue(i->colors.bottomRight, &color);
-		*vBufferCol++ = color;
+		// Ranges that were released at the end of the buffer are gone
+		endQuad = std::min(endQuad, quadList.size());
 
-		vBuffer = (float*)vBufferCol;
+		if(firstQuad < endQuad)
+		{
+			Ogre::uint8* vBufferStart = (Ogre::uint8*)buffer->lock(firstQuad * quadSize, (endQuad - firstQuad) * quadSize, 
+				Ogre::HardwareBuffer::HBL_NORMAL);
+			writeQuads(firstQuad, endQuad - firstQuad, vBufferStart);
+			buffer->unlock();
+		}
 
-		*vBuffer++ = i->texCoords.bottomRight.x;
-		*vBuffer++ = i->texCoords.bottomRight.y;
+		if(i < dirtyRanges.size())
+		{
+			firstQuad = dirtyRanges[i].first;
+			endQuad = firstQuad + dirtyRanges[i].second;
+		}
 	}
 
-	buffer->unlock();
-	isDirty = false;
+	dirtyRanges.clear();
+}
+
+void Canvas::writeQuads(size_t firstQuad, size_t quadCount, Ogre::uint8* dest)
+{
+	assert(buffer->getVertexSize() == QuadList::VERTEX_SIZE);
+
+	Ogre::RenderSystem* renderSystem = Ogre::Root::getSingleton().getRenderSystem();
+	Ogre::Real xTexel = renderSystem->getHorizontalTexelOffset();
+	Ogre::Real yTexel = renderSystem->getVerticalTexelOffset();
+	Ogre::Real xScale = 2 / (Ogre::Real)viewport->getActualWidth();
+	Ogre::Real yScale = -2 / (Ogre::Real)viewport->getActualHeight();
+
+	size_t endQuad = firstQuad + quadCount;
+
+	// The quads of an element are contiguous, each run of them is written with the element's transform
+	for(size_t q = firstQuad; q < endQuad;)
+	{
+		ElementHandle element = quadInfos[q].element;
+		size_t runEnd = q + 1;
+
+		while(runEnd < endQuad && quadInfos[runEnd].element == element)
+			runEnd++;
+
+		// Apply the element's transform, then go from pixels to normalized device coordinates
+		const Element& elem = elements[element];
+		QuadList::Transform transform;
+		transform.xMul = elem.scale * xScale;
+		transform.xAdd = (elem.x + xTexel) * xScale - 1;
+		transform.yMul = elem.scale * yScale;
+		transform.yAdd = (elem.y + yTexel) * yScale + 1;
+
+		quadList.writeVertices(q, runEnd - q, transform, dest + (q - firstQuad) * 4 * QuadList::VERTEX_SIZE, useSSE);
+		q = runEnd;
+	}
 }
\ No newline at end of file
@@ -24,6 +24,7 @@
 
 #include <vector>
 #include "Atlas.h"
+#include "QuadList.h"
 
 class Canvas;
 
@@ -116,6 +117,11 @@ typedef Ogre::TRect<int> ClipRect;
 typedef Ogre::TRect<int> PixelRect;
 typedef Ogre::TRect<Ogre::ColourValue> ColorRect;
 
+/**
+* Identifies the quads created by one draw call of a Canvas, see Canvas::drawRectangle.
+*/
+typedef size_t ElementHandle;
+
 /**
 * Defines the "border" for a rectangle drawn with Canvas.
 */
@@ -147,30 +153,105 @@ struct Border
 	Border(const WidthRect& widths, const ColorRect& colors);
 };
 
+/**
+* One draw call of a Canvas: the quads that use a certain atlas page, or that tile a certain texture of the atlas.
+*/
+class CanvasBatch : public Ogre::Renderable
+{
+	friend class Canvas;
+
+	Canvas* canvas;
+	Ogre::MaterialPtr material;
+	Ogre::IndexData* indexData;
+	size_t page;
+	bool isTiled;
+	Ogre::Vector4 tileRect;
+	size_t firstIndex, indexCount;
+	Ogre::Real left, top, right, bottom;
+
+public:
+	CanvasBatch(Canvas* canvas);
+	~CanvasBatch();
+
+	// Inherited from Ogre::Renderable
+	const Ogre::MaterialPtr& getMaterial() const;
+	void getRenderOperation(Ogre::RenderOperation& op);
+	void getWorldTransforms(Ogre::Matrix4* xform) const;
+	Ogre::Real getSquaredViewDepth(const Ogre::Camera* cam) const;
+	const Ogre::LightList& getLights() const;
+};
+
 /**
 * The Canvas.
+*
+* The canvas is retained: every draw call creates an element, a range of quads that keeps its place in the vertex
+* buffer until it is removed. Moving, recoloring, hiding or removing an element only rewrites its own vertices (or
+* the index buffer), and the ranges of removed elements are recycled. The vertex buffer is only rewritten in full
+* when it is compacted, once freed quads make up half of it, or when it has to grow.
+*
+* Quads are kept in pixels in a QuadList, with their colors packed when they are drawn. Vertices are written an
+* element at a time, applying its transform, with SSE when the processor has it.
+*
+* The buffers grow to twice the number of quads whenever they are outgrown, and never shrink. Indexes are 16-bit
+* while the vertex buffer holds up to 16384 quads, and 32-bit beyond that.
+*
+* Quads are rendered in one batch per atlas page. A quad joins the existing batch of its page unless it overlaps
+* something drawn since, so the result is the same as rendering every element in the order it was drawn. Moving an
+* element only rebuilds the batches when its batch would come to overlap another one.
+*
+* Rectangles filled with a texture of a different size repeat it with a single quad, whose texture coordinates count
+* tiles, when the atlas has a tiled material (see Atlas::getTiledMaterialName). Otherwise they take a quad per tile.
 */
-class Canvas : public Ogre::Renderable, public Ogre::MovableObject, public Ogre::RenderTargetListener
+class Canvas : public Ogre::MovableObject, public Ogre::RenderTargetListener
 {
-	struct Quad
+	friend class CanvasBatch;
+
+	// What a quad needs besides its geometry, which is kept in a QuadList
+	struct QuadInfo
 	{
-		Corners<Ogre::Vector2> vertices;
-		Corners<Ogre::Vector2> texCoords;
-		Corners<Ogre::ColourValue> colors;
+		size_t page;
+		bool isTiled;
+		Ogre::Vector4 tileRect;
+		ElementHandle element;
+	};
+
+	struct Element
+	{
+		size_t firstQuad, quadCount;
+		Ogre::Real x, y, scale;
+		bool isUsed, isVisible;
+		// Set by Canvas::updateBatches: the bounds of its quads before the transform, and the batch that holds all
+		// of them (or none, if they are spread over several)
+		Ogre::Real left, top, right, bottom;
+		size_t batch;
 	};
 
 	Atlas* atlas;
-	std::vector<Canvas::Quad> quadList;
+	QuadList quadList;
+	std::vector<QuadInfo> quadInfos;
+	QuadList pendingQuads;
+	std::vector<QuadInfo> pendingInfos;
+	std::vector<Element> elements;
+	std::vector<ElementHandle> drawOrder;
+	std::vector<ElementHandle> freeElements, removedElements;
+	std::vector<std::pair<size_t, size_t> > freeRanges;
+	std::vector<std::pair<size_t, size_t> > dirtyRanges;
+	size_t freeQuadCount;
+	std::vector<size_t> quadBatches, batchFill;
+	std::vector<Ogre::uint32> indexes, batchIndexes;
+	std::vector<CanvasBatch*> batches;
+	size_t batchCount;
 	Ogre::HardwareVertexBufferSharedPtr buffer;
 	Ogre::VertexData* vertexData;
 	Ogre::IndexData* indexData;
 	size_t bufferSize;
-	Ogre::MaterialPtr material;
 	Ogre::Viewport* viewport;
 	Ogre::uint8 renderQueueID;
 	ClipRect clip;
-	bool isDirty;
+	bool isLayoutDirty;
+	bool needsFullUpdate;
 	bool visibility;
+	bool useSSE;
 
 public:
 	/**
@@ -195,8 +276,10 @@ public:
 	* @param	height	The height of the rectangle, in pixels.
 	* @param	fill	The fill to use.
 	* @param	border	The optional border.
+	*
+	* @return	The element of the rectangle, it stays on the canvas until it is removed or the canvas is cleared.
 	*/
-	void drawRectangle(int x, int y, int width, int height, const Fill& fill, const Border& border = Border());
+	ElementHandle drawRectangle(int x, int y, int width, int height, const Fill& fill, const Border& border = Border());
 
 	/**
 	* Draws a glyph on the canvas.
@@ -207,11 +290,47 @@ public:
 	* @param	width	The width of the rectangle, in pixels.
 	* @param	height	The height of the rectangle, in pixels.
 	* @param	color	The color of the glyph.
+	*
+	* @return	The element of the glyph, it stays on the canvas until it is removed or the canvas is cleared.
+	*/
+	ElementHandle drawGlyph(const GlyphInfo& glyph, int x, int y, int width, int height, const Ogre::ColourValue& color);
+
+	/**
+	* Positions an element: its quads are scaled around the origin of the canvas, then offset. Elements are clipped
+	* when they are drawn, not when they are moved.
+	*
+	* @param	element	The element, as returned by a draw call.
+	* @param	x	The horizontal offset, in pixels.
+	* @param	y	The vertical offset, in pixels.
+	* @param	scale	Optional; the scale of the element.
+	*/
+	void setElementTransform(ElementHandle element, Ogre::Real x, Ogre::Real y, Ogre::Real scale = 1);
+
+	/**
+	* Sets the color of every corner of an element, replacing any gradient.
+	*
+	* @param	element	The element, as returned by a draw call.
+	* @param	color	The new color.
 	*/
-	void drawGlyph(const GlyphInfo& glyph, int x, int y, int width, int height, const Ogre::ColourValue& color);
+	void setElementColor(ElementHandle element, const Ogre::ColourValue& color);
 
 	/**
-	* Clears the canvas.
+	* Shows or hides an element, a hidden element keeps its place in the vertex buffer and in the draw order.
+	*
+	* @param	element	The element, as returned by a draw call.
+	* @param	visible	Whether the element should be rendered.
+	*/
+	void setElementVisible(ElementHandle element, bool visible);
+
+	/**
+	* Removes an element from the canvas, its handle may be returned by a later draw call.
+	*
+	* @param	element	The element, as returned by a draw call.
+	*/
+	void removeElement(ElementHandle element);
+
+	/**
+	* Clears the canvas, removing every element.
 	*/
 	void clear();
 
@@ -230,15 +349,6 @@ public:
 	*/
 	void clearClip();
 
-	// Inherited from Ogre::Renderable
-	const Ogre::MaterialPtr& getMaterial() const;
-	void getRenderOperation(Ogre::RenderOperation& op);
-	void getWorldTransforms(Ogre::Matrix4* xform) const;
-	const Ogre::Quaternion& getWorldOrientation() const;
-	const Ogre::Vector3& getWorldPosition() const;
-	Ogre::Real getSquaredViewDepth(const Ogre::Camera* cam) const;
-	const Ogre::LightList& getLights() const;
-
 	// Inherited from Ogre::MovableObject
 	const Ogre::String& getMovableType() const;
 	const Ogre::AxisAlignedBox& getBoundingBox() const;
@@ -262,15 +372,32 @@ protected:
 
 	void resizeBuffers();
 
-	void localize(Ogre::Vector2& vertex);
-
 	bool isOutsideClip(const PixelRect& rect);
 
-	void drawQuad(const PixelRect& rect, const Ogre::FloatRect& texCoords, const Coloring& coloring);
+	ElementHandle addElement();
+
+	size_t allocate(size_t quadCount);
+
+	void release(size_t firstQuad, size_t quadCount);
 
-	void drawQuad(const Corners<Ogre::Vector2>& corners, const Ogre::FloatRect& texCoords, const Ogre::ColourValue& color);
+	void compact();
+
+	void drawQuad(const PixelRect& rect, const Ogre::FloatRect& texCoords, const Coloring& coloring, size_t page, const Ogre::Vector4* tileRect = 0);
+
+	void drawQuad(const Corners<Ogre::Vector2>& corners, const Ogre::FloatRect& texCoords, const Ogre::ColourValue& color, size_t page);
+
+	void addQuad(const QuadList::Positions& positions, const Ogre::FloatRect& texCoords, const Corners<Ogre::ColourValue>& colors, 
+		size_t page, const Ogre::Vector4* tileRect);
+
+	void resizeQuads(size_t quadCount);
+
+	void updateBatches();
+
+	bool moveWithinBatch(Element& elem);
 
 	void updateGeometry();
+
+	void writeQuads(size_t firstQuad, size_t quadCount, Ogre::uint8* dest);
 };
 
 #endif
\ No newline at end of file
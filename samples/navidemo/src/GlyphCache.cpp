@@ -0,0 +1,472 @@
+/*
+	This file is part of Canvas, a fast, lightweight 2D graphics engine for Ogre3D.
+
+	Copyright (C) 2008 Adam J. Simmons
+	ajs15822@gmail.com
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "GlyphCache.h"
+
+// Transparent pixels kept to the right of and below every glyph
+#define GLYPH_PADDING 1
+
+// Shelves are created in multiples of this height, so that glyphs of similar sizes share them
+#define SHELF_GRANULARITY 4
+
+GlyphCache::GlyphCache(int pageSize, size_t maxPages, size_t firstPage) : pageSize(pageSize), maxPages(maxPages), firstPage(firstPage),
+	glyphCount(0), evictionCount(0)
+{
+}
+
+GlyphCache::~GlyphCache()
+{
+	for(std::map<Ogre::String, Font*>::iterator i = fonts.begin(); i != fonts.end(); i++)
+	{
+		delete i->second->rasterizer;
+		delete i->second;
+	}
+
+	for(std::vector<Page*>::iterator i = pages.begin(); i != pages.end(); i++)
+	{
+		Ogre::MaterialManager::getSingleton().remove((*i)->materialName);
+		Ogre::MaterialManager::getSingleton().remove((*i)->distanceFieldMaterialName);
+		Ogre::TextureManager::getSingleton().remove((*i)->texture->getName());
+		delete *i;
+	}
+}
+
+void GlyphCache::addFont(const Ogre::String& fontFilename, const Ogre::String& resourceGroup, short renderType)
+{
+	if(hasFont(fontFilename))
+		return;
+
+	Ogre::DataStreamPtr stream = Ogre::ResourceGroupManager::getSingleton().openResource(fontFilename, resourceGroup);
+
+	// The rasterizer reads the face straight from memory, the data has to outlive it
+	Font* font = new Font();
+	font->data.resize(stream->size());
+
+	if(!font->data.empty())
+		stream->read(&font->data[0], font->data.size());
+
+	font->rasterizer = new GlyphRasterizer(font->data.empty() ? 0 : &font->data[0], font->data.size(), 
+		FontFaceDefinition::getRenderMode(renderType));
+	font->isDistanceField = renderType == FontFaceDefinition::DistanceField;
+
+	if(!font->rasterizer->getError().empty())
+	{
+		Ogre::String error = font->rasterizer->getError();
+		delete font->rasterizer;
+		delete font;
+
+		OGRE_EXCEPT(Ogre::Exception::ERR_INTERNAL_ERROR, error, "GlyphCache::addFont");
+	}
+
+	fonts[fontFilename] = font;
+}
+
+bool GlyphCache::hasFont(const Ogre::String& fontFilename) const
+{
+	return fonts.find(fontFilename) != fonts.end();
+}
+
+const GlyphInfo* GlyphCache::getGlyphInfo(const Ogre::String& fontFilename, Ogre::uint fontSize, CharCode charCode)
+{
+	std::map<Ogre::String, Font*>::iterator font = fonts.find(fontFilename);
+
+	if(font == fonts.end())
+		return 0;
+
+	GlyphSlots& slots = font->second->sizes[fontSize];
+	GlyphSlots::iterator iter = slots.find(charCode);
+	unsigned long frame = Ogre::Root::getSingleton().getNextFrameNumber();
+
+	if(iter != slots.end())
+	{
+		Glyph& glyph = iter->second;
+
+		// Move it to the front of the usage list
+		if(glyph.hasSlot)
+		{
+			glyph.lastUsedFrame = frame;
+			usage.splice(usage.begin(), usage, glyph.usage);
+		}
+		else if(glyph.isUnplaced && glyph.lastUsedFrame != frame)
+		{
+			glyph.lastUsedFrame = frame;
+			placeGlyph(*font->second, fontSize, glyph);
+		}
+
+		return &glyph.info;
+	}
+
+	Glyph& glyph = slots[charCode];
+	glyph.owner = &slots;
+	glyph.charCode = charCode;
+	glyph.page = 0;
+	glyph.x = glyph.y = glyph.slotWidth = glyph.slotHeight = 0;
+	glyph.lastUsedFrame = frame;
+	glyph.hasSlot = false;
+
+	placeGlyph(*font->second, fontSize, glyph);
+
+	return &glyph.info;
+}
+
+void GlyphCache::placeGlyph(Font& font, Ogre::uint fontSize, Glyph& glyph)
+{
+	RasterizedGlyph bitmap;
+	glyph.isUnplaced = false;
+
+	if(!font.rasterizer->rasterizeGlyph(fontSize, glyph.charCode, bitmap))
+		return;
+
+	glyph.info = GlyphInfo(bitmap.bearingX, bitmap.bearingY, bitmap.advance);
+
+	// Blank glyphs only need their metrics. A glyph that doesn't fit (every slot is in use this frame) keeps an
+	// empty TextureInfo and is tried again the next frame that it is requested.
+	if(bitmap.bitmap && !insert(glyph, bitmap, font.isDistanceField))
+		glyph.isUnplaced = true;
+}
+
+const FontMetrics* GlyphCache::getFontMetrics(const Ogre::String& fontFilename, Ogre::uint fontSize)
+{
+	std::map<Ogre::String, Font*>::iterator font = fonts.find(fontFilename);
+
+	if(font == fonts.end())
+		return 0;
+
+	FontMetricsMap::iterator iter = font->second->metrics.find(fontSize);
+
+	if(iter == font->second->metrics.end())
+	{
+		RasterizedSize size;
+
+		if(!font->second->rasterizer->getSizeMetrics(fontSize, size))
+			size.ascender = size.descender = size.height = size.maxAdvance = 0;
+
+		iter = font->second->metrics.insert(FontMetricsMap::value_type(fontSize, 
+			FontMetrics(size.ascender, size.descender, size.height, size.maxAdvance))).first;
+	}
+
+	return &iter->second;
+}
+
+size_t GlyphCache::getPageCount() const
+{
+	return pages.size();
+}
+
+const Ogre::String& GlyphCache::getMaterialName(size_t page, bool isDistanceField) const
+{
+	return isDistanceField ? pages[page]->distanceFieldMaterialName : pages[page]->materialName;
+}
+
+size_t GlyphCache::getGlyphCount() const
+{
+	return glyphCount;
+}
+
+size_t GlyphCache::getEvictionCount() const
+{
+	return evictionCount;
+}
+
+bool GlyphCache::insert(Glyph& glyph, const RasterizedGlyph& bitmap, bool isDistanceField)
+{
+	// Distance fields are sampled bilinearly, so they need a transparent border on every side. The right and bottom
+	// padding covers the others: whatever lies beyond it belongs to another slot or is left over from an evicted glyph.
+	int border = isDistanceField ? GLYPH_PADDING : 0;
+	int width = bitmap.pitch + border + GLYPH_PADDING;
+	int height = bitmap.rows + border + GLYPH_PADDING;
+
+	if(!allocate(width, height, glyph.page, glyph.x, glyph.y))
+		return false;
+
+	glyph.slotWidth = width;
+	glyph.slotHeight = height;
+	glyph.hasSlot = true;
+	glyph.usage = usage.insert(usage.begin(), &glyph);
+	glyph.info.texInfo = TextureInfo(pageSize, pageSize, glyph.x + border, glyph.y + border, bitmap.pitch, bitmap.rows);
+	glyph.info.texInfo.page = firstPage + glyph.page * 2 + (isDistanceField ? 1 : 0);
+	glyphCount++;
+
+	// Upload the slot (the glyph and its transparent padding) as a white BGRA image with the coverage as alpha
+	uploadBuffer.assign(width * height * 4, 0);
+
+	for(int row = 0; row < bitmap.rows; row++)
+	{
+		Ogre::uint8* dst = &uploadBuffer[((row + border) * width + border) * 4];
+		const unsigned char* src = bitmap.bitmap + row * bitmap.pitch;
+
+		for(int col = 0; col < bitmap.pitch; col++)
+		{
+			*dst++ = 255;
+			*dst++ = 255;
+			*dst++ = 255;
+			*dst++ = src[col];
+		}
+	}
+
+	Ogre::PixelBox pixels(width, height, 1, Ogre::PF_BYTE_BGRA, &uploadBuffer[0]);
+	pages[glyph.page]->texture->getBuffer()->blitFromMemory(pixels, Ogre::Box(glyph.x, glyph.y, glyph.x + width, glyph.y + height));
+
+	return true;
+}
+
+bool GlyphCache::allocate(int width, int height, size_t& page, int& x, int& y)
+{
+	if(width > pageSize || height > pageSize)
+		return false;
+
+	for(page = 0; page < pages.size(); page++)
+		if(allocateOnPage(*pages[page], width, height, x, y))
+			return true;
+
+	if(pages.size() < maxPages)
+	{
+		addPage();
+		page = pages.size() - 1;
+
+		return allocateOnPage(*pages[page], width, height, x, y);
+	}
+
+	// Every page is full, evict the least recently used glyphs until one of their pages has room. Glyphs used
+	// during this frame may still be referenced by quads that are about to be rendered, so those are kept.
+	unsigned long frame = Ogre::Root::getSingleton().getNextFrameNumber();
+
+	while(!usage.empty() && usage.back()->lastUsedFrame != frame)
+	{
+		page = usage.back()->page;
+		evict(usage.back());
+
+		if(allocateOnPage(*pages[page], width, height, x, y))
+			return true;
+	}
+
+	return false;
+}
+
+bool GlyphCache::allocateOnPage(Page& page, int width, int height, int& x, int& y)
+{
+	Shelf* best = 0;
+	int bestSlot = -1;
+
+	// Use the shelf that wastes the least height: one that is at most a quarter taller than the glyph, or an empty one
+	for(std::vector<Shelf>::iterator shelf = page.shelves.begin(); shelf != page.shelves.end(); shelf++)
+	{
+		if(shelf->height < height || (best && shelf->height >= best->height))
+			continue;
+
+		if(shelf->used && shelf->height > height + height / 4 + SHELF_GRANULARITY)
+			continue;
+
+		int slot = -1;
+
+		// Prefer the narrowest released slot that fits, then the room at the end of the shelf
+		for(size_t i = 0; i < shelf->freeSlots.size(); i++)
+			if(shelf->freeSlots[i].second >= width && (slot < 0 || shelf->freeSlots[i].second < shelf->freeSlots[slot].second))
+				slot = (int)i;
+
+		if(slot < 0 && shelf->used + width > pageSize)
+			continue;
+
+		best = &*shelf;
+		bestSlot = slot;
+	}
+
+	if(!best)
+	{
+		int shelfHeight = (height + SHELF_GRANULARITY - 1) / SHELF_GRANULARITY * SHELF_GRANULARITY;
+
+		if(page.usedHeight + shelfHeight > pageSize)
+			shelfHeight = height;
+
+		if(page.usedHeight + shelfHeight > pageSize)
+			return false;
+
+		Shelf shelf;
+		shelf.y = page.usedHeight;
+		shelf.height = shelfHeight;
+		shelf.used = 0;
+		page.shelves.push_back(shelf);
+		page.usedHeight += shelfHeight;
+
+		best = &page.shelves.back();
+	}
+
+	y = best->y;
+
+	if(bestSlot < 0)
+	{
+		x = best->used;
+		best->used += width;
+	}
+	else
+	{
+		std::pair<int, int>& slot = best->freeSlots[bestSlot];
+		x = slot.first;
+
+		if(slot.second > width)
+		{
+			slot.first += width;
+			slot.second -= width;
+		}
+		else
+		{
+			best->freeSlots.erase(best->freeSlots.begin() + bestSlot);
+		}
+	}
+
+	return true;
+}
+
+void GlyphCache::release(Page& page, int x, int y, int width)
+{
+	std::vector<Shelf>::iterator shelf = page.shelves.begin();
+
+	while(shelf != page.shelves.end() && shelf->y != y)
+		shelf++;
+
+	if(shelf == page.shelves.end())
+		return;
+
+	std::vector<std::pair<int, int> >& slots = shelf->freeSlots;
+
+	// Keep the released slots sorted by position and merged with their neighbours
+	std::vector<std::pair<int, int> >::iterator next = slots.begin();
+
+	while(next != slots.end() && next->first < x)
+		next++;
+
+	next = slots.insert(next, std::pair<int, int>(x, width));
+
+	if(next + 1 != slots.end() && next->first + next->second == (next + 1)->first)
+	{
+		next->second += (next + 1)->second;
+		slots.erase(next + 1);
+	}
+
+	if(next != slots.begin() && (next - 1)->first + (next - 1)->second == next->first)
+	{
+		(next - 1)->second += next->second;
+		next = slots.erase(next) - 1;
+	}
+
+	// A slot that reaches the end of the shelf gives its room back to the shelf
+	if(next->first + next->second == shelf->used)
+	{
+		shelf->used = next->first;
+		slots.erase(next);
+	}
+
+	// As do empty shelves at the bottom of the page
+	while(!page.shelves.empty() && !page.shelves.back().used)
+	{
+		page.usedHeight -= page.shelves.back().height;
+		page.shelves.pop_back();
+	}
+}
+
+void GlyphCache::evict(Glyph* glyph)
+{
+	release(*pages[glyph->page], glyph->x, glyph->y, glyph->slotWidth);
+	usage.erase(glyph->usage);
+	glyphCount--;
+	evictionCount++;
+
+	// The metrics are dropped along with the slot, the glyph is simply rasterized again when it is next requested
+	glyph->owner->erase(glyph->charCode);
+}
+
+void GlyphCache::addPage()
+{
+	static unsigned int count = 0;
+	Ogre::String texName = "GlyphCacheTexture_" + Ogre::StringConverter::toString(count);
+
+	Page* page = new Page();
+	page->materialName = "GlyphCacheMaterial_" + Ogre::StringConverter::toString(count);
+	page->distanceFieldMaterialName = "GlyphCacheDistanceFieldMaterial_" + Ogre::StringConverter::toString(count);
+	page->usedHeight = 0;
+	page->texture = Ogre::TextureManager::getSingleton().createManual(
+		texName, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME,
+		Ogre::TEX_TYPE_2D, pageSize, pageSize, 0, Ogre::PF_BYTE_BGRA,
+		Ogre::TU_STATIC_WRITE_ONLY, this);
+
+	clearPage(*page);
+
+	Atlas::createMaterial(page->materialName, texName, false);
+	Atlas::createMaterial(page->distanceFieldMaterialName, texName, true);
+
+	pages.push_back(page);
+	count++;
+
+	Ogre::LogManager::getSingleton().logMessage("GlyphCache: Added page " + Ogre::StringConverter::toString(pages.size()) + " of " + 
+		Ogre::StringConverter::toString(maxPages) + ", " + Ogre::StringConverter::toString(pageSize) + "x" + 
+		Ogre::StringConverter::toString(pageSize) + ".");
+}
+
+void GlyphCache::clearPage(Page& page)
+{
+	Ogre::HardwarePixelBufferSharedPtr pixelBuffer = page.texture->getBuffer();
+	pixelBuffer->lock(Ogre::HardwareBuffer::HBL_DISCARD);
+	const Ogre::PixelBox& pixelBox = pixelBuffer->getCurrentLock();
+	size_t dstPitch = pixelBox.rowPitch * Ogre::PixelUtil::getNumElemBytes(pixelBox.format);
+
+	Ogre::uint8* dstData = static_cast<Ogre::uint8*>(pixelBox.data);
+
+	for(int row = 0; row < pageSize; row++)
+		memset(dstData + row * dstPitch, 0, pageSize * 4);
+
+	pixelBuffer->unlock();
+}
+
+void GlyphCache::loadResource(Ogre::Resource* resource)
+{
+	Ogre::Texture *texture = static_cast<Ogre::Texture*>(resource); 
+
+	texture->setTextureType(Ogre::TEX_TYPE_2D);
+	texture->setWidth(pageSize);
+	texture->setHeight(pageSize);
+	texture->setNumMipmaps(0);
+	texture->setFormat(Ogre::PF_BYTE_BGRA);
+	texture->setUsage(Ogre::TU_STATIC_WRITE_ONLY);
+	texture->createInternalResources();
+
+	size_t page = 0;
+
+	while(page < pages.size() && pages[page]->texture.get() != texture)
+		page++;
+
+	if(page == pages.size())
+		return;
+
+	// The contents are gone, evict the glyphs of the page so that they are rasterized again when next requested
+	clearPage(*pages[page]);
+
+	size_t evictions = evictionCount;
+
+	for(UsageList::iterator i = usage.begin(); i != usage.end();)
+	{
+		Glyph* glyph = *i++;
+
+		if(glyph->page == page)
+			evict(glyph);
+	}
+
+	evictionCount = evictions;
+}
\ No newline at end of file
@@ -0,0 +1,169 @@
+/*
+	This file is part of Canvas, a fast, lightweight 2D graphics engine for Ogre3D.
+
+	Copyright (C) 2008 Adam J. Simmons
+	ajs15822@gmail.com
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef __GlyphCache__
+#define __GlyphCache__
+
+#include "Atlas.h"
+#include <list>
+
+/**
+* A dynamic glyph cache: glyphs are rasterized the first time they are requested and inserted into a texture page,
+* so a font can show any character of its face without declaring it up front.
+*
+* Pages are filled with a shelf allocator (glyphs of similar height share a row), which unlike the skyline packer
+* of the static atlas can release the slot of a single glyph. New pages are added up to a limit, after which the
+* least recently used glyphs are evicted to make room. Glyphs requested during the current frame are never evicted,
+* so text should be requested (and drawn) again every frame that it is shown, as TitleCanvas does.
+*
+* Every page has two materials, one for regular glyphs and one for those of distance-field fonts, so a page accounts
+* for two page numbers (see TextureInfo::page).
+*/
+class GlyphCache : public Ogre::ManualResourceLoader
+{
+public:
+	/**
+	* Creates an empty glyph cache, pages are created when they are first needed.
+	*
+	* @param	pageSize	The width and height of every page, in pixels.
+	* @param	maxPages	The number of pages to fill before glyphs are evicted.
+	* @param	firstPage	The page number (see TextureInfo::page) of the first page of this cache.
+	*/
+	GlyphCache(int pageSize, size_t maxPages, size_t firstPage);
+	~GlyphCache();
+
+	/**
+	* Loads a font-face so that its glyphs can be rasterized on demand, at any size.
+	*
+	* @param	fontFilename	The filename of the font-face.
+	* @param	resourceGroup	The name of the resource group where the font can be found.
+	* @param	renderType	The type of rendering to use, see FontFaceDefinition::RenderType.
+	*/
+	void addFont(const Ogre::String& fontFilename, const Ogre::String& resourceGroup, short renderType);
+
+	/**
+	* Test if a font-face was added with GlyphCache::addFont.
+	*/
+	bool hasFont(const Ogre::String& fontFilename) const;
+
+	/**
+	* Retrieve a glyph, rasterizing and inserting it if it isn't cached yet.
+	*
+	* @return	0 if the font was not added. If the glyph is blank or could not be inserted, the returned
+	*			GlyphInfo's TextureInfo has the member "isEmpty" set to true. A glyph that could not be inserted
+	*			is tried again the next frame that it is requested.
+	*/
+	const GlyphInfo* getGlyphInfo(const Ogre::String& fontFilename, Ogre::uint fontSize, CharCode charCode);
+
+	/**
+	* Retrieve the metrics of a font size.
+	*
+	* @return	0 if the font was not added.
+	*/
+	const FontMetrics* getFontMetrics(const Ogre::String& fontFilename, Ogre::uint fontSize);
+
+	/**
+	* Retrieve the number of pages that have been created so far.
+	*/
+	size_t getPageCount() const;
+
+	/**
+	* Retrieve the name of a material of a page.
+	*
+	* @param	page	The index of the page within this cache, from 0 to GlyphCache::getPageCount - 1.
+	* @param	isDistanceField	Whether to retrieve the material for the glyphs of distance-field fonts.
+	*/
+	const Ogre::String& getMaterialName(size_t page, bool isDistanceField) const;
+
+	/**
+	* Retrieve the number of glyphs that currently occupy a slot.
+	*/
+	size_t getGlyphCount() const;
+
+	/**
+	* Retrieve the number of glyphs that have been evicted to make room for others.
+	*/
+	size_t getEvictionCount() const;
+
+	// Inherited from Ogre::ManualResourceLoader
+	void loadResource(Ogre::Resource* resource);
+
+protected:
+	struct Glyph;
+	typedef std::list<Glyph*> UsageList;
+	typedef std::map<CharCode, Glyph> GlyphSlots;
+
+	struct Glyph
+	{
+		GlyphInfo info;
+		GlyphSlots* owner;
+		CharCode charCode;
+		size_t page;
+		int x, y, slotWidth, slotHeight;
+		unsigned long lastUsedFrame;
+		bool hasSlot;
+		bool isUnplaced;
+		UsageList::iterator usage;
+	};
+
+	struct Font
+	{
+		std::vector<unsigned char> data;
+		GlyphRasterizer* rasterizer;
+		bool isDistanceField;
+		FontMetricsMap metrics;
+		std::map<Ogre::uint, GlyphSlots> sizes;
+	};
+
+	struct Shelf
+	{
+		int y, height, used;
+		std::vector<std::pair<int, int> > freeSlots;
+	};
+
+	struct Page
+	{
+		Ogre::TexturePtr texture;
+		Ogre::String materialName;
+		Ogre::String distanceFieldMaterialName;
+		std::vector<Shelf> shelves;
+		int usedHeight;
+	};
+
+	int pageSize;
+	size_t maxPages, firstPage;
+	std::map<Ogre::String, Font*> fonts;
+	std::vector<Page*> pages;
+	UsageList usage;
+	size_t glyphCount, evictionCount;
+	std::vector<Ogre::uint8> uploadBuffer;
+
+	void placeGlyph(Font& font, Ogre::uint fontSize, Glyph& glyph);
+	bool insert(Glyph& glyph, const RasterizedGlyph& bitmap, bool isDistanceField);
+	bool allocate(int width, int height, size_t& page, int& x, int& y);
+	bool allocateOnPage(Page& page, int width, int height, int& x, int& y);
+	void release(Page& page, int x, int y, int width);
+	void evict(Glyph* glyph);
+	void addPage();
+	void clearPage(Page& page);
+};
+
+#endif
\ No newline at end of file
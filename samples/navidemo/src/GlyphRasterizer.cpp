@@ -0,0 +1,535 @@
+/*
+	This file is part of Canvas, a fast, lightweight 2D graphics engine for Ogre3D.
+
+	Copyright (C) 2008 Adam J. Simmons
+	ajs15822@gmail.com
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "GlyphRasterizer.h"
+#include <windows.h>
+#include <string.h>
+#include <math.h>
+
+// Consecutive char codes are rendered in runs of this many glyphs per task
+#define GLYPHS_PER_TASK 64
+
+struct RasterizerThread
+{
+	static DWORD WINAPI run(LPVOID param)
+	{
+		static_cast<GlyphRasterizer*>(param)->processTasks();
+
+		return 0;
+	}
+};
+
+// Distance fields fade out over this many pixels on either side of the outline
+#define DISTANCE_FIELD_SPREAD 4
+
+// A short piece of the outline, 'half' pixels to either side of its center along its (unit) tangent
+struct EdgeSegment
+{
+	float x, y, tangentX, tangentY, half;
+};
+
+// The coverage of a pixel of 'bitmap' from 0 to 1, pixels beyond its bounds are uncovered
+static inline float getCoverage(const FT_Bitmap& bitmap, int x, int y)
+{
+	if(x < 0 || y < 0 || x >= (int)bitmap.width || y >= (int)bitmap.rows)
+		return 0;
+
+	return bitmap.buffer[y * bitmap.pitch + x] / 255.0f;
+}
+
+// Places the outline within a partly covered pixel, as the straight edge through it that covers 'coverage' of it and
+// runs perpendicular to 'gradientX' and 'gradientY' (of unit length, pointing inwards). Returns the distance of the
+// pixel's center to the edge along the gradient, positive if the center is outside (Gustavson & Strand, 2011).
+static float getEdgeOffset(float gradientX, float gradientY, float coverage)
+{
+	float major = fabs(gradientX), minor = fabs(gradientY);
+
+	if(major < minor)
+	{
+		float swapped = major;
+		major = minor;
+		minor = swapped;
+	}
+
+	float corner = 0.5f * minor / major;
+
+	if(coverage < corner)
+		return 0.5f * (major + minor) - sqrt(2 * major * minor * coverage);
+	else if(coverage < 1 - corner)
+		return (0.5f - coverage) * major;
+
+	return -0.5f * (major + minor) + sqrt(2 * major * minor * (1 - coverage));
+}
+
+// Collects the outline of an anti-aliased glyph as one segment per partly covered pixel, plus one per pixel side where
+// a fully covered pixel meets an uncovered one. Coordinates are in pixels from the top-left of the bitmap.
+static void traceOutline(const FT_Bitmap& bitmap, std::vector<EdgeSegment>& segments)
+{
+	static const int sideX[4] = { 1, -1, 0, 0 };
+	static const int sideY[4] = { 0, 0, 1, -1 };
+	const float diagonal = 1.41421356f;
+
+	for(int y = 0; y < (int)bitmap.rows; y++)
+	{
+		for(int x = 0; x < (int)bitmap.width; x++)
+		{
+			float coverage = getCoverage(bitmap, x, y);
+
+			if(coverage <= 0)
+				continue;
+
+			if(coverage >= 1)
+			{
+				for(int side = 0; side < 4; side++)
+				{
+					if(getCoverage(bitmap, x + sideX[side], y + sideY[side]) <= 0)
+					{
+						EdgeSegment segment = { x + 0.5f + sideX[side] * 0.5f, y + 0.5f + sideY[side] * 0.5f,
+							(float)-sideY[side], (float)sideX[side], 0.5f };
+						segments.push_back(segment);
+					}
+				}
+
+				continue;
+			}
+
+			// The direction of the outline follows from how the coverage changes around the pixel (a Sobel filter)
+			float gradientX = getCoverage(bitmap, x + 1, y - 1) + diagonal * getCoverage(bitmap, x + 1, y) + getCoverage(bitmap, x + 1, y + 1)
+				- getCoverage(bitmap, x - 1, y - 1) - diagonal * getCoverage(bitmap, x - 1, y) - getCoverage(bitmap, x - 1, y + 1);
+			float gradientY = getCoverage(bitmap, x - 1, y + 1) + diagonal * getCoverage(bitmap, x, y + 1) + getCoverage(bitmap, x + 1, y + 1)
+				- getCoverage(bitmap, x - 1, y - 1) - diagonal * getCoverage(bitmap, x, y - 1) - getCoverage(bitmap, x + 1, y - 1);
+			float length = sqrt(gradientX * gradientX + gradientY * gradientY);
+
+			EdgeSegment segment = { x + 0.5f, y + 0.5f, 0, 0, 0 };
+
+			if(length > 1e-6f)
+			{
+				gradientX /= length;
+				gradientY /= length;
+
+				float offset = getEdgeOffset(gradientX, gradientY, coverage);
+
+				segment.x += gradientX * offset;
+				segment.y += gradientY * offset;
+				segment.tangentX = -gradientY;
+				segment.tangentY = gradientX;
+				segment.half = 0.5f;
+			}
+
+			segments.push_back(segment);
+		}
+	}
+}
+
+// Turns an anti-aliased glyph into a distance field of the same resolution, including a border of DISTANCE_FIELD_SPREAD
+// pixels. Fills in the dimensions of 'glyph' and adjusts its metrics.
+static void computeDistanceField(const FT_Bitmap& bitmap, RasterizedGlyph& glyph, std::vector<unsigned char>& field)
+{
+	const int border = DISTANCE_FIELD_SPREAD;
+	const float reach = (float)(DISTANCE_FIELD_SPREAD + 1);
+	int width = bitmap.width + border * 2;
+	int height = bitmap.rows + border * 2;
+
+	std::vector<EdgeSegment> segments;
+	traceOutline(bitmap, segments);
+
+	// Squared distances to the outline, only those within reach of it matter as the field is clamped beyond that
+	std::vector<float> distances(width * height, reach * reach);
+
+	for(size_t i = 0; i < segments.size(); i++)
+	{
+		const EdgeSegment& segment = segments[i];
+		int left = (int)floor(segment.x - reach) + border;
+		int right = (int)ceil(segment.x + reach) + border;
+		int top = (int)floor(segment.y - reach) + border;
+		int bottom = (int)ceil(segment.y + reach) + border;
+
+		left = left < 0 ? 0 : left;
+		right = right > width ? width : right;
+		top = top < 0 ? 0 : top;
+		bottom = bottom > height ? height : bottom;
+
+		for(int y = top; y < bottom; y++)
+		{
+			for(int x = left; x < right; x++)
+			{
+				float deltaX = x - border + 0.5f - segment.x;
+				float deltaY = y - border + 0.5f - segment.y;
+				float along = deltaX * segment.tangentX + deltaY * segment.tangentY;
+				along = along < -segment.half ? -segment.half : (along > segment.half ? segment.half : along);
+				deltaX -= along * segment.tangentX;
+				deltaY -= along * segment.tangentY;
+
+				float& distance = distances[y * width + x];
+				float squared = deltaX * deltaX + deltaY * deltaY;
+
+				if(squared < distance)
+					distance = squared;
+			}
+		}
+	}
+
+	glyph.pitch = width;
+	glyph.rows = height;
+	glyph.bearingX -= DISTANCE_FIELD_SPREAD;
+	glyph.bearingY += DISTANCE_FIELD_SPREAD;
+	field.resize(width * height);
+
+	for(int y = 0; y < height; y++)
+	{
+		for(int x = 0; x < width; x++)
+		{
+			double distance = sqrt(distances[y * width + x]);
+
+			if(getCoverage(bitmap, x - border, y - border) >= 0.5f)
+				distance = -distance;
+
+			double value = 128 - distance * 128 / DISTANCE_FIELD_SPREAD;
+
+			field[y * width + x] = (unsigned char)(value < 0 ? 0 : (value > 255 ? 255 : value));
+		}
+	}
+}
+
+// Loads and renders a glyph with 'face' (whose size must already be set), filling in 'glyph' except for its bitmap.
+// Returns the pixels (the face's bitmap, or 'buffer' for distance fields), or 0 if the glyph failed to render or is blank.
+static const unsigned char* renderGlyph(FT_Face face, FT_UInt glyphIndex, GlyphRasterizer::RenderMode renderMode, RasterizedGlyph& glyph, 
+										std::vector<unsigned char>& buffer, bool& failed)
+{
+	failed = true;
+
+	// Distance fields are scaled anyway, hinting to the pixel grid of one size would only distort them
+	FT_Int32 loadFlags = FT_LOAD_DEFAULT;
+
+	if(renderMode == GlyphRasterizer::LightHinting)
+		loadFlags = FT_LOAD_TARGET_LIGHT;
+	else if(renderMode == GlyphRasterizer::DistanceField)
+		loadFlags = FT_LOAD_NO_HINTING;
+
+	if(FT_Load_Glyph(face, glyphIndex, loadFlags))
+		return 0;
+
+	if(FT_Render_Glyph(face->glyph, renderMode == GlyphRasterizer::LightHinting ? FT_RENDER_MODE_LIGHT : FT_RENDER_MODE_NORMAL))
+		return 0;
+
+	failed = false;
+
+	const FT_Bitmap& bitmap = face->glyph->bitmap;
+	const FT_Glyph_Metrics& metrics = face->glyph->metrics;
+
+	glyph.bearingX = metrics.horiBearingX / 64.0f;
+	glyph.bearingY = metrics.horiBearingY / 64.0f;
+	glyph.advance = metrics.horiAdvance / 64.0f;
+
+	if(!bitmap.buffer || (!bitmap.rows && !bitmap.width))
+		return 0;
+
+	if(renderMode == GlyphRasterizer::DistanceField)
+	{
+		computeDistanceField(bitmap, glyph, buffer);
+
+		return &buffer[0];
+	}
+
+	glyph.pitch = bitmap.pitch;
+	glyph.rows = bitmap.rows;
+
+	return bitmap.buffer;
+}
+
+/************************
+* RasterizedGlyph
+************************/
+
+RasterizedGlyph::RasterizedGlyph() : charCode(0), bearingX(0), bearingY(0), advance(0), pitch(0), rows(0), bitmap(0)
+{
+}
+
+/************************
+* GlyphRasterizer
+************************/
+
+GlyphRasterizer::GlyphRasterizer(const unsigned char* fontData, size_t fontDataSize, RenderMode renderMode)
+	: fontData(fontData), fontDataSize(fontDataSize), renderMode(renderMode), library(0), face(0), 
+	pendingGlyphs(0), nextTask(0), failedTasks(0), threadCount(0), currentSize(0)
+{
+	if(FT_Init_FreeType(&library))
+	{
+		library = 0;
+		error = "Could not load FreeType library.";
+		return;
+	}
+
+	if(FT_New_Memory_Face(library, fontData, (FT_Long)fontDataSize, 0, &face))
+	{
+		face = 0;
+		error = "FreeType could not load a font-face.";
+		return;
+	}
+
+	FT_UInt glyphIndex = 0;
+
+	for(FT_ULong charCode = FT_Get_First_Char(face, &glyphIndex); glyphIndex != 0; charCode = FT_Get_Next_Char(face, charCode, &glyphIndex))
+		charMap.push_back(CharMapEntry(charCode, glyphIndex));
+}
+
+GlyphRasterizer::~GlyphRasterizer()
+{
+	clear();
+
+	if(face)
+		FT_Done_Face(face);
+
+	if(library)
+		FT_Done_FreeType(library);
+}
+
+const std::string& GlyphRasterizer::getError() const
+{
+	return error;
+}
+
+const std::vector<GlyphRasterizer::CharMapEntry>& GlyphRasterizer::getCharMap() const
+{
+	return charMap;
+}
+
+const std::vector<RasterizedSize>& GlyphRasterizer::getSizes() const
+{
+	return sizes;
+}
+
+unsigned int GlyphRasterizer::getThreadCount() const
+{
+	return threadCount;
+}
+
+bool GlyphRasterizer::rasterize(const std::vector<unsigned int>& fontSizes, const std::vector<CharMapEntry>& glyphs, unsigned int threadCount)
+{
+	clear();
+
+	if(!face)
+		return false;
+
+	error.clear();
+	sizes.resize(fontSizes.size());
+	tasks.clear();
+
+	// The global metrics are cheap, get them (and validate every size) up front
+	for(size_t i = 0; i < fontSizes.size(); i++)
+	{
+		RasterizedSize& size = sizes[i];
+
+		if(!getSizeMetrics(fontSizes[i], size))
+		{
+			clear();
+			return false;
+		}
+
+		size.glyphs.resize(glyphs.size());
+
+		for(size_t first = 0; first < glyphs.size(); first += GLYPHS_PER_TASK)
+		{
+			Task task;
+			task.sizeIndex = i;
+			task.firstGlyph = first;
+			task.lastGlyph = first + GLYPHS_PER_TASK < glyphs.size() ? first + GLYPHS_PER_TASK : glyphs.size();
+			tasks.push_back(task);
+		}
+	}
+
+	if(!threadCount)
+	{
+		SYSTEM_INFO systemInfo;
+		GetSystemInfo(&systemInfo);
+		threadCount = systemInfo.dwNumberOfProcessors;
+	}
+
+	if(threadCount > tasks.size())
+		threadCount = (unsigned int)tasks.size();
+
+	this->threadCount = threadCount ? threadCount : 1;
+	pendingGlyphs = &glyphs;
+	nextTask = 0;
+	failedTasks = 0;
+
+	// The calling thread takes part as well
+	std::vector<HANDLE> threads;
+
+	for(unsigned int i = 1; i < this->threadCount; i++)
+	{
+		HANDLE thread = CreateThread(0, 0, &RasterizerThread::run, this, 0, 0);
+
+		// Tasks are shared out as threads ask for them, so the ones that did start simply take on more
+		if(!thread)
+		{
+			this->threadCount = i;
+			break;
+		}
+
+		threads.push_back(thread);
+	}
+
+	processTasks();
+
+	for(std::vector<HANDLE>::iterator i = threads.begin(); i != threads.end(); i++)
+	{
+		WaitForSingleObject(*i, INFINITE);
+		CloseHandle(*i);
+	}
+
+	pendingGlyphs = 0;
+
+	if(failedTasks)
+	{
+		error = "FreeType could not load a font-face or set a font-size.";
+		clear();
+		return false;
+	}
+
+	return true;
+}
+
+void GlyphRasterizer::clear()
+{
+	for(std::vector<RasterizedSize>::iterator i = sizes.begin(); i != sizes.end(); i++)
+		for(std::vector<RasterizedGlyph>::iterator j = i->glyphs.begin(); j != i->glyphs.end(); j++)
+			delete[] j->bitmap;
+
+	sizes.clear();
+}
+
+void GlyphRasterizer::processTasks()
+{
+	FT_Library threadLibrary;
+	FT_Face threadFace;
+
+	// FreeType objects may only be used by one thread at a time, so every thread gets its own
+	if(FT_Init_FreeType(&threadLibrary))
+	{
+		InterlockedIncrement(&failedTasks);
+		return;
+	}
+
+	if(FT_New_Memory_Face(threadLibrary, fontData, (FT_Long)fontDataSize, 0, &threadFace))
+	{
+		FT_Done_FreeType(threadLibrary);
+		InterlockedIncrement(&failedTasks);
+		return;
+	}
+
+	const std::vector<CharMapEntry>& glyphs = *pendingGlyphs;
+	std::vector<unsigned char> buffer;
+	size_t currentSize = (size_t)-1;
+	LONG taskIndex;
+
+	while((taskIndex = InterlockedIncrement(&nextTask) - 1) < (LONG)tasks.size())
+	{
+		const Task& task = tasks[taskIndex];
+		RasterizedSize& size = sizes[task.sizeIndex];
+
+		if(task.sizeIndex != currentSize)
+		{
+			if(FT_Set_Pixel_Sizes(threadFace, 0, (FT_UInt)size.fontSize))
+			{
+				currentSize = (size_t)-1;
+				InterlockedIncrement(&failedTasks);
+				continue;
+			}
+
+			currentSize = task.sizeIndex;
+		}
+
+		for(size_t i = task.firstGlyph; i < task.lastGlyph; i++)
+		{
+			RasterizedGlyph& glyph = size.glyphs[i];
+			glyph.charCode = glyphs[i].first;
+
+			bool failed;
+			const unsigned char* pixels = renderGlyph(threadFace, glyphs[i].second, renderMode, glyph, buffer, failed);
+
+			if(!pixels)
+				continue;
+
+			glyph.bitmap = new unsigned char[glyph.rows * glyph.pitch];
+			memcpy(glyph.bitmap, pixels, glyph.rows * glyph.pitch);
+		}
+	}
+
+	FT_Done_Face(threadFace);
+	FT_Done_FreeType(threadLibrary);
+}
+
+bool GlyphRasterizer::setSize(unsigned int fontSize)
+{
+	if(currentSize == fontSize)
+		return true;
+
+	if(!face || FT_Set_Pixel_Sizes(face, 0, (FT_UInt)fontSize))
+	{
+		currentSize = 0;
+		error = "FreeType could not set a font-size.";
+		return false;
+	}
+
+	currentSize = fontSize;
+	return true;
+}
+
+bool GlyphRasterizer::getSizeMetrics(unsigned int fontSize, RasterizedSize& size)
+{
+	if(!setSize(fontSize))
+		return false;
+
+	size.fontSize = fontSize;
+	size.ascender = face->size->metrics.ascender / 64.0f;
+	size.descender = face->size->metrics.descender / 64.0f;
+	size.height = face->size->metrics.height / 64.0f;
+	size.maxAdvance = face->size->metrics.max_advance / 64.0f;
+
+	return true;
+}
+
+bool GlyphRasterizer::rasterizeGlyph(unsigned int fontSize, unsigned long charCode, RasterizedGlyph& glyph)
+{
+	glyph = RasterizedGlyph();
+	glyph.charCode = charCode;
+
+	if(!setSize(fontSize))
+		return false;
+
+	// Index 0 is the face's 'missing glyph', which is what a char code without a glyph should show
+	bool failed;
+	const unsigned char* pixels = renderGlyph(face, FT_Get_Char_Index(face, charCode), renderMode, glyph, glyphBuffer, failed);
+
+	if(failed)
+		return false;
+
+	if(pixels)
+	{
+		if(glyphBuffer.empty() || pixels != &glyphBuffer[0])
+			glyphBuffer.assign(pixels, pixels + glyph.rows * glyph.pitch);
+
+		glyph.bitmap = &glyphBuffer[0];
+	}
+
+	return true;
+}
\ No newline at end of file
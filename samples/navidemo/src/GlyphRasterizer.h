@@ -0,0 +1,176 @@
+/*
+	This file is part of Canvas, a fast, lightweight 2D graphics engine for Ogre3D.
+
+	Copyright (C) 2008 Adam J. Simmons
+	ajs15822@gmail.com
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef __GlyphRasterizer__
+#define __GlyphRasterizer__
+
+#include <string>
+#include <vector>
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+/**
+* A glyph bitmap rendered by GlyphRasterizer. Metrics are in pixels.
+*/
+struct RasterizedGlyph
+{
+	unsigned long charCode;
+	float bearingX, bearingY, advance;
+	int pitch, rows;
+
+	/// 8-bit coverage, pitch * rows bytes. Owned by the GlyphRasterizer, 0 if the glyph could not be rendered.
+	unsigned char* bitmap;
+
+	RasterizedGlyph();
+};
+
+/**
+* The glyphs and global metrics of one font size, glyphs are in the order of the face's charmap.
+*/
+struct RasterizedSize
+{
+	unsigned int fontSize;
+	float ascender, descender, height, maxAdvance;
+	std::vector<RasterizedGlyph> glyphs;
+};
+
+/**
+* Renders the glyphs of a font-face at several sizes, spread over a number of threads.
+*
+* FreeType objects can't be shared between threads, so each thread loads its own FT_Library and FT_Face from the
+* same (read-only) font data. The work is split into tasks of one size and a run of consecutive char codes; every
+* task writes to its own slots of the output, so the result is identical no matter how many threads are used.
+*/
+class GlyphRasterizer
+{
+public:
+	/// A char code and its glyph index within the face
+	typedef std::pair<unsigned long, unsigned int> CharMapEntry;
+
+	/**
+	* How glyphs are rendered.
+	* <ul>
+	* <li>DefaultHinting - FreeType's default hinting, sharper text.
+	* <li>LightHinting - FreeType's light hinting, smoother shapes.
+	* <li>DistanceField - A signed distance field: alpha is 50% on the outline and fades out over a few pixels on
+	*	either side, so that the glyph can be scaled and thresholded by a shader. Bitmaps get a border of that width.
+	* </ul>
+	*/
+	enum RenderMode
+	{
+		DefaultHinting,
+		LightHinting,
+		DistanceField
+	};
+
+	/**
+	* Loads a font-face.
+	*
+	* @param	fontData	The contents of the font file, they must stay valid for the lifetime of the GlyphRasterizer.
+	* @param	fontDataSize	The size of the font file, in bytes.
+	* @param	renderMode	How glyphs are rendered, see GlyphRasterizer::RenderMode.
+	*/
+	GlyphRasterizer(const unsigned char* fontData, size_t fontDataSize, RenderMode renderMode);
+	~GlyphRasterizer();
+
+	/**
+	* Returns an empty string if the face was loaded (and the last call to GlyphRasterizer::rasterize succeeded),
+	* otherwise a description of the error.
+	*/
+	const std::string& getError() const;
+
+	/**
+	* Retrieve every char code of the face, in the order FreeType enumerates them.
+	*/
+	const std::vector<CharMapEntry>& getCharMap() const;
+
+	/**
+	* Renders a set of glyphs at several sizes.
+	*
+	* @param	sizes	The font sizes, in pixels.
+	* @param	glyphs	The glyphs to render (usually a subset of GlyphRasterizer::getCharMap).
+	* @param	threadCount	The number of threads to use, including the calling one. 0 uses one per processor.
+	*
+	* @return	False if a size could not be set, see GlyphRasterizer::getError.
+	*/
+	bool rasterize(const std::vector<unsigned int>& sizes, const std::vector<CharMapEntry>& glyphs, unsigned int threadCount = 0);
+
+	/**
+	* Retrieve the result of the last call to GlyphRasterizer::rasterize, in the order of its 'sizes'.
+	* Glyphs that FreeType could not render (or that are blank) have a null bitmap.
+	*/
+	const std::vector<RasterizedSize>& getSizes() const;
+
+	/**
+	* Retrieve the number of threads used by the last call to GlyphRasterizer::rasterize.
+	*/
+	unsigned int getThreadCount() const;
+
+	/**
+	* Retrieve the global metrics of a font size, without rendering any glyphs.
+	*
+	* @return	False if the size could not be set, see GlyphRasterizer::getError.
+	*/
+	bool getSizeMetrics(unsigned int fontSize, RasterizedSize& size);
+
+	/**
+	* Renders a single glyph on the calling thread, for glyphs that are needed on demand.
+	*
+	* @param	fontSize	The font size, in pixels.
+	* @param	charCode	The char code to render. Char codes missing from the face render the face's 'missing glyph'.
+	* @param	glyph	Receives the glyph. Its bitmap is owned by the GlyphRasterizer and stays valid until the next call.
+	*
+	* @return	False if the glyph could not be rendered; a blank glyph (like a space) succeeds with a null bitmap.
+	*/
+	bool rasterizeGlyph(unsigned int fontSize, unsigned long charCode, RasterizedGlyph& glyph);
+
+protected:
+	struct Task
+	{
+		size_t sizeIndex;
+		size_t firstGlyph, lastGlyph;
+	};
+
+	const unsigned char* fontData;
+	size_t fontDataSize;
+	RenderMode renderMode;
+	FT_Library library;
+	FT_Face face;
+	std::string error;
+	std::vector<CharMapEntry> charMap;
+	std::vector<RasterizedSize> sizes;
+	const std::vector<CharMapEntry>* pendingGlyphs;
+	std::vector<Task> tasks;
+	volatile long nextTask;
+	volatile long failedTasks;
+	unsigned int threadCount;
+	unsigned int currentSize;
+	std::vector<unsigned char> glyphBuffer;
+
+	void clear();
+	void processTasks();
+	bool setSize(unsigned int fontSize);
+
+	friend struct RasterizerThread;
+};
+
+#endif
\ No newline at end of file
@@ -86,6 +86,7 @@ class NaviDemo : public OIS::MouseListener, public OIS::KeyListener, public Ogre
 	void parseResources();
 	void loadInputSystem();
 	bool isScreenPointOccluded(int x, int y);
+	void checkOcclusion(std::vector<OcclusionQuery>& queries);
 public:
 	bool shouldQuit;
 	NaviDemo();
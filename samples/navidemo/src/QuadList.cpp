@@ -0,0 +1,177 @@
+/*
+	This file is part of Canvas, a fast, lightweight 2D graphics engine for Ogre3D.
+
+	Copyright (C) 2008 Adam J. Simmons
+	ajs15822@gmail.com
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "QuadList.h"
+#include <algorithm>
+#include <assert.h>
+
+#if QUADLIST_HAVE_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace
+{
+	void writeVerticesScalar(const QuadList::Positions* positions, const QuadList::TexCoords* texCoords,
+		const QuadList::Colors* colors, size_t count, const QuadList::Transform& transform, float* dest)
+	{
+		for(size_t q = 0; q < count; q++)
+		{
+			const QuadList::TexCoords& uv = texCoords[q];
+			const float u[4] = { uv.left, uv.right, uv.left, uv.right };
+			const float v[4] = { uv.top, uv.top, uv.bottom, uv.bottom };
+
+			for(int i = 0; i < 4; i++)
+			{
+				dest[0] = positions[q].x[i] * transform.xMul + transform.xAdd;
+				dest[1] = positions[q].y[i] * transform.yMul + transform.yAdd;
+				dest[2] = 0;
+				*(unsigned int*)(dest + 3) = colors[q].corners[i];
+				dest[4] = u[i];
+				dest[5] = v[i];
+				dest += 6;
+			}
+		}
+	}
+
+#if QUADLIST_HAVE_SSE
+	void writeVerticesSSE(const QuadList::Positions* positions, const QuadList::TexCoords* texCoords,
+		const QuadList::Colors* colors, size_t count, const QuadList::Transform& transform, float* dest)
+	{
+		const __m128 xMul = _mm_set1_ps(transform.xMul);
+		const __m128 xAdd = _mm_set1_ps(transform.xAdd);
+		const __m128 yMul = _mm_set1_ps(transform.yMul);
+		const __m128 yAdd = _mm_set1_ps(transform.yAdd);
+		const __m128 zero = _mm_setzero_ps();
+
+		// A quad is 24 floats: every line below is one 16-byte store
+		//	x0 y0 0  c0 | u0 v0 x1 y1 | 0  c1 u1 v1 | x2 y2 0  c2 | u2 v2 x3 y3 | 0  c3 u3 v3
+		for(size_t q = 0; q < count; q++)
+		{
+			__m128 x = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(positions[q].x), xMul), xAdd);
+			__m128 y = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(positions[q].y), yMul), yAdd);
+
+			// Colors are only moved around, never converted, so loading them as floats keeps their bits
+			__m128 c = _mm_loadu_ps((const float*)colors[q].corners);
+			__m128 uv = _mm_loadu_ps(&texCoords[q].left);
+
+			__m128 xyTop = _mm_unpacklo_ps(x, y);				// x0 y0 x1 y1
+			__m128 xyBottom = _mm_unpackhi_ps(x, y);			// x2 y2 x3 y3
+			__m128 zcTop = _mm_unpacklo_ps(zero, c);			// 0  c0 0  c1
+			__m128 zcBottom = _mm_unpackhi_ps(zero, c);			// 0  c2 0  c3
+			__m128 uvTop = _mm_shuffle_ps(uv, uv, _MM_SHUFFLE(1, 2, 1, 0));		// left top right top
+			__m128 uvBottom = _mm_shuffle_ps(uv, uv, _MM_SHUFFLE(3, 2, 3, 0));	// left bottom right bottom
+
+			_mm_storeu_ps(dest + 0, _mm_shuffle_ps(xyTop, zcTop, _MM_SHUFFLE(1, 0, 1, 0)));
+			_mm_storeu_ps(dest + 4, _mm_shuffle_ps(uvTop, xyTop, _MM_SHUFFLE(3, 2, 1, 0)));
+			_mm_storeu_ps(dest + 8, _mm_shuffle_ps(zcTop, uvTop, _MM_SHUFFLE(3, 2, 3, 2)));
+			_mm_storeu_ps(dest + 12, _mm_shuffle_ps(xyBottom, zcBottom, _MM_SHUFFLE(1, 0, 1, 0)));
+			_mm_storeu_ps(dest + 16, _mm_shuffle_ps(uvBottom, xyBottom, _MM_SHUFFLE(3, 2, 1, 0)));
+			_mm_storeu_ps(dest + 20, _mm_shuffle_ps(zcBottom, uvBottom, _MM_SHUFFLE(3, 2, 3, 2)));
+			dest += 24;
+		}
+	}
+#endif
+}
+
+/************************
+* QuadList
+************************/
+
+size_t QuadList::size() const
+{
+	return positions.size();
+}
+
+bool QuadList::empty() const
+{
+	return positions.empty();
+}
+
+void QuadList::resize(size_t count)
+{
+	positions.resize(count);
+	texCoords.resize(count);
+	colors.resize(count);
+}
+
+void QuadList::reserve(size_t count)
+{
+	positions.reserve(count);
+	texCoords.reserve(count);
+	colors.reserve(count);
+}
+
+void QuadList::clear()
+{
+	positions.clear();
+	texCoords.clear();
+	colors.clear();
+}
+
+void QuadList::swap(QuadList& other)
+{
+	positions.swap(other.positions);
+	texCoords.swap(other.texCoords);
+	colors.swap(other.colors);
+}
+
+void QuadList::push_back(const Positions& quadPositions, const TexCoords& quadTexCoords, const Colors& quadColors)
+{
+	positions.push_back(quadPositions);
+	texCoords.push_back(quadTexCoords);
+	colors.push_back(quadColors);
+}
+
+void QuadList::copy(size_t dest, const QuadList& source, size_t first, size_t count)
+{
+	assert(dest + count <= size() && first + count <= source.size());
+
+	std::copy(source.positions.begin() + first, source.positions.begin() + first + count, positions.begin() + dest);
+	std::copy(source.texCoords.begin() + first, source.texCoords.begin() + first + count, texCoords.begin() + dest);
+	std::copy(source.colors.begin() + first, source.colors.begin() + first + count, colors.begin() + dest);
+}
+
+void QuadList::append(const QuadList& source, size_t first, size_t count)
+{
+	assert(first + count <= source.size());
+
+	positions.insert(positions.end(), source.positions.begin() + first, source.positions.begin() + first + count);
+	texCoords.insert(texCoords.end(), source.texCoords.begin() + first, source.texCoords.begin() + first + count);
+	colors.insert(colors.end(), source.colors.begin() + first, source.colors.begin() + first + count);
+}
+
+void QuadList::writeVertices(size_t first, size_t count, const Transform& transform, void* dest, bool useSSE) const
+{
+	if(!count)
+		return;
+
+	assert(first + count <= size());
+
+#if QUADLIST_HAVE_SSE
+	if(useSSE)
+	{
+		writeVerticesSSE(&positions[first], &texCoords[first], &colors[first], count, transform, (float*)dest);
+		return;
+	}
+#endif
+
+	writeVerticesScalar(&positions[first], &texCoords[first], &colors[first], count, transform, (float*)dest);
+}
\ No newline at end of file
@@ -0,0 +1,119 @@
+/*
+	This file is part of Canvas, a fast, lightweight 2D graphics engine for Ogre3D.
+
+	Copyright (C) 2008 Adam J. Simmons
+	ajs15822@gmail.com
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef __QuadList__
+#define __QuadList__
+
+#include <stddef.h>
+#include <vector>
+
+#if defined(__SSE__) || (defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64)))
+#define QUADLIST_HAVE_SSE 1
+#else
+#define QUADLIST_HAVE_SSE 0
+#endif
+
+/**
+* The geometry of a list of 2D quads, stored as a structure of arrays so that their vertices can be written a quad
+* at a time with SSE. Texture coordinates are a rectangle, positions are four corners since a quad may be any
+* shape on screen (the sides of a Canvas border are trapezoids). Colors are already packed in the vertex color
+* format of the render system.
+*
+* Each vertex is a float3 position (z is 0), a packed color and a float2 of texture coordinates. The vertices of a
+* quad are in the order top-left, top-right, bottom-left, bottom-right.
+*/
+class QuadList
+{
+public:
+	/// The corners of a quad, in the order its vertices are written
+	struct Positions
+	{
+		float x[4], y[4];
+	};
+
+	/// The texture coordinates of a quad
+	struct TexCoords
+	{
+		float left, top, right, bottom;
+	};
+
+	/// The packed colors of a quad's corners, in the order its vertices are written
+	struct Colors
+	{
+		unsigned int corners[4];
+	};
+
+	/// Maps positions to the render target: (x * xMul + xAdd, y * yMul + yAdd)
+	struct Transform
+	{
+		float xMul, xAdd, yMul, yAdd;
+	};
+
+	/// The size of a vertex, in bytes
+	static const size_t VERTEX_SIZE = 24;
+
+	std::vector<Positions> positions;
+	std::vector<TexCoords> texCoords;
+	std::vector<Colors> colors;
+
+	size_t size() const;
+
+	bool empty() const;
+
+	void resize(size_t count);
+
+	void reserve(size_t count);
+
+	void clear();
+
+	void swap(QuadList& other);
+
+	void push_back(const Positions& quadPositions, const TexCoords& quadTexCoords, const Colors& quadColors);
+
+	/**
+	* Copies a range of quads from another list over quads of this one.
+	*
+	* @param	dest	The index of the first quad to overwrite, the list must already hold dest + count quads.
+	* @param	source	The list to copy from.
+	* @param	first	The index of the first quad to copy.
+	* @param	count	The number of quads to copy.
+	*/
+	void copy(size_t dest, const QuadList& source, size_t first, size_t count);
+
+	/**
+	* Appends a range of quads from another list.
+	*/
+	void append(const QuadList& source, size_t first, size_t count);
+
+	/**
+	* Writes the vertices of a range of quads, four per quad.
+	*
+	* @param	first	The index of the first quad to write.
+	* @param	count	The number of quads to write.
+	* @param	transform	The transform to apply to every position.
+	* @param	dest	Where to write count * 4 * VERTEX_SIZE bytes, it needn't be aligned.
+	* @param	useSSE	Whether to use SSE, only pass true if the processor supports it. It is ignored when QuadList
+	*					is compiled without SSE. Either way the same vertices are written.
+	*/
+	void writeVertices(size_t first, size_t count, const Transform& transform, void* dest, bool useSSE) const;
+};
+
+#endif
\ No newline at end of file
@@ -26,24 +26,39 @@
 #define HEIGHT_OFFSET 8
 #define BEGIN_RANGE 500
 #define RANGE_LENGTH 400
+// Every title is checked for occlusion once in this many milliseconds
 #define OCCLUSION_CHECK_RATE 500
+// The size that the distance field is rendered at, titles are scaled from it
+#define DISTANCE_FIELD_SIZE 20
+// Titles are drawn around the origin, this keeps them from being clipped
+#define UNCLIPPED_EXTENT 100000
 
 TitleCanvas::TitleCanvas(Ogre::Camera* camera, const std::string& font, Ogre::SceneManager* sceneMgr) : camera(camera), font(font), 
-	occlusionHandler(0), isHidden(false)
+	occlusionHandler(0), occlusionCursor(0), occlusionBudget(0), isHidden(false)
 {
-	FontFaceDefinition titleFont(font);
-	for(unsigned int size = 10 + SIZE_OFFSET; size <= (20 + SIZE_OFFSET); size += 1)
-		titleFont.addSize(size);
+	// A single distance-field size covers every title size
+	FontFaceDefinition titleFont(font, CharCodeRange::BasicLatin, FontFaceDefinition::DistanceField);
+	titleFont.addSize(DISTANCE_FIELD_SIZE);
 
 	std::vector<Ogre::String> textures;
 	std::vector<FontFaceDefinition> fonts;
 	fonts.push_back(titleFont);
 
-	atlas = new Atlas(textures, fonts, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
+	atlas = new Atlas(textures, fonts, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME, "TitleCanvas.atlascache");
+
+	// Characters outside of BasicLatin are rasterized as titles need them
+	atlas->addDynamicFont(font, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME, FontFaceDefinition::DistanceField);
 	canvas = new Canvas(atlas, camera->getViewport());
+	canvas->setClip(-UNCLIPPED_EXTENT, -UNCLIPPED_EXTENT, UNCLIPPED_EXTENT, UNCLIPPED_EXTENT);
 	sceneMgr->getRootSceneNode()->createChildSceneNode()->attachObject(canvas);
 }
 
+void OcclusionHandler::checkOcclusion(std::vector<OcclusionQuery>& queries)
+{
+	for(std::vector<OcclusionQuery>::iterator i = queries.begin(); i != queries.end(); i++)
+		i->isOccluded = isScreenPointOccluded(i->x, i->y);
+}
+
 void TitleCanvas::setOcclusionHandler(OcclusionHandler* handler)
 {
 	occlusionHandler = handler;
@@ -77,6 +92,7 @@ void TitleCanvas::addTitle(Ogre::MovableObject* target, const Ogre::DisplayStrin
 	title.caption = caption;
 	title.color = color;
 	title.isOccluded = false;
+	title.isDrawn = false;
 	titles.push_back(title);
 }
 
@@ -86,6 +102,8 @@ void TitleCanvas::editTitle(Ogre::MovableObject* target, const Ogre::DisplayStri
 	{
 		if(i->target == target)
 		{
+			// Drawn again on the next update
+			eraseTitle(*i);
 			i->caption = caption;
 			i->color = color;
 			break;
@@ -99,6 +117,7 @@ void TitleCanvas::removeTitle(Ogre::MovableObject* target)
 	{
 		if(i->target == target)
 		{
+			eraseTitle(*i);
 			titles.erase(i);
 			break;
 		}
@@ -110,17 +129,31 @@ void TitleCanvas::update()
 	if(isHidden)
 		return;
 
-	static std::vector<Title> visibleTitles;
-	visibleTitles.clear();
+	// The titles take turns: as many are checked for occlusion as are due since the last update, so that each one is
+	// checked once per OCCLUSION_CHECK_RATE without checking them all in the same frame. A long frame counts as a
+	// tenth of that, checking the rest later rather than all at once.
+	size_t occlusionChecks = 0;
 
-	bool isCheckingOcclusion = false;
-	if(timer.getMilliseconds() > OCCLUSION_CHECK_RATE && occlusionHandler)
-		isCheckingOcclusion = true;
+	if(occlusionHandler && !titles.empty())
+	{
+		unsigned long elapsed = std::min(timer.getMicroseconds(), (unsigned long)OCCLUSION_CHECK_RATE * 100);
+		occlusionBudget += titles.size() * elapsed / (OCCLUSION_CHECK_RATE * 1000.0f);
+		occlusionChecks = (size_t)occlusionBudget;
+		occlusionBudget -= occlusionChecks;
+		occlusionCursor %= titles.size();
+	}
+
+	timer.reset();
+	occlusionQueries.clear();
+	queriedTitles.clear();
 
 	for(std::vector<Title>::iterator i = titles.begin(); i != titles.end(); i++)
 	{
 		if(!i->target->isInScene())
+		{
+			hideTitle(*i);
 			continue;
+		}
 
 		// Derive the average point between the top-most corners of the object's bounding box
 		const Ogre::AxisAlignedBox &AABB = i->target->getWorldBoundingBox(true);
@@ -134,52 +167,68 @@ void TitleCanvas::update()
 		i->position.z = camera->getDerivedPosition().distance(point);
 
 		if(i->position.z >= BEGIN_RANGE + RANGE_LENGTH)
+		{
+			hideTitle(*i);
 			continue;
+		}
 
 		// Is the camera facing that point? If not, hide the overlay and return.
 		Ogre::Plane cameraPlane = Ogre::Plane(Ogre::Vector3(camera->getDerivedOrientation().zAxis()), camera->getDerivedPosition());
 		if(cameraPlane.getSide(point) != Ogre::Plane::NEGATIVE_SIDE)
+		{
+			hideTitle(*i);
 			continue;
+		}
 		
 		// Derive the 2D (x,y) screen-space coordinates for that point
 		point = camera->getProjectionMatrix() * (camera->getViewMatrix() * point);
 		Ogre::Real x = (point.x / 2) + 0.5f;
 		Ogre::Real y = 1 - ((point.y / 2) + 0.5f);
 
-		if(x < 0 || x > 1)
-			continue;
-		else if(y < 0 || y > 1)
+		if(x < 0 || x > 1 || y < 0 || y > 1)
+		{
+			hideTitle(*i);
 			continue;
+		}
 
-		if(isCheckingOcclusion)
-			i->isOccluded = occlusionHandler->isScreenPointOccluded(x * camera->getViewport()->getActualWidth(), 
-				y * camera->getViewport()->getActualHeight());
+		size_t index = i - titles.begin();
+
+		// The result is applied once the whole batch has been checked, below
+		if((index + titles.size() - occlusionCursor) % titles.size() < occlusionChecks)
+		{
+			OcclusionQuery query;
+			query.x = (int)(x * camera->getViewport()->getActualWidth());
+			query.y = (int)(y * camera->getViewport()->getActualHeight());
+			query.distance = i->position.z;
+			query.isOccluded = false;
+
+			occlusionQueries.push_back(query);
+			queriedTitles.push_back(index);
+		}
 		
 		if(i->isOccluded)
+		{
+			hideTitle(*i);
 			continue;
+		}
 
 		i->position.x = x;
 		i->position.y = y;
-		
-		visibleTitles.push_back(*i); 
-	}
 
-	canvas->clear();
-
-	for(std::vector<Title>::iterator i = visibleTitles.begin(); i != visibleTitles.end(); i++)
-	{
-		int x = i->position.x * camera->getViewport()->getActualWidth();
-		int y = i->position.y * camera->getViewport()->getActualHeight();
+		// Glyphs rasterized on demand may have been evicted while the title was hidden
+		if(!i->isDrawn || hasEvictedGlyphs(*i))
+		{
+			eraseTitle(*i);
+			drawTitle(*i);
+		}
 
-		// scale [40, 400] to [5, 0]: (-5 / 360)x + (50 / 9) = y
-		Ogre::Real distance = Ogre::Math::Floor((-10 / 360.0)*i->position.z + (100 / 9.0));
+		// scale [40, 400] to [10, 0]: (-10 / 360)x + (100 / 9) = y, the size changes smoothly since glyphs are scaled
+		Ogre::Real distance = (-10 / 360.0)*i->position.z + (100 / 9.0);
 
 		if(distance < 0) distance = 0; 
 		else if(distance > 10) distance = 10;
 
-		Ogre::uint fontSize = distance + 10 + SIZE_OFFSET;
-		Ogre::Real avgAdvance = atlas->getGlyphInfo(font, fontSize, 'x').advance;
-		Ogre::Real pen = x - (i->caption.length() * avgAdvance) / 2;
+		Ogre::Real scale = (distance + 10 + SIZE_OFFSET) / DISTANCE_FIELD_SIZE;
 		
 		Ogre::Real opacity;
 		if(i->position.z <= BEGIN_RANGE)
@@ -189,25 +238,111 @@ void TitleCanvas::update()
 		else
 			opacity = (RANGE_LENGTH - i->position.z + BEGIN_RANGE) / RANGE_LENGTH;
 
-		Ogre::ColourValue col;
+		Ogre::ColourValue col = i->color;
+		col.a = opacity;
+
+		Ogre::Real screenX = x * camera->getViewport()->getActualWidth();
+		Ogre::Real screenY = y * camera->getViewport()->getActualHeight();
+
+		// Elements that didn't change are not written again
+		for(size_t j = 0; j < i->glyphs.size(); j++)
+		{
+			canvas->setElementTransform(i->shadows[j], screenX, screenY, scale);
+			canvas->setElementColor(i->shadows[j], Ogre::ColourValue(0, 0.1, 0.35, 0.5 * opacity));
+			canvas->setElementVisible(i->shadows[j], true);
+
+			canvas->setElementTransform(i->glyphs[j], screenX, screenY, scale);
+			canvas->setElementColor(i->glyphs[j], col);
+			canvas->setElementVisible(i->glyphs[j], true);
+		}
+	}
+
+	occlusionCursor += occlusionChecks;
+
+	if(occlusionQueries.empty())
+		return;
+
+	occlusionHandler->checkOcclusion(occlusionQueries);
+
+	// Titles that were just occluded are hidden now, those that were just revealed are shown on the next update
+	for(size_t j = 0; j < occlusionQueries.size(); j++)
+	{
+		Title& title = titles[queriedTitles[j]];
+		title.isOccluded = occlusionQueries[j].isOccluded;
+
+		if(title.isOccluded)
+			hideTitle(title);
+	}
+}
+
+void TitleCanvas::drawTitle(Title& title)
+{
+	Ogre::Real avgAdvance = atlas->getGlyphInfo(font, DISTANCE_FIELD_SIZE, 'x').advance;
+	Ogre::Real pen = -(title.caption.length() * avgAdvance) / 2;
 
-		for(Ogre::DisplayString::const_iterator j = i->caption.begin(); j != i->caption.end(); j++)
+	for(Ogre::DisplayString::const_iterator j = title.caption.begin(); j != title.caption.end(); j++)
+	{
+		if(*j == ' ')
 		{
-			if(*j == ' ')
-			{
-				pen += avgAdvance;
-				continue;
-			}
-
-			col = i->color;
-			col.a = opacity;
-			GlyphInfo glyph = atlas->getGlyphInfo(font, fontSize, (*j));
-			canvas->drawGlyph(glyph, glyph.bearingX + pen + 1, y - glyph.bearingY + 1, glyph.texInfo.width, glyph.texInfo.height, Ogre::ColourValue(0, 0.1, 0.35, 0.5 * opacity));
-			canvas->drawGlyph(glyph, glyph.bearingX + pen, y - glyph.bearingY, glyph.texInfo.width, glyph.texInfo.height, col);
-			pen += glyph.advance;
+			pen += avgAdvance;
+			continue;
 		}
+
+		// The baseline is at the origin, the colors are set by TitleCanvas::update
+		GlyphInfo glyph = atlas->getGlyphInfo(font, DISTANCE_FIELD_SIZE, (*j));
+		int left = (int)Ogre::Math::Floor(pen + glyph.bearingX);
+		int top = (int)Ogre::Math::Floor(-glyph.bearingY);
+
+		title.shadows.push_back(canvas->drawGlyph(glyph, left + 1, top + 1, glyph.texInfo.width, glyph.texInfo.height, Ogre::ColourValue::ZERO));
+		title.glyphs.push_back(canvas->drawGlyph(glyph, left, top, glyph.texInfo.width, glyph.texInfo.height, Ogre::ColourValue::ZERO));
+		title.textures.push_back(glyph.texInfo);
+		pen += glyph.advance;
+	}
+
+	title.isDrawn = true;
+}
+
+void TitleCanvas::eraseTitle(Title& title)
+{
+	for(size_t j = 0; j < title.glyphs.size(); j++)
+	{
+		canvas->removeElement(title.shadows[j]);
+		canvas->removeElement(title.glyphs[j]);
+	}
+
+	title.shadows.clear();
+	title.glyphs.clear();
+	title.textures.clear();
+	title.isDrawn = false;
+}
+
+void TitleCanvas::hideTitle(Title& title)
+{
+	for(size_t j = 0; j < title.glyphs.size(); j++)
+	{
+		canvas->setElementVisible(title.shadows[j], false);
+		canvas->setElementVisible(title.glyphs[j], false);
+	}
+}
+
+bool TitleCanvas::hasEvictedGlyphs(const Title& title)
+{
+	// Requesting the glyphs also keeps those of the glyph cache from being evicted while the title is shown
+	std::vector<TextureInfo>::const_iterator texture = title.textures.begin();
+
+	for(Ogre::DisplayString::const_iterator j = title.caption.begin(); j != title.caption.end(); j++)
+	{
+		if(*j == ' ')
+			continue;
+
+		const TextureInfo& current = atlas->getGlyphInfo(font, DISTANCE_FIELD_SIZE, (*j)).texInfo;
+
+		if(current.isEmpty != texture->isEmpty || current.page != texture->page || 
+			current.texCoords.left != texture->texCoords.left || current.texCoords.top != texture->texCoords.top)
+			return true;
+
+		texture++;
 	}
 
-	if(isCheckingOcclusion)
-		timer.reset();
+	return false;
 }
\ No newline at end of file
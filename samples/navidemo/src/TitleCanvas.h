@@ -29,12 +29,41 @@
 /**
 * The TitleCanvas is used to render 'titles' above various MovableObjects dynamically, in a single batch.
 * Titles automatically follow their target, are sized based on camera distance, and have slight text-shadows.
+*
+* Every title is drawn once, around the origin of the canvas, and then only moved, scaled and faded.
+*
+* Each title is checked for occlusion twice a second. The checks are spread over the frames in between, a few titles
+* per update, and the titles of an update are passed to the OcclusionHandler as one batch.
 */
 
+/**
+* A point to be tested by OcclusionHandler::checkOcclusion.
+*/
+struct OcclusionQuery
+{
+	/// The point on the screen, in pixels
+	int x, y;
+
+	/// The distance from the camera to the point, only what is nearer can occlude it
+	Ogre::Real distance;
+
+	/// The result, filled in by the handler
+	bool isOccluded;
+};
+
 class OcclusionHandler
 {
 public:
 	virtual bool isScreenPointOccluded(int x, int y) = 0;
+
+	/**
+	* Tests a batch of points for occlusion. TitleCanvas makes one call per update, with the titles whose turn it is.
+	* Handlers should override this to share the work among the points (a broadphase, a readback of the depth
+	* buffer, ...), the default calls OcclusionHandler::isScreenPointOccluded for every point.
+	*
+	* @param	queries	The points to test, OcclusionQuery::isOccluded is set for each of them.
+	*/
+	virtual void checkOcclusion(std::vector<OcclusionQuery>& queries);
 };
 
 class TitleCanvas
@@ -46,6 +75,10 @@ class TitleCanvas
 		Ogre::ColourValue color;
 		Ogre::Vector3 position;
 		bool isOccluded;
+		bool isDrawn;
+		// The shadow and the glyph of every character, and the textures they were drawn with
+		std::vector<ElementHandle> shadows, glyphs;
+		std::vector<TextureInfo> textures;
 	};
 
 	Atlas* atlas;
@@ -54,8 +87,17 @@ class TitleCanvas
 	std::string font;
 	std::vector<Title> titles;
 	OcclusionHandler* occlusionHandler;
+	std::vector<OcclusionQuery> occlusionQueries;
+	std::vector<size_t> queriedTitles;
+	size_t occlusionCursor;
+	Ogre::Real occlusionBudget;
 	Ogre::Timer timer;
 	bool isHidden;
+
+	void drawTitle(Title& title);
+	void eraseTitle(Title& title);
+	void hideTitle(Title& title);
+	bool hasEvictedGlyphs(const Title& title);
 public:
 
 	/**
@@ -23,6 +23,11 @@
 #include "Navi.h"
 #include "NaviUtilities.h"
 #include <OGRE/OgreBitwise.h>
+#include <OGRE/OgrePlatformInformation.h>
+
+#if __OGRE_HAVE_SSE
+#include <emmintrin.h>
+#endif
 
 using namespace Ogre;
 using namespace NaviLibrary;
@@ -64,6 +69,28 @@ Navi::Navi(const std::string& name, unsigned short width, unsigned short height,
 	alwaysReceivesKeyboard = false;
 	hasInternalKeyboardFocus = false;
 	resizeParameters = std::pair<int, int>(0, 0);
+	mipmapMode = NoMipmaps;
+	maxMipRefreshPS = 0;
+	lastMipRefreshTime = 0;
+	mipChain = 0;
+	mipCount = 0;
+	pendingMipBounds.x = pendingMipBounds.y = pendingMipBounds.width = pendingMipBounds.height = 0;
+	lodTarget = 0;
+	lodLevel = maxLODLevel = pendingLODLevel = pendingLODFrames = 0;
+	zoomPercent = 100;
+	stagingSource = 0;
+	stagingSourceWidth = stagingSourceHeight = stagingSourceRowSpan = 0;
+	stagingBuffer = 0;
+	stagingPitch = 0;
+	browserFrames = NaviManager::Get().isThreaded() ? new Impl::FrameTripleBuffer() : 0;
+	statsEnabled = NaviManager::Get().isStatsEnabled();
+	zOrderAbove = zOrderBelow = 0;
+	updateDivisor = updatePhase = 0;
+	lastPacedTime = 0;
+	updatesOnDemand = false;
+	wakeFrameCount = 10;
+	pendingUpdateFrames = 0;
+	recorder = 0;
 
 	createMaterial();
 	
@@ -111,6 +138,28 @@ Navi::Navi(const std::string& name, unsigned short width, unsigned short height,
 	alwaysReceivesKeyboard = false;
 	hasInternalKeyboardFocus = false;
 	resizeParameters = std::pair<int, int>(0, 0);
+	mipmapMode = NoMipmaps;
+	maxMipRefreshPS = 0;
+	lastMipRefreshTime = 0;
+	mipChain = 0;
+	mipCount = 0;
+	pendingMipBounds.x = pendingMipBounds.y = pendingMipBounds.width = pendingMipBounds.height = 0;
+	lodTarget = 0;
+	lodLevel = maxLODLevel = pendingLODLevel = pendingLODFrames = 0;
+	zoomPercent = 100;
+	stagingSource = 0;
+	stagingSourceWidth = stagingSourceHeight = stagingSourceRowSpan = 0;
+	stagingBuffer = 0;
+	stagingPitch = 0;
+	browserFrames = NaviManager::Get().isThreaded() ? new Impl::FrameTripleBuffer() : 0;
+	statsEnabled = NaviManager::Get().isStatsEnabled();
+	zOrderAbove = zOrderBelow = 0;
+	updateDivisor = updatePhase = 0;
+	lastPacedTime = 0;
+	updatesOnDemand = false;
+	wakeFrameCount = 10;
+	pendingUpdateFrames = 0;
+	recorder = 0;
 
 	createMaterial();
 	createWebView(asyncRender, maxAsyncRenderRate);	
@@ -121,8 +170,16 @@ Navi::~Navi()
 	if(alphaCache)
 		delete[] alphaCache;
 
-	if(webView)
-		awe_webview_destroy(webView);
+	if(mipChain)
+		delete[] mipChain;
+
+	destroyWebView();
+
+	if(recorder)
+		delete recorder;
+
+	if(browserFrames)
+		delete browserFrames;
 
 	if(overlay)
 		delete overlay;
@@ -134,12 +191,137 @@ Navi::~Navi()
 
 void Navi::createWebView(bool asyncRender, int maxAsyncRenderRate)
 {
+	// Queued ahead of the call below, the browser thread drops commands for Navis that it doesn't know of
+	NaviManager::Get().addBrowserTarget(this);
+
+	if(NaviManager::Get().sendToBrowser(this, &Navi::createWebView, asyncRender, maxAsyncRenderRate))
+		return;
+
 	webView = awe_webcore_create_webview(naviWidth, naviHeight, false);
 	OSM::WebViewEventHelper::instance().addListener(webView, this);
 	
 	awe_webview_create_object(webView, OSM_STR("Client"));
 
 	bind("drag", NaviDelegate(this, &Navi::onRequestDrag));
+	bind("requestFrame", NaviDelegate(this, &Navi::onRequestFrame));
+
+	if(browserFrames)
+		NaviManager::Get().browserNavis.push_back(this);
+}
+
+void Navi::destroyWebView()
+{
+	if(NaviManager::Get().sendToBrowser(this, &Navi::destroyWebView))
+		return;
+
+	// Any command still queued for this Navi is dropped from here on, it may be deleted before they run
+	std::vector<Navi*>& browserTargets = NaviManager::Get().browserTargets;
+	std::vector<Navi*>::iterator target = std::find(browserTargets.begin(), browserTargets.end(), this);
+
+	if(target != browserTargets.end())
+		browserTargets.erase(target);
+
+	if(!webView)
+		return;
+
+	OSM::WebViewEventHelper::instance().removeListener(webView);
+	awe_webview_destroy(webView);
+	webView = 0;
+
+	std::vector<Navi*>& browserNavis = NaviManager::Get().browserNavis;
+	std::vector<Navi*>::iterator i = std::find(browserNavis.begin(), browserNavis.end(), this);
+
+	if(i != browserNavis.end())
+		browserNavis.erase(i);
+}
+
+void Navi::renderFrame()
+{
+	if(!webView || (updatesOnDemand && pendingUpdateFrames <= 0) || !awe_webview_is_dirty(webView))
+		return;
+
+	NAVI_TRACE_SCOPE_DETAIL("Navi::renderFrame", naviName.c_str());
+
+	unsigned long long timestamp = 0;
+
+	NAVI_STATS(statsEnabled, timestamp = Impl::getTimestampUS())
+	const awe_renderbuffer* renderBuffer = awe_webview_render(webView);
+	NAVI_STATS(statsEnabled, stats.renderTime += Impl::getTimestampUS() - timestamp)
+
+	if(renderBuffer)
+		publishFrame(renderBuffer);
+}
+
+void Navi::publishFrame(const awe_renderbuffer* renderBuffer)
+{
+	Impl::Frame& frame = browserFrames->getBackFrame(awe_renderbuffer_get_width(renderBuffer), 
+		awe_renderbuffer_get_height(renderBuffer));
+
+	awe_renderbuffer_copy_to(renderBuffer, frame.buffer, frame.rowSpan, 4, false, false);
+
+	browserFrames->publish();
+}
+
+void Navi::focusWebView(bool isFocused)
+{
+	if(NaviManager::Get().deferToBrowser(this, &Navi::focusWebView, isFocused))
+		return;
+
+	if(webView)
+	{
+		if(isFocused)
+			awe_webview_focus(webView);
+		else
+			awe_webview_unfocus(webView);
+	}
+}
+
+void Navi::injectKeyboardEvent(UINT msg, WPARAM wParam, LPARAM lParam)
+{
+	if(NaviManager::Get().deferToBrowser(this, &Navi::injectKeyboardEvent, msg, wParam, lParam))
+		return;
+
+	wakeUpdates();
+
+	if(webView)
+		awe_webview_inject_keyboard_event_win(webView, msg, wParam, lParam);
+}
+
+void Navi::resizeWebView(int width, int height, int zoom)
+{
+	if(NaviManager::Get().deferToBrowser(this, &Navi::resizeWebView, width, height, zoom))
+		return;
+
+	if(!webView)
+		return;
+
+	awe_webview_resize(webView, width, height, false, 0);
+
+	if(zoom)
+		awe_webview_set_zoom(webView, zoom);
+}
+
+void Navi::setWebViewTransparent(bool isTransparent)
+{
+	if(NaviManager::Get().deferToBrowser(this, &Navi::setWebViewTransparent, isTransparent))
+		return;
+
+	if(webView)
+		awe_webview_set_transparent(webView, isTransparent);
+}
+
+void Navi::applyZoom(int zoom)
+{
+	if(NaviManager::Get().deferToBrowser(this, &Navi::applyZoom, zoom))
+		return;
+
+	if(!webView)
+		return;
+
+	if(zoom)
+		awe_webview_set_zoom(webView, zoom);
+	else
+		awe_webview_reset_zoom(webView);
 }
 
 void Navi::createMaterial()
@@ -162,11 +344,47 @@ void Navi::createMaterial()
 		}
 	}
 
-	// Create the texture
+	MaterialPtr material = MaterialManager::getSingleton().create(naviName + "Material", 
+		ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
+	matPass = material->getTechnique(0)->getPass(0);
+	matPass->setSceneBlending(SBT_TRANSPARENT_ALPHA);
+	matPass->setDepthWriteEnabled(false);
+
+	createTexture();
+}
+
+void Navi::createTexture()
+{
+	int numMipmaps = 0;
+	int usage = TU_DYNAMIC_WRITE_ONLY_DISCARDABLE;
+
+	if(mipChain)
+	{
+		delete[] mipChain;
+		mipChain = 0;
+	}
+
+	mipCount = 0;
+
+	if(mipmapMode == HardwareMipmaps)
+	{
+		numMipmaps = MIP_UNLIMITED;
+		usage |= TU_AUTOMIPMAP;
+	}
+	else if(mipmapMode == SoftwareMipmaps)
+	{
+		for(unsigned short size = std::max(texWidth, texHeight); size > 1; size >>= 1)
+			mipCount++;
+
+		numMipmaps = mipCount;
+		// Levels are only partially updated so the contents must survive between locks
+		usage = TU_DYNAMIC_WRITE_ONLY;
+	}
+
 	TexturePtr texture = TextureManager::getSingleton().createManual(
 		naviName + "Texture", ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME,
-		TEX_TYPE_2D, texWidth, texHeight, 0, PF_BYTE_BGRA,
-		TU_DYNAMIC_WRITE_ONLY_DISCARDABLE, this);
+		TEX_TYPE_2D, texWidth, texHeight, numMipmaps, PF_BYTE_BGRA,
+		usage, this);
 
 	HardwarePixelBufferSharedPtr pixelBuffer = texture->getBuffer();
 	pixelBuffer->lock(HardwareBuffer::HBL_DISCARD);
@@ -180,19 +398,56 @@ void Navi::createMaterial()
 
 	pixelBuffer->unlock();
 
-	MaterialPtr material = MaterialManager::getSingleton().create(naviName + "Material", 
-		ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
-	matPass = material->getTechnique(0)->getPass(0);
-	matPass->setSceneBlending(SBT_TRANSPARENT_ALPHA);
-	matPass->setDepthWriteEnabled(false);
+	if(mipmapMode == SoftwareMipmaps)
+	{
+		size_t chainSize = 0;
+		for(unsigned short level = 0; level <= mipCount; level++)
+			chainSize += std::max(texWidth >> level, 1) * std::max(texHeight >> level, 1) * 4;
+
+		mipChain = new unsigned char[chainSize];
+		memset(mipChain, 128, chainSize);
+
+		unsigned char* levelData = mipChain + texWidth * texHeight * 4;
+		for(unsigned short level = 1; level <= mipCount; level++)
+		{
+			size_t levelWidth = std::max(texWidth >> level, 1);
+			size_t levelHeight = std::max(texHeight >> level, 1);
+
+			texture->getBuffer(0, level)->blitFromMemory(PixelBox(levelWidth, levelHeight, 1, PF_BYTE_BGRA, levelData));
+			levelData += levelWidth * levelHeight * 4;
+		}
+	}
+
+	pendingMipBounds.x = pendingMipBounds.y = pendingMipBounds.width = pendingMipBounds.height = 0;
 
 	baseTexUnit = matPass->createTextureUnitState(naviName + "Texture");
 	
-	baseTexUnit->setTextureFiltering(texFiltering, texFiltering, FO_NONE);
+	baseTexUnit->setTextureFiltering(texFiltering, texFiltering, mipmapMode == NoMipmaps ? FO_NONE : FO_LINEAR);
 	if(texFiltering == FO_ANISOTROPIC)
 		baseTexUnit->setTextureAnisotropy(4);
 }
 
+void Navi::recreateTexture()
+{
+	matPass->removeAllTextureUnitStates();
+	maskTexUnit = 0;
+
+	Ogre::TextureManager::getSingleton().remove(naviName + "Texture");
+
+	createTexture();
+
+	if(usingMask)
+	{
+		setMask(maskImageParameters.first, maskImageParameters.second);
+	}
+	else if(alphaCache)
+	{
+		delete[] alphaCache;
+		alphaCache = new unsigned char[texWidth * texHeight];
+		alphaCachePitch = texWidth;
+	}
+}
+
 // This is for when the rendering device has a hiccup and loses the dynamic texture
 void Navi::loadResource(Resource* resource)
 {
@@ -201,9 +456,24 @@ void Navi::loadResource(Resource* resource)
 	tex->setTextureType(TEX_TYPE_2D);
 	tex->setWidth(texWidth);
 	tex->setHeight(texHeight);
-	tex->setNumMipmaps(0);
 	tex->setFormat(PF_BYTE_BGRA);
-	tex->setUsage(TU_DYNAMIC_WRITE_ONLY_DISCARDABLE);
+
+	if(mipmapMode == HardwareMipmaps)
+	{
+		tex->setNumMipmaps(MIP_UNLIMITED);
+		tex->setUsage(TU_DYNAMIC_WRITE_ONLY_DISCARDABLE | TU_AUTOMIPMAP);
+	}
+	else if(mipmapMode == SoftwareMipmaps)
+	{
+		tex->setNumMipmaps(mipCount);
+		tex->setUsage(TU_DYNAMIC_WRITE_ONLY);
+	}
+	else
+	{
+		tex->setNumMipmaps(0);
+		tex->setUsage(TU_DYNAMIC_WRITE_ONLY_DISCARDABLE);
+	}
+
 	tex->createInternalResources();
 
 	needsForceRender = true;
@@ -214,15 +484,36 @@ void Navi::loadResource(Resource* resource)
 
 void Navi::update()
 {
-	if(!webView)
+	if(!prepareUpdate())
 		return;
 
+	unsigned long long timestamp = 0;
+
+	NAVI_STATS(statsEnabled, timestamp = Impl::getTimestampUS())
+	copyRows(0, texHeight);
+	NAVI_STATS(statsEnabled, stats.copyTime += Impl::getTimestampUS() - timestamp; timestamp = Impl::getTimestampUS())
+	extractAlphaRows(0, texHeight);
+	NAVI_STATS(statsEnabled, stats.alphaCacheTime += Impl::getTimestampUS() - timestamp)
+
+	finishUpdate();
+}
+
+bool Navi::prepareUpdate()
+{
+	if(!webView)
+		return false;
+
+	NAVI_TRACE_SCOPE_DETAIL("Navi::prepareUpdate", naviName.c_str());
+
 	resizeIfNeeded();
 
+	NAVI_STATS(statsEnabled, stats.updatesAttempted++)
+
 	if(maxUpdatePS)
 		if(timer.getMilliseconds() - lastUpdateTime < 1000 / maxUpdatePS)
-			return;
+			return false;
 
+	consumeUpdateRequest();
 	updateFade();
 
 	if(usingMask)
@@ -232,35 +523,290 @@ void Navi::update()
 	else
 		baseTexUnit->setAlphaOperation(LBX_SOURCE1, LBS_MANUAL, LBS_CURRENT, static_cast<Ogre::Real>(fadeValue * opacity));
 
-	if(!needsForceRender)
-		if(!awe_webview_is_dirty(webView))
-			return;
+	if(browserFrames)
+	{
+		// The browser thread renders the pages, just pick up the newest finished frame
+		bool hasNewFrame = browserFrames->acquire();
 
-	TexturePtr texture = TextureManager::getSingleton().getByName(naviName + "Texture");
-	
-	HardwarePixelBufferSharedPtr pixelBuffer = texture->getBuffer();
-	pixelBuffer->lock(HardwareBuffer::HBL_DISCARD);
-	const PixelBox& pixelBox = pixelBuffer->getCurrentLock();
+		if(!hasNewFrame && !needsForceRender)
+		{
+			if(mipmapMode == SoftwareMipmaps)
+				updateMipmaps(false);
 
-	uint8* destBuffer = static_cast<uint8*>(pixelBox.data);
+			return false;
+		}
 
-	const awe_renderbuffer* renderBuffer = awe_webview_render(webView);
+		NAVI_STATS(statsEnabled, if(hasNewFrame) stats.dirtyFrames++)
+
+		const Impl::Frame& frame = browserFrames->getFrontFrame();
+
+		if(!frame.buffer)
+			return false;
+
+		// Dirty regions of frames that were skipped over aren't tracked, so refresh everything
+		stagingDirtyBounds.x = stagingDirtyBounds.y = 0;
+		stagingDirtyBounds.width = texWidth;
+		stagingDirtyBounds.height = texHeight;
+		stagingSource = frame.buffer;
+		stagingSourceWidth = frame.width;
+		stagingSourceHeight = frame.height;
+		stagingSourceRowSpan = frame.rowSpan;
+	}
+	else
+	{
+		bool isDirty = awe_webview_is_dirty(webView);
+
+		if(!isDirty && !needsForceRender)
+		{
+			if(mipmapMode == SoftwareMipmaps)
+				updateMipmaps(false);
+
+			return false;
+		}
+
+		NAVI_STATS(statsEnabled, if(isDirty) stats.dirtyFrames++)
+
+		stagingDirtyBounds = awe_webview_get_dirty_bounds(webView);
+
+		if(needsForceRender)
+		{
+			stagingDirtyBounds.x = stagingDirtyBounds.y = 0;
+			stagingDirtyBounds.width = texWidth;
+			stagingDirtyBounds.height = texHeight;
+		}
+
+		unsigned long long timestamp = 0;
+
+		NAVI_STATS(statsEnabled, timestamp = Impl::getTimestampUS())
+		const awe_renderbuffer* renderBuffer = awe_webview_render(webView);
+		NAVI_STATS(statsEnabled, stats.renderTime += Impl::getTimestampUS() - timestamp)
+
+		if(!renderBuffer)
+			return false;
+
+		stagingSource = awe_renderbuffer_get_buffer(renderBuffer);
+		stagingSourceWidth = awe_renderbuffer_get_width(renderBuffer);
+		stagingSourceHeight = awe_renderbuffer_get_height(renderBuffer);
+		stagingSourceRowSpan = awe_renderbuffer_get_rowspan(renderBuffer);
+	}
+
+	if(mipmapMode == SoftwareMipmaps)
+	{
+		stagingBuffer = mipChain;
+		stagingPitch = texWidth * 4;
+	}
+	else
+	{
+		TexturePtr texture = TextureManager::getSingleton().getByName(naviName + "Texture");
+		
+		HardwarePixelBufferSharedPtr pixelBuffer = texture->getBuffer();
+		pixelBuffer->lock(HardwareBuffer::HBL_DISCARD);
+		const PixelBox& pixelBox = pixelBuffer->getCurrentLock();
+
+		stagingBuffer = static_cast<uint8*>(pixelBox.data);
+		stagingPitch = texPitch;
+	}
 
-	awe_renderbuffer_copy_to(renderBuffer, destBuffer, texPitch, texDepth, false, false);
+	NAVI_STATS(statsEnabled, stats.updatesPerformed++)
+
+	return true;
+}
+
+void Navi::copyRows(int startRow, int endRow)
+{
+	if(!stagingBuffer || !stagingSource)
+		return;
+
+	int copyHeight = std::min(std::min(stagingSourceHeight, (int)texHeight), endRow);
+	size_t copyWidth = std::min(stagingSourceWidth, (int)texWidth) * 4;
+
+	for(int row = startRow; row < copyHeight; row++)
+		memcpy(stagingBuffer + row * stagingPitch, stagingSource + row * stagingSourceRowSpan, copyWidth);
+}
+
+void Navi::extractAlphaRows(int startRow, int endRow)
+{
+	if(!stagingBuffer || !stagingSource)
+		return;
 
 	if(isWebViewTransparent && !usingMask && ignoringTrans)
 	{
-		for(int row = 0; row < texHeight; row++)
+		endRow = std::min(endRow, (int)texHeight);
+
+		for(int row = startRow; row < endRow; row++)
 			for(int col = 0; col < texWidth; col++)
-				alphaCache[row * alphaCachePitch + col] = destBuffer[row * texPitch + col * 4 + 3];
+				alphaCache[row * alphaCachePitch + col] = stagingBuffer[row * stagingPitch + col * 4 + 3];
 	}
+}
 
-	pixelBuffer->unlock();
+void Navi::finishUpdate()
+{
+	if(!stagingBuffer)
+		return;
+
+	NAVI_TRACE_SCOPE_DETAIL("Navi::finishUpdate", naviName.c_str());
+
+	TexturePtr texture = TextureManager::getSingleton().getByName(naviName + "Texture");
+
+	if(mipmapMode == SoftwareMipmaps)
+	{
+		int left = std::max(stagingDirtyBounds.x, 0);
+		int top = std::max(stagingDirtyBounds.y, 0);
+		int right = std::min(stagingDirtyBounds.x + stagingDirtyBounds.width, (int)texWidth);
+		int bottom = std::min(stagingDirtyBounds.y + stagingDirtyBounds.height, (int)texHeight);
+
+		if(right > left && bottom > top)
+		{
+			PixelBox levelBox(texWidth, texHeight, 1, PF_BYTE_BGRA, mipChain);
+			Box dirtyBox(left, top, right, bottom);
+
+			texture->getBuffer()->blitFromMemory(levelBox.getSubVolume(dirtyBox), dirtyBox);
+			NAVI_STATS(statsEnabled, stats.bytesUploaded += (right - left) * (bottom - top) * 4)
+
+			if(pendingMipBounds.width)
+			{
+				int pendingRight = pendingMipBounds.x + pendingMipBounds.width;
+				int pendingBottom = pendingMipBounds.y + pendingMipBounds.height;
+
+				left = std::min(left, pendingMipBounds.x);
+				top = std::min(top, pendingMipBounds.y);
+				right = std::max(right, pendingRight);
+				bottom = std::max(bottom, pendingBottom);
+			}
+
+			pendingMipBounds.x = left;
+			pendingMipBounds.y = top;
+			pendingMipBounds.width = right - left;
+			pendingMipBounds.height = bottom - top;
+		}
+
+		updateMipmaps(needsForceRender);
+	}
+	else
+	{
+		// With HardwareMipmaps the chain is regenerated by the render system when the level is unlocked
+		texture->getBuffer()->unlock();
+		NAVI_STATS(statsEnabled, if(stagingSource) stats.bytesUploaded += 
+			std::min(stagingSourceWidth, (int)texWidth) * 4 * std::min(stagingSourceHeight, (int)texHeight))
+	}
+
+	if(recorder)
+		recorder->submit(stagingSource, stagingSourceWidth, stagingSourceHeight, stagingSourceRowSpan);
+
+	stagingBuffer = 0;
+	stagingSource = 0;
 
 	lastUpdateTime = timer.getMilliseconds();
 	needsForceRender = false;
 }
 
+namespace
+{
+	const int MIP_TILE_SIZE = 32;
+	const Ogre::Real LOD_HYSTERESIS = 0.15f;
+	const unsigned short LOD_REFINE_FRAMES = 3;
+	const unsigned short LOD_COARSEN_FRAMES = 30;
+
+	int scaleForLOD(int size, unsigned short level)
+	{
+		return std::max((size + (1 << level) - 1) >> level, 1);
+	}
+
+	// Box-filters the region [left, right) x [top, bottom) of a BGRA mip level from the level above it.
+	// Odd source dimensions are handled by clamping the second sample to the last row/column.
+	void downsampleRegion(const unsigned char* src, int srcWidth, int srcHeight, unsigned char* dest, int destWidth,
+		int left, int top, int right, int bottom)
+	{
+#if __OGRE_HAVE_SSE
+		static const bool hasSSE2 = (PlatformInformation::getCpuFeatures() & PlatformInformation::CPU_FEATURE_SSE2) != 0;
+#endif
+
+		for(int y = top; y < bottom; y++)
+		{
+			const unsigned char* row0 = src + std::min(y * 2, srcHeight - 1) * srcWidth * 4;
+			const unsigned char* row1 = src + std::min(y * 2 + 1, srcHeight - 1) * srcWidth * 4;
+			unsigned char* destRow = dest + y * destWidth * 4;
+			int x = left;
+
+#if __OGRE_HAVE_SSE
+			if(hasSSE2)
+			{
+				// Four destination pixels per iteration: average the two source rows, then the even/odd columns
+				for(; x + 4 <= right && (x + 3) * 2 + 1 < srcWidth; x += 4)
+				{
+					__m128i lo = _mm_avg_epu8(_mm_loadu_si128((const __m128i*)(row0 + x * 8)), 
+						_mm_loadu_si128((const __m128i*)(row1 + x * 8)));
+					__m128i hi = _mm_avg_epu8(_mm_loadu_si128((const __m128i*)(row0 + x * 8 + 16)), 
+						_mm_loadu_si128((const __m128i*)(row1 + x * 8 + 16)));
+
+					__m128i even = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(lo), _mm_castsi128_ps(hi), _MM_SHUFFLE(2, 0, 2, 0)));
+					__m128i odd = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(lo), _mm_castsi128_ps(hi), _MM_SHUFFLE(3, 1, 3, 1)));
+
+					_mm_storeu_si128((__m128i*)(destRow + x * 4), _mm_avg_epu8(even, odd));
+				}
+			}
+#endif
+
+			for(; x < right; x++)
+			{
+				int col0 = std::min(x * 2, srcWidth - 1) * 4;
+				int col1 = std::min(x * 2 + 1, srcWidth - 1) * 4;
+
+				for(int channel = 0; channel < 4; channel++)
+					destRow[x * 4 + channel] = (unsigned char)((row0[col0 + channel] + row0[col1 + channel] + 
+						row1[col0 + channel] + row1[col1 + channel] + 2) >> 2);
+			}
+		}
+	}
+}
+
+void Navi::updateMipmaps(bool forceRefresh)
+{
+	if(!mipChain || !pendingMipBounds.width || !pendingMipBounds.height)
+		return;
+
+	if(maxMipRefreshPS && !forceRefresh)
+		if(timer.getMilliseconds() - lastMipRefreshTime < 1000 / maxMipRefreshPS)
+			return;
+
+	// Expand the accumulated dirty region to whole tiles so that lower levels are refreshed in aligned blocks
+	int left = (pendingMipBounds.x / MIP_TILE_SIZE) * MIP_TILE_SIZE;
+	int top = (pendingMipBounds.y / MIP_TILE_SIZE) * MIP_TILE_SIZE;
+	int right = std::min(((pendingMipBounds.x + pendingMipBounds.width + MIP_TILE_SIZE - 1) / MIP_TILE_SIZE) * MIP_TILE_SIZE, (int)texWidth);
+	int bottom = std::min(((pendingMipBounds.y + pendingMipBounds.height + MIP_TILE_SIZE - 1) / MIP_TILE_SIZE) * MIP_TILE_SIZE, (int)texHeight);
+
+	TexturePtr texture = TextureManager::getSingleton().getByName(naviName + "Texture");
+
+	unsigned char* srcLevel = mipChain;
+	int srcWidth = texWidth;
+	int srcHeight = texHeight;
+
+	for(unsigned short level = 1; level <= mipCount; level++)
+	{
+		unsigned char* destLevel = srcLevel + srcWidth * srcHeight * 4;
+		int destWidth = std::max(srcWidth >> 1, 1);
+		int destHeight = std::max(srcHeight >> 1, 1);
+
+		left = left >> 1;
+		top = top >> 1;
+		right = std::min((right + 1) >> 1, destWidth);
+		bottom = std::min((bottom + 1) >> 1, destHeight);
+
+		downsampleRegion(srcLevel, srcWidth, srcHeight, destLevel, destWidth, left, top, right, bottom);
+
+		Box dirtyBox(left, top, right, bottom);
+		texture->getBuffer(0, level)->blitFromMemory(PixelBox(destWidth, destHeight, 1, PF_BYTE_BGRA, destLevel).getSubVolume(dirtyBox), dirtyBox);
+		NAVI_STATS(statsEnabled, stats.bytesUploaded += (right - left) * (bottom - top) * 4)
+
+		srcLevel = destLevel;
+		srcWidth = destWidth;
+		srcHeight = destHeight;
+	}
+
+	pendingMipBounds.x = pendingMipBounds.y = pendingMipBounds.width = pendingMipBounds.height = 0;
+	lastMipRefreshTime = timer.getMilliseconds();
+}
+
 void Navi::updateFade()
 {
 	if(isFading)
@@ -320,60 +866,128 @@ void Navi::resizeIfNeeded()
 			newTexWidth = Bitwise::firstPO2From(naviWidth);
 			newTexHeight = Bitwise::firstPO2From(naviHeight);
 		}
-	}
+	}
+
+	if(overlay)
+	{
+		overlay->resize(naviWidth, naviHeight);
+		overlay->panel->setUV(0, 0, (Real)naviWidth/newTexWidth, (Real)naviHeight/newTexHeight);	
+	}
+
+	resizeWebView(scaleForLOD(naviWidth, lodLevel), scaleForLOD(naviHeight, lodLevel), 0);
+
+	newTexWidth = scaleForLOD(newTexWidth, lodLevel);
+	newTexHeight = scaleForLOD(newTexHeight, lodLevel);
+
+	if(newTexWidth == texWidth && newTexHeight == texHeight)
+		return;
+
+	texWidth = newTexWidth;
+	texHeight = newTexHeight;
+
+	recreateTexture();
+}
+
+void Navi::updateLOD(Camera* camera, Viewport* viewport)
+{
+	if(!lodTarget || !webView)
+		return;
+
+	unsigned short desiredLevel = lodLevel;
+	const AxisAlignedBox& bounds = lodTarget->getWorldBoundingBox(true);
+
+	if(!lodTarget->isVisible() || !camera->isVisible(bounds))
+	{
+		desiredLevel = maxLODLevel;
+	}
+	else
+	{
+		const Vector3* corners = bounds.getAllCorners();
+		Matrix4 viewProj = camera->getProjectionMatrix() * camera->getViewMatrix();
+		Real minX = 1, minY = 1, maxX = -1, maxY = -1;
+		Real coverage = 1;
+		bool isBehindCamera = false;
+
+		for(int i = 0; i < 8 && !isBehindCamera; i++)
+		{
+			Vector4 projected = viewProj * Vector4(corners[i].x, corners[i].y, corners[i].z, 1);
+
+			if(projected.w <= 0)
+			{
+				isBehindCamera = true;
+				break;
+			}
+
+			minX = std::min(minX, projected.x / projected.w);
+			minY = std::min(minY, projected.y / projected.w);
+			maxX = std::max(maxX, projected.x / projected.w);
+			maxY = std::max(maxY, projected.y / projected.w);
+		}
+
+		// A target that straddles the camera plane is close enough to warrant full resolution
+		if(!isBehindCamera)
+		{
+			limit<Real>(minX, -1, 1);
+			limit<Real>(minY, -1, 1);
+			limit<Real>(maxX, -1, 1);
+			limit<Real>(maxY, -1, 1);
+
+			Real screenWidth = (maxX - minX) * 0.5f * viewport->getActualWidth();
+			Real screenHeight = (maxY - minY) * 0.5f * viewport->getActualHeight();
+
+			coverage = std::max(screenWidth / naviWidth, screenHeight / naviHeight);
+		}
 
-	if(overlay)
-	{
-		overlay->resize(naviWidth, naviHeight);
-		overlay->panel->setUV(0, 0, (Real)naviWidth/newTexWidth, (Real)naviHeight/newTexHeight);	
+		// Only cross a level's threshold once the coverage is well past it, to avoid thrashing at the boundary
+		while(desiredLevel < maxLODLevel && coverage <= (1 - LOD_HYSTERESIS) / (2 << desiredLevel))
+			desiredLevel++;
+		while(desiredLevel > 0 && coverage > (1 + LOD_HYSTERESIS) / (1 << desiredLevel))
+			desiredLevel--;
 	}
 
-	awe_webview_resize(webView, naviWidth, naviHeight, false, 0);
-
-	if(newTexWidth == texWidth && newTexHeight == texHeight)
+	if(desiredLevel == lodLevel)
+	{
+		pendingLODLevel = lodLevel;
+		pendingLODFrames = 0;
 		return;
+	}
 
-	texWidth = newTexWidth;
-	texHeight = newTexHeight;
-
-	matPass->removeAllTextureUnitStates();
-	maskTexUnit = 0;
-
-	Ogre::TextureManager::getSingleton().remove(naviName + "Texture");
+	if(desiredLevel != pendingLODLevel)
+	{
+		pendingLODLevel = desiredLevel;
+		pendingLODFrames = 0;
+	}
 
-	TexturePtr texture = TextureManager::getSingleton().createManual(
-		naviName + "Texture", ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME,
-		TEX_TYPE_2D, texWidth, texHeight, 0, PF_BYTE_BGRA,
-		TU_DYNAMIC_WRITE_ONLY_DISCARDABLE, this);
+	if(++pendingLODFrames >= (desiredLevel < lodLevel ? LOD_REFINE_FRAMES : LOD_COARSEN_FRAMES))
+		setLODLevel(desiredLevel);
+}
 
-	HardwarePixelBufferSharedPtr pixelBuffer = texture->getBuffer();
-	pixelBuffer->lock(HardwareBuffer::HBL_DISCARD);
-	const PixelBox& pixelBox = pixelBuffer->getCurrentLock();
-	texDepth = Ogre::PixelUtil::getNumElemBytes(pixelBox.format);
-	texPitch = (pixelBox.rowPitch*texDepth);
+void Navi::setLODLevel(unsigned short level)
+{
+	pendingLODLevel = level;
+	pendingLODFrames = 0;
 
-	uint8* pDest = static_cast<uint8*>(pixelBox.data);
+	if(level == lodLevel || !webView)
+		return;
 
-	memset(pDest, 128, texHeight*texPitch);
+	lodLevel = level;
 
-	pixelBuffer->unlock();
+	// The page is rendered at a fraction of its size and zoomed out by the same factor so its layout is unchanged
+	resizeWebView(scaleForLOD(naviWidth, lodLevel), scaleForLOD(naviHeight, lodLevel), std::max(zoomPercent / (1 << lodLevel), 10));
 
-	baseTexUnit = matPass->createTextureUnitState(naviName + "Texture");
-	
-	baseTexUnit->setTextureFiltering(texFiltering, texFiltering, FO_NONE);
-	if(texFiltering == FO_ANISOTROPIC)
-		baseTexUnit->setTextureAnisotropy(4);
+	// Scaling the (power-of-two) texture by the same factor keeps the derived UV's the same at every level
+	int newTexWidth = scaleForLOD(compensateNPOT ? Bitwise::firstPO2From(naviWidth) : naviWidth, lodLevel);
+	int newTexHeight = scaleForLOD(compensateNPOT ? Bitwise::firstPO2From(naviHeight) : naviHeight, lodLevel);
 
-	if(usingMask)
-	{
-		setMask(maskImageParameters.first, maskImageParameters.second);
-	}
-	else if(alphaCache)
+	if(newTexWidth != texWidth || newTexHeight != texHeight)
 	{
-		delete[] alphaCache;
-		alphaCache = new unsigned char[texWidth * texHeight];
-		alphaCachePitch = texWidth;
+		texWidth = newTexWidth;
+		texHeight = newTexHeight;
+
+		recreateTexture();
 	}
+
+	needsForceRender = true;
 }
 
 bool Navi::isPointOverMe(int x, int y)
@@ -397,6 +1011,11 @@ bool Navi::isPointOverMe(int x, int y)
 
 void Navi::loadURL(const std::string& url)
 {
+	if(NaviManager::Get().deferToBrowser(this, &Navi::loadURL, url))
+		return;
+
+	wakeUpdates();
+
 	if(webView)
 		awe_webview_load_url(webView, OSM_STR(url), OSM_EMPTY(),
 		OSM_EMPTY(), OSM_EMPTY());
@@ -404,21 +1023,38 @@ void Navi::loadURL(const std::string& url)
 
 void Navi::loadFile(const std::string& file)
 {
+	if(NaviManager::Get().deferToBrowser(this, &Navi::loadFile, file))
+		return;
+
+	wakeUpdates();
+
 	if(webView)
 		awe_webview_load_file(webView, OSM_STR(file), OSM_EMPTY());
 }
 
 void Navi::loadHTML(const std::string& html)
 {
+	if(NaviManager::Get().deferToBrowser(this, &Navi::loadHTML, html))
+		return;
+
+	wakeUpdates();
+
 	if(webView)
 		awe_webview_load_html(webView, OSM_STR(html), OSM_EMPTY());
 }
 
 void Navi::evaluateJS(const std::string& javascript, const OSM::JSArguments& args)
 {
+	if(NaviManager::Get().deferToBrowser(this, &Navi::evaluateJS, javascript, args))
+		return;
+
 	if(!webView)
 		return;
 
+	wakeUpdates();
+
+	NAVI_STATS(statsEnabled, stats.jsEvaluations++)
+
 	if(!args.size())
 	{
 		awe_webview_execute_javascript(webView, OSM_STR(javascript), OSM_EMPTY());
@@ -457,9 +1093,18 @@ void Navi::evaluateJS(const std::string& javascript, const OSM::JSArguments& arg
 
 OSM::JSValue Navi::evaluateJSWithResult(const std::string& javascript, const OSM::JSArguments& args)
 {
+	OSM::JSValue browserResult;
+
+	if(NaviManager::Get().sendToBrowser(this, &Navi::evaluateJSInto, javascript, args, &browserResult))
+		return browserResult;
+
 	if(!webView)
 		return OSM::JSValue();
 
+	wakeUpdates();
+
+	NAVI_STATS(statsEnabled, stats.jsEvaluations++)
+
 	if(!args.size())
 	{
 		awe_jsvalue* result = awe_webview_execute_javascript_with_result(webView, OSM::String(javascript).getInstance(), 
@@ -501,8 +1146,16 @@ OSM::JSValue Navi::evaluateJSWithResult(const std::string& javascript, const OSM
 	return OSM::JSValue(result, true);
 }
 
+void Navi::evaluateJSInto(const std::string& javascript, const OSM::JSArguments& args, OSM::JSValue* result)
+{
+	*result = evaluateJSWithResult(javascript, args);
+}
+
 void Navi::bind(const std::string& name, const NaviDelegate& callback)
 {
+	if(NaviManager::Get().deferToBrowser(this, &Navi::bind, name, callback))
+		return;
+
 	if(!webView)
 		return;
 
@@ -513,6 +1166,9 @@ void Navi::bind(const std::string& name, const NaviDelegate& callback)
 
 void Navi::setProperty(const std::string& name, const OSM::JSValue& value)
 {
+	if(NaviManager::Get().deferToBrowser(this, &Navi::setProperty, name, value))
+		return;
+
 	if(!webView)
 		return;
 
@@ -522,6 +1178,9 @@ void Navi::setProperty(const std::string& name, const OSM::JSValue& value)
 
 void Navi::setTransparent(bool isTransparent)
 {
+	if(NaviManager::Get().deferToMain(this, &Navi::setTransparent, isTransparent))
+		return;
+
 	if(!webView)
 		return;
 
@@ -542,17 +1201,23 @@ void Navi::setTransparent(bool isTransparent)
 		}
 	}
 
-	awe_webview_set_transparent(webView, isTransparent);
+	setWebViewTransparent(isTransparent);
 	isWebViewTransparent = isTransparent;
 }
 
 void Navi::setIgnoreBounds(bool ignoreBounds)
 {
+	if(NaviManager::Get().deferToMain(this, &Navi::setIgnoreBounds, ignoreBounds))
+		return;
+
 	ignoringBounds = ignoreBounds;
 }
 
 void Navi::setIgnoreTransparent(bool ignoreTrans, float threshold)
 {
+	if(NaviManager::Get().deferToMain(this, &Navi::setIgnoreTransparent, ignoreTrans, threshold))
+		return;
+
 	ignoringTrans = ignoreTrans;
 
 	limit<float>(threshold, 0, 1);
@@ -562,6 +1227,9 @@ void Navi::setIgnoreTransparent(bool ignoreTrans, float threshold)
 
 void Navi::setMask(std::string maskFileName, std::string groupName)
 {
+	if(NaviManager::Get().deferToMain(this, &Navi::setMask, maskFileName, groupName))
+		return;
+
 	if(usingMask)
 	{
 		if(maskTexUnit)
@@ -680,17 +1348,141 @@ void Navi::setMask(std::string maskFileName, std::string groupName)
 
 void Navi::setMaxUPS(unsigned int maxUPS)
 {
+	if(NaviManager::Get().deferToMain(this, &Navi::setMaxUPS, maxUPS))
+		return;
+
 	maxUpdatePS = maxUPS;
 }
 
+void Navi::setUpdateDivisor(unsigned int divisor)
+{
+	if(NaviManager::Get().deferToMain(this, &Navi::setUpdateDivisor, divisor))
+		return;
+
+	NaviManager::Get().assignPacing(this, divisor);
+}
+
+unsigned int Navi::getUpdateDivisor()
+{
+	return updateDivisor;
+}
+
+void Navi::setOnDemandUpdates(bool enabled, unsigned int wakeFrames)
+{
+	if(NaviManager::Get().deferToMain(this, &Navi::setOnDemandUpdates, enabled, wakeFrames))
+		return;
+
+	wakeFrameCount = wakeFrames;
+	updatesOnDemand = enabled;
+
+	// Pick up whatever changed while this Navi was being updated normally
+	if(enabled)
+		requestUpdates(wakeFrameCount);
+}
+
+bool Navi::isUpdatingOnDemand()
+{
+	return updatesOnDemand;
+}
+
+void Navi::requestUpdates(unsigned int frameCount)
+{
+	// Requests may come from any thread, only ever raise the pending count
+	LONG pending;
+
+	do
+	{
+		pending = pendingUpdateFrames;
+
+		if(pending >= (LONG)frameCount)
+			return;
+	}
+	while(InterlockedCompareExchange(&pendingUpdateFrames, (LONG)frameCount, pending) != pending);
+}
+
+void Navi::wakeUpdates()
+{
+	if(updatesOnDemand)
+		requestUpdates(wakeFrameCount);
+}
+
+bool Navi::hasUpdateRequest()
+{
+	// A fade has to be stepped every frame until it completes, whether or not the page changes
+	return !updatesOnDemand || needsForceRender || isFading || pendingUpdateFrames > 0;
+}
+
+void Navi::consumeUpdateRequest()
+{
+	if(updatesOnDemand && pendingUpdateFrames > 0)
+		InterlockedDecrement(&pendingUpdateFrames);
+}
+
+void Navi::setMipmapping(MipmapMode mode, unsigned int maxRefreshPS)
+{
+	if(NaviManager::Get().deferToMain(this, &Navi::setMipmapping, mode, maxRefreshPS))
+		return;
+
+	if(!isMaterialOnly())
+		return;
+
+	if(mode == HardwareMipmaps && 
+		!Root::getSingleton().getRenderSystem()->getCapabilities()->hasCapability(RSC_AUTOMIPMAP))
+		mode = SoftwareMipmaps;
+
+	maxMipRefreshPS = maxRefreshPS;
+
+	if(mode == mipmapMode)
+		return;
+
+	mipmapMode = mode;
+
+	recreateTexture();
+	needsForceRender = true;
+}
+
+void Navi::setLODTarget(Ogre::MovableObject* target, unsigned short maxLevel)
+{
+	if(NaviManager::Get().deferToMain(this, &Navi::setLODTarget, target, maxLevel))
+		return;
+
+	if(!isMaterialOnly())
+		return;
+
+	lodTarget = target;
+	maxLODLevel = target ? maxLevel : 0;
+
+	if(lodLevel > maxLODLevel)
+		setLODLevel(maxLODLevel);
+
+	pendingLODLevel = lodLevel;
+	pendingLODFrames = 0;
+}
+
+unsigned short Navi::getLODLevel()
+{
+	return lodLevel;
+}
+
+NaviStats Navi::getStats()
+{
+	return stats;
+}
+
 void Navi::setMovable(bool isMovable)
 {
+	if(NaviManager::Get().deferToMain(this, &Navi::setMovable, isMovable))
+		return;
+
 	if(!isMaterialOnly())
 		movable = isMovable;
 }
 
 void Navi::setEnableTooltips(bool isEnabled)
 {
+	if(NaviManager::Get().deferToMain(this, &Navi::setEnableTooltips, isEnabled))
+		return;
+
 	tooltipsEnabled = isEnabled;
 
 	if(!isEnabled)
@@ -699,42 +1491,65 @@ void Navi::setEnableTooltips(bool isEnabled)
 
 void Navi::setAlwaysReceivesKeyboard(bool isEnabled)
 {
+	if(NaviManager::Get().deferToMain(this, &Navi::setAlwaysReceivesKeyboard, isEnabled))
+		return;
+
 	alwaysReceivesKeyboard = isEnabled;
 }
 
 void Navi::setModal(bool isModal)
 {
+	if(NaviManager::Get().deferToMain(this, &Navi::setModal, isModal))
+		return;
+
 	if(overlay)
 		NaviManager::Get().setNaviModality(this, isModal);
 }
 
 void Navi::setViewport(Ogre::Viewport* viewport)
 {
+	if(NaviManager::Get().deferToMain(this, &Navi::setViewport, viewport))
+		return;
+
 	if(overlay)
 		overlay->setViewport(viewport);
 }
 
 void Navi::setOpacity(float opacity)
 {
+	if(NaviManager::Get().deferToMain(this, &Navi::setOpacity, opacity))
+		return;
+
 	limit<float>(opacity, 0, 1);
 	
 	this->opacity = opacity;
+
+	wakeUpdates();
 }
 
 void Navi::setPosition(const NaviPosition &naviPosition)
 {
+	if(NaviManager::Get().deferToMain(this, &Navi::setPosition, naviPosition))
+		return;
+
 	if(overlay)
 		overlay->setPosition(naviPosition);
 }
 
 void Navi::resetPosition()
 {
+	if(NaviManager::Get().deferToMain(this, &Navi::resetPosition))
+		return;
+
 	if(overlay)
 		overlay->resetPosition();
 }
 
 void Navi::hide(bool fade, unsigned short fadeDurationMS)
 {
+	if(NaviManager::Get().deferToMain(this, &Navi::hide, fade, fadeDurationMS))
+		return;
+
 	updateFade();
 
 	NaviManager::Get().handleNaviHide(this);
@@ -751,10 +1566,15 @@ void Navi::hide(bool fade, unsigned short fadeDurationMS)
 		fadeValue = 0;
 		overlay->hide();
 	}
+
+	wakeUpdates();
 }
 
 void Navi::show(bool fade, unsigned short fadeDurationMS)
 {
+	if(NaviManager::Get().deferToMain(this, &Navi::show, fade, fadeDurationMS))
+		return;
+
 	updateFade();
 
 	if(fade)
@@ -770,21 +1590,29 @@ void Navi::show(bool fade, unsigned short fadeDurationMS)
 	}
 
 	overlay->show();
+
+	wakeUpdates();
 }
 
 void Navi::focus()
 {
+	if(NaviManager::Get().deferToMain(this, &Navi::focus))
+		return;
+
 	if(!webView)
 		return;
 
 	if(overlay)
 		NaviManager::GetPointer()->focusNavi(0, 0, this);
 	else
-		awe_webview_focus(webView);
+		focusWebView(true);
 }
 
 void Navi::moveNavi(int deltaX, int deltaY)
 {
+	if(NaviManager::Get().deferToMain(this, &Navi::moveNavi, deltaX, deltaY))
+		return;
+
 	if(overlay)
 		overlay->move(deltaX, deltaY);
 }
@@ -846,64 +1674,191 @@ void Navi::getDerivedUV(Ogre::Real& u1, Ogre::Real& v1, Ogre::Real& u2, Ogre::Re
 
 	if(compensateNPOT)
 	{
-		u2 = (Ogre::Real)naviWidth/texWidth;
-		v2 = (Ogre::Real)naviHeight/(Ogre::Real)texHeight;
+		u2 = (Ogre::Real)naviWidth/Bitwise::firstPO2From(naviWidth);
+		v2 = (Ogre::Real)naviHeight/(Ogre::Real)Bitwise::firstPO2From(naviHeight);
 	}
 }
 
 void Navi::injectMouseMove(int xPos, int yPos)
 {
+	if(NaviManager::Get().deferToMain(this, &Navi::injectMouseMove, xPos, yPos))
+		return;
+
+	// The LOD level belongs to the main thread, so the position is scaled before it is handed to the browser thread
+	injectWebViewMouseMove(xPos / (1 << lodLevel), yPos / (1 << lodLevel));
+}
+
+void Navi::injectWebViewMouseMove(int xPos, int yPos)
+{
+	if(NaviManager::Get().deferToBrowser(this, &Navi::injectWebViewMouseMove, xPos, yPos))
+		return;
+
+	wakeUpdates();
+
 	if(webView)
 		awe_webview_inject_mouse_move(webView, xPos, yPos);
 }
 
 void Navi::injectMouseWheel(int relScroll)
 {
+	if(NaviManager::Get().deferToBrowser(this, &Navi::injectMouseWheel, relScroll))
+		return;
+
+	wakeUpdates();
+
 	if(webView)
 		awe_webview_inject_mouse_wheel(webView, relScroll, 0);
 }
 
 void Navi::injectMouseDown(int xPos, int yPos)
 {
+	if(NaviManager::Get().deferToMain(this, &Navi::injectMouseDown, xPos, yPos))
+		return;
+
 	if(hasInternalKeyboardFocus)
 		NaviManager::Get().handleKeyboardFocusChange(this, true);
 
+	injectWebViewMouseDown();
+}
+
+void Navi::injectWebViewMouseDown()
+{
+	if(NaviManager::Get().deferToBrowser(this, &Navi::injectWebViewMouseDown))
+		return;
+
+	wakeUpdates();
+
 	if(webView)
 		awe_webview_inject_mouse_down(webView, AWE_MB_LEFT);
 }
 
+void Navi::changeKeyboardFocus(bool isFocused)
+{
+	if(NaviManager::Get().deferToMain(this, &Navi::changeKeyboardFocus, isFocused))
+		return;
+
+	NaviManager::Get().handleKeyboardFocusChange(this, isFocused);
+	hasInternalKeyboardFocus = isFocused;
+}
+
 void Navi::injectMouseUp(int xPos, int yPos)
 {
+	if(NaviManager::Get().deferToBrowser(this, &Navi::injectMouseUp, xPos, yPos))
+		return;
+
+	wakeUpdates();
+
 	if(webView)
 		awe_webview_inject_mouse_up(webView, AWE_MB_LEFT);
 }
 
 void Navi::captureImage(const std::string& filename)
 {
+	if(NaviManager::Get().deferToBrowser(this, &Navi::captureImage, filename))
+		return;
+
 	if(webView)
 	{
 		const awe_renderbuffer* buffer = awe_webview_render(webView);
 		if(buffer)
+		{
 			awe_renderbuffer_save_to_jpeg(buffer, OSM_STR(filename), 90);
+
+			// Rendering cleared the page's dirty state, so pass the frame on instead of waiting for the next change
+			if(browserFrames)
+				publishFrame(buffer);
+			else
+				needsForceRender = true;
+
+			wakeUpdates();
+		}
+	}
+}
+
+void Navi::startRecording(const std::string& filename, RecordingFormat format, RecordingPolicy policy, 
+	unsigned int bufferCount, unsigned int frameRate)
+{
+	// The output is opened on the calling thread so that a failure is thrown to the caller
+	Impl::FrameRecorder* newRecorder = new Impl::FrameRecorder(filename, format, policy, bufferCount, frameRate);
+
+	if(!newRecorder->isOpen())
+	{
+		delete newRecorder;
+
+		OGRE_EXCEPT(Ogre::Exception::ERR_CANNOT_WRITE_TO_FILE, 
+			"Could not create the recording '" + filename + "' for Navi '" + naviName + "'.", 
+			"Navi::startRecording");
+	}
+
+	attachRecorder(newRecorder);
+}
+
+void Navi::attachRecorder(Impl::FrameRecorder* newRecorder)
+{
+	if(NaviManager::Get().transferToMain(this, &Navi::attachRecorder, newRecorder))
+		return;
+
+	stopRecording();
+
+	recorder = newRecorder;
+
+	// Make sure the recording starts with a complete frame
+	needsForceRender = true;
+	wakeUpdates();
+}
+
+void Navi::stopRecording()
+{
+	if(NaviManager::Get().deferToMain(this, &Navi::stopRecording))
+		return;
+
+	if(recorder)
+	{
+		delete recorder;
+		recorder = 0;
 	}
 }
 
+bool Navi::isRecording()
+{
+	return recorder != 0;
+}
+
+NaviRecordingStats Navi::getRecordingStats()
+{
+	return recorder ? recorder->getStats() : NaviRecordingStats();
+}
+
 void Navi::resize(int width, int height)
 {
+	if(NaviManager::Get().deferToMain(this, &Navi::resize, width, height))
+		return;
+
 	resizeParameters.first = width;
 	resizeParameters.second = height;
+	wakeUpdates();
 }
 
 void Navi::setZoom(int percent)
 {
-	if(webView)
-		awe_webview_set_zoom(webView, percent);
+	if(NaviManager::Get().deferToMain(this, &Navi::setZoom, percent))
+		return;
+
+	zoomPercent = percent;
+	wakeUpdates();
+
+	applyZoom(std::max(zoomPercent / (1 << lodLevel), 10));
 }
 
 void Navi::resetZoom()
 {
-	if(webView)
-		awe_webview_reset_zoom(webView);
+	if(NaviManager::Get().deferToMain(this, &Navi::resetZoom))
+		return;
+
+	zoomPercent = 100;
+
+	// A zoom of 0 resets it
+	applyZoom(lodLevel ? zoomPercent / (1 << lodLevel) : 0);
 }
 
 void Navi::onBeginNavigation(awe_webview* caller, 
@@ -936,10 +1891,20 @@ void Navi::onJSCallback(awe_webview* caller,
 	{
 		std::string name = callbackName.str();
 
-		std::map<std::string, NaviDelegate>::iterator i = delegateMap.find(name);
+		DelegateMap::iterator i = delegateMap.find(name);
 
 		if(i != delegateMap.end())
-			NaviManager::Get().queueCallback(this, args, i->second);
+		{
+			NaviManager::CallbackInvocation invocation;
+			invocation.caller = this;
+			invocation.args = args;
+			invocation.callback = i->second;
+			invocation.name = name;
+			invocation.queuedTime = 0;
+			NAVI_STATS(statsEnabled, invocation.queuedTime = Impl::getTimestampUS())
+
+			NaviManager::Get().queueCallback(invocation);
+		}
 	}
 }
 
@@ -965,8 +1930,7 @@ void Navi::onChangeCursor(awe_webview* caller,
 void Navi::onChangeKeyboardFocus(awe_webview* caller, 
 										   bool isFocused)
 {
-	NaviManager::Get().handleKeyboardFocusChange(this, isFocused);
-	hasInternalKeyboardFocus = isFocused;
+	changeKeyboardFocus(isFocused);
 	onJSCallback(caller, L"Client", L"_changeKeyboardFocus", JSArgs(isFocused));
 }
 
@@ -1058,4 +2022,11 @@ void Navi::onRequestDrag(Navi *caller, const OSM::JSArguments &args)
 {
 	if(overlay)
 		NaviManager::Get().handleRequestDrag(this);
+}
+
+void Navi::onRequestFrame(Navi *caller, const OSM::JSArguments &args)
+{
+	int frameCount = args.size() ? args[0].toInteger() : 1;
+
+	requestUpdates(frameCount > 0 ? frameCount : 1);
 }
\ No newline at end of file
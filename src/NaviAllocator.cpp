@@ -0,0 +1,113 @@
+/*
+	This file is part of NaviLibrary, a library that allows developers to create and 
+	interact with web-content as an overlay or material in Ogre3D applications.
+
+	Copyright (C) 2011 Khrona LLC
+	https://github.com/khrona/navi
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "NaviAllocator.h"
+#include <windows.h>
+#include <stdlib.h>
+
+using namespace NaviLibrary;
+
+namespace
+{
+	NaviAllocator* installedAllocator = 0;
+	volatile bool isTracking = false;
+	volatile LONG trackedCounts[AllocationTagCount] = { 0 };
+	volatile LONG trackedBytes[AllocationTagCount] = { 0 };
+}
+
+NaviAllocationCounts::NaviAllocationCounts()
+{
+	for(int i = 0; i < AllocationTagCount; i++)
+		count[i] = bytes[i] = 0;
+}
+
+unsigned long NaviAllocationCounts::getTotalCount() const
+{
+	unsigned long total = 0;
+
+	for(int i = 0; i < AllocationTagCount; i++)
+		total += count[i];
+
+	return total;
+}
+
+void NaviLibrary::setNaviAllocator(NaviAllocator* allocator)
+{
+	installedAllocator = allocator;
+}
+
+NaviAllocator* NaviLibrary::getNaviAllocator()
+{
+	return installedAllocator;
+}
+
+const char* NaviLibrary::getAllocationTagName(AllocationTag tag)
+{
+	static const char* names[AllocationTagCount] = { "strings", "delegates", "navi map", "callbacks", "commands", "js arrays" };
+
+	return tag < AllocationTagCount ? names[tag] : "unknown";
+}
+
+void* Impl::allocate(size_t size, AllocationTag tag)
+{
+	if(isTracking)
+	{
+		InterlockedIncrement(&trackedCounts[tag]);
+		InterlockedExchangeAdd(&trackedBytes[tag], (LONG)size);
+	}
+
+	void* result = installedAllocator ? installedAllocator->allocate(size, tag) : malloc(size ? size : 1);
+
+	if(!result)
+		throw std::bad_alloc();
+
+	return result;
+}
+
+void Impl::deallocate(void* pointer, size_t size, AllocationTag tag)
+{
+	if(!pointer)
+		return;
+
+	if(installedAllocator)
+		installedAllocator->deallocate(pointer, size, tag);
+	else
+		free(pointer);
+}
+
+void Impl::setAllocationTracking(bool enabled)
+{
+	isTracking = enabled;
+}
+
+NaviAllocationCounts Impl::takeAllocationCounts()
+{
+	NaviAllocationCounts counts;
+
+	for(int i = 0; i < AllocationTagCount; i++)
+	{
+		counts.count[i] = (unsigned long)InterlockedExchange(&trackedCounts[i], 0);
+		counts.bytes[i] = (unsigned long)InterlockedExchange(&trackedBytes[i], 0);
+	}
+
+	return counts;
+}
\ No newline at end of file
@@ -35,11 +35,89 @@ template<> NaviManager* Singleton<NaviManager>::instance = 0;
 
 #define TIP_SHOW_DELAY 0.7
 #define TIP_ENTRY_DELAY 2.0
+#define COPY_BAND_ROWS 64
+#define BROWSER_UPDATE_INTERVAL 10
+#define MAX_NAVI_ZORDER 198 // 199 is reserved for the tooltip
+#define PACING_HORIZON 120 // Divisible by most useful divisors, so that their frames repeat within it
 
-NaviManager::NaviManager(Ogre::Viewport* defaultViewport, const std::string &baseDirectory)
+NaviManager::NaviManager(Ogre::Viewport* defaultViewport, const std::string &baseDirectory, bool useBrowserThread)
 	: focusedNavi(0), mouseXPos(0), mouseYPos(0), mouseButtonRDown(false), mouseButtonLDown(false), zOrderCounter(5), 
 	defaultViewport(defaultViewport), tooltipParent(0), lastTooltip(0), tooltipShowTime(0), isDraggingFocusedNavi(0),
-	keyboardFocusedNavi(0), isFocusedNaviModal(false)
+	keyboardFocusedNavi(0), isFocusedNaviModal(false), lodCamera(0), workerPool(0), baseDirectory(baseDirectory),
+	browserThread(0), browserWakeEvent(0), browserReadyEvent(0), browserThreadId(0), mainThreadId(0), isBrowserThreadRunning(false),
+	statsEnabled(false), nativeTooltip(0), displayRefreshRate(0), pacingLoads(PACING_HORIZON, 0), 
+	logFrameAllocations(false), frameNumber(0)
+{
+	setDisplayRefreshRate(0);
+
+	for(int i = 0; i < 3; i++)
+	{
+		zOrderLists[i].bottom = zOrderLists[i].top = 0;
+		zOrderLists[i].count = 0;
+	}
+
+	if(useBrowserThread)
+	{
+		mainThreadId = GetCurrentThreadId();
+		browserWakeEvent = CreateEvent(0, FALSE, FALSE, 0);
+		browserReadyEvent = CreateEvent(0, TRUE, FALSE, 0);
+		isBrowserThreadRunning = true;
+		browserThread = CreateThread(0, 0, &NaviManager::browserThreadProc, this, 0, &browserThreadId);
+
+		WaitForSingleObject(browserReadyEvent, INFINITE);
+	}
+	else
+	{
+		initializeWebCore();
+	}
+
+	NAVI_TRACE_THREAD("Main thread");
+
+	keyboardHook = new Impl::KeyboardHook(this);
+
+	tooltipNavi = 0;
+	createTooltipNavi();
+}
+
+NaviManager::~NaviManager()
+{
+	delete keyboardHook;
+
+	if(workerPool)
+		delete workerPool;
+
+	for(iter = activeNavis.begin(); iter != activeNavis.end();)
+	{
+		Navi* toDelete = iter->second;
+		iter = activeNavis.erase(iter);
+		delete toDelete;
+	}
+
+	if(tooltipNavi)
+		delete tooltipNavi;
+
+	if(nativeTooltip)
+		delete nativeTooltip;
+
+	if(browserThread)
+	{
+		isBrowserThreadRunning = false;
+		SetEvent(browserWakeEvent);
+		WaitForSingleObject(browserThread, INFINITE);
+
+		CloseHandle(browserThread);
+		CloseHandle(browserWakeEvent);
+		CloseHandle(browserReadyEvent);
+	}
+	else
+	{
+		awe_webcore_shutdown();
+	}
+
+	Impl::TraceRecorder::shutdown();
+}
+
+void NaviManager::initializeWebCore()
 {
 	// Enable plugins by default
 	awe_webcore_initialize(true, true, false, awe_string_empty(), 
@@ -51,29 +129,131 @@ NaviManager::NaviManager(Ogre::Viewport* defaultViewport, const std::string &bas
 		false, awe_string_empty());
 
 	awe_webcore_set_base_directory(OSM_STR(NaviUtilities::getCurrentWorkingDirectory() + baseDirectory + "\\"));
-	keyboardHook = new Impl::KeyboardHook(this);
-
-	tooltipNavi = new Navi("__tooltip", 250, 50, NaviPosition(0, 0), false, 70, 199, Front, defaultViewport);
-	tooltipNavi->hide();
-	tooltipNavi->setTransparent(true);
-	tooltipNavi->loadFile("tooltip.html");
-	tooltipNavi->bind("resizeTooltip", NaviDelegate(this, &NaviManager::onResizeTooltip));
 }
 
-NaviManager::~NaviManager()
+DWORD WINAPI NaviManager::browserThreadProc(LPVOID param)
 {
-	delete keyboardHook;
+	NaviManager* manager = static_cast<NaviManager*>(param);
 
-	for(iter = activeNavis.begin(); iter != activeNavis.end();)
+	NAVI_TRACE_THREAD("Browser thread");
+
+	manager->initializeWebCore();
+	SetEvent(manager->browserReadyEvent);
+
+	while(manager->isBrowserThreadRunning)
 	{
-		Navi* toDelete = iter->second;
-		iter = activeNavis.erase(iter);
-		delete toDelete;
+		{
+			NAVI_TRACE_SCOPE("Browser commands");
+			manager->executeBrowserCommands();
+		}
+
+		{
+			NAVI_TRACE_SCOPE("awe_webcore_update");
+			awe_webcore_update();
+		}
+
+		for(std::vector<Navi*>::iterator i = manager->browserNavis.begin(); i != manager->browserNavis.end(); i++)
+			(*i)->renderFrame();
+
+		// Sleep until the next tick, or until a command arrives
+		WaitForSingleObject(manager->browserWakeEvent, BROWSER_UPDATE_INTERVAL);
 	}
 
-	delete tooltipNavi;
+	manager->executeBrowserCommands();
 
 	awe_webcore_shutdown();
+
+	return 0;
+}
+
+bool NaviManager::isThreaded()
+{
+	return browserThread != 0;
+}
+
+bool NaviManager::isBrowserThread()
+{
+	return !browserThread || GetCurrentThreadId() == browserThreadId;
+}
+
+bool NaviManager::isMainThread()
+{
+	return !browserThread || GetCurrentThreadId() == mainThreadId;
+}
+
+bool NaviManager::postCommand(Impl::CommandQueue& queue, Impl::Command* command, bool waitForCompletion)
+{
+	HANDLE completedEvent = 0;
+
+	if(waitForCompletion)
+	{
+		completedEvent = CreateEvent(0, FALSE, FALSE, 0);
+		command = new Impl::BlockingCommand(command, completedEvent);
+	}
+
+	queue.push(command);
+
+	if(&queue == &browserCommands)
+		SetEvent(browserWakeEvent);
+
+	if(completedEvent)
+	{
+		WaitForSingleObject(completedEvent, INFINITE);
+		CloseHandle(completedEvent);
+	}
+
+	return true;
+}
+
+void NaviManager::executeMainCommands()
+{
+	while(Impl::Command* command = mainCommands.pop())
+	{
+		// Another thread may have queued the command for a Navi that has since been destroyed
+		if(isCommandTargetAlive(command->getTarget()))
+			command->execute();
+		else
+			command->cancel();
+
+		delete command;
+	}
+}
+
+void NaviManager::executeBrowserCommands()
+{
+	while(Impl::Command* command = browserCommands.pop())
+	{
+		// Navis are only valid targets here from their createWebView until their destroyWebView
+		const void* target = command->getTarget();
+
+		if(target == this || std::find(browserTargets.begin(), browserTargets.end(), target) != browserTargets.end())
+			command->execute();
+		else
+			command->cancel();
+
+		delete command;
+	}
+}
+
+bool NaviManager::isCommandTargetAlive(const void* target)
+{
+	if(target == this || (tooltipNavi && target == tooltipNavi))
+		return true;
+
+	for(NaviMap::iterator i = activeNavis.begin(); i != activeNavis.end(); i++)
+		if(i->second == target)
+			return true;
+
+	return false;
+}
+
+void NaviManager::addBrowserTarget(Navi* navi)
+{
+	if(deferToBrowser(this, &NaviManager::addBrowserTarget, navi))
+		return;
+
+	if(std::find(browserTargets.begin(), browserTargets.end(), navi) == browserTargets.end())
+		browserTargets.push_back(navi);
 }
 
 NaviManager& NaviManager::Get()
@@ -93,30 +273,119 @@ NaviManager* NaviManager::GetPointer()
 
 void NaviManager::Update()
 {
-	awe_webcore_update();
+	NAVI_TRACE_SCOPE("NaviManager::Update");
+
+	lastFrameAllocations = Impl::takeAllocationCounts();
+
+	if(logFrameAllocations && lastFrameAllocations.getTotalCount())
+		logAllocations();
+
+	frameNumber++;
+
+	if(browserThread)
+	{
+		NAVI_TRACE_SCOPE("Main commands");
+		executeMainCommands();
+	}
+	else
+	{
+		NAVI_TRACE_SCOPE("awe_webcore_update");
+		awe_webcore_update();
+	}
 
-	while(queuedCallbacks.size())
 	{
-		CallbackInvocation invocation = queuedCallbacks.front();
-		queuedCallbacks.pop_front();
+		NAVI_TRACE_SCOPE("Callback dispatch");
+
+		while(queuedCallbacks.size())
+		{
+			// Move the invocation out of the queue rather than copying its name and arguments. The delegate may
+			// destroy its caller (and with it, the caller's queued callbacks) or even this NaviManager, so it must
+			// run from a local rather than from the queue or a member.
+			CallbackInvocation invocation;
+			invocation.caller = queuedCallbacks.front().caller;
+			invocation.args.swap(queuedCallbacks.front().args);
+			invocation.callback = queuedCallbacks.front().callback;
+			invocation.name.swap(queuedCallbacks.front().name);
+			invocation.queuedTime = queuedCallbacks.front().queuedTime;
+			queuedCallbacks.pop_front();
+
+			NAVI_STATS(statsEnabled, invocation.caller->stats.callbacksDispatched++; invocation.caller->stats.callbackLatency += Impl::getTimestampUS() - invocation.queuedTime)
 
-		invocation.callback(invocation.caller, invocation.args);
+			{
+				NAVI_TRACE_SCOPE_DETAIL(invocation.name.c_str(), invocation.caller->naviName.c_str());
+				invocation.callback(invocation.caller, invocation.args);
+			}
 
-		if(!NaviManager::GetPointer())
-			return;
+			if(!NaviManager::GetPointer())
+				return;
+		}
 	}
 
+	Ogre::Viewport* lodViewport = lodCamera && lodCamera->getViewport() ? lodCamera->getViewport() : defaultViewport;
+
+	dirtyNavis.clear();
+	copyBands.clear();
+
+	unsigned long long frameTime = 0;
+	NAVI_STATS(statsEnabled, frameTime = Impl::getTimestampUS())
+
+	// Render every dirty Navi and map its staging memory here, the pixel copies are then spread over the worker pool
 	for(iter = activeNavis.begin(); iter != activeNavis.end(); iter++)
-		iter->second->update();
+	{
+		if(lodCamera && lodViewport)
+			iter->second->updateLOD(lodCamera, lodViewport);
+
+		if(!isPacedFrame(iter->second, frameTime) || !iter->second->hasUpdateRequest())
+			continue;
 
-	tooltipNavi->update();
+		if(iter->second->prepareUpdate())
+		{
+			dirtyNavis.push_back(iter->second);
+
+			for(int row = 0; row < iter->second->texHeight; row += COPY_BAND_ROWS)
+			{
+				CopyBand band = { iter->second, row, row + COPY_BAND_ROWS, 0, 0 };
+				copyBands.push_back(band);
+			}
+		}
+	}
+
+	{
+		NAVI_TRACE_SCOPE("Texture copies");
+
+		if(workerPool)
+			workerPool->run(&NaviManager::copyBand, this, (unsigned int)copyBands.size());
+		else
+			for(unsigned int i = 0; i < copyBands.size(); i++)
+				copyBand(this, i);
+	}
+
+#if NAVI_ENABLE_STATS
+	// Band timings are summed here rather than on the workers so that each Navi's counters have a single writer
+	if(statsEnabled)
+	{
+		for(std::vector<CopyBand>::iterator i = copyBands.begin(); i != copyBands.end(); i++)
+		{
+			i->navi->stats.copyTime += i->copyTime;
+			i->navi->stats.alphaCacheTime += i->alphaTime;
+		}
+	}
+#endif
+
+	for(std::vector<Navi*>::iterator i = dirtyNavis.begin(); i != dirtyNavis.end(); i++)
+		(*i)->finishUpdate();
+
+	NAVI_TRACE_SCOPE("Tooltip");
+
+	if(tooltipNavi)
+		tooltipNavi->update();
 
 	if(tooltipShowTime)
 	{
 		if(tooltipShowTime < tooltipTimer.getMilliseconds())
 		{
-			tooltipNavi->show(true);
-			tooltipNavi->setPosition(NaviPosition(mouseXPos, mouseYPos + 15));
+			showTooltip();
+			moveTooltip(mouseXPos, mouseYPos + 15);
 			tooltipShowTime = 0;
 			lastTooltip = tooltipTimer.getMilliseconds();
 		}
@@ -131,20 +400,17 @@ Navi* NaviManager::createNavi(const std::string &naviName, unsigned short width,
 			"An attempt was made to create a Navi named '" + naviName + "' when a Navi by the same name already exists!", 
 			"NaviManager::createNavi");
 
-	int highestZOrder = -1;
-	int zOrder = 0;
+	if(zOrderLists[tier].count > MAX_NAVI_ZORDER)
+		OGRE_EXCEPT(Ogre::Exception::ERR_RT_ASSERTION_FAILED, 
+			"An attempt was made to create a Navi named '" + naviName + "' in a tier that already has a Navi at every z-order!", 
+			"NaviManager::createNavi");
 
-	for(iter = activeNavis.begin(); iter != activeNavis.end(); iter++)
-		if(iter->second->overlay)
-			if(iter->second->overlay->getTier() == tier)
-				if(iter->second->overlay->getZOrder() > highestZOrder)
-					highestZOrder = iter->second->overlay->getZOrder();
+	Navi* navi = new Navi(naviName, width, height, naviPosition, asyncRender, maxAsyncRenderRate, 0, tier, 
+		viewport? viewport : defaultViewport);
 
-	if(highestZOrder != -1)
-		zOrder = highestZOrder + 1;
+	raiseToTop(navi);
 
-	return activeNavis[naviName] = new Navi(naviName, width, height, naviPosition, asyncRender, maxAsyncRenderRate, (Ogre::uchar)zOrder, tier, 
-		viewport? viewport : defaultViewport);
+	return activeNavis[naviName] = navi;
 }
 
 Navi* NaviManager::createNaviMaterial(const std::string &naviName, unsigned short width, unsigned short height, 
@@ -187,12 +453,24 @@ void NaviManager::destroyNavi(const std::string &naviName)
 
 void NaviManager::destroyNavi(Navi* naviToDestroy)
 {
+	if(browserThread && naviToDestroy)
+	{
+		// Close the page on the browser thread first, then run whatever it had already handed over to us
+		naviToDestroy->destroyWebView();
+		executeMainCommands();
+	}
+
 	for(iter = activeNavis.begin(); iter != activeNavis.end(); iter++)
 	{
 		if(iter->second == naviToDestroy)
 		{
 			activeNavis.erase(iter);
 
+			if(naviToDestroy->overlay)
+				unlinkZOrder(naviToDestroy);
+
+			releasePacing(naviToDestroy);
+
 			if(focusedNavi == naviToDestroy)
 			{
 				focusedNavi = 0;
@@ -205,9 +483,10 @@ void NaviManager::destroyNavi(Navi* naviToDestroy)
 
 			// Update the webCore here to grab any queued callback events for this thread
 			// before clearing those specific to the Navi being destroyed
-			awe_webcore_update();
+			if(!browserThread)
+				awe_webcore_update();
 	
-			for(std::deque<CallbackInvocation>::iterator i = queuedCallbacks.begin(); i != queuedCallbacks.end();)
+			for(CallbackQueue::iterator i = queuedCallbacks.begin(); i != queuedCallbacks.end();)
 			{
 				if(i->caller == naviToDestroy)
 					i = queuedCallbacks.erase(i);
@@ -256,7 +535,7 @@ bool NaviManager::injectMouseMove(int xPos, int yPos)
 {
 	bool eventHandled = false;
 
-	if(tooltipNavi->getVisibility())
+	if(isTooltipVisible())
 		moveTooltip(xPos, yPos + 15);
 
 	if(focusedNavi && isDraggingFocusedNavi || focusedNavi && mouseButtonRDown)
@@ -409,75 +688,379 @@ bool NaviManager::focusNavi(int x, int y, Navi* selection)
 		return false;
 	}
 
-	std::vector<Navi*> sortedNavis;
+	if(naviToFocus->overlay)
+		raiseToTop(naviToFocus);
+
+	focusedNavi = naviToFocus;
+	focusedNavi->focusWebView(true);
+	isDraggingFocusedNavi = false;
+	keyboardFocusedNavi = focusedNavi->hasInternalKeyboardFocus? focusedNavi : 0;
+
+	return true;
+}
+
+Navi* NaviManager::getTopNavi(int x, int y)
+{
+	// Walk each tier from front to back, the first Navi under the point is the topmost one
+	for(int tier = Front; tier >= Back; tier--)
+		for(Navi* navi = zOrderLists[tier].top; navi; navi = navi->zOrderBelow)
+			if(navi->isPointOverMe(x, y))
+				return navi;
+
+	return 0;
+}
+
+void NaviManager::raiseToTop(Navi* navi)
+{
+	ZOrderList& list = zOrderLists[navi->overlay->getTier()];
+
+	if(list.top == navi)
+		return;
+
+	if(navi->zOrderBelow || navi->zOrderAbove || list.bottom == navi)
+		unlinkZOrder(navi);
+
+	navi->zOrderBelow = list.top;
+	navi->zOrderAbove = 0;
+
+	if(list.top)
+		list.top->zOrderAbove = navi;
+	else
+		list.bottom = navi;
 
+	list.top = navi;
+	list.count++;
+
+	// Take the next free rank, ranks are only renumbered once the top of the range is reached
+	if(!navi->zOrderBelow)
+		navi->overlay->setZOrder(0);
+	else if(navi->zOrderBelow->overlay->getZOrder() < MAX_NAVI_ZORDER)
+		navi->overlay->setZOrder(navi->zOrderBelow->overlay->getZOrder() + 1);
+	else
+		compactZOrder(navi->overlay->getTier());
+}
+
+void NaviManager::unlinkZOrder(Navi* navi)
+{
+	ZOrderList& list = zOrderLists[navi->overlay->getTier()];
+
+	if(navi->zOrderAbove)
+		navi->zOrderAbove->zOrderBelow = navi->zOrderBelow;
+	else
+		list.top = navi->zOrderBelow;
+
+	if(navi->zOrderBelow)
+		navi->zOrderBelow->zOrderAbove = navi->zOrderAbove;
+	else
+		list.bottom = navi->zOrderAbove;
+
+	navi->zOrderAbove = navi->zOrderBelow = 0;
+	list.count--;
+}
+
+void NaviManager::compactZOrder(Tier tier)
+{
+	// Renumbers the whole tier in one pass, every Navi gets its own rank since a tier never holds more Navis than ranks
+	Ogre::uchar rank = 0;
+
+	for(Navi* navi = zOrderLists[tier].bottom; navi; navi = navi->zOrderAbove)
+		navi->overlay->setZOrder(rank++);
+}
+
+void NaviManager::setDefaultViewport(Ogre::Viewport* viewport)
+{
 	for(iter = activeNavis.begin(); iter != activeNavis.end(); iter++)
+	{
 		if(iter->second->overlay)
-			if(iter->second->overlay->getTier() == naviToFocus->overlay->getTier())
-				sortedNavis.push_back(iter->second);
+			if(iter->second->overlay->viewport == defaultViewport)
+				iter->second->overlay->setViewport(viewport);
+	}
+
+	defaultViewport = viewport;
+}
 
-	struct compare { bool operator()(Navi* a, Navi* b){ return(a->overlay->getZOrder() > b->overlay->getZOrder()); }};
-	std::sort(sortedNavis.begin(), sortedNavis.end(), compare());
+void NaviManager::setLODCamera(Ogre::Camera* camera)
+{
+	lodCamera = camera;
+}
 
-	if(sortedNavis.size())
+void NaviManager::setWorkerCount(unsigned int numWorkers)
+{
+	if(workerPool)
 	{
-		if(sortedNavis.at(0) != naviToFocus)
+		if(workerPool->getWorkerCount() == numWorkers)
+			return;
+
+		delete workerPool;
+		workerPool = 0;
+	}
+
+	if(numWorkers)
+		workerPool = new Impl::WorkerPool(numWorkers);
+}
+
+unsigned int NaviManager::getWorkerCount()
+{
+	return workerPool ? workerPool->getWorkerCount() : 0;
+}
+
+void NaviManager::copyBand(void* manager, unsigned int bandIndex)
+{
+	NaviManager* naviManager = static_cast<NaviManager*>(manager);
+	CopyBand& band = naviManager->copyBands[bandIndex];
+	NAVI_TRACE_SCOPE_DETAIL("Copy band", band.navi->naviName.c_str());
+	unsigned long long timestamp = 0;
+
+	NAVI_STATS(naviManager->statsEnabled, timestamp = Impl::getTimestampUS())
+	band.navi->copyRows(band.startRow, band.endRow);
+	NAVI_STATS(naviManager->statsEnabled, band.copyTime = Impl::getTimestampUS() - timestamp; timestamp = Impl::getTimestampUS())
+	band.navi->extractAlphaRows(band.startRow, band.endRow);
+	NAVI_STATS(naviManager->statsEnabled, band.alphaTime = Impl::getTimestampUS() - timestamp)
+}
+
+void NaviManager::setStatsEnabled(bool enabled)
+{
+	statsEnabled = enabled;
+
+	for(iter = activeNavis.begin(); iter != activeNavis.end(); iter++)
+		iter->second->statsEnabled = enabled;
+
+	if(tooltipNavi)
+		tooltipNavi->statsEnabled = enabled;
+}
+
+bool NaviManager::isStatsEnabled()
+{
+	return statsEnabled;
+}
+
+NaviStats NaviManager::getStats()
+{
+	NaviStats result = tooltipNavi ? tooltipNavi->stats : NaviStats();
+
+	for(iter = activeNavis.begin(); iter != activeNavis.end(); iter++)
+		result += iter->second->stats;
+
+	return result;
+}
+
+void NaviManager::startTrace(unsigned int capacity)
+{
+	Impl::TraceRecorder::start(capacity);
+}
+
+void NaviManager::stopTrace()
+{
+	Impl::TraceRecorder::stop();
+}
+
+bool NaviManager::isTracing()
+{
+	return Impl::TraceRecorder::isRecording();
+}
+
+void NaviManager::saveTrace(const std::string& filename)
+{
+	if(!Impl::TraceRecorder::save(filename))
+		OGRE_EXCEPT(Ogre::Exception::ERR_CANNOT_WRITE_TO_FILE, 
+			"Could not write the trace file '" + filename + "'.", 
+			"NaviManager::saveTrace");
+}
+
+void NaviManager::resetStats()
+{
+	for(iter = activeNavis.begin(); iter != activeNavis.end(); iter++)
+		iter->second->stats.reset();
+
+	if(tooltipNavi)
+		tooltipNavi->stats.reset();
+}
+
+void NaviManager::setDisplayRefreshRate(unsigned int refreshRate)
+{
+	if(!refreshRate)
+	{
+		DEVMODE mode;
+		mode.dmSize = sizeof(mode);
+		mode.dmDriverExtra = 0;
+
+		// A frequency of 0 or 1 stands for the hardware's default rate
+		if(EnumDisplaySettings(0, ENUM_CURRENT_SETTINGS, &mode) && mode.dmDisplayFrequency > 1)
+			refreshRate = mode.dmDisplayFrequency;
+		else
+			refreshRate = 60;
+	}
+
+	displayRefreshRate = refreshRate;
+}
+
+unsigned int NaviManager::getDisplayRefreshRate()
+{
+	return displayRefreshRate;
+}
+
+void NaviManager::assignPacing(Navi* navi, unsigned int divisor)
+{
+	releasePacing(navi);
+
+	if(!divisor)
+		return;
+
+	// Pick the phase whose frames carry the fewest paced Navis so that Navis sharing a rate are staggered
+	unsigned int bestPhase = 0, bestPeak = 0, bestTotal = 0;
+
+	for(unsigned int phase = 0; phase < std::min(divisor, (unsigned int)PACING_HORIZON); phase++)
+	{
+		unsigned int peak = 0, total = 0;
+
+		for(unsigned int frame = phase; frame < PACING_HORIZON; frame += divisor)
 		{
-			unsigned int popIdx = 0;
-			for(; popIdx < sortedNavis.size(); popIdx++)
-				if(sortedNavis.at(popIdx) == naviToFocus)
-					break;
-
-			unsigned short highestZ = sortedNavis.at(0)->overlay->getZOrder();
-			for(unsigned int i = 0; i < popIdx; i++)
-				sortedNavis.at(i)->overlay->setZOrder(sortedNavis.at(i+1)->overlay->getZOrder());
-			
-			sortedNavis.at(popIdx)->overlay->setZOrder(highestZ);
+			peak = std::max(peak, pacingLoads[frame]);
+			total += pacingLoads[frame];
+		}
+
+		if(!phase || peak < bestPeak || (peak == bestPeak && total < bestTotal))
+		{
+			bestPhase = phase;
+			bestPeak = peak;
+			bestTotal = total;
 		}
 	}
 
-	focusedNavi = naviToFocus;
-	awe_webview_focus(focusedNavi->webView);
-	isDraggingFocusedNavi = false;
-	keyboardFocusedNavi = focusedNavi->hasInternalKeyboardFocus? focusedNavi : 0;
+	for(unsigned int frame = bestPhase; frame < PACING_HORIZON; frame += divisor)
+		pacingLoads[frame]++;
+
+	navi->updateDivisor = divisor;
+	navi->updatePhase = bestPhase;
+	navi->lastPacedTime = 0;
+}
+
+void NaviManager::releasePacing(Navi* navi)
+{
+	if(!navi->updateDivisor)
+		return;
+
+	for(unsigned int frame = navi->updatePhase; frame < PACING_HORIZON; frame += navi->updateDivisor)
+		pacingLoads[frame]--;
+
+	navi->updateDivisor = navi->updatePhase = 0;
+}
+
+bool NaviManager::isPacedFrame(Navi* navi, unsigned long long timestamp)
+{
+	if(!navi->updateDivisor)
+		return true;
+
+	if(frameNumber % navi->updateDivisor != navi->updatePhase)
+		return false;
+
+#if NAVI_ENABLE_STATS
+	if(timestamp && navi->lastPacedTime)
+	{
+		unsigned long long targetInterval = navi->updateDivisor * 1000000ULL / displayRefreshRate;
+		unsigned long long interval = timestamp - navi->lastPacedTime;
+		unsigned long long deviation = interval > targetInterval ? interval - targetInterval : targetInterval - interval;
+
+		navi->stats.pacedIntervals++;
+		navi->stats.pacingJitter += deviation;
+		navi->stats.maxPacingJitter = std::max(navi->stats.maxPacingJitter, deviation);
+	}
+#endif
+
+	navi->lastPacedTime = timestamp;
 
 	return true;
 }
 
-Navi* NaviManager::getTopNavi(int x, int y)
+void NaviManager::setNativeTooltips(bool enabled, const NaviTooltipStyle& style)
 {
-	Navi* top = 0;
+	handleTooltip(0, L"");
 
-	for(iter = activeNavis.begin(); iter != activeNavis.end(); iter++)
+	if(nativeTooltip)
 	{
-		if(!iter->second->isPointOverMe(x, y))
-			continue;
+		delete nativeTooltip;
+		nativeTooltip = 0;
+	}
 
-		if(!top)
-			top = iter->second;
-		else
-			top = top->overlay->panel->getZOrder() > iter->second->overlay->panel->getZOrder()? top : iter->second;
+	if(enabled)
+	{
+		nativeTooltip = new Impl::NativeTooltip(style, defaultViewport);
+		destroyTooltipNavi();
 	}
+	else if(!tooltipNavi)
+	{
+		createTooltipNavi();
+	}
+}
 
-	return top;
+bool NaviManager::isUsingNativeTooltips()
+{
+	return nativeTooltip != 0;
 }
 
-void NaviManager::setDefaultViewport(Ogre::Viewport* viewport)
+void NaviManager::createTooltipNavi()
 {
-	for(iter = activeNavis.begin(); iter != activeNavis.end(); iter++)
+	tooltipNavi = new Navi("__tooltip", 250, 50, NaviPosition(0, 0), false, 70, 199, Front, defaultViewport);
+	tooltipNavi->hide();
+	tooltipNavi->setTransparent(true);
+	tooltipNavi->loadFile("tooltip.html");
+	tooltipNavi->bind("resizeTooltip", NaviDelegate(this, &NaviManager::onResizeTooltip));
+}
+
+void NaviManager::destroyTooltipNavi()
+{
+	if(!tooltipNavi)
+		return;
+
+	if(browserThread)
 	{
-		if(iter->second->overlay)
-			if(iter->second->overlay->viewport == defaultViewport)
-				iter->second->overlay->setViewport(viewport);
+		tooltipNavi->destroyWebView();
+		executeMainCommands();
 	}
 
-	defaultViewport = viewport;
+	for(CallbackQueue::iterator i = queuedCallbacks.begin(); i != queuedCallbacks.end();)
+	{
+		if(i->caller == tooltipNavi)
+			i = queuedCallbacks.erase(i);
+		else
+			i++;
+	}
+
+	delete tooltipNavi;
+	tooltipNavi = 0;
+}
+
+void NaviManager::setAllocationTracking(bool enabled, bool logEachFrame)
+{
+	Impl::setAllocationTracking(enabled);
+	Impl::takeAllocationCounts();
+
+	logFrameAllocations = enabled && logEachFrame;
+	lastFrameAllocations = NaviAllocationCounts();
+}
+
+NaviAllocationCounts NaviManager::getFrameAllocations()
+{
+	return lastFrameAllocations;
+}
+
+void NaviManager::logAllocations()
+{
+	std::ostringstream report;
+	report << "Navi allocations in frame " << frameNumber << ": " << lastFrameAllocations.getTotalCount();
+
+	for(int i = 0; i < AllocationTagCount; i++)
+		if(lastFrameAllocations.count[i])
+			report << ", " << getAllocationTagName((AllocationTag)i) << " " << lastFrameAllocations.count[i] 
+				<< " (" << lastFrameAllocations.bytes[i] << " bytes)";
+
+	Ogre::LogManager::getSingleton().logMessage(report.str());
 }
 
 void NaviManager::deFocusAllNavis()
 {
 	for(iter = activeNavis.begin(); iter != activeNavis.end(); iter++)
-		awe_webview_unfocus(iter->second->webView);
+		iter->second->focusWebView(false);
 
 	focusedNavi = 0;
 	isDraggingFocusedNavi = false;
@@ -488,26 +1071,31 @@ void NaviManager::deFocusAllNavis()
 void NaviManager::handleKeyMessage(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
 {
 	if(keyboardFocusedNavi && keyboardFocusedNavi != focusedNavi)
-		awe_webview_inject_keyboard_event_win(keyboardFocusedNavi->webView, msg, wParam, lParam);
+		keyboardFocusedNavi->injectKeyboardEvent(msg, wParam, lParam);
 	else if(focusedNavi)
-		awe_webview_inject_keyboard_event_win(focusedNavi->webView, msg, wParam, lParam);		
+		focusedNavi->injectKeyboardEvent(msg, wParam, lParam);		
 
 	for(iter = activeNavis.begin(); iter != activeNavis.end(); iter++)
 		if(iter->second->alwaysReceivesKeyboard && iter->second != keyboardFocusedNavi)
-			awe_webview_inject_keyboard_event_win(iter->second->webView, msg, wParam, lParam);	
+			iter->second->injectKeyboardEvent(msg, wParam, lParam);	
 }
 
 void NaviManager::onResizeTooltip(Navi* Navi, const OSM::JSArguments& args)
 {
-	if(args.size() != 2 || !tooltipParent)
+	if(args.size() != 2 || !tooltipParent || !tooltipNavi)
 		return;
 
 	tooltipNavi->resize(args[0].toInteger(), args[1].toInteger());
+	presentTooltip();
+}
+
+void NaviManager::presentTooltip()
+{
 	moveTooltip(mouseXPos, mouseYPos + 15);
 
 	if(lastTooltip + TIP_ENTRY_DELAY * 1000 > tooltipTimer.getMilliseconds())
 	{
-		tooltipNavi->show(true);
+		showTooltip();
 		lastTooltip = tooltipTimer.getMilliseconds();
 	}
 	else
@@ -516,15 +1104,46 @@ void NaviManager::onResizeTooltip(Navi* Navi, const OSM::JSArguments& args)
 	}
 }
 
+void NaviManager::showTooltip()
+{
+	if(nativeTooltip)
+		nativeTooltip->show();
+	else
+		tooltipNavi->show(true);
+}
+
+bool NaviManager::isTooltipVisible()
+{
+	return nativeTooltip ? nativeTooltip->getVisibility() : tooltipNavi->getVisibility();
+}
+
 void NaviManager::handleTooltip(Navi* tooltipParent, const std::wstring& tipText)
 {
+	if(deferToMain(this, &NaviManager::handleTooltip, tooltipParent, tipText))
+		return;
+
+	NAVI_TRACE_SCOPE("NaviManager::handleTooltip");
+
 	tooltipShowTime = 0;
-	tooltipNavi->hide(true);
+
+	if(nativeTooltip)
+		nativeTooltip->hide();
+	else
+		tooltipNavi->hide(true);
 
 	if(tipText.length())
 	{
 		this->tooltipParent = tooltipParent;
-		tooltipNavi->evaluateJS("setTooltip(?)", JSArgs(tipText));
+
+		if(nativeTooltip)
+		{
+			nativeTooltip->setText(tipText);
+			presentTooltip();
+		}
+		else
+		{
+			tooltipNavi->evaluateJS("setTooltip(?)", JSArgs(tipText));
+		}
 	}
 	else
 	{
@@ -540,13 +1159,16 @@ void NaviManager::handleRequestDrag(Navi* caller)
 
 void NaviManager::handleKeyboardFocusChange(Navi* caller, bool isFocused)
 {
+	if(deferToMain(this, &NaviManager::handleKeyboardFocusChange, caller, isFocused))
+		return;
+
 	if(isFocused)
 	{
 		if(!caller->isMaterialOnly())
 		{
 			if(!caller->getOverlay()->getVisibility())
 			{
-				awe_webview_unfocus(caller->webView);
+				caller->focusWebView(false);
 
 				if(keyboardFocusedNavi == caller)
 					keyboardFocusedNavi = 0;
@@ -556,11 +1178,11 @@ void NaviManager::handleKeyboardFocusChange(Navi* caller, bool isFocused)
 		}				
 
 		keyboardFocusedNavi = caller;
-		awe_webview_focus(keyboardFocusedNavi->webView);
+		keyboardFocusedNavi->focusWebView(true);
 
 		for(iter = activeNavis.begin(); iter != activeNavis.end(); iter++)
 			if(iter->second != keyboardFocusedNavi)
-				awe_webview_unfocus(iter->second->webView);
+				iter->second->focusWebView(false);
 	}
 	else if(caller == keyboardFocusedNavi)
 	{
@@ -596,18 +1218,16 @@ void NaviManager::handleNaviHide(Navi* caller)
 
 		if(keyboardFocusedNavi == caller)
 		{
-			awe_webview_unfocus(keyboardFocusedNavi->webView);
+			keyboardFocusedNavi->focusWebView(false);
 			keyboardFocusedNavi = 0;
 		}
 	}
 }
 
-void NaviManager::queueCallback(Navi* caller, const OSM::JSArguments& args, const NaviDelegate& callback)
+void NaviManager::queueCallback(const CallbackInvocation& invocation)
 {
-	CallbackInvocation invocation;
-	invocation.caller = caller;
-	invocation.args = args;
-	invocation.callback = callback;
+	if(deferToMain(this, &NaviManager::queueCallback, invocation))
+		return;
 
 	queuedCallbacks.push_back(invocation);
 }
@@ -629,8 +1249,16 @@ void NaviManager::moveTooltip(int x, int y)
 		if(x < left || x > width + left || y < top || y > height + top)
 			continue;
 
-		tooltipNavi->setViewport(vp);
-		tooltipNavi->setPosition(NaviPosition(x - left, y - top));
+		if(nativeTooltip)
+		{
+			nativeTooltip->setViewport(vp);
+			nativeTooltip->setPosition(x - left, y - top);
+		}
+		else
+		{
+			tooltipNavi->setViewport(vp);
+			tooltipNavi->setPosition(NaviPosition(x - left, y - top));
+		}
 		break;
 	}
 }
\ No newline at end of file
@@ -0,0 +1,462 @@
+/*
+	This file is part of NaviLibrary, a library that allows developers to create and 
+	interact with web-content as an overlay or material in Ogre3D applications.
+
+	Copyright (C) 2011 Khrona LLC
+	https://github.com/khrona/navi
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "NaviRecorder.h"
+#include "NaviStats.h"
+#include "NaviTrace.h"
+#include <string.h>
+
+using namespace NaviLibrary;
+using namespace NaviLibrary::Impl;
+
+namespace
+{
+	// PNG chunk checksums, the table is filled during static initialization so that encoders can share it
+	struct CRCTable
+	{
+		unsigned long entries[256];
+
+		CRCTable()
+		{
+			for(unsigned long n = 0; n < 256; n++)
+			{
+				unsigned long c = n;
+
+				for(int k = 0; k < 8; k++)
+					c = c & 1 ? 0xedb88320UL ^ (c >> 1) : c >> 1;
+
+				entries[n] = c;
+			}
+		}
+	};
+
+	const CRCTable crcTable;
+
+	unsigned long updateCRC(unsigned long crc, const unsigned char* data, size_t length)
+	{
+		for(size_t i = 0; i < length; i++)
+			crc = crcTable.entries[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+
+		return crc;
+	}
+
+	void writeBE32(FILE* file, unsigned long value)
+	{
+		unsigned char bytes[4] = { (unsigned char)(value >> 24), (unsigned char)(value >> 16), (unsigned char)(value >> 8), (unsigned char)value };
+		fwrite(bytes, 1, 4, file);
+	}
+
+	// Writes part of a chunk's payload and folds it into the chunk's CRC
+	void writeChunkData(FILE* file, const unsigned char* data, size_t length, unsigned long& crc)
+	{
+		fwrite(data, 1, length, file);
+		crc = updateCRC(crc, data, length);
+	}
+
+	void writeChunk(FILE* file, const char* type, const unsigned char* data, size_t length)
+	{
+		unsigned long crc = 0xffffffffUL;
+
+		writeBE32(file, (unsigned long)length);
+		writeChunkData(file, (const unsigned char*)type, 4, crc);
+		writeChunkData(file, data, length, crc);
+		writeBE32(file, crc ^ 0xffffffffUL);
+	}
+
+	// Y'CbCr (BT.601, studio swing) from 8-bit RGB
+	inline unsigned char toY(int r, int g, int b) { return (unsigned char)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16); }
+	inline unsigned char toU(int r, int g, int b) { return (unsigned char)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128); }
+	inline unsigned char toV(int r, int g, int b) { return (unsigned char)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128); }
+}
+
+FrameRecorder::FrameRecorder(const std::string& filename, RecordingFormat format, RecordingPolicy policy, 
+	unsigned int bufferCount, unsigned int frameRate) : filename(filename), format(format), policy(policy), 
+	bufferCount(bufferCount ? bufferCount : 1), frameRate(frameRate ? frameRate : 30), thread(0), isStopping(false), 
+	frameWidth(0), frameHeight(0), startTime(0), file(0), isWritable(false), hasHeader(false), hasPendingFrame(false), slotsWritten(0)
+{
+	if(format == Y4MRecording)
+	{
+		file = fopen(filename.c_str(), "wb");
+		isWritable = file != 0;
+	}
+	else
+	{
+		// Make sure the first image of the sequence can be created
+		FILE* image = fopen((filename + "_000000.png").c_str(), "wb");
+		isWritable = image != 0;
+
+		if(image)
+			fclose(image);
+	}
+
+	InitializeCriticalSection(&lock);
+	frameReadyEvent = CreateEvent(0, FALSE, FALSE, 0);
+	bufferFreeEvent = CreateEvent(0, FALSE, FALSE, 0);
+	thread = CreateThread(0, 0, &FrameRecorder::encoderProc, this, 0, 0);
+
+	// Without an encoder nothing would ever free a buffer, report the recording as failed instead
+	if(!thread)
+	{
+		if(file)
+		{
+			fclose(file);
+			file = 0;
+		}
+
+		isWritable = false;
+	}
+}
+
+FrameRecorder::~FrameRecorder()
+{
+	unsigned long long stopTime = getTimestampUS();
+
+	if(thread)
+	{
+		// The encoder drains every queued frame before it exits
+		isStopping = true;
+		SetEvent(frameReadyEvent);
+		WaitForSingleObject(thread, INFINITE);
+		CloseHandle(thread);
+	}
+
+	// The last frame stays on screen until the recording stops, so it fills every slot up to and including that time
+	if(hasPendingFrame)
+	{
+		unsigned long long stopSlot = (stopTime - startTime) * frameRate / 1000000 + 1;
+
+		while(slotsWritten < stopSlot)
+			writePendingY4MFrame();
+	}
+
+	CloseHandle(frameReadyEvent);
+	CloseHandle(bufferFreeEvent);
+	DeleteCriticalSection(&lock);
+
+	if(file)
+		fclose(file);
+
+	for(std::vector<Buffer*>::iterator i = freeBuffers.begin(); i != freeBuffers.end(); i++)
+	{
+		delete[] (*i)->pixels;
+		delete *i;
+	}
+}
+
+bool FrameRecorder::isOpen() const
+{
+	return isWritable;
+}
+
+void FrameRecorder::submit(const unsigned char* pixels, int width, int height, int rowSpan)
+{
+	if(!frameWidth)
+	{
+		allocateBuffers(width, height);
+		startTime = getTimestampUS();
+	}
+
+	EnterCriticalSection(&lock);
+
+	stats.framesCaptured++;
+
+	// Buffers (and Y4M streams) have a fixed size, so frames from before a resize has settled are skipped
+	if(width != frameWidth || height != frameHeight)
+	{
+		stats.framesDropped++;
+		LeaveCriticalSection(&lock);
+		return;
+	}
+
+	while(freeBuffers.empty())
+	{
+		if(policy == DropFrames)
+		{
+			stats.framesDropped++;
+			LeaveCriticalSection(&lock);
+			return;
+		}
+
+		LeaveCriticalSection(&lock);
+		WaitForSingleObject(bufferFreeEvent, INFINITE);
+		EnterCriticalSection(&lock);
+	}
+
+	Buffer* buffer = freeBuffers.back();
+	freeBuffers.pop_back();
+
+	LeaveCriticalSection(&lock);
+
+	for(int row = 0; row < height; row++)
+		memcpy(buffer->pixels + row * width * 4, pixels + row * rowSpan, width * 4);
+
+	buffer->timestamp = getTimestampUS();
+
+	EnterCriticalSection(&lock);
+	readyBuffers.push_back(buffer);
+	LeaveCriticalSection(&lock);
+
+	SetEvent(frameReadyEvent);
+}
+
+NaviRecordingStats FrameRecorder::getStats()
+{
+	EnterCriticalSection(&lock);
+	NaviRecordingStats result = stats;
+	LeaveCriticalSection(&lock);
+
+	return result;
+}
+
+void FrameRecorder::allocateBuffers(int width, int height)
+{
+	frameWidth = width;
+	frameHeight = height;
+
+	freeBuffers.reserve(bufferCount);
+	readyBuffers.reserve(bufferCount);
+
+	for(unsigned int i = 0; i < bufferCount; i++)
+	{
+		Buffer* buffer = new Buffer();
+		buffer->pixels = new unsigned char[width * height * 4];
+		buffer->width = width;
+		buffer->height = height;
+		buffer->timestamp = 0;
+		freeBuffers.push_back(buffer);
+	}
+}
+
+void FrameRecorder::encode(Buffer* buffer)
+{
+	NAVI_TRACE_SCOPE("Encode frame");
+
+	if(format == Y4MRecording)
+		writeY4M(buffer);
+	else
+		writePNG(buffer);
+}
+
+void FrameRecorder::writeY4M(Buffer* buffer)
+{
+	if(!file)
+		return;
+
+	// 4:2:0 needs even dimensions, an odd last row or column is cropped
+	int width = buffer->width & ~1;
+	int height = buffer->height & ~1;
+
+	if(!width || !height)
+		return;
+
+	if(!hasHeader)
+	{
+		fprintf(file, "YUV4MPEG2 W%d H%d F%u:1 Ip A1:1 C420jpeg\n", width, height, frameRate);
+		hasHeader = true;
+	}
+
+	// Y4M has a constant frame rate, so the previous frame is repeated until this one's time slot comes up. A frame is
+	// only written once its slots are over, one that is replaced within its own slot is never written.
+	unsigned long long slot = (buffer->timestamp - startTime) * frameRate / 1000000;
+
+	while(hasPendingFrame && slotsWritten < slot)
+		writePendingY4MFrame();
+
+	encodeBuffer.resize(width * height * 3 / 2);
+
+	unsigned char* yPlane = &encodeBuffer[0];
+	unsigned char* uPlane = yPlane + width * height;
+	unsigned char* vPlane = uPlane + width * height / 4;
+	int pitch = buffer->width * 4;
+
+	for(int y = 0; y < height; y += 2)
+	{
+		const unsigned char* row0 = buffer->pixels + y * pitch;
+		const unsigned char* row1 = row0 + pitch;
+
+		for(int x = 0; x < width; x += 2)
+		{
+			const unsigned char* p00 = row0 + x * 4;
+			const unsigned char* p01 = p00 + 4;
+			const unsigned char* p10 = row1 + x * 4;
+			const unsigned char* p11 = p10 + 4;
+
+			yPlane[y * width + x] = toY(p00[2], p00[1], p00[0]);
+			yPlane[y * width + x + 1] = toY(p01[2], p01[1], p01[0]);
+			yPlane[(y + 1) * width + x] = toY(p10[2], p10[1], p10[0]);
+			yPlane[(y + 1) * width + x + 1] = toY(p11[2], p11[1], p11[0]);
+
+			int r = (p00[2] + p01[2] + p10[2] + p11[2] + 2) / 4;
+			int g = (p00[1] + p01[1] + p10[1] + p11[1] + 2) / 4;
+			int b = (p00[0] + p01[0] + p10[0] + p11[0] + 2) / 4;
+
+			uPlane[y / 2 * width / 2 + x / 2] = toU(r, g, b);
+			vPlane[y / 2 * width / 2 + x / 2] = toV(r, g, b);
+		}
+	}
+
+	hasPendingFrame = true;
+}
+
+void FrameRecorder::writePendingY4MFrame()
+{
+	fwrite("FRAME\n", 1, 6, file);
+	fwrite(&encodeBuffer[0], 1, encodeBuffer.size(), file);
+	slotsWritten++;
+
+	EnterCriticalSection(&lock);
+	stats.framesEncoded++;
+	stats.bytesWritten += 6 + encodeBuffer.size();
+	LeaveCriticalSection(&lock);
+}
+
+void FrameRecorder::writePNG(Buffer* buffer)
+{
+	char suffix[32];
+	sprintf(suffix, "_%06lu.png", stats.framesEncoded);
+
+	FILE* image = fopen((filename + suffix).c_str(), "wb");
+
+	if(!image)
+	{
+		EnterCriticalSection(&lock);
+		stats.framesDropped++;
+		LeaveCriticalSection(&lock);
+		return;
+	}
+
+	int width = buffer->width;
+	int height = buffer->height;
+	size_t rowLength = width * 4 + 1;
+
+	// Each row is prefixed with filter type 0 (none) and converted from BGRA to RGBA
+	encodeBuffer.resize(rowLength * height);
+
+	for(int y = 0; y < height; y++)
+	{
+		unsigned char* dest = &encodeBuffer[y * rowLength];
+		const unsigned char* source = buffer->pixels + y * width * 4;
+
+		*dest++ = 0;
+
+		for(int x = 0; x < width; x++, dest += 4, source += 4)
+		{
+			dest[0] = source[2];
+			dest[1] = source[1];
+			dest[2] = source[0];
+			dest[3] = source[3];
+		}
+	}
+
+	static const unsigned char signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+	fwrite(signature, 1, 8, image);
+
+	unsigned char header[13] = { (unsigned char)(width >> 24), (unsigned char)(width >> 16), (unsigned char)(width >> 8), (unsigned char)width, 
+		(unsigned char)(height >> 24), (unsigned char)(height >> 16), (unsigned char)(height >> 8), (unsigned char)height, 
+		8, 6, 0, 0, 0 };
+	writeChunk(image, "IHDR", header, sizeof(header));
+
+	// The image data is stored in uncompressed deflate blocks so that encoding stays cheap and dependency-free
+	const size_t maxBlockLength = 65535;
+	size_t rawLength = encodeBuffer.size();
+	size_t blockCount = (rawLength + maxBlockLength - 1) / maxBlockLength;
+	unsigned long crc = 0xffffffffUL;
+	unsigned long adlerA = 1, adlerB = 0;
+
+	writeBE32(image, (unsigned long)(2 + rawLength + blockCount * 5 + 4));
+	writeChunkData(image, (const unsigned char*)"IDAT", 4, crc);
+
+	const unsigned char zlibHeader[2] = { 0x78, 0x01 };
+	writeChunkData(image, zlibHeader, 2, crc);
+
+	for(size_t offset = 0; offset < rawLength; offset += maxBlockLength)
+	{
+		size_t length = rawLength - offset < maxBlockLength ? rawLength - offset : maxBlockLength;
+		unsigned char blockHeader[5] = { (unsigned char)(offset + length == rawLength ? 1 : 0), 
+			(unsigned char)length, (unsigned char)(length >> 8), (unsigned char)~length, (unsigned char)(~length >> 8) };
+
+		writeChunkData(image, blockHeader, 5, crc);
+		writeChunkData(image, &encodeBuffer[offset], length, crc);
+
+		for(size_t i = 0; i < length; i++)
+		{
+			adlerA = (adlerA + encodeBuffer[offset + i]) % 65521;
+			adlerB = (adlerB + adlerA) % 65521;
+		}
+	}
+
+	unsigned long adler = (adlerB << 16) | adlerA;
+	unsigned char adlerBytes[4] = { (unsigned char)(adler >> 24), (unsigned char)(adler >> 16), (unsigned char)(adler >> 8), (unsigned char)adler };
+	writeChunkData(image, adlerBytes, 4, crc);
+	writeBE32(image, crc ^ 0xffffffffUL);
+
+	writeChunk(image, "IEND", 0, 0);
+
+	long fileSize = ftell(image);
+	fclose(image);
+
+	EnterCriticalSection(&lock);
+	stats.framesEncoded++;
+	stats.bytesWritten += fileSize;
+	LeaveCriticalSection(&lock);
+}
+
+DWORD WINAPI FrameRecorder::encoderProc(LPVOID param)
+{
+	FrameRecorder* recorder = static_cast<FrameRecorder*>(param);
+
+	NAVI_TRACE_THREAD("Recorder thread");
+
+	for(;;)
+	{
+		WaitForSingleObject(recorder->frameReadyEvent, INFINITE);
+
+		for(;;)
+		{
+			EnterCriticalSection(&recorder->lock);
+
+			if(recorder->readyBuffers.empty())
+			{
+				LeaveCriticalSection(&recorder->lock);
+				break;
+			}
+
+			Buffer* buffer = recorder->readyBuffers.front();
+			recorder->readyBuffers.erase(recorder->readyBuffers.begin());
+
+			LeaveCriticalSection(&recorder->lock);
+
+			recorder->encode(buffer);
+
+			EnterCriticalSection(&recorder->lock);
+			recorder->freeBuffers.push_back(buffer);
+			LeaveCriticalSection(&recorder->lock);
+
+			SetEvent(recorder->bufferFreeEvent);
+		}
+
+		if(recorder->isStopping)
+			break;
+	}
+
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,141 @@
+/*
+	This file is part of NaviLibrary, a library that allows developers to create and 
+	interact with web-content as an overlay or material in Ogre3D applications.
+
+	Copyright (C) 2011 Khrona LLC
+	https://github.com/khrona/navi
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "NaviThreading.h"
+
+using namespace NaviLibrary::Impl;
+
+#define FRESH_FRAME_FLAG 0x4
+
+CommandQueue::CommandQueue() : head(&stub), tail(&stub)
+{
+}
+
+CommandQueue::~CommandQueue()
+{
+	while(Command* command = pop())
+		delete command;
+}
+
+void CommandQueue::push(Command* command)
+{
+	command->next = 0;
+	Command* previous = (Command*)InterlockedExchangePointer((PVOID volatile*)&head, command);
+	previous->next = command;
+}
+
+Command* CommandQueue::pop()
+{
+	Command* first = tail;
+	Command* next = first->next;
+
+	if(first == &stub)
+	{
+		if(!next)
+			return 0;
+
+		tail = next;
+		first = next;
+		next = next->next;
+	}
+
+	if(next)
+	{
+		tail = next;
+		return first;
+	}
+
+	// 'first' is the last command, re-insert the stub so it can be detached. If a producer is halfway
+	// through a push, try again later.
+	if(first != head)
+		return 0;
+
+	push(&stub);
+
+	next = first->next;
+
+	if(next)
+	{
+		tail = next;
+		return first;
+	}
+
+	return 0;
+}
+
+FrameTripleBuffer::FrameTripleBuffer() : backIndex(0), frontIndex(1), middleState(2)
+{
+	for(int i = 0; i < 3; i++)
+	{
+		frames[i].buffer = 0;
+		frames[i].width = frames[i].height = frames[i].rowSpan = frames[i].capacity = 0;
+	}
+}
+
+FrameTripleBuffer::~FrameTripleBuffer()
+{
+	for(int i = 0; i < 3; i++)
+		if(frames[i].buffer)
+			delete[] frames[i].buffer;
+}
+
+Frame& FrameTripleBuffer::getBackFrame(int width, int height)
+{
+	Frame& frame = frames[backIndex];
+
+	if(frame.capacity < width * height * 4)
+	{
+		if(frame.buffer)
+			delete[] frame.buffer;
+
+		frame.capacity = width * height * 4;
+		frame.buffer = new unsigned char[frame.capacity];
+	}
+
+	frame.width = width;
+	frame.height = height;
+	frame.rowSpan = width * 4;
+
+	return frame;
+}
+
+void FrameTripleBuffer::publish()
+{
+	LONG previous = InterlockedExchange(&middleState, backIndex | FRESH_FRAME_FLAG);
+	backIndex = previous & ~FRESH_FRAME_FLAG;
+}
+
+bool FrameTripleBuffer::acquire()
+{
+	if(!(middleState & FRESH_FRAME_FLAG))
+		return false;
+
+	LONG previous = InterlockedExchange(&middleState, frontIndex);
+	frontIndex = previous & ~FRESH_FRAME_FLAG;
+
+	return true;
+}
+
+const Frame& FrameTripleBuffer::getFrontFrame()
+{
+	return frames[frontIndex];
+}
\ No newline at end of file
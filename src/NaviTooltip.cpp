@@ -0,0 +1,220 @@
+/*
+	This file is part of NaviLibrary, a library that allows developers to create and 
+	interact with web-content as an overlay or material in Ogre3D applications.
+
+	Copyright (C) 2011 Khrona LLC
+	https://github.com/khrona/navi
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "NaviTooltip.h"
+#include "NaviUtilities.h"
+#include <OGRE/OgreTextAreaOverlayElement.h>
+#include <OGRE/OgreFontManager.h>
+
+using namespace Ogre;
+using namespace NaviLibrary;
+using namespace NaviLibrary::Impl;
+
+#define TOOLTIP_BORDER_MATERIAL "NaviTooltipBorderMaterial"
+#define TOOLTIP_BACKGROUND_MATERIAL "NaviTooltipBackgroundMaterial"
+
+namespace
+{
+	void createSolidMaterial(const Ogre::String& name, const ColourValue& color)
+	{
+		MaterialPtr material = MaterialManager::getSingleton().create(name, ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
+		Pass* matPass = material->getTechnique(0)->getPass(0);
+		matPass->setLightingEnabled(false);
+		matPass->setDepthCheckEnabled(false);
+		matPass->setDepthWriteEnabled(false);
+		matPass->setSceneBlending(SBT_TRANSPARENT_ALPHA);
+
+		TextureUnitState* texUnit = matPass->createTextureUnitState();
+		texUnit->setColourOperationEx(LBX_SOURCE1, LBS_MANUAL, LBS_CURRENT, color);
+		texUnit->setAlphaOperation(LBX_SOURCE1, LBS_MANUAL, LBS_CURRENT, color.a);
+	}
+}
+
+NaviTooltipStyle::NaviTooltipStyle(const Ogre::String& fontName, Real charHeight) : fontName(fontName), charHeight(charHeight), 
+	maxWidth(175), padding(5), textColor(0x68 / 255.0f, 0x80 / 255.0f, 0xa9 / 255.0f), 
+	backgroundColor(0xf1 / 255.0f, 0xf7 / 255.0f, 0xfd / 255.0f), borderColor(0x8a / 255.0f, 0x9f / 255.0f, 0xc5 / 255.0f)
+{
+}
+
+NativeTooltip::NativeTooltip(const NaviTooltipStyle& style, Ogre::Viewport* viewport) : style(style), overlay(0), 
+	background(0), textArea(0), font(0), spaceWidth(0)
+{
+	font = static_cast<Font*>(FontManager::getSingleton().getByName(style.fontName).get());
+
+	if(!font)
+		OGRE_EXCEPT(Ogre::Exception::ERR_ITEM_NOT_FOUND, 
+			"Could not find the font '" + style.fontName + "' for native tooltips.", 
+			"NativeTooltip::NativeTooltip");
+
+	font->load();
+	spaceWidth = getCharWidth(L'0');
+
+	createSolidMaterial(TOOLTIP_BORDER_MATERIAL, style.borderColor);
+	createSolidMaterial(TOOLTIP_BACKGROUND_MATERIAL, style.backgroundColor);
+
+	overlay = new NaviOverlay("NaviNativeTooltip", viewport, 1, 1, NaviPosition(0, 0), TOOLTIP_BORDER_MATERIAL, 199, Front);
+	overlay->hide();
+
+	OverlayManager& overlayManager = OverlayManager::getSingleton();
+
+	background = static_cast<PanelOverlayElement*>(overlayManager.createOverlayElement("Panel", "NaviNativeTooltipBackground"));
+	background->setMetricsMode(GMM_PIXELS);
+	background->setMaterialName(TOOLTIP_BACKGROUND_MATERIAL);
+	background->setPosition(1, 1);
+	overlay->panel->addChild(background);
+
+	textArea = static_cast<TextAreaOverlayElement*>(overlayManager.createOverlayElement("TextArea", "NaviNativeTooltipText"));
+	textArea->setMetricsMode(GMM_PIXELS);
+	textArea->setFontName(style.fontName);
+	textArea->setCharHeight(style.charHeight);
+	textArea->setSpaceWidth(spaceWidth);
+	textArea->setColour(style.textColor);
+	textArea->setAlignment(TextAreaOverlayElement::Center);
+	background->addChild(textArea);
+}
+
+NativeTooltip::~NativeTooltip()
+{
+	OverlayManager& overlayManager = OverlayManager::getSingleton();
+
+	background->removeChild(textArea->getName());
+	overlayManager.destroyOverlayElement(textArea);
+	overlay->panel->removeChild(background->getName());
+	overlayManager.destroyOverlayElement(background);
+
+	delete overlay;
+
+	MaterialManager::getSingleton().remove(TOOLTIP_BORDER_MATERIAL);
+	MaterialManager::getSingleton().remove(TOOLTIP_BACKGROUND_MATERIAL);
+}
+
+void NativeTooltip::setText(const std::wstring& text)
+{
+	Real textWidth = 0;
+	int lineCount = 0;
+	std::wstring wrappedText = wrapText(text, textWidth, lineCount);
+
+#if OGRE_UNICODE_SUPPORT
+	textArea->setCaption(DisplayString(wrappedText));
+#else
+	textArea->setCaption(NaviUtilities::toMultibyte(wrappedText));
+#endif
+
+	int contentWidth = (int)Math::Ceil(textWidth);
+	int contentHeight = (int)Math::Ceil(lineCount * style.charHeight);
+
+	// Lines are centered on the text area's origin
+	textArea->setPosition(style.padding + contentWidth / 2, style.padding);
+	background->setDimensions(contentWidth + style.padding * 2, contentHeight + style.padding * 2);
+	overlay->resize(contentWidth + style.padding * 2 + 2, contentHeight + style.padding * 2 + 2);
+}
+
+void NativeTooltip::setViewport(Ogre::Viewport* viewport)
+{
+	if(overlay->viewport != viewport)
+		overlay->setViewport(viewport);
+}
+
+void NativeTooltip::setPosition(int x, int y)
+{
+	overlay->setPosition(NaviPosition(x, y));
+}
+
+void NativeTooltip::show()
+{
+	overlay->show();
+}
+
+void NativeTooltip::hide()
+{
+	overlay->hide();
+}
+
+bool NativeTooltip::getVisibility() const
+{
+	return overlay->getVisibility();
+}
+
+Real NativeTooltip::getCharWidth(wchar_t character) const
+{
+	if(character == L' ')
+		return spaceWidth;
+
+	return font->getGlyphAspectRatio((Font::CodePoint)character) * style.charHeight;
+}
+
+std::wstring NativeTooltip::wrapText(const std::wstring& text, Real& width, int& lineCount) const
+{
+	std::wstring result;
+	Real lineWidth = 0;
+	width = 0;
+	lineCount = 1;
+
+	for(size_t i = 0; i < text.length();)
+	{
+		if(text[i] == L'\n')
+		{
+			result += L'\n';
+			width = std::max(width, lineWidth);
+			lineWidth = 0;
+			lineCount++;
+			i++;
+			continue;
+		}
+
+		size_t wordEnd = text.find_first_of(L" \n", i);
+		if(wordEnd == std::wstring::npos)
+			wordEnd = text.length();
+
+		// Runs of spaces collapse, as they would in the web-view tooltip
+		if(wordEnd == i)
+		{
+			i++;
+			continue;
+		}
+
+		Real wordWidth = 0;
+		for(size_t c = i; c < wordEnd; c++)
+			wordWidth += getCharWidth(text[c]);
+
+		if(lineWidth > 0 && lineWidth + spaceWidth + wordWidth > style.maxWidth)
+		{
+			result += L'\n';
+			width = std::max(width, lineWidth);
+			lineWidth = 0;
+			lineCount++;
+		}
+		else if(lineWidth > 0)
+		{
+			result += L' ';
+			lineWidth += spaceWidth;
+		}
+
+		result.append(text, i, wordEnd - i);
+		lineWidth += wordWidth;
+		i = wordEnd;
+	}
+
+	width = std::max(width, lineWidth);
+
+	return result;
+}
\ No newline at end of file
@@ -0,0 +1,224 @@
+/*
+	This file is part of NaviLibrary, a library that allows developers to create and 
+	interact with web-content as an overlay or material in Ogre3D applications.
+
+	Copyright (C) 2011 Khrona LLC
+	https://github.com/khrona/navi
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "NaviTrace.h"
+#include <fstream>
+#include <string.h>
+
+using namespace NaviLibrary::Impl;
+
+volatile bool TraceRecorder::isEnabled = false;
+TraceRecorder::Buffer* volatile TraceRecorder::buffer = 0;
+volatile LONG TraceRecorder::writeIndex = 0;
+TraceRecorder::ThreadName TraceRecorder::threadNames[TraceRecorder::MAX_THREADS];
+volatile LONG TraceRecorder::threadNameCount = 0;
+
+namespace
+{
+	void copyName(char* dest, const char* source, size_t destSize)
+	{
+		if(!source)
+			source = "";
+
+		strncpy(dest, source, destSize - 1);
+		dest[destSize - 1] = 0;
+	}
+
+	void writeEscaped(std::ofstream& file, const char* text)
+	{
+		for(; *text; text++)
+		{
+			if(*text == '"' || *text == '\\')
+				file << '\\' << *text;
+			else if((unsigned char)*text >= 0x20)
+				file << *text;
+		}
+	}
+}
+
+void TraceRecorder::start(unsigned int capacity)
+{
+	stop();
+
+	// Round the capacity up to a power of two so that slots can be found with a mask
+	LONG roundedCapacity = 1;
+	while(roundedCapacity < (LONG)capacity && roundedCapacity < 0x40000000)
+		roundedCapacity <<= 1;
+
+	if(!buffer || buffer->capacityMask + 1 != roundedCapacity)
+	{
+		Buffer* newBuffer = new Buffer;
+		newBuffer->events = new Event[roundedCapacity];
+		newBuffer->capacityMask = roundedCapacity - 1;
+		newBuffer->retired = buffer;
+
+		for(LONG i = 0; i < roundedCapacity; i++)
+			newBuffer->events[i].sequence = 0;
+
+		// Writers pick up the events and their mask together, through a single pointer
+		InterlockedExchangePointer((PVOID volatile*)&buffer, newBuffer);
+	}
+	else
+	{
+		for(LONG i = 0; i <= buffer->capacityMask; i++)
+			buffer->events[i].sequence = 0;
+	}
+
+	InterlockedExchange(&writeIndex, 0);
+
+	isEnabled = true;
+}
+
+void TraceRecorder::stop()
+{
+	isEnabled = false;
+}
+
+void TraceRecorder::shutdown()
+{
+	stop();
+
+	// By now every thread that could record has been stopped
+	while(buffer)
+	{
+		Buffer* retired = buffer->retired;
+		delete[] buffer->events;
+		delete buffer;
+		buffer = retired;
+	}
+}
+
+void TraceRecorder::record(const char* name, const char* detail, unsigned long long startTime, unsigned long long duration)
+{
+	Buffer* current = buffer;
+
+	if(!current)
+		return;
+
+	LONG index = InterlockedIncrement(&writeIndex) - 1;
+	Event& event = current->events[index & current->capacityMask];
+
+	// The sequence is cleared while the slot is being written so that save() can skip torn events
+	InterlockedExchange(&event.sequence, 0);
+
+	event.threadId = GetCurrentThreadId();
+	event.startTime = startTime;
+	event.duration = duration;
+	copyName(event.name, name, MAX_NAME_LENGTH);
+	copyName(event.detail, detail, MAX_NAME_LENGTH);
+
+	InterlockedExchange(&event.sequence, index + 1);
+}
+
+void TraceRecorder::nameThread(const char* name)
+{
+	DWORD threadId = GetCurrentThreadId();
+
+	for(LONG i = 0; i < threadNameCount && i < MAX_THREADS; i++)
+	{
+		if(threadNames[i].threadId == threadId)
+		{
+			copyName(threadNames[i].name, name, MAX_NAME_LENGTH);
+			return;
+		}
+	}
+
+	LONG index = InterlockedIncrement(&threadNameCount) - 1;
+
+	if(index >= MAX_THREADS)
+		return;
+
+	copyName(threadNames[index].name, name, MAX_NAME_LENGTH);
+	threadNames[index].threadId = threadId;
+}
+
+bool TraceRecorder::save(const std::string& filename)
+{
+	std::ofstream file(filename.c_str());
+
+	if(!file.is_open())
+		return false;
+
+	file << "{\"traceEvents\":[";
+
+	bool isFirst = true;
+	DWORD processId = GetCurrentProcessId();
+
+	for(LONG i = 0; i < threadNameCount && i < MAX_THREADS; i++)
+	{
+		if(!threadNames[i].threadId)
+			continue;
+
+		file << (isFirst ? "\n" : ",\n");
+		file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << processId << ",\"tid\":" << threadNames[i].threadId;
+		file << ",\"args\":{\"name\":\"";
+		writeEscaped(file, threadNames[i].name);
+		file << "\"}}";
+		isFirst = false;
+	}
+
+	Buffer* current = buffer;
+
+	if(current)
+	{
+		LONG capacityMask = current->capacityMask;
+		LONG endIndex = writeIndex;
+		LONG beginIndex = endIndex > capacityMask + 1 ? endIndex - (capacityMask + 1) : 0;
+
+		for(LONG i = beginIndex; i < endIndex; i++)
+		{
+			const Event& slot = current->events[i & capacityMask];
+			LONG sequence = slot.sequence;
+
+			if(sequence != i + 1)
+				continue;
+
+			MemoryBarrier();
+			Event event = slot;
+			MemoryBarrier();
+
+			// Skip events that were overwritten while being copied
+			if(slot.sequence != sequence)
+				continue;
+
+			file << (isFirst ? "\n" : ",\n");
+			file << "{\"name\":\"";
+			writeEscaped(file, event.name);
+			file << "\",\"cat\":\"navi\",\"ph\":\"X\",\"pid\":" << processId << ",\"tid\":" << event.threadId;
+			file << ",\"ts\":" << event.startTime << ",\"dur\":" << event.duration;
+
+			if(event.detail[0])
+			{
+				file << ",\"args\":{\"detail\":\"";
+				writeEscaped(file, event.detail);
+				file << "\"}";
+			}
+
+			file << "}";
+			isFirst = false;
+		}
+	}
+
+	file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+	return file.good();
+}
\ No newline at end of file
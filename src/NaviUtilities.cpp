@@ -22,6 +22,7 @@
 
 #include "NaviUtilities.h"
 #include "NaviManager.h"
+#include "NaviAllocator.h"
 #include <ctype.h>
 #if OGRE_PLATFORM == OGRE_PLATFORM_WIN32
 #include <direct.h>
@@ -61,20 +62,20 @@ bool NaviUtilities::isNumeric(const std::string &numberString)
 std::wstring NaviUtilities::toWide(const std::string &stringToConvert)
 {
 	size_t size = mbstowcs(0, stringToConvert.c_str(), 0) + 1;
-	wchar_t *temp = new wchar_t[size];
+	wchar_t *temp = static_cast<wchar_t*>(Impl::allocate(size * sizeof(wchar_t), StringAllocations));
 	mbstowcs(temp, stringToConvert.c_str(), size);
 	std::wstring result(temp);
-	delete[] temp;
+	Impl::deallocate(temp, size * sizeof(wchar_t), StringAllocations);
 	return result;
 }
 
 std::string NaviUtilities::toMultibyte(const std::wstring &wstringToConvert)
 {
 	size_t size = wcstombs(0, wstringToConvert.c_str(), 0) + 1;
-	char *temp = new char[size];
+	char *temp = static_cast<char*>(Impl::allocate(size, StringAllocations));
 	wcstombs(temp, wstringToConvert.c_str(), size);
 	std::string result(temp);
-	delete[] temp;
+	Impl::deallocate(temp, size, StringAllocations);
 	return result;
 }
 
@@ -0,0 +1,120 @@
+/*
+	This file is part of NaviLibrary, a library that allows developers to create and 
+	interact with web-content as an overlay or material in Ogre3D applications.
+
+	Copyright (C) 2011 Khrona LLC
+	https://github.com/khrona/navi
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "WorkerPool.h"
+#include "NaviTrace.h"
+
+using namespace NaviLibrary::Impl;
+
+WorkerPool::WorkerPool(unsigned int numWorkers) : taskFunction(0), taskUserData(0), nextTask(0), taskCount(0), isShuttingDown(false)
+{
+	if(numWorkers > MAXIMUM_WAIT_OBJECTS)
+		numWorkers = MAXIMUM_WAIT_OBJECTS;
+
+	for(unsigned int i = 0; i < numWorkers; i++)
+	{
+		Worker* worker = new Worker();
+		worker->pool = this;
+		worker->wakeEvent = CreateEvent(0, FALSE, FALSE, 0);
+		worker->idleEvent = CreateEvent(0, FALSE, FALSE, 0);
+		worker->thread = CreateThread(0, 0, &WorkerPool::workerProc, worker, 0, 0);
+
+		workers.push_back(worker);
+		idleEvents.push_back(worker->idleEvent);
+	}
+}
+
+WorkerPool::~WorkerPool()
+{
+	isShuttingDown = true;
+
+	for(std::vector<Worker*>::iterator i = workers.begin(); i != workers.end(); i++)
+		SetEvent((*i)->wakeEvent);
+
+	for(std::vector<Worker*>::iterator i = workers.begin(); i != workers.end(); i++)
+	{
+		WaitForSingleObject((*i)->thread, INFINITE);
+		CloseHandle((*i)->thread);
+		CloseHandle((*i)->wakeEvent);
+		CloseHandle((*i)->idleEvent);
+		delete *i;
+	}
+}
+
+unsigned int WorkerPool::getWorkerCount()
+{
+	return (unsigned int)workers.size();
+}
+
+void WorkerPool::run(TaskFunction function, void* userData, unsigned int count)
+{
+	if(!count)
+		return;
+
+	taskFunction = function;
+	taskUserData = userData;
+	taskCount = (LONG)count;
+	InterlockedExchange(&nextTask, 0);
+
+	// Don't bother waking the workers for a single task
+	if(count == 1 || workers.empty())
+	{
+		processTasks();
+		return;
+	}
+
+	for(std::vector<Worker*>::iterator i = workers.begin(); i != workers.end(); i++)
+		SetEvent((*i)->wakeEvent);
+
+	processTasks();
+
+	WaitForMultipleObjects((DWORD)idleEvents.size(), &idleEvents[0], TRUE, INFINITE);
+}
+
+void WorkerPool::processTasks()
+{
+	LONG taskIndex;
+
+	while((taskIndex = InterlockedIncrement(&nextTask) - 1) < taskCount)
+		taskFunction(taskUserData, (unsigned int)taskIndex);
+}
+
+DWORD WINAPI WorkerPool::workerProc(LPVOID param)
+{
+	Worker* worker = static_cast<Worker*>(param);
+
+	NAVI_TRACE_THREAD("Worker thread");
+
+	for(;;)
+	{
+		WaitForSingleObject(worker->wakeEvent, INFINITE);
+
+		if(worker->pool->isShuttingDown)
+			break;
+
+		worker->pool->processTasks();
+
+		SetEvent(worker->idleEvent);
+	}
+
+	return 0;
+}
\ No newline at end of file
@@ -1,6 +1,8 @@
 #include "awesomium_capi_helpers.h"
+#include "NaviAllocator.h"
 
 using namespace OSM;
+using namespace NaviLibrary;
 
 awe_jsvalue* CreateJSValueFromArray(const JSValue::Array& value)
 {
@@ -14,7 +16,8 @@ awe_jsvalue* CreateJSValueFromArray(const JSValue::Array& value)
 	}
 	else
 	{
-		awe_jsvalue** valArray = new awe_jsvalue*[value.size()];
+		size_t arraySize = value.size() * sizeof(awe_jsvalue*);
+		awe_jsvalue** valArray = static_cast<awe_jsvalue**>(Impl::allocate(arraySize, JSArrayAllocations));
 
 		size_t idx = 0;
 		for(JSValue::Array::const_iterator i = value.begin(); i != value.end(); i++)
@@ -23,6 +26,7 @@ awe_jsvalue* CreateJSValueFromArray(const JSValue::Array& value)
 		}
 
 		awe_jsarray* jsarray = awe_jsarray_create((const awe_jsvalue**)valArray, value.size());
+		Impl::deallocate(valArray, arraySize, JSArrayAllocations);
 		instance = awe_jsvalue_create_array_value(jsarray);
 		awe_jsarray_destroy(jsarray);
 	}
@@ -189,13 +193,13 @@ std::string String::str() const
 
 	if(bufSize > 0)
 	{
-		char* stringBuffer = new char[bufSize];
+		char* stringBuffer = static_cast<char*>(Impl::allocate(bufSize, StringAllocations));
 		awe_string_to_utf8(instance, stringBuffer, bufSize);
 
 		std::string result;
 		result.assign(stringBuffer, bufSize);
 
-		delete[] stringBuffer;
+		Impl::deallocate(stringBuffer, bufSize, StringAllocations);
 
 		return result;
 	}
@@ -212,13 +216,13 @@ std::wstring String::wstr() const
 
 	if(bufSize > 0)
 	{
-		wchar_t* stringBuffer = new wchar_t[bufSize];
+		wchar_t* stringBuffer = static_cast<wchar_t*>(Impl::allocate(bufSize * sizeof(wchar_t), StringAllocations));
 		awe_string_to_wide(instance, stringBuffer, bufSize);
 
 		std::wstring result;
 		result.assign(stringBuffer, bufSize);
 
-		delete[] stringBuffer;
+		Impl::deallocate(stringBuffer, bufSize * sizeof(wchar_t), StringAllocations);
 
 		return result;
 	}